@@ -0,0 +1,196 @@
+// Host benchmark of the SDI burst loop in BasicVs1053::SendData(): one
+// DREQ check, then 32 bytes through the SSP data register.
+//
+// The same driver code runs with three bus and pin types:
+//
+//   out of line  LabSpi/LabGPIO behind noinline calls, a Transfer() per
+//                byte, the way SendData() was compiled before the driver
+//                became a template
+//   inline       VS1053 as main.cpp builds it, LabSpi/LabGPIO inlined into
+//                the loop and each burst streamed with LabSpi::Write()
+//   recording    RecordingSpi/RecordingPin, the driver alone
+//
+// The first two go through the same fake registers, so only the calls
+// differ. Before timing, the recording driver is checked for the exact
+// bytes, XDCS framing and DREQ polls of a chunk.
+//
+// Times are host cycles (TSC where there is one, otherwise nanoseconds).
+// They show the call overhead that inlining removes, not Cortex-M4 cycles;
+// the SSP1 byte row of 'bench' on the board gives those.
+//
+// usage: burst_bench [--chunks=200000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "LabGPIO.hpp"
+#include "LabSpi.hpp"
+#include "RecordingBus.hpp"
+#include "VS1053.hpp"
+
+namespace
+{
+constexpr uint16_t kChunkSize = 512;
+constexpr uint16_t kBurstsPerChunk = kChunkSize / VS1053::kBurstSize;
+
+// LabSpi and LabGPIO with their hot calls forced back out of line
+class CalledSpi : public LabSpi
+{
+    public:
+        __attribute__((noinline)) uint8_t Transfer(uint8_t send) { return LabSpi::Transfer(send); }
+        // A byte at a time, each waiting out its frame
+        __attribute__((noinline)) void Write(const uint8_t * data, uint16_t size)
+        {
+            for(uint16_t i = 0; i < size; i++)
+            {
+                Transfer(data[i]);
+            }
+        }
+};
+
+class CalledPin : public LabGPIO
+{
+    public:
+        using LabGPIO::LabGPIO;
+        __attribute__((noinline)) void SetHigh() { LabGPIO::SetHigh(); }
+        __attribute__((noinline)) void SetLow() { LabGPIO::SetLow(); }
+        __attribute__((noinline)) bool ReadBool() { return LabGPIO::ReadBool(); }
+};
+
+typedef BasicVs1053<CalledSpi, CalledPin, CalledPin, CalledPin> CalledVs1053;
+typedef BasicVs1053<RecordingSpi, RecordingPin, RecordingPin, RecordingPin> RecordingVs1053;
+
+// Same pins as main.cpp
+LabGPIO XDCS(1, 30);
+LabGPIO XCS(1, 14);
+LabGPIO XRST(0, 25);
+LabGPIO DREQ(1, 23);
+CalledPin called_xdcs(1, 30);
+CalledPin called_xcs(1, 14);
+CalledPin called_xrst(0, 25);
+CalledPin called_dreq(1, 23);
+
+uint8_t chunk[kChunkSize];
+
+uint64_t Cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+template <class Driver>
+double CyclesPerBurst(Driver& driver, uint32_t chunks)
+{
+    uint64_t start = Cycles();
+    for(uint32_t i = 0; i < chunks; i++)
+    {
+        driver.SendData(chunk, sizeof(chunk));
+    }
+    return static_cast<double>(Cycles() - start) / (chunks * kBurstsPerChunk);
+}
+
+bool Check(bool condition, const char * what)
+{
+    if(!condition)
+    {
+        printf("FAIL: %s\n", what);
+    }
+    return condition;
+}
+
+// One chunk through the recording driver: every byte once and in order,
+// XDCS low around exactly those bytes, XCS untouched, DREQ read before the
+// chunk and before each burst.
+bool CheckSendData()
+{
+    RecordingPin xdcs;
+    RecordingPin xcs;
+    RecordingPin xrst;
+    RecordingPin dreq;
+    RecordingVs1053 driver(&xdcs, &xcs, &xrst, &dreq, LabSpi::SPI_Port::kPort2);
+    bool ok = true;
+
+    ok &= Check(driver.init(), "init");
+    ok &= Check(RecordingSpi::port == LabSpi::SPI_Port::kPort2, "bus opened on the driver's port");
+    ok &= Check(RecordingSpi::divide == RecordingVs1053::kStreamDivide, "bus sped up after CLOCKF");
+
+    RecordingSpi::Clear();
+    xdcs.Clear();
+    xcs.Clear();
+    dreq.Clear();
+    driver.SendData(chunk, sizeof(chunk));
+
+    ok &= Check(RecordingSpi::transfers == kChunkSize &&
+                memcmp(RecordingSpi::sent, chunk, kChunkSize) == 0, "chunk sent once, in order");
+    ok &= Check(xdcs.edges == 2 && xdcs.fell_at == 0 && xdcs.rose_at == kChunkSize,
+                "XDCS low around exactly the chunk");
+    ok &= Check(xcs.edges == 0, "XCS stays high during SDI");
+    ok &= Check(dreq.reads == 1 + kBurstsPerChunk, "DREQ read before the chunk and each burst");
+    return ok;
+}
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t chunks = 200000;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strncmp(argv[i], "--chunks=", 9) == 0)
+        {
+            chunks = strtoul(argv[i] + 9, nullptr, 0);
+        }
+    }
+    if(chunks == 0)
+    {
+        printf("usage: %s [--chunks=N]\n", argv[0]);
+        return 1;
+    }
+
+    for(uint16_t i = 0; i < kChunkSize; i++)
+    {
+        chunk[i] = i;
+    }
+    if(!CheckSendData())
+    {
+        return 2;
+    }
+
+    // DREQ high and SSP never busy, so only the driver's own work is timed
+    fake::gpio[1].PIN.value |= (1 << 23);
+    VS1053 inline_driver(&XDCS, &XCS, &XRST, &DREQ);
+    CalledVs1053 called_driver(&called_xdcs, &called_xcs, &called_xrst, &called_dreq);
+    inline_driver.init();
+    called_driver.init();
+
+    RecordingPin xdcs;
+    RecordingPin xcs;
+    RecordingPin xrst;
+    RecordingPin dreq;
+    RecordingVs1053 recording_driver(&xdcs, &xcs, &xrst, &dreq);
+    recording_driver.init();
+
+    // Warm up caches and the branch predictor before the timed runs
+    CyclesPerBurst(called_driver, chunks / 10 + 1);
+    CyclesPerBurst(inline_driver, chunks / 10 + 1);
+
+    double called = CyclesPerBurst(called_driver, chunks);
+    double inlined = CyclesPerBurst(inline_driver, chunks);
+    double recording = CyclesPerBurst(recording_driver, chunks);
+
+    printf("+-------------------------+--------------+--------------+\n");
+    printf("| %-23s | %12s | %12s |\n", "SDI 32 byte burst", "Cycles", "Relative");
+    printf("+-------------------------+--------------+--------------+\n");
+    printf("| %-23s | %12.1f | %11.0f%% |\n", "out of line (before)", called, 100.0);
+    printf("| %-23s | %12.1f | %11.0f%% |\n", "inline (VS1053)", inlined, 100.0 * inlined / called);
+    printf("| %-23s | %12.1f | %11.0f%% |\n", "recording fakes", recording, 100.0 * recording / called);
+    printf("+-------------------------+--------------+--------------+\n");
+    return 0;
+}
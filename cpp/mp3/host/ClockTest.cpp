@@ -0,0 +1,133 @@
+// Host test of ClockController: drives RecordDreq() the way the consumer
+// does and checks the CLOCKF each control period asks for.
+//
+// Covers the decay to the 2.0x floor on an easy stream, the feed forward
+// raise for a demanding format, the feedback raise when the decoder holds
+// DREQ low while the feed falls short, holding the clock when only the feed
+// is short, the minimum poll count, polls without queued data being
+// ignored, and NewTrack() releasing a pinned floor.
+//
+// usage: clock_test
+#include <cstdio>
+
+#include "ClockController.hpp"
+
+namespace
+{
+using Format = DecoderTelemetry::Format;
+
+uint32_t failures = 0;
+
+void Check(bool passed, const char * what)
+{
+    printf("%s  %s\n", passed ? "ok  " : "FAIL", what);
+    if(!passed)
+    {
+        failures++;
+    }
+}
+
+// One control period: polls consumer checks, dreq_low of them with DREQ low
+void Polls(ClockController& clock, uint16_t polls, uint16_t dreq_low, bool data_queued = true)
+{
+    for(uint16_t i = 0; i < polls; i++)
+    {
+        clock.RecordDreq(i >= dreq_low, data_queued);
+    }
+}
+
+// Runs periods of a decoder keeping up easily, @return periods that changed CLOCKF
+uint32_t Healthy(ClockController& clock, uint32_t periods, Format format, uint32_t bitrate)
+{
+    uint32_t changes = 0;
+    for(uint32_t i = 0; i < periods; i++)
+    {
+        Polls(clock, 40, 10);
+        changes += clock.Update(format, bitrate, bitrate / 8) ? 1 : 0;
+    }
+    return changes;
+}
+
+void TestDecay()
+{
+    ClockController clock;
+
+    Check(clock.GetClockf() == 0x6000, "decay: starts at the old fixed 3.0x");
+    Healthy(clock, ClockController::kStablePeriods - 1, Format::kMp3, 128000);
+    Check(clock.GetClockf() == 0x6000, "decay: holds until kStablePeriods healthy periods");
+    Check(Healthy(clock, 1, Format::kMp3, 128000) == 1 && clock.GetClockf() == 0x4000,
+          "decay: one step down, CLOCKF rewritten");
+    Healthy(clock, ClockController::kStablePeriods, Format::kMp3, 128000);
+    Check(clock.GetClockf() == 0x2000, "decay: 128 kbps MP3 settles at 2.0x");
+    Check(Healthy(clock, 5 * ClockController::kStablePeriods, Format::kMp3, 128000) == 0 &&
+          clock.GetStep() == ClockController::kMinStep, "decay: never below 2.0x, SCI reads need it");
+    Check(clock.GetDrops() == 2 && clock.GetRaises() == 0, "decay: two drops counted");
+}
+
+void TestFeedForward()
+{
+    ClockController clock;
+
+    Healthy(clock, 2 * ClockController::kStablePeriods, Format::kMp3, 128000);
+    Polls(clock, 40, 10);
+    bool changed = clock.Update(Format::kFlac, 900000, 0);
+    Check(changed && clock.GetClockf() == 0xE000, "feed forward: FLAC raises to 4.5x plus one step at once");
+
+    // 320 kbps MP3 needs 3.0x, decays to it and no further
+    clock.NewTrack();
+    Healthy(clock, 10 * ClockController::kStablePeriods, Format::kMp3, 320000);
+    Check(clock.GetStep() == ClockController::RequiredStep(Format::kMp3, 320000),
+          "feed forward: a new track decays to its own floor");
+}
+
+void TestFeedback()
+{
+    ClockController clock;
+
+    // Decoder FIFO full on 95% of polls and the feed 20% short
+    Polls(clock, 40, 38);
+    bool changed = clock.Update(Format::kMp3, 320000, 32000);
+    Check(changed && clock.GetClockf() == 0xA000, "feedback: busy decoder and short feed raise two steps");
+    Check(clock.GetRaises() == 1, "feedback: raise counted");
+
+    Healthy(clock, 5 * ClockController::kStablePeriods, Format::kMp3, 320000);
+    Check(clock.GetClockf() == 0xA000, "feedback: floor pinned for the rest of the track");
+
+    clock.NewTrack();
+    Healthy(clock, 5 * ClockController::kStablePeriods, Format::kMp3, 320000);
+    Check(clock.GetClockf() == 0x6000, "feedback: NewTrack() lets it decay again");
+}
+
+void TestHolds()
+{
+    ClockController clock;
+
+    // The feed is short but DREQ is high: the card is slow, not the decoder
+    uint32_t changes = 0;
+    for(uint8_t i = 0; i < 3 * ClockController::kStablePeriods; i++)
+    {
+        Polls(clock, 40, 4);
+        changes += clock.Update(Format::kMp3, 128000, 8000) ? 1 : 0;
+    }
+    Check(changes == 0 && clock.GetClockf() == 0x6000, "short feed, idle decoder: clock held, no decay either");
+
+    // Busy on every poll but too few polls to tell
+    Polls(clock, ClockController::kMinPolls - 1, ClockController::kMinPolls - 1);
+    Check(!clock.Update(Format::kMp3, 128000, 8000), "fewer than kMinPolls polls: not counted as busy");
+
+    // DREQ low while starved says nothing about load
+    Polls(clock, 40, 40, false);
+    Check(!clock.Update(Format::kMp3, 128000, 8000), "polls without queued data are ignored");
+}
+}
+
+int main()
+{
+    TestDecay();
+    TestFeedForward();
+    TestFeedback();
+    TestHolds();
+
+    printf("\n%s, %lu failed\n", failures ? "FAILED" : "PASSED", static_cast<unsigned long>(failures));
+    return failures ? 1 : 0;
+}
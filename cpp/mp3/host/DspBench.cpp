@@ -0,0 +1,361 @@
+// Host checks and timing of the PCM DSP stage (PcmDsp).
+//
+//   bit exactness  ProcessSimd(), built on the emulated SMLAD/PKHBT/SSAT,
+//                  against ProcessScalar() over random band settings,
+//                  sample rates and channel counts, fed noise, sweeps,
+//                  impulses and full scale squares in uneven chunks so the
+//                  filter state is carried across calls
+//   response       gain of -20 dBFS sines at each band's frequency against
+//                  the band's setting, which shows how much the 16 bit
+//                  coefficients give away
+//   limiter        every 16 bit value in ascending order through +12 dB of
+//                  gain: the output stays within full scale, never steps
+//                  down, and GetLimited() counts exactly the samples past
+//                  the knee
+//   cycles         host cycles per sample (TSC where there is one,
+//                  otherwise nanoseconds) of both paths with four bands on
+//                  stereo. Only the scalar row means anything here, the
+//                  SIMD row times the emulation; 'dsp bench' on the board
+//                  gives Cortex-M4 cycles for both.
+//
+// usage: dsp_bench [--configs=200] [--seconds=10]
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "PcmDsp.hpp"
+
+namespace
+{
+constexpr uint32_t kSignalFrames = 16384;
+// What one 4 chunk read holds, 2048 bytes of 16 bit stereo
+constexpr uint32_t kReadFrames = 512;
+constexpr double kResponseTolerance = 0.5;      // dB
+
+struct Options
+{
+    uint32_t configs = 200;
+    uint32_t seconds = 10;
+};
+
+bool ParseOption(const char * arg, const char * name, uint32_t * value)
+{
+    size_t length = strlen(name);
+    if(strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = strtoul(arg + length + 1, nullptr, 0);
+        return true;
+    }
+    return false;
+}
+
+uint64_t Cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Interleaved test signal, every channel different
+std::vector<int16_t> MakeSignal(uint8_t kind, uint8_t channels, uint32_t rate, std::mt19937& random)
+{
+    std::vector<int16_t> signal(kSignalFrames * channels);
+    std::uniform_int_distribution<int> noise(-32768, 32767);
+
+    for(uint32_t frame = 0; frame < kSignalFrames; frame++)
+    {
+        for(uint8_t channel = 0; channel < channels; channel++)
+        {
+            double t = static_cast<double>(frame) / rate;
+            int32_t value = 0;
+            switch(kind)
+            {
+                case 0:
+                    value = noise(random);
+                    break;
+                case 1:     // 20 Hz to Nyquist
+                    value = static_cast<int32_t>(32000 * sin(2 * M_PI * 20 * t *
+                        pow(rate / 40.0, static_cast<double>(frame) / kSignalFrames)));
+                    break;
+                case 2:
+                    value = (frame % 1000 == channel) ? 32767 : 0;
+                    break;
+                default:
+                    value = ((frame / (50 + channel * 7)) & 1) ? 32767 : -32768;
+                    break;
+            }
+            signal[frame * channels + channel] = static_cast<int16_t>(value);
+        }
+    }
+    return signal;
+}
+
+PcmDsp::Band RandomBand(std::mt19937& random)
+{
+    PcmDsp::Band band;
+    band.type = static_cast<PcmDsp::BandType>(random() % 4);
+    band.gain_db = PcmDsp::kMinBandGain + random() % (PcmDsp::kMaxBandGain - PcmDsp::kMinBandGain + 1);
+    band.q_tenths = PcmDsp::kMinQ + random() % (PcmDsp::kMaxQ - PcmDsp::kMinQ + 1);
+    band.frequency = PcmDsp::kMinFrequency + random() % 20000;
+    return band;
+}
+
+// Feeds both paths the same chunks, the way the reader hands them over
+uint32_t CompareRun(PcmDsp& scalar, PcmDsp& simd, const std::vector<int16_t>& signal,
+                    uint8_t channels, std::mt19937& random)
+{
+    std::vector<int16_t> a(signal);
+    std::vector<int16_t> b(signal);
+    uint32_t mismatches = 0;
+
+    for(uint32_t frame = 0; frame < kSignalFrames;)
+    {
+        uint32_t frames = 1 + random() % kReadFrames;
+        if(frames > kSignalFrames - frame)
+        {
+            frames = kSignalFrames - frame;
+        }
+        scalar.ProcessScalar(&a[frame * channels], frames);
+        simd.ProcessSimd(&b[frame * channels], frames);
+        frame += frames;
+    }
+    for(size_t i = 0; i < a.size(); i++)
+    {
+        mismatches += (a[i] != b[i]);
+    }
+    return mismatches;
+}
+
+bool CheckBitExact(const Options& options)
+{
+    std::mt19937 random(1);
+    static const uint32_t kRates[] = { 8000, 22050, 32000, 44100, 48000 };
+    uint64_t compared = 0;
+    uint32_t mismatches = 0;
+    uint32_t failed = 0;
+
+    for(uint32_t config = 0; config < options.configs; config++)
+    {
+        PcmDsp scalar;
+        PcmDsp simd;
+        uint32_t rate = kRates[random() % 5];
+        uint8_t channels = 1 + random() % 2;
+        int8_t gain = PcmDsp::kMinGain + random() % (PcmDsp::kMaxGain - PcmDsp::kMinGain + 1);
+
+        for(PcmDsp * dsp : { &scalar, &simd })
+        {
+            dsp->SetFormat(rate, channels);
+            dsp->SetGain(gain);
+            dsp->SetEnabled(true);
+        }
+        for(uint8_t band = 0; band < PcmDsp::kMaxBands; band++)
+        {
+            PcmDsp::Band settings = RandomBand(random);
+            scalar.SetBand(band, settings);
+            simd.SetBand(band, settings);
+        }
+        for(uint8_t kind = 0; kind < 4; kind++)
+        {
+            std::vector<int16_t> signal = MakeSignal(kind, channels, rate, random);
+            uint32_t differ = CompareRun(scalar, simd, signal, channels, random);
+            mismatches += differ;
+            failed += (differ != 0);
+            compared += signal.size();
+        }
+    }
+
+    printf("Bit exactness: %u configurations, %llu samples, %u differ (%u runs)\n",
+           options.configs, static_cast<unsigned long long>(compared), mismatches, failed);
+    return mismatches == 0;
+}
+
+double MeasureGain(const PcmDsp::Band& band, uint32_t rate, uint32_t frequency)
+{
+    PcmDsp dsp;
+    std::vector<int16_t> signal(rate);
+    double in = 0;
+    double out = 0;
+
+    dsp.SetFormat(rate, 1);
+    dsp.SetBand(0, band);
+    dsp.SetEnabled(true);
+    for(uint32_t i = 0; i < rate; i++)
+    {
+        signal[i] = static_cast<int16_t>(3276 * sin(2 * M_PI * frequency * i / rate));
+    }
+    std::vector<int16_t> original(signal);
+    dsp.ProcessScalar(signal.data(), rate);
+    // Second half only, past the filter settling
+    for(uint32_t i = rate / 2; i < rate; i++)
+    {
+        in += static_cast<double>(original[i]) * original[i];
+        out += static_cast<double>(signal[i]) * signal[i];
+    }
+    return 10 * log10(out / in);
+}
+
+bool CheckResponse()
+{
+    struct Case
+    {
+        const char * name;
+        PcmDsp::Band band;
+        uint32_t measure_at;
+    };
+    static const Case kCases[] = {
+        { "peak 1 kHz +6",      { PcmDsp::BandType::kPeaking, 6, 14, 1000 }, 1000 },
+        { "peak 1 kHz -12",     { PcmDsp::BandType::kPeaking, -12, 14, 1000 }, 1000 },
+        { "peak 3 kHz +12 Q4",  { PcmDsp::BandType::kPeaking, 12, 40, 3000 }, 3000 },
+        { "peak 80 Hz -12",     { PcmDsp::BandType::kPeaking, -12, 7, 80 }, 80 },
+        { "peak 100 Hz -6",     { PcmDsp::BandType::kPeaking, -6, 7, 100 }, 100 },
+        { "low shelf 100 +9",   { PcmDsp::BandType::kLowShelf, 9, 7, 100 }, 20 },
+        { "low shelf 300 -9",   { PcmDsp::BandType::kLowShelf, -9, 7, 300 }, 50 },
+        { "high shelf 8k +6",   { PcmDsp::BandType::kHighShelf, 6, 7, 8000 }, 18000 },
+        { "high shelf 4k -12",  { PcmDsp::BandType::kHighShelf, -12, 7, 4000 }, 16000 },
+    };
+    bool passed = true;
+
+    printf("+----------------------+------------+------------+\n");
+    printf("| %-20s | %10s | %10s |\n", "44.1 kHz band", "Set (dB)", "Got (dB)");
+    printf("+----------------------+------------+------------+\n");
+    for(const Case& test : kCases)
+    {
+        double measured = MeasureGain(test.band, 44100, test.measure_at);
+        bool close = fabs(measured - test.band.gain_db) <= kResponseTolerance;
+        passed = passed && close;
+        printf("| %-20s | %10d | %10.2f |%s\n", test.name, test.band.gain_db, measured,
+               close ? "" : " off");
+    }
+    printf("+----------------------+------------+------------+\n");
+    return passed;
+}
+
+bool CheckLimiter()
+{
+    constexpr int8_t kGain = 12;
+    PcmDsp dsp;
+    std::vector<int16_t> signal(65536);
+    uint32_t over_knee = 0;
+    uint32_t steps_down = 0;
+    int32_t peak = 0;
+
+    // Bands off, the gain alone drives most of the ramp past the knee
+    dsp.SetFormat(44100, 1);
+    dsp.SetGain(kGain);
+    dsp.SetEnabled(true);
+    for(uint32_t i = 0; i < signal.size(); i++)
+    {
+        signal[i] = static_cast<int16_t>(static_cast<int32_t>(i) - 32768);
+    }
+    dsp.ProcessScalar(signal.data(), signal.size());
+
+    for(uint32_t i = 0; i < signal.size(); i++)
+    {
+        int32_t magnitude = (signal[i] < 0) ? -signal[i] : signal[i];
+        // Only the limiter puts a sample over the knee
+        over_knee += (magnitude > PcmDsp::kLimiterKnee);
+        peak = (magnitude > peak) ? magnitude : peak;
+        steps_down += (i > 0 && signal[i] < signal[i - 1]);
+    }
+
+    bool passed = peak <= PcmDsp::kFullScale && steps_down == 0 && over_knee > 0 &&
+                  dsp.GetLimited() == over_knee;
+    printf("Limiter: +%d dB over every 16 bit value, %u limited (%u over the knee), peak %d, "
+           "%u steps down%s\n", kGain, dsp.GetLimited(), over_knee, peak, steps_down, passed ? "" : " FAILED");
+    return passed;
+}
+
+// Every pass starts from the original signal again, the copy costs well
+// under a cycle per sample
+double CyclesPerSample(PcmDsp& dsp, bool simd, const std::vector<int16_t>& original, uint32_t passes)
+{
+    std::vector<int16_t> signal(original.size());
+    uint64_t start = Cycles();
+    for(uint32_t pass = 0; pass < passes; pass++)
+    {
+        memcpy(signal.data(), original.data(), signal.size() * sizeof(int16_t));
+        for(uint32_t frame = 0; frame < kSignalFrames; frame += kReadFrames)
+        {
+            if(simd)
+            {
+                dsp.ProcessSimd(&signal[frame * 2], kReadFrames);
+            }
+            else
+            {
+                dsp.ProcessScalar(&signal[frame * 2], kReadFrames);
+            }
+        }
+    }
+    return static_cast<double>(Cycles() - start) / (static_cast<double>(passes) * signal.size());
+}
+
+void Time(const Options& options)
+{
+    static const PcmDsp::Band kBands[PcmDsp::kMaxBands] = {
+        { PcmDsp::BandType::kLowShelf, 6, 7, 100 },
+        { PcmDsp::BandType::kPeaking, -4, 14, 1000 },
+        { PcmDsp::BandType::kPeaking, 3, 10, 3000 },
+        { PcmDsp::BandType::kHighShelf, -3, 7, 10000 },
+    };
+    std::mt19937 random(2);
+    PcmDsp dsp;
+    // 44.1 kHz stereo for --seconds, a little at a time
+    uint32_t passes = options.seconds * 44100 / kSignalFrames + 1;
+
+    dsp.SetFormat(44100, 2);
+    for(uint8_t band = 0; band < PcmDsp::kMaxBands; band++)
+    {
+        dsp.SetBand(band, kBands[band]);
+    }
+    dsp.SetEnabled(true);
+    // A -12 dBFS sweep, under the knee even with the boosts
+    std::vector<int16_t> signal = MakeSignal(1, 2, 44100, random);
+    for(int16_t& sample : signal)
+    {
+        sample /= 4;
+    }
+
+    CyclesPerSample(dsp, false, signal, passes / 10 + 1);
+    double scalar = CyclesPerSample(dsp, false, signal, passes);
+    double simd = CyclesPerSample(dsp, true, signal, passes);
+
+    printf("+----------------------+------------+\n");
+    printf("| %-20s | %10s |\n", "4 bands, stereo", "Cycles");
+    printf("+----------------------+------------+\n");
+    printf("| %-20s | %10.1f |\n", "scalar", scalar);
+    printf("| %-20s | %10.1f |\n", "SIMD (emulated)", simd);
+    printf("+----------------------+------------+\n");
+    printf("Limiter changed %u of %u timed samples, the sweep stays under the knee\n", dsp.GetLimited(),
+           dsp.GetSamples());
+}
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!ParseOption(argv[i], "--configs", &options.configs) &&
+           !ParseOption(argv[i], "--seconds", &options.seconds))
+        {
+            printf("usage: %s [--configs=N] [--seconds=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bool exact = CheckBitExact(options);
+    bool response = CheckResponse();
+    bool limiter = CheckLimiter();
+    Time(options);
+    return (exact && response && limiter) ? 0 : 2;
+}
@@ -0,0 +1,33 @@
+#include "L0_LowLevel/LPC40xx.h"
+#include "utility/time.hpp"
+
+namespace fake
+{
+LPC_GPIO_TypeDef gpio[6];
+LPC_GPIOINT_TypeDef gpioint;
+// SR reads TFE | TNF: the transmit FIFO always has room and no frame is
+// ever busy, the simulator finishes each byte as it is written
+LPC_SSP_TypeDef ssp[3] = { { 0, 0, {}, 0x3 }, { 0, 0, {}, 0x3 }, { 0, 0, {}, 0x3 } };
+LPC_SC_TypeDef sc;
+LPC_IOCON_TypeDef iocon;
+DWT_Type dwt = { 0, { 0, [](FakeRegister&) { return static_cast<uint32_t>(sim::Now() * 96 / 1000); } } };
+CoreDebug_Type core_debug;
+}
+
+namespace sim
+{
+namespace
+{
+uint64_t now = 0;
+}
+
+uint64_t Now()
+{
+    return now;
+}
+
+void Advance(uint64_t nanoseconds)
+{
+    now += nanoseconds;
+}
+}
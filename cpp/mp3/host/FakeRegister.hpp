@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// Stand-in for a memory mapped peripheral register on the host.
+//
+// Reads and writes behave like a plain uint32_t unless a hook is attached,
+// in which case the simulator sees every access. This lets the unmodified
+// LabGPIO and LabSpi sources drive a simulated VS1053.
+class FakeRegister
+{
+    public:
+        typedef uint32_t (*ReadHook)(FakeRegister& reg);
+        typedef void (*WriteHook)(FakeRegister& reg, uint32_t value);
+
+        operator uint32_t()
+        {
+            return (on_read) ? on_read(*this) : value;
+        }
+        FakeRegister& operator=(uint32_t new_value)
+        {
+            value = new_value;
+            if(on_write)
+            {
+                on_write(*this, new_value);
+            }
+            return *this;
+        }
+        FakeRegister& operator|=(uint32_t bits) { return *this = static_cast<uint32_t>(*this) | bits; }
+        FakeRegister& operator&=(uint32_t bits) { return *this = static_cast<uint32_t>(*this) & bits; }
+        FakeRegister& operator^=(uint32_t bits) { return *this = static_cast<uint32_t>(*this) ^ bits; }
+
+        uint32_t value = 0;
+        ReadHook on_read = nullptr;
+        WriteHook on_write = nullptr;
+};
@@ -0,0 +1,97 @@
+#include "FreeRTOS.h"
+
+#include <cstring>
+
+#include "utility/time.hpp"
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t * storage,
+                                 StaticQueue_t * queue)
+{
+    queue->storage = storage;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t)
+{
+    if(queue->count == queue->length)
+    {
+        return errQUEUE_FULL;
+    }
+    UBaseType_t slot = (queue->head + queue->count) % queue->length;
+    memcpy(&queue->storage[slot * queue->item_size], item, queue->item_size);
+    queue->count++;
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void * item, BaseType_t *)
+{
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t)
+{
+    if(queue->count == 0)
+    {
+        return pdFALSE;
+    }
+    memcpy(item, &queue->storage[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    queue->head = 0;
+    queue->count = 0;
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    return queue->length - queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t * mutex)
+{
+    mutex->taken = false;
+    return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t)
+{
+    if(mutex->taken)
+    {
+        return pdFALSE;
+    }
+    mutex->taken = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    mutex->taken = false;
+    return pdTRUE;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    if(task)
+    {
+        task->notifications++;
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim::Advance(ticks * 1000000ULL);
+}
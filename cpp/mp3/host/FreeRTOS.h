@@ -0,0 +1,70 @@
+// Host replacement for the FreeRTOS headers the player's pipeline code
+// includes (FreeRTOS.h, queue.h, semphr.h, task.h).
+//
+// The benches run every task on one thread, so nothing here ever blocks: a
+// queue is a plain ring, a mutex is always free when taken, a notify only
+// counts and a critical section does nothing. A call that would have waited
+// on the target returns at once and the bench decides which task runs
+// next. A tick is one millisecond of simulated time.
+#pragma once
+
+#include <cstdint>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE             ((BaseType_t)0)
+#define pdTRUE              ((BaseType_t)1)
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define errQUEUE_FULL       ((BaseType_t)0)
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFF)
+#define configTICK_RATE_HZ  1000
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+#define portYIELD_FROM_ISR(woken)   ((void)(woken))
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define taskENTER_CRITICAL_FROM_ISR()       ((UBaseType_t)0)
+#define taskEXIT_CRITICAL_FROM_ISR(state)   ((void)(state))
+
+struct StaticQueue_t
+{
+    uint8_t * storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+typedef StaticQueue_t * QueueHandle_t;
+
+struct StaticSemaphore_t
+{
+    bool taken;
+};
+typedef StaticSemaphore_t * SemaphoreHandle_t;
+
+struct StaticTask_t
+{
+    uint32_t notifications;
+};
+typedef StaticTask_t * TaskHandle_t;
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t * storage,
+                                 StaticQueue_t * queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void * item, BaseType_t * woken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t wait);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t * mutex);
+/// Only fails when the one thread already holds it, a deadlock on target
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+void xTaskNotifyGive(TaskHandle_t task);
+/// Advances simulated time, nothing else runs meanwhile
+void vTaskDelay(TickType_t ticks);
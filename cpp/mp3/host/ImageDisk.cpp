@@ -0,0 +1,157 @@
+#include "ImageDisk.hpp"
+
+#include <cstdio>
+#include <ctime>
+
+#include "ff.h"
+#include "diskio.h"
+#include "utility/time.hpp"
+
+#if FF_FS_REENTRANT
+#error "Host build expects FF_FS_REENTRANT 0, the bench is single threaded"
+#endif
+
+#if defined(FF_DEFINED) && FF_DEFINED >= 86606
+typedef LBA_t SectorAddress;
+#else
+typedef DWORD SectorAddress;
+#endif
+
+namespace
+{
+constexpr UINT kSectorSize = 512;
+FILE * image = nullptr;
+uint32_t read_cost = 0;
+uint32_t byte_cost = 0;
+uint32_t reads = 0;
+uint64_t read_time = 0;
+}
+
+namespace ImageDisk
+{
+bool Open(const char * path)
+{
+    image = fopen(path, "r+b");
+    return (image != nullptr);
+}
+
+void Close()
+{
+    if(image)
+    {
+        fclose(image);
+        image = nullptr;
+    }
+}
+
+void SetReadCost(uint32_t per_read_ns, uint32_t per_byte_ns)
+{
+    read_cost = per_read_ns;
+    byte_cost = per_byte_ns;
+}
+
+uint32_t GetReads()
+{
+    return reads;
+}
+
+uint64_t GetReadTime()
+{
+    return read_time;
+}
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+    return (pdrv == 0 && image) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+    return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE * buff, SectorAddress sector, UINT count)
+{
+    if(disk_status(pdrv))
+    {
+        return RES_NOTRDY;
+    }
+    if(fseek(image, static_cast<long>(sector) * kSectorSize, SEEK_SET) != 0 ||
+       fread(buff, kSectorSize, count, image) != count)
+    {
+        return RES_ERROR;
+    }
+    uint64_t cost = read_cost + uint64_t(byte_cost) * kSectorSize * count;
+    sim::Advance(cost);
+    read_time += cost;
+    reads++;
+    return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE * buff, SectorAddress sector, UINT count)
+{
+    if(disk_status(pdrv))
+    {
+        return RES_NOTRDY;
+    }
+    if(fseek(image, static_cast<long>(sector) * kSectorSize, SEEK_SET) != 0 ||
+       fwrite(buff, kSectorSize, count, image) != count)
+    {
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void * buff)
+{
+    if(disk_status(pdrv))
+    {
+        return RES_NOTRDY;
+    }
+
+    switch(cmd)
+    {
+        case CTRL_SYNC:
+            fflush(image);
+            return RES_OK;
+        case GET_SECTOR_COUNT:
+            fseek(image, 0, SEEK_END);
+            *static_cast<SectorAddress *>(buff) = ftell(image) / kSectorSize;
+            return RES_OK;
+        case GET_SECTOR_SIZE:
+            *static_cast<WORD *>(buff) = kSectorSize;
+            return RES_OK;
+        case GET_BLOCK_SIZE:
+            *static_cast<DWORD *>(buff) = 1;
+            return RES_OK;
+        default:
+            return RES_PARERR;
+    }
+}
+
+#if !FF_FS_READONLY && !FF_FS_NORTC
+DWORD get_fattime(void)
+{
+    time_t now = time(nullptr);
+    struct tm * t = localtime(&now);
+    return (static_cast<DWORD>(t->tm_year - 80) << 25) |
+           (static_cast<DWORD>(t->tm_mon + 1) << 21) |
+           (static_cast<DWORD>(t->tm_mday) << 16) |
+           (static_cast<DWORD>(t->tm_hour) << 11) |
+           (static_cast<DWORD>(t->tm_min) << 5) |
+           (static_cast<DWORD>(t->tm_sec) >> 1);
+}
+#endif
+
+#if FF_USE_LFN == 3
+void * ff_memalloc(UINT msize)
+{
+    return new BYTE[msize];
+}
+
+void ff_memfree(void * mblock)
+{
+    delete[] static_cast<BYTE *>(mblock);
+}
+#endif
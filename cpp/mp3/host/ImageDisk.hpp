@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// FatFS disk driver backed by a raw FAT image file on the host, e.g. one
+// made with: mkfs.vfat -C sd.img 65536 && mcopy -i sd.img *.mp3 ::
+//
+// Reads can be given a cost in simulated time, the command and access time
+// of the card plus its transfer time, so f_read() takes as long as it would
+// on the SD card.
+namespace ImageDisk
+{
+bool Open(const char * path);
+void Close();
+/// @param per_read_ns - every disk_read() call, however many sectors
+/// @param per_byte_ns - every byte read
+void SetReadCost(uint32_t per_read_ns, uint32_t per_byte_ns);
+/// @return disk_read() calls so far
+uint32_t GetReads();
+/// @return simulated time spent in disk_read(), ns
+uint64_t GetReadTime();
+}
@@ -0,0 +1,114 @@
+// Host replacement for the LPC40xx device header. Only the peripherals the
+// mp3 project touches are declared; registers the simulator needs to see
+// are FakeRegisters, the rest are plain memory.
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "FakeRegister.hpp"
+
+enum IRQn_Type
+{
+    GPIO_IRQn = 38
+};
+
+struct LPC_GPIO_TypeDef
+{
+    uint32_t DIR;
+    uint32_t RESERVED0[3];
+    uint32_t MASK;
+    FakeRegister PIN;
+    uint32_t SET;
+    uint32_t CLR;
+};
+
+struct LPC_GPIOINT_TypeDef
+{
+    uint32_t IntStatus;
+    uint32_t IO0IntStatR;
+    uint32_t IO0IntStatF;
+    uint32_t IO0IntClr;
+    uint32_t IO0IntEnR;
+    uint32_t IO0IntEnF;
+    uint32_t IO2IntStatR;
+    uint32_t IO2IntStatF;
+    uint32_t IO2IntClr;
+    uint32_t IO2IntEnR;
+    uint32_t IO2IntEnF;
+};
+
+struct LPC_SSP_TypeDef
+{
+    uint32_t CR0;
+    uint32_t CR1;
+    FakeRegister DR;
+    uint32_t SR;
+    uint32_t CPSR;
+    uint32_t IMSC;
+    uint32_t RIS;
+    uint32_t MIS;
+    uint32_t ICR;
+    uint32_t DMACR;
+};
+
+struct LPC_SC_TypeDef
+{
+    uint32_t PCONP;
+};
+
+// Cycle counter for TraceBuffer, reads the simulated clock at 96 MHz
+struct DWT_Type
+{
+    uint32_t CTRL;
+    FakeRegister CYCCNT;
+};
+
+struct CoreDebug_Type
+{
+    uint32_t DEMCR;
+};
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+struct LPC_IOCON_TypeDef
+{
+    uint32_t P0_7;
+    uint32_t P0_8;
+    uint32_t P0_9;
+    uint32_t P1_0;
+    uint32_t P1_1;
+    uint32_t P1_4;
+    uint32_t P1_15;
+    uint32_t P1_19;
+    uint32_t P2_22;
+    uint32_t P2_26;
+    uint32_t P2_27;
+};
+
+namespace fake
+{
+extern LPC_GPIO_TypeDef gpio[6];
+extern LPC_GPIOINT_TypeDef gpioint;
+extern LPC_SSP_TypeDef ssp[3];
+extern LPC_SC_TypeDef sc;
+extern LPC_IOCON_TypeDef iocon;
+extern DWT_Type dwt;
+extern CoreDebug_Type core_debug;
+}
+
+#define LPC_GPIO0   (&fake::gpio[0])
+#define LPC_GPIO1   (&fake::gpio[1])
+#define LPC_GPIO2   (&fake::gpio[2])
+#define LPC_GPIO3   (&fake::gpio[3])
+#define LPC_GPIO4   (&fake::gpio[4])
+#define LPC_GPIO5   (&fake::gpio[5])
+#define LPC_GPIOINT (&fake::gpioint)
+#define LPC_SSP0    (&fake::ssp[0])
+#define LPC_SSP1    (&fake::ssp[1])
+#define LPC_SSP2    (&fake::ssp[2])
+#define LPC_SC      (&fake::sc)
+#define LPC_IOCON   (&fake::iocon)
+#define DWT         (&fake::dwt)
+#define CoreDebug   (&fake::core_debug)
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "L0_LowLevel/LPC40xx.h"
+
+typedef void (*IsrPointer)(void);
+
+// No interrupts on the host, handlers are never called
+inline void RegisterIsr(IRQn_Type, IsrPointer, bool = true, int32_t = -1)
+{
+}
@@ -0,0 +1,110 @@
+// Compares the old track list (256 byte name plus a whole ID3v1 tag per
+// track) with TrackLibrary on memory per track, scan cost and the title
+// lookups the song list does on every frame.
+//
+// usage: library_bench [tracks] [lookups]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "TrackLibrary.hpp"
+
+namespace
+{
+// Old layout from main.cpp
+ID3v1_t mp3_files[TrackLibrary::kMaxTracks];
+char fileName[TrackLibrary::kMaxTracks][256];
+
+TrackLibrary library;
+
+// Typical rip: 8.3 short name and a title shared by a few tracks
+void MakeTrack(uint32_t i, char * name, ID3v1_t * tag)
+{
+    memset(tag->buffer, 0, sizeof(tag->buffer));
+    memcpy(tag->header, "TAG", 3);
+    snprintf(name, 16, "TRACK%03u.MP3", static_cast<unsigned>(i % 1000));
+    char title[48];
+    int length = snprintf(title, sizeof(title), "Song Number %u Extended Mix", static_cast<unsigned>(i / 2));
+    memcpy(tag->title, title, (length < 30) ? length : 30);
+    memcpy(tag->artist, "Khalil's Kids", 13);
+    memcpy(tag->album, "Greatest Hits", 13);
+}
+
+template <typename Function>
+double Time(Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t tracks = (argc > 1) ? strtoul(argv[1], nullptr, 10) : TrackLibrary::kMaxTracks;
+    uint32_t lookups = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 1000000;
+    if(tracks == 0 || tracks > TrackLibrary::kMaxTracks)
+    {
+        tracks = TrackLibrary::kMaxTracks;
+    }
+
+    char name[16];
+    ID3v1_t tag;
+
+    double old_scan = Time([&]() {
+        for(uint32_t i = 0; i < tracks; i++)
+        {
+            MakeTrack(i, name, &tag);
+            strcpy(fileName[i], name);
+            mp3_files[i] = tag;
+        }
+    });
+    double new_scan = Time([&]() {
+        for(uint32_t i = 0; i < tracks; i++)
+        {
+            MakeTrack(i, name, &tag);
+            library.Add(name, &tag, 1 << 20, i);
+        }
+    });
+
+    // Same access pattern as printSongList: 15 characters of a title
+    volatile uint32_t checksum = 0;
+    char title[16] = { 0 };
+    double old_lookup = Time([&]() {
+        for(uint32_t n = 0; n < lookups; n++)
+        {
+            memcpy(title, mp3_files[n % tracks].title, 15);
+            checksum += title[n % 15];
+        }
+    });
+    double new_lookup = Time([&]() {
+        for(uint32_t n = 0; n < lookups; n++)
+        {
+            strncpy(title, library.GetTitle(n % tracks), 15);
+            checksum += title[n % 15];
+        }
+    });
+    double new_pointer = Time([&]() {
+        for(uint32_t n = 0; n < lookups; n++)
+        {
+            checksum += library.GetTitle(n % tracks)[n % 15];
+        }
+    });
+
+    size_t old_bytes = sizeof(mp3_files) + sizeof(fileName);
+    size_t new_bytes = sizeof(library);
+    printf("%lu tracks, arena %u of %u bytes (%u saved by sharing), %lu overflows, %lu arena full\n",
+           static_cast<unsigned long>(tracks), library.GetArenaUsed(), TrackLibrary::kArenaSize,
+           library.GetArenaSaved(), static_cast<unsigned long>(library.GetOverflows()),
+           static_cast<unsigned long>(library.GetArenaFull()));
+    printf("%-22s %12s %12s\n", "", "old", "library");
+    printf("%-22s %12zu %12zu\n", "bytes", old_bytes, new_bytes);
+    printf("%-22s %12zu %12zu\n", "bytes per track",
+           old_bytes / TrackLibrary::kMaxTracks, new_bytes / TrackLibrary::kMaxTracks);
+    printf("%-22s %12.1f %12.1f\n", "scan (us)", old_scan, new_scan);
+    printf("%-22s %12.2f %12.2f\n", "title copy (ns)",
+           old_lookup * 1000 / lookups, new_lookup * 1000 / lookups);
+    printf("%-22s %12s %12.2f\n", "title pointer (ns)", "-", new_pointer * 1000 / lookups);
+    return 0;
+}
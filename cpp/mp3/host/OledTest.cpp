@@ -0,0 +1,253 @@
+// Host test of BasicOledFramebuffer against a fake SSD1306 that keeps its
+// own display RAM and decodes the column/page window commands.
+//
+// Checks Diff() on the cases that matter (clean, one cell, both edges, the
+// whole page), that after every Flush() the fake's display RAM is exactly a
+// full render of what was drawn, and that Flush() reports the bytes the
+// panel really received. Ends with the bytes of typical frames next to the
+// 1 KB OledTerminal sent for every printf.
+//
+// usage: oled_test
+#include <cstdio>
+#include <cstring>
+
+#include "OledFramebuffer.hpp"
+
+namespace
+{
+constexpr uint8_t kPanelColumns = 128;
+
+// SSD1306 in horizontal addressing mode, the only mode the framebuffer uses
+class FakePanel
+{
+    public:
+        FakePanel()
+        {
+            memset(ram, 0, sizeof(ram));
+        }
+
+        void Command(uint8_t command)
+        {
+            command_bytes++;
+            if(arguments_left)
+            {
+                argument[2 - arguments_left] = command;
+                if(--arguments_left == 0)
+                {
+                    Window();
+                }
+                return;
+            }
+            if(command == 0x21 || command == 0x22)
+            {
+                window_command = command;
+                arguments_left = 2;
+            }
+        }
+
+        void Data(const uint8_t * bytes, uint16_t count)
+        {
+            for(uint16_t i = 0; i < count; i++)
+            {
+                ram[page][column] = bytes[i];
+                if(column++ == column_end)
+                {
+                    column = column_start;
+                    page = (page == page_end) ? page_start : page + 1;
+                }
+            }
+            data_bytes += count;
+        }
+
+        uint8_t ram[8][kPanelColumns];
+        uint32_t command_bytes = 0;
+        uint32_t data_bytes = 0;
+
+    private:
+        void Window()
+        {
+            if(window_command == 0x21)
+            {
+                column_start = column = argument[0];
+                column_end = argument[1];
+            }
+            else
+            {
+                page_start = page = argument[0];
+                page_end = argument[1];
+            }
+        }
+
+        uint8_t window_command = 0;
+        uint8_t argument[2];
+        uint8_t arguments_left = 0;
+        uint8_t column_start = 0;
+        uint8_t column_end = kPanelColumns - 1;
+        uint8_t page_start = 0;
+        uint8_t page_end = 7;
+        uint8_t column = 0;
+        uint8_t page = 0;
+};
+
+using Framebuffer = BasicOledFramebuffer<FakePanel>;
+
+uint32_t failures = 0;
+
+void Check(bool passed, const char * what)
+{
+    printf("%s  %s\n", passed ? "ok  " : "FAIL", what);
+    if(!passed)
+    {
+        failures++;
+    }
+}
+
+// What the whole panel should hold for these 8 lines of 16 characters
+bool PanelShows(const FakePanel& panel, const char text[8][17])
+{
+    for(uint8_t page = 0; page < 8; page++)
+    {
+        for(uint8_t cell = 0; cell < 16; cell++)
+        {
+            const uint8_t * glyph = oled_font::Glyph(text[page][cell]);
+            const uint8_t * shown = &panel.ram[page][cell * 8];
+            if(shown[0] != 0 || memcmp(&shown[1], glyph, oled_font::kWidth) != 0 || shown[6] != 0 ||
+               shown[7] != 0)
+            {
+                printf("      page %u cell %u is not '%c'\n", page, cell, text[page][cell]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Draw(Framebuffer& display, const char text[8][17])
+{
+    display.Clear();
+    for(uint8_t page = 0; page < 8; page++)
+    {
+        display.SetCursor(0, page);
+        display.printf("%.16s", text[page]);
+    }
+}
+
+// Flush, then check the panel and that the count matches what it received
+uint32_t FlushAndCheck(Framebuffer& display, FakePanel& panel, const char text[8][17], const char * what)
+{
+    uint32_t before = panel.command_bytes + panel.data_bytes;
+    uint32_t bytes = display.Flush();
+    uint32_t received = panel.command_bytes + panel.data_bytes - before;
+    char line[96];
+
+    snprintf(line, sizeof(line), "%s: panel matches", what);
+    Check(PanelShows(panel, text), line);
+    snprintf(line, sizeof(line), "%s: %lu bytes reported, %lu received", what,
+             static_cast<unsigned long>(bytes), static_cast<unsigned long>(received));
+    Check(bytes == received, line);
+    return bytes;
+}
+
+void TestDiff()
+{
+    const char shown[] = "Title: Song One ";
+    char pending[17];
+
+    memcpy(pending, shown, sizeof(pending));
+    Framebuffer::Span span = Framebuffer::Diff(shown, pending, 16);
+    Check(!span.IsDirty(), "diff: identical page is clean");
+
+    pending[5] = '!';
+    span = Framebuffer::Diff(shown, pending, 16);
+    Check(span.first == 5 && span.last == 5, "diff: one cell");
+
+    pending[0] = 'X';
+    pending[15] = 'X';
+    span = Framebuffer::Diff(shown, pending, 16);
+    Check(span.first == 0 && span.last == 15, "diff: first and last cell");
+
+    memcpy(pending, shown, sizeof(pending));
+    pending[3] = 'X';
+    pending[9] = 'X';
+    span = Framebuffer::Diff(shown, pending, 16);
+    Check(span.first == 3 && span.last == 9, "diff: unchanged cells between two changes are sent");
+
+    memset(pending, '#', 16);
+    span = Framebuffer::Diff(shown, pending, 16);
+    Check(span.first == 0 && span.last == 15, "diff: whole page");
+}
+}
+
+int main()
+{
+    FakePanel panel;
+    Framebuffer display(&panel);
+    char text[8][17];
+
+    TestDiff();
+
+    for(uint8_t page = 0; page < 8; page++)
+    {
+        memset(text[page], ' ', 16);
+        text[page][16] = '\0';
+    }
+    Draw(display, text);
+    Check(display.Flush() == 0, "blank frame on a blank panel sends nothing");
+
+    memcpy(text[0], "Now Playing...  ", 16);
+    memcpy(text[1], "Title: Song One ", 16);
+    memcpy(text[2], "Artist: Kids    ", 16);
+    memcpy(text[4], "MP3 128kbps     ", 16);
+    memcpy(text[5], "00:00           ", 16);
+    Draw(display, text);
+    uint32_t first = FlushAndCheck(display, panel, text, "first frame");
+    // Trailing blanks were already blank
+    uint32_t expected = 0;
+    const uint8_t widths[] = { 14, 15, 12, 0, 11, 5, 0, 0 };
+    for(uint8_t width : widths)
+    {
+        expected += width ? Framebuffer::kWindowBytes + width * Framebuffer::kBytesPerCell : 0;
+    }
+    Check(first == expected, "first frame: only the written spans");
+
+    Draw(display, text);
+    Check(display.Flush() == 0, "same frame again sends nothing");
+
+    memcpy(text[5], "00:01", 5);
+    Draw(display, text);
+    uint32_t tick = FlushAndCheck(display, panel, text, "clock tick");
+    Check(tick == Framebuffer::kWindowBytes + Framebuffer::kBytesPerCell, "clock tick: one cell");
+
+    memcpy(text[0], "Paused...       ", 16);
+    memcpy(text[5], "01:59", 5);
+    Draw(display, text);
+    uint32_t pause = FlushAndCheck(display, panel, text, "pause");
+
+    display.Invalidate();
+    uint32_t full = FlushAndCheck(display, panel, text, "invalidate");
+    Check(full == 8 * (Framebuffer::kWindowBytes + 16 * Framebuffer::kBytesPerCell), "invalidate: every page");
+
+    // Drawn past the panel's edges
+    display.Clear();
+    display.SetCursor(10, 7);
+    display.printf("wrapped and dropped");
+    for(uint8_t page = 0; page < 8; page++)
+    {
+        memset(text[page], ' ', 16);
+    }
+    memcpy(&text[7][10], "wrappe", 6);
+    FlushAndCheck(display, panel, text, "past the last page");
+
+    printf("\n+--------------------+-----------+\n");
+    printf("| frame              | bytes     |\n");
+    printf("+--------------------+-----------+\n");
+    printf("| first              | %9lu |\n", static_cast<unsigned long>(first));
+    printf("| clock tick         | %9lu |\n", static_cast<unsigned long>(tick));
+    printf("| pause              | %9lu |\n", static_cast<unsigned long>(pause));
+    printf("| whole panel        | %9lu |\n", static_cast<unsigned long>(full));
+    printf("| OledTerminal, each | %9u |\n", 8 * kPanelColumns);
+    printf("+--------------------+-----------+\n");
+
+    printf("\n%s, %lu failed\n", failures ? "FAILED" : "PASSED", static_cast<unsigned long>(failures));
+    return failures ? 1 : 0;
+}
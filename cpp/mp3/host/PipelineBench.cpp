@@ -0,0 +1,153 @@
+// Host benchmark of the SD -> queue -> SDI pipeline of main.cpp.
+//
+// The real ZonePipeline runs one zone in simulated time under
+// SimulatedPlayer, with main.cpp's 4 chunk queue and read batch. Files come
+// from a FAT image through the real FatFS, every disk read costs
+// --sd-read-us, and bytes go through the real VS1053 and LabSpi code into
+// SimulatedVs1053. --skip-every sets the zone's skip flag like 'zone 1
+// next' and times the new track's first chunk into the decoder.
+//
+// usage: pipeline_bench <sd.img> [--bitrate=128000] [--seconds=60]
+//        [--spi=2000000] [--sd-read-us=1000] [--skip-every=0]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ff.h"
+#include "ImageDisk.hpp"
+#include "SimulatedPlayer.hpp"
+#include "utility/time.hpp"
+
+namespace
+{
+struct Options
+{
+    const char * image = nullptr;
+    uint32_t bitrate = 128000;
+    uint32_t seconds = 60;
+    uint32_t spi_hz = 2000000;
+    uint32_t sd_read_us = 1000;
+    uint32_t skip_every = 0;
+};
+
+FATFS fs;
+
+bool ParseOption(const char * arg, const char * name, uint32_t * value)
+{
+    size_t length = strlen(name);
+    if(strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = strtoul(arg + length + 1, nullptr, 0);
+        return true;
+    }
+    return false;
+}
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!ParseOption(argv[i], "--bitrate", &options.bitrate) &&
+           !ParseOption(argv[i], "--seconds", &options.seconds) &&
+           !ParseOption(argv[i], "--spi", &options.spi_hz) &&
+           !ParseOption(argv[i], "--sd-read-us", &options.sd_read_us) &&
+           !ParseOption(argv[i], "--skip-every", &options.skip_every))
+        {
+            options.image = argv[i];
+        }
+    }
+
+    if(!options.image || !ImageDisk::Open(options.image))
+    {
+        printf("usage: %s <sd.img> [--bitrate=N] [--seconds=N] [--spi=HZ] "
+               "[--sd-read-us=N] [--skip-every=SECONDS]\n", argv[0]);
+        return 1;
+    }
+    if(f_mount(&fs, "", 1) != FR_OK)
+    {
+        printf("Could not mount %s\n", options.image);
+        return 1;
+    }
+
+    SimulatedPlayer::Options player;
+    player.spi_hz = options.spi_hz;
+    player.bitrate[0] = options.bitrate;
+    if(!SimulatedPlayer::Start(player))
+    {
+        printf("No .mp3 files in %s\n", options.image);
+        return 1;
+    }
+    ImageDisk::SetReadCost(options.sd_read_us * 1000, 0);
+
+    Zone & zone = SimulatedPlayer::GetZone(0);
+    uint64_t end_time = sim::Now() + options.seconds * 1000000000ULL;
+    uint64_t next_skip = sim::Now() + options.skip_every * 1000000000ULL;
+    uint64_t skip_time = 0;
+    bool skip_pending = false;
+    uint8_t skip_from = 0;
+    uint32_t sent_at_open = 0;
+    uint64_t skip_latency_total = 0;
+    uint64_t skip_latency_max = 0;
+    uint32_t skips = 0;
+
+    while(sim::Now() < end_time)
+    {
+        if(options.skip_every && !skip_pending && sim::Now() >= next_skip)
+        {
+            next_skip += options.skip_every * 1000000000ULL;
+            zone.skip = true;
+            skip_from = zone.song_index;
+            skip_time = sim::Now();
+            skip_pending = true;
+            sent_at_open = UINT32_MAX;
+        }
+
+        if(!SimulatedPlayer::Step())
+        {
+            SimulatedPlayer::Idle(skip_pending ? end_time : (options.skip_every ? next_skip : end_time));
+        }
+
+        // The reader opened the next track, the first chunk sent after that
+        // is the new track's
+        if(skip_pending && sent_at_open == UINT32_MAX && zone.song_index != skip_from)
+        {
+            sent_at_open = zone.bytes_sent;
+        }
+        if(skip_pending && sent_at_open != UINT32_MAX && zone.bytes_sent != sent_at_open)
+        {
+            uint64_t latency = sim::Now() - skip_time;
+            skip_latency_total += latency;
+            if(latency > skip_latency_max)
+            {
+                skip_latency_max = latency;
+            }
+            skips++;
+            skip_pending = false;
+        }
+    }
+    SimulatedPlayer::Stop();
+
+    const SimulatedVs1053::Stats& stats = SimulatedPlayer::GetDecoder(0).GetStats();
+    double seconds = options.seconds;
+    printf("+--------------------------+--------------+\n");
+    printf("| Simulated time           | %9u s  |\n", options.seconds);
+    printf("| Stream rate              | %9u B/s|\n", options.bitrate / 8);
+    printf("| SDI throughput           | %9.0f B/s|\n", stats.sdi_bytes / seconds);
+    printf("| Underruns                | %12u |\n", stats.underruns);
+    printf("| Starved time             | %9.1f ms |\n", stats.starved_time / 1e6);
+    printf("| Lowest FIFO level        | %10u B |\n", stats.min_fifo_level);
+    printf("| FIFO overflows           | %12u |\n", stats.overflows);
+    printf("| SCI writes / reads       | %5u / %5u |\n", stats.sci_writes, stats.sci_reads);
+    printf("| SD reads                 | %12u |\n", SimulatedPlayer::GetScheduler().GetServed(0));
+    if(skips)
+    {
+        printf("| Skip latency avg / max   | %4.1f / %4.1f ms|\n",
+               skip_latency_total / 1e6 / skips, skip_latency_max / 1e6);
+    }
+    printf("+--------------------------+--------------+\n");
+
+    ImageDisk::Close();
+    return (stats.underruns == 0) ? 0 : 2;
+}
@@ -0,0 +1,343 @@
+// Host benchmark of Ogg Vorbis recording onto a card that stalls, through
+// the real VS1053 and RecordWriter code.
+//
+// The simulated VS1053's encoder fills its buffer at --bitrate. Like
+// main.cpp, the consumer looks at the level every 10 ms and reads what
+// RecordWriter::WordsToDrain() asks for in batches, the reader writes each
+// full buffer to the image. A write keeps the card busy for --write-us plus
+// --byte-ns per byte, and after every --spike-kb written one write stalls
+// for --spike-ms more, the way cards pause to erase. The consumer keeps
+// running while the card is busy. Two setups record the same stream:
+//
+//   single  one 2 KB buffer, filled and written in turn
+//   double  two 2 KB buffers, one fills while the other is written
+//
+// Encoder words count up from 0, so reading the file back shows every word
+// that went missing. It must match the words the writer dropped plus those
+// the encoder lost to a full buffer. Highest clean rate is the top --bitrate
+// (to 8 kbps) each setup records for --seconds without losing a word.
+//
+// usage: record_bench <sd.img> [--seconds=60] [--bitrate=96000]
+//        [--write-us=400] [--byte-ns=250] [--spike-ms=250] [--spike-kb=128]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ff.h"
+#include "ImageDisk.hpp"
+#include "LabGPIO.hpp"
+#include "RecordWriter.hpp"
+#include "SimulatedVs1053.hpp"
+#include "utility/time.hpp"
+#include "VS1053.hpp"
+
+namespace
+{
+constexpr uint32_t kPeripheralClock = 96000000;
+constexpr uint64_t kPollTime = 10000000;        // ns, main.cpp's kRecordPollMs
+constexpr const char * kRecordPath = "BENCH.OGG";
+
+struct Options
+{
+    const char * image = nullptr;
+    uint32_t seconds = 60;
+    uint32_t bitrate = 96000;
+    uint32_t write_us = 400;
+    uint32_t byte_ns = 250;
+    uint32_t spike_ms = 250;
+    uint32_t spike_kb = 128;
+};
+
+struct Setup
+{
+    const char * name;
+    uint8_t buffers;
+};
+
+struct Result
+{
+    SimulatedVs1053::Stats stats;
+    uint64_t elapsed;
+    uint64_t card_time;
+    uint64_t max_card_time;
+    uint32_t writes;
+    uint32_t batches;
+    uint32_t bytes_written;
+    uint32_t dropped_words;
+    uint16_t peak_level;
+    uint16_t min_room;
+    uint32_t missing_words;         // from reading the file back
+    bool stream_ok;
+    uint32_t clean_bitrate;
+};
+
+// Same pins as main.cpp
+LabGPIO XDCS(1, 30);
+LabGPIO XCS(1, 14);
+LabGPIO XRST(0, 25);
+LabGPIO DREQ(1, 23);
+VS1053 Decoder(&XDCS, &XCS, &XRST, &DREQ);
+
+FATFS fs;
+
+bool ParseOption(const char * arg, const char * name, uint32_t * value)
+{
+    size_t length = strlen(name);
+    if(strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = strtoul(arg + length + 1, nullptr, 0);
+        return true;
+    }
+    return false;
+}
+
+// One pass of the consumer: level, then as many batches as the writer asks for
+void Drain(RecordWriter & writer, bool finishing)
+{
+    uint16_t words[RecordWriter::kBatchWords];
+    uint16_t count = writer.WordsToDrain(Decoder.recordedWords(), finishing);
+
+    while(count)
+    {
+        uint16_t batch = (count < RecordWriter::kBatchWords) ? count : RecordWriter::kBatchWords;
+        Decoder.readRecorded(words, batch);
+        writer.Append(words, batch);
+        count -= batch;
+    }
+}
+
+// Runs the consumer at its poll period until the card finishes a write
+// started now, then hands the buffer back
+void CardWrite(RecordWriter & writer, const Options & options, Result & result,
+               uint64_t * next_poll, uint32_t * since_spike)
+{
+    uint64_t cost = options.write_us * 1000ULL + RecordWriter::kBufferSize * uint64_t(options.byte_ns);
+    *since_spike += RecordWriter::kBufferSize;
+    if(options.spike_kb && *since_spike >= options.spike_kb * 1024)
+    {
+        cost += options.spike_ms * 1000000ULL;
+        *since_spike = 0;
+    }
+    uint64_t done = sim::Now() + cost;
+
+    while(sim::Now() < done)
+    {
+        if(sim::Now() >= *next_poll)
+        {
+            Drain(writer, false);
+            *next_poll += kPollTime;
+            continue;
+        }
+        sim::Advance(((*next_poll < done) ? *next_poll : done) - sim::Now());
+    }
+    writer.WriteNext();
+    result.card_time += cost;
+    if(cost > result.max_card_time)
+    {
+        result.max_card_time = cost;
+    }
+}
+
+// Counts the words missing from the recording's count up sequence
+bool CheckStream(Result & result, bool odd_byte)
+{
+    FIL file = {};
+    uint8_t bytes[RecordWriter::kBufferSize];
+    UINT bytes_read = 0;
+    uint16_t expected = 0;
+    uint32_t size;
+
+    if(f_open(&file, kRecordPath, FA_READ) != FR_OK)
+    {
+        return false;
+    }
+    size = f_size(&file);
+    result.missing_words = 0;
+    while(f_read(&file, bytes, sizeof(bytes), &bytes_read) == FR_OK && bytes_read >= 2)
+    {
+        for(UINT i = 0; i + 1 < bytes_read; i += 2)
+        {
+            uint16_t word = (bytes[i] << 8) | bytes[i + 1];
+            result.missing_words += static_cast<uint16_t>(word - expected);
+            expected = word + 1;
+        }
+    }
+    f_close(&file);
+
+    return (size == result.bytes_written) && ((size & 1) == odd_byte) &&
+           (result.missing_words == result.dropped_words + result.stats.encoder_overflows);
+}
+
+Result Run(const Setup & setup, const Options & options, uint32_t bitrate)
+{
+    Result result;
+    SimulatedVs1053 simulated;
+    static uint8_t storage[RecordWriter::kMaxBuffers][RecordWriter::kBufferSize];
+    RecordWriter writer(storage, setup.buffers);
+    uint32_t since_spike = 0;
+    bool odd_byte = false;
+
+    memset(&result, 0, sizeof(result));
+    simulated.Attach(1, { 1, 14 }, { 1, 30 }, { 1, 23 }, kPeripheralClock / VS1053::kStreamDivide);
+    simulated.SetEncoderBitrate(bitrate);
+    Decoder.init();
+    writer.Open(kRecordPath);
+    // No plugin to load here, the model encodes as soon as it is started
+    Decoder.prepareRecording();
+    Decoder.startRecording(false, 0);
+
+    uint64_t start_time = sim::Now();
+    uint64_t end_time = start_time + options.seconds * 1000000000ULL;
+    uint64_t next_poll = start_time;
+
+    while(sim::Now() < end_time)
+    {
+        // Consumer, priority 3
+        if(sim::Now() >= next_poll)
+        {
+            Drain(writer, false);
+            next_poll += kPollTime;
+            continue;
+        }
+        // Reader, priority 2
+        if(writer.HasPending())
+        {
+            CardWrite(writer, options, result, &next_poll, &since_spike);
+            continue;
+        }
+        sim::Advance(next_poll - sim::Now());
+    }
+
+    // 'record stop': drain small amounts too until the encoder is done,
+    // then whatever is left
+    Decoder.stopRecording();
+    while(!Decoder.recordingDone(&odd_byte) || Decoder.recordedWords())
+    {
+        Drain(writer, true);
+        if(writer.HasPending())
+        {
+            CardWrite(writer, options, result, &next_poll, &since_spike);
+        }
+        else
+        {
+            sim::Advance(kPollTime);
+        }
+    }
+    Decoder.endRecording();
+    writer.Close(odd_byte);
+
+    result.stats = simulated.GetStats();
+    result.elapsed = sim::Now() - start_time;
+    result.writes = writer.GetWrites();
+    result.batches = writer.GetBatches();
+    result.bytes_written = writer.GetBytesWritten();
+    result.dropped_words = writer.GetDroppedWords();
+    result.peak_level = writer.GetPeakLevel();
+    result.min_room = writer.GetMinRoom();
+    result.stream_ok = CheckStream(result, odd_byte);
+    return result;
+}
+
+bool Clean(const Result & result)
+{
+    return result.stream_ok && result.dropped_words == 0 && result.stats.encoder_overflows == 0;
+}
+
+// Highest bitrate, in 8 kbps steps, that records without losing a word
+uint32_t CleanBitrate(const Setup & setup, const Options & options)
+{
+    uint32_t low = 0;
+    uint32_t high = 1000000 / 8000;
+
+    while(low < high)
+    {
+        uint32_t middle = (low + high + 1) / 2;
+        if(Clean(Run(setup, options, middle * 8000)))
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+    return low * 8000;
+}
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!ParseOption(argv[i], "--seconds", &options.seconds) &&
+           !ParseOption(argv[i], "--bitrate", &options.bitrate) &&
+           !ParseOption(argv[i], "--write-us", &options.write_us) &&
+           !ParseOption(argv[i], "--byte-ns", &options.byte_ns) &&
+           !ParseOption(argv[i], "--spike-ms", &options.spike_ms) &&
+           !ParseOption(argv[i], "--spike-kb", &options.spike_kb))
+        {
+            options.image = argv[i];
+        }
+    }
+
+    if(!options.image || options.bitrate < 8000 || !ImageDisk::Open(options.image))
+    {
+        printf("usage: %s <sd.img> [--seconds=N] [--bitrate=N] [--write-us=N] [--byte-ns=N] "
+               "[--spike-ms=N] [--spike-kb=N]\n", argv[0]);
+        return 1;
+    }
+    if(f_mount(&fs, "", 1) != FR_OK)
+    {
+        printf("Could not mount %s\n", options.image);
+        return 1;
+    }
+    printf("%lu bps for %lu s, writes %lu us + %lu ns/B, %lu ms stall every %lu KB\n",
+           static_cast<unsigned long>(options.bitrate), static_cast<unsigned long>(options.seconds),
+           static_cast<unsigned long>(options.write_us), static_cast<unsigned long>(options.byte_ns),
+           static_cast<unsigned long>(options.spike_ms), static_cast<unsigned long>(options.spike_kb));
+
+    const Setup setups[] = {
+        { "Single", 1 },
+        { "Double", RecordWriter::kMaxBuffers },
+    };
+    Result results[2];
+    for(uint8_t i = 0; i < 2; i++)
+    {
+        results[i] = Run(setups[i], options, options.bitrate);
+        results[i].clean_bitrate = CleanBitrate(setups[i], options);
+    }
+
+    printf("+---------------------------+--------------+--------------+\n");
+    printf("| %-25s | %12s | %12s |\n", "", setups[0].name, setups[1].name);
+    printf("+---------------------------+--------------+--------------+\n");
+
+#define RECORD_ROW(label, format, expression)                               \
+    printf("| %-25s |", label);                                             \
+    for(const Result & r : results)                                        \
+    {                                                                       \
+        printf(" " format " |", expression);                                \
+    }                                                                       \
+    printf("\n");
+
+    RECORD_ROW("Encoded (words)", "%12llu", static_cast<unsigned long long>(r.stats.encoded_words));
+    RECORD_ROW("Written (B/s)", "%12.0f", r.bytes_written / (r.elapsed / 1e9));
+    RECORD_ROW("Card busy (%)", "%12.1f", 100.0 * r.card_time / r.elapsed);
+    RECORD_ROW("Longest write (ms)", "%12.1f", r.max_card_time / 1e6);
+    RECORD_ROW("Writes", "%12u", r.writes);
+    RECORD_ROW("SCI batches", "%12u", r.batches);
+    RECORD_ROW("Words per batch", "%12.1f", r.batches ? (r.bytes_written / 2.0 + r.dropped_words) / r.batches : 0.0);
+    RECORD_ROW("Peak encoder level", "%12u", r.peak_level);
+    RECORD_ROW("Lowest writer room", "%12u", r.min_room);
+    RECORD_ROW("Dropped by writer", "%12u", r.dropped_words);
+    RECORD_ROW("Lost in encoder", "%12u", r.stats.encoder_overflows);
+    RECORD_ROW("Missing from file", "%12u", r.missing_words);
+    RECORD_ROW("Stream check", "%12s", r.stream_ok ? "ok" : "FAILED");
+    RECORD_ROW("Highest clean rate (bps)", "%12u", r.clean_bitrate);
+#undef RECORD_ROW
+    printf("+---------------------------+--------------+--------------+\n");
+
+    f_unlink(kRecordPath);
+    ImageDisk::Close();
+    return (Clean(results[1]) && results[0].stream_ok) ? 0 : 2;
+}
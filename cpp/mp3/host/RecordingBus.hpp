@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+#include "LabSpi.hpp"
+
+// Recording stand-ins for LabSpi and LabGPIO, for plugging into BasicVs1053
+// on the host. Nothing sits behind them, not even the fake registers, so
+// what a driver instance costs and what it puts on the bus can be seen on
+// its own.
+//
+// The driver owns its bus object, so every RecordingSpi shares one log
+// that the bench reads back.
+class RecordingSpi
+{
+    public:
+        static constexpr uint16_t kLogSize = 4096;
+
+        bool Initialize(uint8_t, LabSpi::FrameModes, uint8_t, LabSpi::SPI_Port spi_port)
+        {
+            port = spi_port;
+            return true;
+        }
+        void SetDivider(uint8_t spi_divide) { divide = spi_divide; }
+        uint8_t Transfer(uint8_t send)
+        {
+            if(transfers < kLogSize)
+            {
+                sent[transfers] = send;
+            }
+            transfers++;
+            return miso;
+        }
+        void Write(const uint8_t * data, uint16_t size)
+        {
+            for(uint16_t i = 0; i < size; i++)
+            {
+                Transfer(data[i]);
+            }
+        }
+        static void Clear() { transfers = 0; }
+
+        static inline uint8_t sent[kLogSize];
+        static inline uint32_t transfers = 0;
+        static inline uint8_t miso = 0xFF;          // returned by every transfer
+        static inline LabSpi::SPI_Port port = LabSpi::SPI_Port::kPort0;
+        static inline uint8_t divide = 0;
+};
+
+// Counts reads and edges. Edges are stamped with the bus's transfer count,
+// so a chip select can be checked to frame exactly the bytes it should.
+class RecordingPin
+{
+    public:
+        explicit RecordingPin(bool initial = true) : level(initial)
+        {
+        }
+
+        void SetAsOutput() { output = true; }
+        void SetAsInput() { output = false; }
+        void SetHigh() { Set(true); }
+        void SetLow() { Set(false); }
+        bool ReadBool() { reads++; return level; }
+        void Clear() { reads = 0; edges = 0; }
+
+        bool level;
+        bool output = false;
+        uint32_t reads = 0;
+        uint32_t edges = 0;
+        uint32_t fell_at = 0;       // bus transfers before the last falling edge
+        uint32_t rose_at = 0;       // and before the last rising edge
+
+    private:
+        void Set(bool high)
+        {
+            if(high != level)
+            {
+                edges++;
+                (high ? rose_at : fell_at) = RecordingSpi::transfers;
+            }
+            level = high;
+        }
+};
@@ -0,0 +1,313 @@
+#include "SimulatedPlayer.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "ClockController.hpp"
+#include "DecoderTelemetry.hpp"
+#include "DeferredLog.hpp"
+#include "DreqLatency.hpp"
+#include "ff.h"
+#include "LabGPIO.hpp"
+#include "PcmDsp.hpp"
+#include "PressLatency.hpp"
+#include "TraceBuffer.hpp"
+#include "utility/time.hpp"
+#include "VS1053.hpp"
+
+namespace
+{
+using SimulatedPlayer::kMaxZones;
+using SimulatedPlayer::kMaxQueueDepth;
+using SimulatedPlayer::kMaxSongs;
+constexpr uint16_t kChunkSize = ZonePipeline::kChunkSize;
+
+bool NextSong(uint8_t zone);
+void CardRead(uint8_t) {}
+void FirstAudio() {}
+void NotifyReader();
+void SendToken(uint8_t token);
+
+// Same pins and ports as the zone table in main.cpp
+LabGPIO XDCS(1, 30);
+LabGPIO XCS(1, 14);
+LabGPIO XRST(0, 25);
+LabGPIO DREQ(1, 23);
+LabGPIO XDCS2(2, 0);
+LabGPIO XCS2(2, 1);
+LabGPIO XRST2(2, 2);
+LabGPIO DREQ2(2, 4);
+VS1053 Decoder(&XDCS, &XCS, &XRST, &DREQ);
+VS1053 Decoder2(&XDCS2, &XCS2, &XRST2, &DREQ2, LabSpi::SPI_Port::kPort0);
+SimulatedVs1053 simulated[kMaxZones];
+
+SemaphoreHandle_t SPI_MUTEX = nullptr;
+SemaphoreHandle_t SD_MUTEX = nullptr;
+SemaphoreHandle_t SSP0_MUTEX = nullptr;
+StaticSemaphore_t spi_mutex;
+StaticSemaphore_t sd_mutex;
+StaticSemaphore_t ssp0_mutex;
+
+DecoderTelemetry telemetry[kMaxZones];
+Zone zones[kMaxZones] = {
+    { &Decoder, &DREQ, &SPI_MUTEX, &telemetry[0] },
+    { &Decoder2, &DREQ2, &SSP0_MUTEX, &telemetry[1] },
+};
+uint8_t queue_storage[kMaxZones][kMaxQueueDepth * kChunkSize];
+StaticQueue_t queues[kMaxZones];
+
+// The pipeline and DreqLatency log through this, nothing drains it here so
+// their messages are dropped once it fills
+DeferredLog deferred_log;
+TraceBuffer trace_buffer;
+DreqLatency dreq_latency(&deferred_log);
+ClockController clock_controller;
+PressLatency press_latency;
+PcmDsp pcm_dsp;
+SerialStream serial_stream;
+
+ZoneScheduler scheduler(1);
+ZonePipeline pipeline(zones, 1, &scheduler, &SD_MUTEX, 1, &serial_stream,
+                      { NextSong, CardRead, FirstAudio, NotifyReader, SendToken },
+                      { &trace_buffer, &dreq_latency, &clock_controller, &press_latency, &pcm_dsp,
+                        &deferred_log });
+alignas(int16_t) uint8_t read_buffer[kMaxQueueDepth * kChunkSize];
+
+SimulatedPlayer::Options settings;
+char songs[kMaxSongs][256];
+uint8_t song_count = 0;
+
+// Simulated time each task sleeps until, 0 when ready
+uint64_t reader_wake = 0;
+uint64_t consumer_wake[kMaxZones] = { 0 };
+uint8_t next_consumer = 0;
+
+bool NextSong(uint8_t zone)
+{
+    uint8_t next = (zones[zone].song_index + 1) % song_count;
+
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        pipeline.Open(zone, next, songs[next]);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    return true;
+}
+
+void NotifyReader()
+{
+    reader_wake = 0;
+}
+
+void SendToken(uint8_t token)
+{
+    if(settings.send_token)
+    {
+        settings.send_token(token);
+    }
+}
+
+void ScanSongs()
+{
+    DIR dir;
+    FILINFO fno;
+
+    song_count = 0;
+    if(f_opendir(&dir, "/") != FR_OK)
+    {
+        return;
+    }
+    while(song_count < kMaxSongs && f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+    {
+        if(settings.is_track(fno.fname))
+        {
+            snprintf(songs[song_count++], sizeof(songs[0]), "%s", fno.fname);
+        }
+    }
+    f_closedir(&dir);
+}
+}
+
+namespace SimulatedPlayer
+{
+bool IsMp3(const char * name)
+{
+    return strstr(name, ".mp3") || strstr(name, ".MP3");
+}
+
+bool Start(const Options & options)
+{
+    settings = options;
+    ScanSongs();
+    if(song_count == 0 && !(options.stream && options.zones == 1))
+    {
+        return false;
+    }
+
+    SPI_MUTEX = xSemaphoreCreateMutexStatic(&spi_mutex);
+    SD_MUTEX = xSemaphoreCreateMutexStatic(&sd_mutex);
+    SSP0_MUTEX = xSemaphoreCreateMutexStatic(&ssp0_mutex);
+    scheduler = ZoneScheduler(options.zones);
+    pipeline = ZonePipeline(zones, options.zones, &scheduler, &SD_MUTEX, options.read_batch, &serial_stream,
+                            { NextSong, CardRead, FirstAudio, NotifyReader, SendToken },
+                            { &trace_buffer, &dreq_latency, &clock_controller, &press_latency, &pcm_dsp,
+                              &deferred_log });
+    reader_wake = 0;
+    next_consumer = 0;
+
+    simulated[0].Attach(1, { 1, 14 }, { 1, 30 }, { 1, 23 }, options.spi_hz);
+    simulated[1].Attach(0, { 2, 1 }, { 2, 0 }, { 2, 4 }, options.spi_hz);
+    for(uint8_t zone = 0; zone < options.zones; zone++)
+    {
+        Zone & target = zones[zone];
+        f_close(&target.file);
+        target.queue = xQueueCreateStatic(options.queue_depth, kChunkSize, queue_storage[zone], &queues[zone]);
+        target.file_size = 0;
+        target.total_bytes_read = 0;
+        target.bytes_sent = 0;
+        target.playing = true;
+        target.changing = false;
+        target.skip = false;
+        target.cancel = false;
+        target.generation = 0;
+        target.streaming = (options.stream && zone == ZonePipeline::kMainZone);
+        target.chunk_length = 0;
+        target.chunk_sent = 0;
+        consumer_wake[zone] = 0;
+
+        simulated[zone].SetBitrate(options.bitrate[zone]);
+        target.decoder->init();
+        scheduler.SetByteRate(zone, options.bitrate[zone] / 8);
+        if(target.streaming)
+        {
+            serial_stream.Start(Uptime() / 1000);
+        }
+        // Zones start on different songs, as two rooms would
+        else if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+        {
+            pipeline.Open(zone, zone % song_count, songs[zone % song_count]);
+            xSemaphoreGive(SD_MUTEX);
+        }
+    }
+    return true;
+}
+
+void Stop()
+{
+    for(uint8_t zone = 0; zone < settings.zones; zone++)
+    {
+        simulated[zone].Stop();
+        f_close(&zones[zone].file);
+    }
+}
+
+bool Step()
+{
+    uint64_t now = sim::Now();
+
+    // Consumers, priority 3, taking turns. One whose decoder was full
+    // sleeps a tick, as in vDecoderConsumerTask.
+    for(uint8_t i = 0; i < settings.zones; i++)
+    {
+        uint8_t zone = (next_consumer + i) % settings.zones;
+        if(consumer_wake[zone] <= now && pipeline.HasWork(zone))
+        {
+            if(pipeline.Consume(zone, 0) == ZonePipeline::Pass::kDecoderFull)
+            {
+                consumer_wake[zone] = now + kDecoderFullMs * 1000000ULL;
+            }
+            next_consumer = (zone + 1) % settings.zones;
+            return true;
+        }
+    }
+
+    // The SD reader, priority 2
+    if(reader_wake <= now)
+    {
+        if(zones[ZonePipeline::kMainZone].streaming)
+        {
+            pipeline.PumpStream(read_buffer, Uptime() / 1000);
+        }
+        if(!pipeline.Read(read_buffer))
+        {
+            reader_wake = now + kReaderIdleMs * 1000000ULL;
+        }
+        return true;
+    }
+    return false;
+}
+
+uint64_t Idle(uint64_t end_time)
+{
+    uint64_t now = sim::Now();
+    uint64_t wake = (reader_wake < end_time) ? reader_wake : end_time;
+
+    for(uint8_t zone = 0; zone < settings.zones; zone++)
+    {
+        if(pipeline.HasWork(zone) && consumer_wake[zone] < wake)
+        {
+            wake = consumer_wake[zone];
+        }
+    }
+    if(wake <= now)
+    {
+        return 0;
+    }
+    sim::Advance(wake - now);
+    return wake - now;
+}
+
+uint64_t RunUntil(uint64_t end_time)
+{
+    uint64_t idle = 0;
+
+    while(sim::Now() < end_time)
+    {
+        if(!Step())
+        {
+            idle += Idle(end_time);
+        }
+    }
+    return idle;
+}
+
+void WakeReader()
+{
+    NotifyReader();
+}
+
+ZonePipeline & GetPipeline()
+{
+    return pipeline;
+}
+
+ZoneScheduler & GetScheduler()
+{
+    return scheduler;
+}
+
+Zone & GetZone(uint8_t zone)
+{
+    return zones[zone];
+}
+
+SimulatedVs1053 & GetDecoder(uint8_t zone)
+{
+    return simulated[zone];
+}
+
+SerialStream & GetStream()
+{
+    return serial_stream;
+}
+
+uint8_t GetSongCount()
+{
+    return song_count;
+}
+
+const char * GetSongName(uint8_t index)
+{
+    return songs[index];
+}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SerialStream.hpp"
+#include "SimulatedVs1053.hpp"
+#include "Zone.hpp"
+#include "ZonePipeline.hpp"
+#include "ZoneScheduler.hpp"
+
+// main.cpp's audio path on the host: the same zone table, queues, mutexes
+// and instruments around the real ZonePipeline, with one SimulatedVs1053
+// per zone on the same pins and SSP ports as the target.
+//
+// Step() stands in for the FreeRTOS scheduler. The consumers (priority 3)
+// run while any of them has a chunk to send and is awake, otherwise the
+// reader (priority 2) gets a pass, the same loop as vDecoderProducerTask.
+// A consumer whose decoder is full sleeps kDecoderFullMs, as on the
+// target, and whatever else is ready runs meanwhile.
+//
+// Tracks come from the root of the mounted image. At the end of a track a
+// zone opens the next one itself, there is no settings task.
+namespace SimulatedPlayer
+{
+constexpr uint8_t kMaxZones = 2;            // decoders on SSP1 and SSP0
+constexpr uint8_t kMaxQueueDepth = 8;
+constexpr uint8_t kMaxSongs = 100;
+// main.cpp's longest reader sleep without a wakeup
+constexpr uint32_t kReaderIdleMs = 20;
+// main.cpp's consumer sleep on a full decoder
+constexpr uint32_t kDecoderFullMs = 1;
+
+bool IsMp3(const char * name);
+
+struct Options
+{
+    uint8_t zones = 1;
+    uint8_t queue_depth = 4;
+    uint8_t read_batch = 2;
+    uint32_t spi_hz = 2000000;
+    uint32_t bitrate[kMaxZones] = { 128000, 320000 };
+    // Which files of the image are tracks
+    bool (*is_track)(const char * name) = IsMp3;
+    // Zone 0 plays the serial stream from the start, as after 'stream on',
+    // and the image may hold no tracks
+    bool stream = false;
+    // Where the stream's flow control tokens go, nullptr drops them
+    void (*send_token)(uint8_t token) = nullptr;
+};
+
+/// Scans the mounted image, brings up the decoders and opens zone n on
+/// track n. May be called again for a fresh run.
+///
+/// @return false if the image holds no tracks and zone 0 is not streaming
+bool Start(const Options & options);
+/// Ends every zone's stream, the FIFOs drain without underruns from here.
+void Stop();
+
+/// Runs one pass of the highest priority task that is ready.
+///
+/// @return false if every task is asleep
+bool Step();
+/// Moves simulated time to the next wakeup, or to end_time if sooner.
+///
+/// @return simulated time skipped, ns
+uint64_t Idle(uint64_t end_time);
+/// Steps and idles until end_time.
+///
+/// @return simulated time spent idle, ns
+uint64_t RunUntil(uint64_t end_time);
+/// What the UART interrupt does once a chunk of the stream is waiting
+void WakeReader();
+
+ZonePipeline & GetPipeline();
+ZoneScheduler & GetScheduler();
+Zone & GetZone(uint8_t zone);
+SimulatedVs1053 & GetDecoder(uint8_t zone);
+SerialStream & GetStream();
+uint8_t GetSongCount();
+const char * GetSongName(uint8_t index);
+}
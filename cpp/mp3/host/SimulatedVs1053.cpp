@@ -0,0 +1,369 @@
+#include "SimulatedVs1053.hpp"
+#include "utility/time.hpp"
+
+#include <cstring>
+
+namespace
+{
+// One decoder per SSP port, indexed by port
+SimulatedVs1053* attached[SimulatedVs1053::kMaxAttached] = { nullptr };
+
+enum : uint8_t
+{
+    kWrite = 0x02,
+    kRead = 0x03,
+    kMode = 0x0,
+    kWram = 0x6,
+    kWramAddr = 0x7,
+    kHdat0 = 0x8,
+    kHdat1 = 0x9,
+    kAiAddr = 0xA,
+    kAiCtrl3 = 0xF
+};
+
+enum : uint16_t
+{
+    kSmReset = (1 << 2),
+    kSmAdpcm = (1 << 12),
+    kRecordStop = (1 << 0),
+    kRecordDone = (1 << 1),
+    kRecordOddByte = (1 << 2)
+};
+
+// Every GPIO poll costs roughly one AHB access plus loop overhead
+constexpr uint64_t kPollTime = 100;     // ns
+}
+
+void SimulatedVs1053::Attach(uint8_t ssp, Pin xcs, Pin xdcs, Pin dreq, uint32_t spi_hz)
+{
+    attached[ssp] = this;
+    ssp_port = ssp;
+    xcs_pin = xcs;
+    xdcs_pin = xdcs;
+    dreq_pin = dreq;
+    byte_time = 8ULL * 1000000000ULL / spi_hz;
+
+    memset(registers, 0, sizeof(registers));
+    memset(wram, 0, sizeof(wram));
+    memset(&stats, 0, sizeof(stats));
+    stats.min_fifo_level = kFifoSize;
+    in_sci = false;
+    sci_busy_until = 0;
+    fifo_level = 0;
+    byte_rate = 16000;
+    drain_remainder = 0;
+    last_update = sim::Now();
+    playing = false;
+    starved = false;
+    starved_since = 0;
+    capture = nullptr;
+    capture_size = 0;
+    captured = 0;
+    encoding = false;
+    encoder_stopping = false;
+    encoder_rate = 128000 / 16;
+    encoder_remainder = 0;
+    encoder_head = 0;
+    encoder_level = 0;
+    encoder_sequence = 0;
+
+    fake::gpio[dreq.port].PIN.on_read = ReadGpio;
+    fake::gpio[xcs.port].PIN.on_write = WriteGpio;
+    fake::ssp[ssp].DR.on_write = WriteSsp;
+}
+
+void SimulatedVs1053::SetBitrate(uint32_t bits_per_second)
+{
+    Update();
+    byte_rate = bits_per_second / 8;
+}
+
+void SimulatedVs1053::SetEncoderBitrate(uint32_t bits_per_second)
+{
+    Update();
+    encoder_rate = bits_per_second / 16;
+}
+
+void SimulatedVs1053::Stop()
+{
+    Update();
+    playing = false;
+    if(starved)
+    {
+        stats.starved_time += sim::Now() - starved_since;
+        starved = false;
+    }
+}
+
+void SimulatedVs1053::Capture(uint8_t* buffer, uint32_t size)
+{
+    capture = buffer;
+    capture_size = size;
+    captured = 0;
+}
+
+void SimulatedVs1053::Update()
+{
+    uint64_t now = sim::Now();
+    uint64_t elapsed = now - last_update;
+    last_update = now;
+
+    if(encoding)
+    {
+        Encode(elapsed);
+    }
+    if(fifo_level == 0 && !playing)
+    {
+        return;
+    }
+
+    // Drain at the stream byte rate, keeping the fractional byte
+    uint64_t owed = elapsed * byte_rate + drain_remainder;
+    uint64_t bytes = owed / 1000000000ULL;
+    drain_remainder = owed % 1000000000ULL;
+
+    if(bytes >= fifo_level)
+    {
+        if(playing && !starved && bytes > 0)
+        {
+            // Back date to when the last byte actually drained
+            starved = true;
+            starved_since = now - (bytes - fifo_level) * 1000000000ULL / byte_rate;
+            stats.underruns++;
+        }
+        stats.bytes_played += fifo_level;
+        fifo_level = 0;
+    }
+    else
+    {
+        stats.bytes_played += bytes;
+        fifo_level -= bytes;
+    }
+
+    if(playing && fifo_level < stats.min_fifo_level)
+    {
+        stats.min_fifo_level = fifo_level;
+    }
+}
+
+void SimulatedVs1053::Encode(uint64_t elapsed)
+{
+    // Whole words at the encoded rate, keeping the fraction
+    uint64_t owed = elapsed * encoder_rate + encoder_remainder;
+    uint64_t words = owed / 1000000000ULL;
+    encoder_remainder = owed % 1000000000ULL;
+
+    if(encoder_stopping)
+    {
+        words = kEncoderFlushWords;
+        encoding = false;
+        registers[kAiCtrl3] |= kRecordDone;
+        if((stats.encoded_words + words) & 1)
+        {
+            registers[kAiCtrl3] |= kRecordOddByte;
+        }
+    }
+    for(uint64_t i = 0; i < words; i++)
+    {
+        if(encoder_level < kRecordBufferWords)
+        {
+            encoder_buffer[(encoder_head + encoder_level) % kRecordBufferWords] = encoder_sequence;
+            encoder_level++;
+        }
+        else
+        {
+            stats.encoder_overflows++;
+        }
+        encoder_sequence++;
+        stats.encoded_words++;
+    }
+    if(encoder_level > stats.max_encoder_level)
+    {
+        stats.max_encoder_level = encoder_level;
+    }
+}
+
+void SimulatedVs1053::WriteRegister(uint8_t address, uint16_t data)
+{
+    registers[address] = data;
+    if(address == kMode && (data & kSmReset))
+    {
+        encoding = false;
+        encoder_level = 0;
+        registers[kAiCtrl3] = 0;
+    }
+    else if(address == kAiAddr && data && (registers[kMode] & kSmAdpcm))
+    {
+        encoding = true;
+        encoder_stopping = false;
+        encoder_remainder = 0;
+        encoder_head = 0;
+        encoder_level = 0;
+        encoder_sequence = 0;
+    }
+    else if(address == kAiCtrl3 && encoding && (data & kRecordStop))
+    {
+        encoder_stopping = true;
+    }
+}
+
+bool SimulatedVs1053::Dreq()
+{
+    Update();
+    return (sim::Now() >= sci_busy_until) && (kFifoSize - fifo_level >= kDreqThreshold);
+}
+
+uint16_t SimulatedVs1053::GetFifoLevel()
+{
+    Update();
+    return fifo_level;
+}
+
+bool SimulatedVs1053::PinLow(Pin pin) const
+{
+    return ((fake::gpio[pin.port].PIN.value >> pin.pin) & 1) == 0;
+}
+
+uint8_t SimulatedVs1053::Transfer(uint8_t mosi)
+{
+    uint8_t miso = 0xFF;
+    sim::Advance(byte_time);
+    Update();
+
+    if(PinLow(xcs_pin))
+    {
+        if(!in_sci)
+        {
+            in_sci = true;
+            sci_index = 0;
+        }
+
+        if(sci_index == 0)
+        {
+            sci_instruction = mosi;
+        }
+        else if(sci_index == 1)
+        {
+            sci_address = mosi & 0xF;
+            if(sci_instruction == kRead)
+            {
+                sci_read_word = registers[sci_address];
+                if(sci_address == kWram)
+                {
+                    sci_read_word = wram[registers[kWramAddr] & 0x1FFF];
+                    registers[kWramAddr]++;
+                }
+                else if(sci_address == kHdat1 && (encoding || encoder_level))
+                {
+                    sci_read_word = encoder_level;
+                }
+                else if(sci_address == kHdat0 && encoder_level)
+                {
+                    sci_read_word = encoder_buffer[encoder_head];
+                    encoder_head = (encoder_head + 1) % kRecordBufferWords;
+                    encoder_level--;
+                }
+                stats.sci_reads++;
+            }
+        }
+        else if(sci_instruction == kRead)
+        {
+            // Upper byte first
+            miso = ((sci_index & 1) == 0) ? (sci_read_word >> 8) : (sci_read_word & 0xFF);
+        }
+        else if(sci_instruction == kWrite)
+        {
+            if((sci_index & 1) == 0)
+            {
+                sci_word = mosi << 8;
+            }
+            else
+            {
+                // A complete word, later words of a multiple write go to the same register
+                sci_word |= mosi;
+                if(sci_address == kWram)
+                {
+                    wram[registers[kWramAddr] & 0x1FFF] = sci_word;
+                    registers[kWramAddr]++;
+                }
+                else
+                {
+                    WriteRegister(sci_address, sci_word);
+                }
+                sci_busy_until = sim::Now() + kSciBusyTime;
+                stats.sci_writes++;
+            }
+        }
+        sci_index++;
+    }
+    else if(PinLow(xdcs_pin))
+    {
+        if(fifo_level < kFifoSize)
+        {
+            fifo_level++;
+        }
+        else
+        {
+            stats.overflows++;
+        }
+        if(capture && captured < capture_size)
+        {
+            capture[captured] = mosi;
+        }
+        captured++;
+        stats.sdi_bytes++;
+        playing = true;
+        if(starved)
+        {
+            stats.starved_time += sim::Now() - starved_since;
+            starved = false;
+        }
+    }
+    return miso;
+}
+
+uint32_t SimulatedVs1053::ReadGpio(FakeRegister& reg)
+{
+    sim::Advance(kPollTime);
+    for(SimulatedVs1053* decoder : attached)
+    {
+        if(!decoder || &fake::gpio[decoder->dreq_pin.port].PIN != &reg)
+        {
+            continue;
+        }
+        if(decoder->Dreq())
+        {
+            reg.value |= (1 << decoder->dreq_pin.pin);
+        }
+        else
+        {
+            reg.value &= ~(1 << decoder->dreq_pin.pin);
+        }
+    }
+    return reg.value;
+}
+
+void SimulatedVs1053::WriteGpio(FakeRegister& reg, uint32_t)
+{
+    // XCS rising ends the SCI transaction
+    for(SimulatedVs1053* decoder : attached)
+    {
+        if(decoder && &fake::gpio[decoder->xcs_pin.port].PIN == &reg &&
+           !decoder->PinLow(decoder->xcs_pin))
+        {
+            decoder->in_sci = false;
+        }
+    }
+}
+
+void SimulatedVs1053::WriteSsp(FakeRegister& reg, uint32_t value)
+{
+    // The received byte is what the next read of DR returns
+    for(SimulatedVs1053* decoder : attached)
+    {
+        if(decoder && &fake::ssp[decoder->ssp_port].DR == &reg)
+        {
+            reg.value = decoder->Transfer(value & 0xFF);
+        }
+    }
+}
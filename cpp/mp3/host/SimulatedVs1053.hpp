@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+
+#include "L0_LowLevel/LPC40xx.h"
+
+// Behavioural model of a VS1053 attached to the fake SSP and GPIO registers.
+//
+// - SDI bytes (XDCS low) go into a 2048 byte FIFO that drains at the
+//   configured stream bitrate in simulated time.
+// - DREQ is high while the FIFO has room for at least 32 bytes and no SCI
+//   operation is in progress.
+// - SCI (XCS low) decodes read/write instructions into a register file,
+//   including SCI multiple writes and WRAM auto increment.
+// - Playback starts with the first SDI byte; running the FIFO dry after
+//   that counts as an underrun until Stop() is called.
+// - Writing SCI_AIADDR with SM_ADPCM set starts the encoder: it fills a
+//   kRecordBufferWords buffer at the configured encoded rate, words that do
+//   not fit are lost. SCI_HDAT1 reads the level, each SCI_HDAT0 read takes
+//   one word. Words count up from 0, so a recording's gaps show where words
+//   went missing. Setting bit 0 of SCI_AICTRL3 ends the stream after
+//   kEncoderFlushWords more words and sets bit 1 (and bit 2, the last word
+//   holding one byte, when the total is odd).
+// - Capture() keeps a copy of the SDI bytes, for checking what reached
+//   the decoder against what was sent.
+// - One decoder can be attached to each SSP port, so multi-zone setups run
+//   side by side on the same simulated clock.
+class SimulatedVs1053
+{
+    public:
+        static constexpr uint16_t kFifoSize = 2048;
+        static constexpr uint8_t kMaxAttached = 3;     // SSP0 to SSP2
+        static constexpr uint16_t kDreqThreshold = 32;
+        // DREQ stays low this long after every SCI write
+        static constexpr uint64_t kSciBusyTime = 2000;     // ns
+        static constexpr uint16_t kRecordBufferWords = 1024;
+        // The last page the encoder writes once asked to stop
+        static constexpr uint16_t kEncoderFlushWords = 200;
+
+        struct Pin
+        {
+            uint8_t port;
+            uint8_t pin;
+        };
+
+        struct Stats
+        {
+            uint64_t sdi_bytes;
+            uint64_t bytes_played;
+            uint32_t sci_writes;
+            uint32_t sci_reads;
+            uint32_t underruns;
+            uint64_t starved_time;          // ns
+            uint32_t overflows;             // SDI bytes sent without room
+            uint16_t min_fifo_level;        // lowest level seen while playing
+            uint64_t encoded_words;
+            uint32_t encoder_overflows;     // words lost to a full buffer
+            uint16_t max_encoder_level;
+        };
+
+        /// Attaches the model to the fake registers. Only one instance may be
+        /// attached to each SSP port.
+        ///
+        /// @param spi_hz - SPI clock, sets the simulated time per byte
+        void Attach(uint8_t ssp, Pin xcs, Pin xdcs, Pin dreq, uint32_t spi_hz);
+        void SetBitrate(uint32_t bits_per_second);
+        void SetEncoderBitrate(uint32_t bits_per_second);
+        /// Ends the stream: the FIFO drains without counting underruns.
+        void Stop();
+        /// Copies the SDI bytes from here on into buffer, up to size of them.
+        /// GetCaptured() counts them all, those past size included.
+        void Capture(uint8_t* buffer, uint32_t size);
+        uint32_t GetCaptured() const { return captured; }
+
+        bool Dreq();
+        uint16_t GetFifoLevel();
+        uint16_t GetRegister(uint8_t address) const { return registers[address & 0xF]; }
+        const Stats& GetStats() { Update(); return stats; }
+
+    private:
+        static uint32_t ReadGpio(FakeRegister& reg);
+        static void WriteGpio(FakeRegister& reg, uint32_t value);
+        static void WriteSsp(FakeRegister& reg, uint32_t value);
+
+        void Update();
+        uint8_t Transfer(uint8_t mosi);
+        bool PinLow(Pin pin) const;
+        void Encode(uint64_t elapsed);
+        void WriteRegister(uint8_t address, uint16_t data);
+
+        uint8_t ssp_port;
+        Pin xcs_pin;
+        Pin xdcs_pin;
+        Pin dreq_pin;
+        uint64_t byte_time;
+
+        uint16_t registers[16];
+        uint16_t wram[0x2000];
+
+        // SCI transaction state
+        bool in_sci;
+        uint8_t sci_index;
+        uint8_t sci_instruction;
+        uint8_t sci_address;
+        uint16_t sci_word;
+        uint16_t sci_read_word;
+        uint64_t sci_busy_until;
+
+        uint32_t fifo_level;
+        uint32_t byte_rate;
+        uint64_t drain_remainder;
+        uint64_t last_update;
+        bool playing;
+        bool starved;
+        uint64_t starved_since;
+
+        uint8_t* capture;
+        uint32_t capture_size;
+        uint32_t captured;
+
+        bool encoding;
+        bool encoder_stopping;
+        uint32_t encoder_rate;          // words per second
+        uint64_t encoder_remainder;
+        uint16_t encoder_buffer[kRecordBufferWords];
+        uint16_t encoder_head;
+        uint16_t encoder_level;
+        uint16_t encoder_sequence;
+
+        Stats stats;
+};
@@ -0,0 +1,346 @@
+// Host benchmark of MP3 playback from the serial stream, through the real
+// SerialStream and VS1053 code, with a real sender on the other end of a
+// pty.
+//
+// A child process sends --seconds of a --bitrate stream through StreamSender
+// over a pty, paced to --baud like the UART would, and stops for --hiccup-ms
+// every --hiccup-every-ms like a busy host does. The parent plays the
+// player: bytes read from the pty go through SerialStream::Receive() like
+// the UART interrupt's, and SimulatedPlayer runs the real ZonePipeline with
+// zone 0 streaming, its PumpStream() filling the 4 chunk queue and writing
+// the tokens back to the pty. Simulated time follows the wall clock, so both
+// sides see the same time. Three senders stream the same data:
+//
+//   blast   no flow control, as fast as the line goes
+//   paced   no flow control, at the stream's bitrate by the wall clock
+//   credit  SerialStream's credits
+//
+// Overruns are bytes that arrived with the ring full, each one a hole in
+// the MP3 stream. Underruns are the decoder running dry mid-stream. The
+// stream counts up (i % 251), and the SDI bytes the decoder got must be
+// exactly what was sent, then zeros to the end of the last chunk; a hole,
+// or padding that PumpStream() put mid-stream, fails the check.
+//
+// usage: stream_bench [--seconds=10] [--bitrate=320000] [--baud=921600]
+//        [--hiccup-ms=100] [--hiccup-every-ms=2000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "SerialStream.hpp"
+#include "SimulatedPlayer.hpp"
+#include "StreamSender.hpp"
+#include "utility/time.hpp"
+#include "VS1053.hpp"
+
+namespace
+{
+constexpr uint16_t kChunkSize = ZonePipeline::kChunkSize;
+constexpr uint32_t kPeripheralClock = 96000000;
+// Longest the player loop sleeps with nothing to do
+constexpr uint32_t kIdleSleepUs = 200;
+
+struct Options
+{
+    uint32_t seconds = 10;
+    uint32_t bitrate = 320000;
+    uint32_t baud = 921600;
+    uint32_t hiccup_ms = 100;
+    uint32_t hiccup_every_ms = 2000;
+};
+
+struct Setup
+{
+    const char * name;
+    StreamSender::Mode mode;
+};
+
+struct Result
+{
+    SimulatedVs1053::Stats stats;
+    StreamSender::Stats sender;
+    uint64_t elapsed;                   // ns, start to last byte played
+    uint64_t first_audio;               // ns, start to first chunk sent
+    uint32_t received;
+    uint32_t overruns;
+    uint32_t credits;
+    uint32_t windows;
+    uint16_t peak_level;
+    bool sender_ok;
+    bool data_ok;                       // SDI bytes match the sent stream
+};
+
+// The player's end of the pty, for the tokens
+int player_pty = -1;
+
+bool ParseOption(const char * arg, const char * name, uint32_t * value)
+{
+    size_t length = strlen(name);
+    if(strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = strtoul(arg + length + 1, nullptr, 0);
+        return true;
+    }
+    return false;
+}
+
+void SendToken(uint8_t token)
+{
+    if(write(player_pty, &token, 1) != 1)
+    {
+        perror("tokens");
+    }
+}
+
+uint64_t WallNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The sent stream, then zero padding to a whole chunk, and nothing else
+bool CheckData(const std::vector<uint8_t> & sent, const std::vector<uint8_t> & capture, uint32_t captured)
+{
+    uint32_t padded = (sent.size() + kChunkSize - 1) / kChunkSize * kChunkSize;
+
+    if(captured != padded)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < captured; i++)
+    {
+        if(capture[i] != ((i < sent.size()) ? sent[i] : 0))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sender side, in the child. Reports its stats through the pipe.
+void RunSender(int pty, int report, const Setup & setup, const Options & options,
+               const std::vector<uint8_t> & data)
+{
+    StreamSender::Options sender_options;
+    sender_options.mode = setup.mode;
+    sender_options.pace_baud = options.baud;
+    sender_options.bitrate = options.bitrate;
+    sender_options.hiccup_ms = options.hiccup_ms;
+    sender_options.hiccup_every_ms = options.hiccup_every_ms;
+
+    StreamSender sender(pty, sender_options);
+    bool ok = sender.Send(data.data(), data.size());
+    StreamSender::Stats stats = sender.GetStats();
+    stats.sent = ok ? stats.sent : 0;
+    if(write(report, &stats, sizeof(stats)) != sizeof(stats))
+    {
+        _exit(1);
+    }
+    _exit(ok ? 0 : 1);
+}
+
+Result Run(const Setup & setup, const Options & options, const std::vector<uint8_t> & data)
+{
+    Result result;
+    SimulatedPlayer::Options player;
+    uint8_t buffer[256];
+    int report[2];
+
+    memset(&result, 0, sizeof(result));
+    int pty;
+    int line;
+    if(!StreamSender::OpenPty(&pty, &line) || pipe(report) != 0)
+    {
+        perror("pty");
+        exit(1);
+    }
+
+    player.spi_hz = kPeripheralClock / VS1053::kStreamDivide;
+    player.bitrate[0] = options.bitrate;
+    player.stream = true;
+    player.send_token = SendToken;
+    player_pty = pty;
+    SimulatedPlayer::Start(player);
+    SerialStream & stream = SimulatedPlayer::GetStream();
+    Zone & zone = SimulatedPlayer::GetZone(0);
+    std::vector<uint8_t> capture(data.size() + kChunkSize);
+    SimulatedPlayer::GetDecoder(0).Capture(capture.data(), capture.size());
+
+    uint64_t sim_start = sim::Now();
+    fflush(stdout);
+    pid_t sender = fork();
+    if(sender == 0)
+    {
+        close(pty);
+        RunSender(line, report[1], setup, options, data);
+    }
+    close(report[1]);
+    fcntl(pty, F_SETFL, fcntl(pty, F_GETFL) | O_NONBLOCK);
+    uint64_t wall_start = WallNow();
+    bool sender_done = false;
+    bool tail_only = false;
+
+    while(true)
+    {
+        // Simulated time follows the wall clock, the decoder drains in step
+        // with the sender. SPI transfers may run it ahead, then wait.
+        uint64_t wall = WallNow() - wall_start;
+        uint64_t simulated_elapsed = sim::Now() - sim_start;
+        if(wall > simulated_elapsed)
+        {
+            sim::Advance(wall - simulated_elapsed);
+        }
+        else if(simulated_elapsed - wall > 1000)
+        {
+            usleep((simulated_elapsed - wall) / 1000);
+        }
+
+        // UART interrupt
+        ssize_t count;
+        while((count = read(pty, buffer, sizeof(buffer))) > 0)
+        {
+            for(ssize_t i = 0; i < count; i++)
+            {
+                if(stream.Receive(buffer[i]) == kChunkSize)
+                {
+                    SimulatedPlayer::WakeReader();
+                }
+            }
+        }
+        if(!sender_done && waitpid(sender, nullptr, WNOHANG) == sender)
+        {
+            // Whatever it wrote before exiting is read on the next pass
+            sender_done = true;
+            continue;
+        }
+
+        bool ran = SimulatedPlayer::Step();
+        if(!result.first_audio && zone.bytes_sent)
+        {
+            result.first_audio = sim::Now() - sim_start;
+        }
+        // Only the partial last chunk is left, which waits out kStreamEndMs
+        // by design. The decoder running dry meanwhile is the end of the
+        // stream, not an underrun. Counted from the bytes, the sender's exit
+        // is seen later.
+        if(!tail_only && stream.GetReceived() == data.size() && stream.Available() < kChunkSize &&
+           !SimulatedPlayer::GetPipeline().HasWork(0))
+        {
+            SimulatedPlayer::GetDecoder(0).Stop();
+            tail_only = true;
+        }
+        if(sender_done && !SimulatedPlayer::GetPipeline().HasWork(0) && !stream.Available())
+        {
+            break;
+        }
+        if(!ran)
+        {
+            usleep(kIdleSleepUs);
+        }
+    }
+
+    SimulatedPlayer::Stop();
+    result.elapsed = sim::Now() - sim_start;
+    result.stats = SimulatedPlayer::GetDecoder(0).GetStats();
+    result.received = stream.GetReceived();
+    result.overruns = stream.GetOverruns();
+    result.credits = stream.GetCredits();
+    result.windows = stream.GetWindows();
+    result.peak_level = stream.GetPeakLevel();
+    result.data_ok = CheckData(data, capture, SimulatedPlayer::GetDecoder(0).GetCaptured());
+    result.sender_ok = (read(report[0], &result.sender, sizeof(result.sender)) == sizeof(result.sender)) &&
+                       result.sender.sent == data.size();
+    close(report[0]);
+    close(line);
+    close(pty);
+    return result;
+}
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!ParseOption(argv[i], "--seconds", &options.seconds) &&
+           !ParseOption(argv[i], "--bitrate", &options.bitrate) &&
+           !ParseOption(argv[i], "--baud", &options.baud) &&
+           !ParseOption(argv[i], "--hiccup-ms", &options.hiccup_ms) &&
+           !ParseOption(argv[i], "--hiccup-every-ms", &options.hiccup_every_ms))
+        {
+            printf("usage: %s [--seconds=N] [--bitrate=N] [--baud=N] [--hiccup-ms=N] "
+                   "[--hiccup-every-ms=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(options.bitrate < 8000 || options.baud / 10 < options.bitrate / 8)
+    {
+        printf("The line must carry the stream, %lu baud is under %lu bps\n",
+               static_cast<unsigned long>(options.baud), static_cast<unsigned long>(options.bitrate));
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    printf("%lu bps over %lu baud for %lu s, sender stops %lu ms every %lu ms\n",
+           static_cast<unsigned long>(options.bitrate), static_cast<unsigned long>(options.baud),
+           static_cast<unsigned long>(options.seconds), static_cast<unsigned long>(options.hiccup_ms),
+           static_cast<unsigned long>(options.hiccup_every_ms));
+
+    // Counts up, so holes would show in a capture of the SDI bytes
+    std::vector<uint8_t> data(uint64_t(options.seconds) * options.bitrate / 8);
+    for(size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = i % 251;
+    }
+
+    const Setup setups[] = {
+        { "Blast", StreamSender::Mode::kBlast },
+        { "Paced", StreamSender::Mode::kPaced },
+        { "Credit", StreamSender::Mode::kCredit },
+    };
+    Result results[3];
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        results[i] = Run(setups[i], options, data);
+    }
+
+    printf("+---------------------------+------------+------------+------------+\n");
+    printf("| %-25s | %10s | %10s | %10s |\n", "", setups[0].name, setups[1].name, setups[2].name);
+    printf("+---------------------------+------------+------------+------------+\n");
+
+#define STREAM_ROW(label, format, expression)                               \
+    printf("| %-25s |", label);                                             \
+    for(const Result & r : results)                                        \
+    {                                                                       \
+        printf(" " format " |", expression);                                \
+    }                                                                       \
+    printf("\n");
+
+    STREAM_ROW("Sent (bytes)", "%10llu", static_cast<unsigned long long>(r.sender.sent));
+    STREAM_ROW("Sender rate (B/s)", "%10.0f", r.sender.elapsed ? r.sender.sent / (r.sender.elapsed / 1e9) : 0.0);
+    STREAM_ROW("Line use (%)", "%10.1f",
+               r.sender.elapsed ? 100.0 * r.sender.sent * 10 / options.baud / (r.sender.elapsed / 1e9) : 0.0);
+    STREAM_ROW("Waiting for credit (ms)", "%10.0f", r.sender.waited / 1e6);
+    STREAM_ROW("Sender hiccups", "%10u", r.sender.hiccups);
+    STREAM_ROW("Received (bytes)", "%10u", r.received);
+    STREAM_ROW("Overruns (bytes)", "%10u", r.overruns);
+    STREAM_ROW("Peak ring level", "%10u", r.peak_level);
+    STREAM_ROW("Windows granted", "%10u", r.windows);
+    STREAM_ROW("Credits returned", "%10u", r.credits);
+    STREAM_ROW("First audio (ms)", "%10.1f", r.first_audio / 1e6);
+    STREAM_ROW("Played (B/s)", "%10.0f", r.stats.bytes_played / (r.elapsed / 1e9));
+    STREAM_ROW("Decoder underruns", "%10u", r.stats.underruns);
+    STREAM_ROW("Starved (ms)", "%10.1f", r.stats.starved_time / 1e6);
+    STREAM_ROW("Played as sent", "%10s", r.data_ok ? "ok" : "FAILED");
+#undef STREAM_ROW
+    printf("+---------------------------+------------+------------+------------+\n");
+
+    const Result & credit = results[2];
+    bool clean = credit.sender_ok && credit.data_ok && credit.overruns == 0 && credit.stats.underruns == 0;
+    return clean ? 0 : 2;
+}
@@ -0,0 +1,76 @@
+// Streams an MP3 file to the player's stream UART through a USB serial
+// adapter, for 'stream on'. Runs the same StreamSender as stream_bench.
+//
+// usage: stream_send <file.mp3> <tty> [--baud=921600] [--blast]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+#include "StreamSender.hpp"
+
+int main(int argc, char * argv[])
+{
+    const char * path = nullptr;
+    const char * tty = nullptr;
+    StreamSender::Options options;
+    uint32_t baud = 921600;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strncmp(argv[i], "--baud=", 7) == 0)
+        {
+            baud = strtoul(argv[i] + 7, nullptr, 0);
+        }
+        else if(strcmp(argv[i], "--blast") == 0)
+        {
+            options.mode = StreamSender::Mode::kBlast;
+        }
+        else if(!path)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            tty = argv[i];
+        }
+    }
+    if(!path || !tty)
+    {
+        printf("usage: %s <file.mp3> <tty> [--baud=N] [--blast]\n", argv[0]);
+        return 1;
+    }
+
+    FILE * file = fopen(path, "rb");
+    if(!file)
+    {
+        printf("Could not open %s\n", path);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t block[4096];
+    size_t count;
+    while((count = fread(block, 1, sizeof(block), file)) > 0)
+    {
+        data.insert(data.end(), block, block + count);
+    }
+    fclose(file);
+
+    int fd = StreamSender::OpenSerial(tty, baud);
+    if(fd < 0)
+    {
+        printf("Could not open %s at %lu baud\n", tty, static_cast<unsigned long>(baud));
+        return 1;
+    }
+
+    StreamSender sender(fd, options);
+    bool ok = sender.Send(data.data(), data.size());
+    const StreamSender::Stats & stats = sender.GetStats();
+    printf("%llu of %zu bytes in %.1f s, %.0f B/s, %.0f ms waiting for credit, %u credits, %u windows\n",
+           static_cast<unsigned long long>(stats.sent), data.size(), stats.elapsed / 1e9,
+           stats.elapsed ? stats.sent / (stats.elapsed / 1e9) : 0.0, stats.waited / 1e6, stats.credits,
+           stats.windows);
+    close(fd);
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,209 @@
+#include "StreamSender.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "SerialStream.hpp"
+
+namespace
+{
+// Bytes per write(), small enough that pacing stays smooth
+constexpr size_t kPieceSize = 256;
+// How far ahead of the line pacing may write, what a USB serial adapter
+// buffers anyway
+constexpr uint64_t kLineSlack = 2000000;                // ns
+constexpr uint64_t kDrainTimeout = 1000000000ULL;      // ns
+
+uint64_t WallNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+StreamSender::StreamSender(int fd, const Options& options)
+    : fd(fd), options(options), window(0)
+{
+    memset(&stats, 0, sizeof(stats));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+int StreamSender::OpenSerial(const char * path, uint32_t baud)
+{
+    struct termios settings;
+    speed_t speed;
+
+    switch(baud)
+    {
+        case 115200: speed = B115200; break;
+        case 230400: speed = B230400; break;
+        case 460800: speed = B460800; break;
+        case 921600: speed = B921600; break;
+        case 1000000: speed = B1000000; break;
+        default: return -1;
+    }
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if(fd < 0 || tcgetattr(fd, &settings) != 0)
+    {
+        if(fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    cfmakeraw(&settings);
+    settings.c_cflag |= CLOCAL | CREAD;
+    settings.c_cflag &= ~(CSTOPB | CRTSCTS);
+    cfsetispeed(&settings, speed);
+    cfsetospeed(&settings, speed);
+    tcsetattr(fd, TCSANOW, &settings);
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+bool StreamSender::OpenPty(int * master, int * line)
+{
+    struct termios settings;
+
+    *master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(*master < 0 || grantpt(*master) != 0 || unlockpt(*master) != 0)
+    {
+        return false;
+    }
+    *line = open(ptsname(*master), O_RDWR | O_NOCTTY);
+    if(*line < 0 || tcgetattr(*line, &settings) != 0)
+    {
+        return false;
+    }
+    cfmakeraw(&settings);
+    return tcsetattr(*line, TCSANOW, &settings) == 0;
+}
+
+void StreamSender::ReadTokens()
+{
+    uint8_t tokens[64];
+    ssize_t count;
+
+    while((count = read(fd, tokens, sizeof(tokens))) > 0)
+    {
+        for(ssize_t i = 0; i < count; i++)
+        {
+            if(tokens[i] == SerialStream::kWindowToken)
+            {
+                window = SerialStream::kBufferSize;
+                stats.windows++;
+            }
+            else if(tokens[i] == SerialStream::kCreditToken)
+            {
+                window += SerialStream::kCreditBytes;
+                stats.credits++;
+            }
+        }
+    }
+}
+
+// Until a token arrives, the line has room again or the timeout
+void StreamSender::Wait(uint32_t microseconds)
+{
+    struct pollfd descriptor = { fd, POLLIN, 0 };
+    struct timespec timeout = { 0, long(microseconds) * 1000 };
+    ppoll(&descriptor, 1, &timeout, nullptr);
+}
+
+bool StreamSender::Send(const uint8_t * data, size_t size)
+{
+    uint64_t start = WallNow();
+    uint64_t next_hiccup = start + options.hiccup_every_ms * 1000000ULL;
+    uint64_t waiting_since = 0;
+    uint64_t line_free = start;         // when the last byte written is on the wire
+    size_t sent = 0;
+
+    while(sent < size)
+    {
+        uint64_t now = WallNow();
+        ReadTokens();
+
+        if(options.hiccup_ms && options.hiccup_every_ms && now >= next_hiccup)
+        {
+            usleep(options.hiccup_ms * 1000);
+            next_hiccup += options.hiccup_every_ms * 1000000ULL;
+            stats.hiccups++;
+            continue;
+        }
+
+        uint64_t allowed = size - sent;
+        if(options.mode == Mode::kCredit)
+        {
+            if(window <= 0)
+            {
+                allowed = 0;
+            }
+            else if(uint64_t(window) < allowed)
+            {
+                allowed = window;
+            }
+            if(allowed == 0 && !waiting_since)
+            {
+                waiting_since = now;
+            }
+            else if(allowed && waiting_since)
+            {
+                stats.waited += now - waiting_since;
+                waiting_since = 0;
+            }
+        }
+        if(options.pace_baud)
+        {
+            // The line never catches up on time it sat idle
+            line_free = std::max(line_free, now);
+            uint64_t line = (now + kLineSlack - line_free) * (options.pace_baud / 10) / 1000000000ULL;
+            allowed = std::min(allowed, line);
+        }
+        if(options.mode == Mode::kPaced)
+        {
+            uint64_t due = (now - start) * (options.bitrate / 8) / 1000000000ULL;
+            allowed = (due > sent) ? std::min<uint64_t>(allowed, due - sent) : 0;
+        }
+        if(allowed == 0)
+        {
+            Wait(waiting_since ? 1000 : 200);
+            continue;
+        }
+
+        ssize_t written = write(fd, data + sent, std::min<uint64_t>(allowed, kPieceSize));
+        if(written < 0)
+        {
+            if(errno != EAGAIN && errno != EINTR)
+            {
+                return false;
+            }
+            Wait(200);
+            continue;
+        }
+        sent += written;
+        window -= written;
+        if(options.pace_baud)
+        {
+            line_free += written * 10000000000ULL / options.pace_baud;
+        }
+    }
+    stats.sent = sent;
+    stats.elapsed = WallNow() - start;
+
+    // Every credit back means the player has read every byte
+    uint64_t deadline = WallNow() + kDrainTimeout;
+    while(options.mode == Mode::kCredit && window < SerialStream::kBufferSize - SerialStream::kCreditBytes &&
+          WallNow() < deadline)
+    {
+        Wait(1000);
+        ReadTokens();
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+// Host side of the serial stream protocol in source/SerialStream.hpp, shared
+// by stream_send (a real USB serial adapter) and stream_bench (a pty).
+//
+// In credit mode nothing goes out until the player grants a window, and no
+// more than the window is ever outstanding. The other modes ignore the
+// tokens and are only there to show what the credits are for.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class StreamSender
+{
+    public:
+        enum class Mode : uint8_t
+        {
+            kCredit = 0,
+            kBlast,             // as fast as the line goes
+            kPaced              // at the stream's bitrate by the wall clock
+        };
+
+        struct Options
+        {
+            Mode mode = Mode::kCredit;
+            // Limits writes to what the line could have carried at baud, 10
+            // bits a byte. A real tty does that itself, a pty does not.
+            uint32_t pace_baud = 0;
+            uint32_t bitrate = 320000;          // kPaced only
+            // Sender stops for hiccup_ms every hiccup_every_ms, the way a
+            // busy host or USB stack does
+            uint32_t hiccup_ms = 0;
+            uint32_t hiccup_every_ms = 0;
+        };
+
+        struct Stats
+        {
+            uint64_t sent;
+            uint64_t elapsed;                   // ns, first to last byte
+            uint64_t waited;                    // ns with data left but no credit
+            uint32_t credits;
+            uint32_t windows;
+            uint32_t hiccups;
+        };
+
+        /// @param fd - tty or pty, switched to non-blocking
+        StreamSender(int fd, const Options& options);
+
+        /// Opens a serial port raw, 8N1, at baud.
+        ///
+        /// @return file descriptor, -1 if it cannot be opened or the baud
+        ///         rate is not one termios has
+        static int OpenSerial(const char * path, uint32_t baud);
+        /// Opens a pty pair, the line side raw. Here the termios headers do
+        /// not clash with the fake LPC40xx registers.
+        static bool OpenPty(int * master, int * line);
+
+        /// Sends all of data, then waits for the credits to show the player
+        /// has taken all of it (credit mode only, at most one second).
+        ///
+        /// @return false on a write error
+        bool Send(const uint8_t * data, size_t size);
+
+        const Stats& GetStats() const { return stats; }
+
+    private:
+        void ReadTokens();
+        void Wait(uint32_t microseconds);
+
+        int fd;
+        Options options;
+        int64_t window;                         // bytes the player has room for
+        Stats stats;
+};
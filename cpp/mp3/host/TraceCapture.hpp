@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "TraceEvents.hpp"
+
+// Loads a 'trace dump' capture. The capture may contain console text
+// around the dump, the "MP3T" header is searched for.
+//
+// @return false with a message printed if there is no trace in the file
+inline bool LoadTraceCapture(const char * path, trace::Header * header,
+                             std::vector<trace::Record> * records)
+{
+    FILE * capture = fopen(path, "rb");
+    if(!capture)
+    {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t block[4096];
+    size_t length;
+    while((length = fread(block, 1, sizeof(block), capture)) > 0)
+    {
+        data.insert(data.end(), block, block + length);
+    }
+    fclose(capture);
+
+    size_t offset = 0;
+    while(offset + sizeof(trace::Header) <= data.size() && memcmp(&data[offset], "MP3T", 4) != 0)
+    {
+        offset++;
+    }
+    if(offset + sizeof(trace::Header) > data.size())
+    {
+        printf("No trace header found\n");
+        return false;
+    }
+
+    memcpy(header, &data[offset], sizeof(*header));
+    offset += sizeof(*header);
+    if(header->cycles_per_us == 0)
+    {
+        header->cycles_per_us = 1;
+    }
+    if(offset + header->count * sizeof(trace::Record) > data.size())
+    {
+        printf("Capture is truncated, decoding what is there\n");
+        header->count = (data.size() - offset) / sizeof(trace::Record);
+    }
+
+    records->resize(header->count);
+    if(header->count)
+    {
+        memcpy(records->data(), &data[offset], header->count * sizeof(trace::Record));
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+// Renders a binary trace captured from the 'trace dump' command as a
+// timeline, followed by per-event counts and the durations of paired
+// events (SD reads and mutex waits).
+//
+// usage: trace_decode <capture.bin>
+#include <cstdio>
+#include <vector>
+
+#include "TraceCapture.hpp"
+#include "TraceEvents.hpp"
+
+namespace
+{
+struct Duration
+{
+    uint32_t count = 0;
+    uint64_t total = 0;
+    uint32_t max = 0;
+    bool open = false;
+    uint64_t start = 0;
+
+    void Begin(uint64_t now)
+    {
+        open = true;
+        start = now;
+    }
+    void End(uint64_t now)
+    {
+        if(!open)
+        {
+            return;
+        }
+        uint32_t length = static_cast<uint32_t>(now - start);
+        total += length;
+        count++;
+        if(length > max)
+        {
+            max = length;
+        }
+        open = false;
+    }
+    void Print(const char * name, uint32_t cycles_per_us) const
+    {
+        if(count)
+        {
+            printf("%-16s %8u %12.1f %12.1f\n", name, count,
+                   static_cast<double>(total) / count / cycles_per_us,
+                   static_cast<double>(max) / cycles_per_us);
+        }
+    }
+};
+}
+
+int main(int argc, char * argv[])
+{
+    if(argc < 2)
+    {
+        printf("usage: %s <capture.bin>\n", argv[0]);
+        return 1;
+    }
+
+    trace::Header header;
+    std::vector<trace::Record> records;
+    if(!LoadTraceCapture(argv[1], &header, &records))
+    {
+        return 1;
+    }
+
+    printf("%u events, %u overwritten, %u cycles/us\n\n",
+           header.count, header.dropped, header.cycles_per_us);
+    printf("%12s %10s  %-16s %s\n", "time (us)", "delta", "event", "arg");
+
+    uint32_t counts[trace::kEventCount] = { 0 };
+    Duration sd_read;
+    Duration mutex_wait[2];
+    uint64_t now = 0;
+    uint32_t previous = 0;
+
+    for(uint32_t i = 0; i < header.count; i++)
+    {
+        const trace::Record& record = records[i];
+
+        // Unsigned difference survives CYCCNT wrapping between records
+        uint32_t delta = (i == 0) ? 0 : record.cycles - previous;
+        previous = record.cycles;
+        now += delta;
+
+        printf("%12.1f %10.1f  %-16s 0x%04X\n",
+               static_cast<double>(now) / header.cycles_per_us,
+               static_cast<double>(delta) / header.cycles_per_us,
+               trace::EventToString(record.event), record.arg);
+
+        if(record.event < trace::kEventCount)
+        {
+            counts[record.event]++;
+        }
+        switch(record.event)
+        {
+            case trace::kSdReadStart: sd_read.Begin(now); break;
+            case trace::kSdReadEnd: sd_read.End(now); break;
+            case trace::kMutexWait: mutex_wait[record.arg & 1].Begin(now); break;
+            case trace::kMutexAcquired: mutex_wait[record.arg & 1].End(now); break;
+            default: break;
+        }
+    }
+
+    printf("\n%-16s %8s\n", "event", "count");
+    for(uint8_t event = 1; event < trace::kEventCount; event++)
+    {
+        printf("%-16s %8u\n", trace::EventToString(event), counts[event]);
+    }
+
+    printf("\n%-16s %8s %12s %12s\n", "duration", "count", "avg (us)", "max (us)");
+    sd_read.Print("SD read", header.cycles_per_us);
+    mutex_wait[trace::kSpiMutex].Print("SPI mutex wait", header.cycles_per_us);
+    mutex_wait[trace::kSdMutex].Print("SD mutex wait", header.cycles_per_us);
+    return 0;
+}
@@ -0,0 +1,439 @@
+// Host benchmark of the serial upload, through the real UploadReceiver code,
+// with UploadSender on the other end of a pty.
+//
+// A child process sends --kb of data through UploadSender over a pty, paced
+// to --baud like the UART would. The parent plays the player: bytes read
+// from the pty go through UploadReceiver::Receive() like the UART
+// interrupt's, and main.cpp's ReceiveUpload() loop wakes on every frame or
+// every 5 ms, writes the full buffers to the image, then sends the replies.
+// A write keeps the card busy for --write-us plus --byte-ns per byte, and
+// after every --spike-kb written one write stalls for --spike-ms more, the
+// way cards pause to erase. Bytes keep arriving while the card is busy, but
+// the loop sends no replies until it is done. Replies reach the sender
+// --latency-us late, the round trip of a USB serial adapter, which a pty
+// does not have. Simulated time follows the wall clock. Three setups send
+// the same file:
+//
+//   stop&wait  one buffer, one frame in flight
+//   single     one buffer, a window of frames in flight
+//   double     two buffers, a window of frames in flight
+//
+// --corrupt-every=N flips a byte of every Nth frame after its CRC, the
+// player must NAK it and the file must still match.
+//
+// usage: upload_bench <sd.img> [--kb=256] [--baud=921600] [--latency-us=1000]
+//        [--write-us=400] [--byte-ns=250] [--spike-ms=250] [--spike-kb=128]
+//        [--corrupt-every=0]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "ff.h"
+#include "ImageDisk.hpp"
+#include "StreamSender.hpp"
+#include "UploadReceiver.hpp"
+#include "UploadSender.hpp"
+#include "utility/time.hpp"
+
+namespace
+{
+constexpr uint64_t kPollTime = 5000000;         // ns, main.cpp's kUploadPollMs
+constexpr uint64_t kGiveUpTime = 120000000000;  // ns, in case the sender hangs
+constexpr const char * kUploadPath = "UPLOAD.MP3";
+// Longest the player loop sleeps with nothing to do
+constexpr uint32_t kIdleSleepUs = 100;
+
+struct Options
+{
+    const char * image = nullptr;
+    uint32_t kb = 256;
+    uint32_t baud = 921600;
+    uint32_t latency_us = 1000;
+    uint32_t write_us = 400;
+    uint32_t byte_ns = 250;
+    uint32_t spike_ms = 250;
+    uint32_t spike_kb = 128;
+    uint32_t corrupt_every = 0;
+};
+
+struct Setup
+{
+    const char * name;
+    uint8_t buffers;
+    uint8_t window;
+};
+
+// Reply on its way to the sender
+struct Reply
+{
+    uint64_t due;
+    uint8_t bytes[4];
+    uint8_t count;
+};
+
+// What the child sends back through the pipe
+struct Report
+{
+    UploadSender::Stats stats;
+    bool ok;
+};
+
+struct Result
+{
+    Report sender;
+    uint64_t card_time;
+    uint64_t max_card_time;
+    uint32_t writes;
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t out_of_order;
+    uint32_t duplicates;
+    uint32_t naks;
+    uint32_t no_room;
+    bool file_ok;
+};
+
+FATFS fs;
+
+bool ParseOption(const char * arg, const char * name, uint32_t * value)
+{
+    size_t length = strlen(name);
+    if(strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = strtoul(arg + length + 1, nullptr, 0);
+        return true;
+    }
+    return false;
+}
+
+uint64_t WallNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Sender side, in the child. Reports its stats through the pipe.
+void RunSender(int pty, int report, const Setup & setup, const Options & options,
+               const std::vector<uint8_t> & data)
+{
+    UploadSender::Options sender_options;
+    sender_options.pace_baud = options.baud;
+    sender_options.window = setup.window;
+    sender_options.corrupt_every = options.corrupt_every;
+
+    UploadSender sender(pty, sender_options);
+    Report result;
+    result.ok = sender.Send(data.data(), data.size());
+    result.stats = sender.GetStats();
+    if(write(report, &result, sizeof(result)) != sizeof(result))
+    {
+        _exit(1);
+    }
+    _exit(result.ok ? 0 : 1);
+}
+
+bool CheckFile(const std::vector<uint8_t> & data)
+{
+    FIL file = {};
+    uint8_t bytes[UploadReceiver::kBufferSize];
+    UINT bytes_read = 0;
+    size_t offset = 0;
+    bool same = true;
+
+    if(f_open(&file, kUploadPath, FA_READ) != FR_OK)
+    {
+        return false;
+    }
+    while(f_read(&file, bytes, sizeof(bytes), &bytes_read) == FR_OK && bytes_read > 0)
+    {
+        if(offset + bytes_read > data.size() || memcmp(bytes, &data[offset], bytes_read) != 0)
+        {
+            same = false;
+            break;
+        }
+        offset += bytes_read;
+    }
+    f_close(&file);
+    return same && offset == data.size();
+}
+
+Result Run(const Setup & setup, const Options & options, const std::vector<uint8_t> & data)
+{
+    Result result;
+    static uint8_t storage[UploadReceiver::kMaxBuffers][UploadReceiver::kBufferSize];
+    UploadReceiver receiver(storage, setup.buffers, setup.window);
+    uint8_t buffer[256];
+    std::deque<uint8_t> on_line;
+    std::deque<Reply> replies;
+    int report[2];
+
+    memset(&result, 0, sizeof(result));
+    int pty;
+    int line;
+    if(!StreamSender::OpenPty(&pty, &line) || pipe(report) != 0)
+    {
+        perror("pty");
+        exit(1);
+    }
+    if(!receiver.Open(data.size()))
+    {
+        printf("Could not create %s\n", kUploadPath);
+        exit(1);
+    }
+
+    uint64_t sim_start = sim::Now();
+    fflush(stdout);
+    pid_t sender = fork();
+    if(sender == 0)
+    {
+        close(pty);
+        RunSender(line, report[1], setup, options, data);
+    }
+    close(report[1]);
+    fcntl(pty, F_SETFL, fcntl(pty, F_GETFL) | O_NONBLOCK);
+    uint64_t wall_start = WallNow();
+    uint64_t next_poll = sim_start;
+    uint64_t busy_until = 0;
+    uint64_t line_time = sim_start;
+    uint64_t byte_time = 10000000000ULL / options.baud;
+    uint32_t since_spike = 0;
+    bool writing = false;
+    bool woken = false;
+    bool sender_done = false;
+
+    while(sim::Now() - sim_start < kGiveUpTime)
+    {
+        uint64_t wall = WallNow() - wall_start;
+        uint64_t simulated_elapsed = sim::Now() - sim_start;
+        if(wall > simulated_elapsed)
+        {
+            sim::Advance(wall - simulated_elapsed);
+        }
+        uint64_t now = sim::Now();
+
+        while(!replies.empty() && replies.front().due <= now)
+        {
+            if(write(pty, replies.front().bytes, replies.front().count) != replies.front().count)
+            {
+                perror("replies");
+            }
+            replies.pop_front();
+        }
+
+        // The sender writes ahead of the line, the UART still shifts the
+        // bytes in one at a time at baud
+        ssize_t count;
+        while((count = read(pty, buffer, sizeof(buffer))) > 0)
+        {
+            if(on_line.empty() && line_time < now)
+            {
+                line_time = now;
+            }
+            on_line.insert(on_line.end(), buffer, buffer + count);
+        }
+
+        // UART interrupt, runs while the card is busy too
+        bool received = false;
+        while(!on_line.empty() && line_time + byte_time <= now)
+        {
+            woken |= receiver.Receive(on_line.front());
+            on_line.pop_front();
+            line_time += byte_time;
+            received = true;
+        }
+        if(!sender_done && waitpid(sender, nullptr, WNOHANG) == sender)
+        {
+            // Whatever it wrote before exiting is read on the next pass
+            sender_done = true;
+            continue;
+        }
+        if(sender_done && on_line.empty() && !writing && !receiver.HasPending())
+        {
+            break;
+        }
+
+        // Terminal task, in f_write until the card is done
+        if(writing)
+        {
+            if(now < busy_until)
+            {
+                usleep(kIdleSleepUs);
+                continue;
+            }
+            receiver.WriteNext();
+            writing = false;
+        }
+        else if(!woken && now < next_poll)
+        {
+            if(!received)
+            {
+                usleep(kIdleSleepUs);
+            }
+            continue;
+        }
+
+        if(receiver.HasPending())
+        {
+            uint64_t cost = options.write_us * 1000ULL + UploadReceiver::kBufferSize * uint64_t(options.byte_ns);
+            since_spike += UploadReceiver::kBufferSize;
+            if(options.spike_kb && since_spike >= options.spike_kb * 1024)
+            {
+                cost += options.spike_ms * 1000000ULL;
+                since_spike = 0;
+            }
+            busy_until = now + cost;
+            writing = true;
+            result.card_time += cost;
+            if(cost > result.max_card_time)
+            {
+                result.max_card_time = cost;
+            }
+            continue;
+        }
+
+        Reply reply;
+        reply.due = now + options.latency_us * 1000ULL;
+        reply.count = receiver.TakeReplies(reply.bytes, sizeof(reply.bytes), (now - sim_start) / 1000000);
+        if(reply.count)
+        {
+            replies.push_back(reply);
+        }
+        woken = false;
+        next_poll = now + kPollTime;
+    }
+    if(!sender_done)
+    {
+        kill(sender, SIGKILL);
+        waitpid(sender, nullptr, 0);
+    }
+
+    result.writes = receiver.GetWrites();
+    result.frames = receiver.GetFrames();
+    result.crc_errors = receiver.GetCrcErrors();
+    result.out_of_order = receiver.GetOutOfOrder();
+    result.duplicates = receiver.GetDuplicates();
+    result.naks = receiver.GetNaks();
+    result.no_room = receiver.GetNoRoom();
+    bool complete = receiver.Close(kUploadPath);
+    result.file_ok = complete && CheckFile(data);
+    if(read(report[0], &result.sender, sizeof(result.sender)) != sizeof(result.sender))
+    {
+        result.sender.ok = false;
+    }
+    close(report[0]);
+    close(line);
+    close(pty);
+    return result;
+}
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!ParseOption(argv[i], "--kb", &options.kb) &&
+           !ParseOption(argv[i], "--baud", &options.baud) &&
+           !ParseOption(argv[i], "--latency-us", &options.latency_us) &&
+           !ParseOption(argv[i], "--write-us", &options.write_us) &&
+           !ParseOption(argv[i], "--byte-ns", &options.byte_ns) &&
+           !ParseOption(argv[i], "--spike-ms", &options.spike_ms) &&
+           !ParseOption(argv[i], "--spike-kb", &options.spike_kb) &&
+           !ParseOption(argv[i], "--corrupt-every", &options.corrupt_every))
+        {
+            options.image = argv[i];
+        }
+    }
+
+    if(!options.image || !options.kb || !options.baud || !ImageDisk::Open(options.image))
+    {
+        printf("usage: %s <sd.img> [--kb=N] [--baud=N] [--latency-us=N] [--write-us=N] [--byte-ns=N] "
+               "[--spike-ms=N] [--spike-kb=N] [--corrupt-every=N]\n", argv[0]);
+        return 1;
+    }
+    if(f_mount(&fs, "", 1) != FR_OK)
+    {
+        printf("Could not mount %s\n", options.image);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    printf("%lu KB over %lu baud, %lu us replies, writes %lu us + %lu ns/B, %lu ms stall every %lu KB\n",
+           static_cast<unsigned long>(options.kb), static_cast<unsigned long>(options.baud),
+           static_cast<unsigned long>(options.latency_us),
+           static_cast<unsigned long>(options.write_us), static_cast<unsigned long>(options.byte_ns),
+           static_cast<unsigned long>(options.spike_ms), static_cast<unsigned long>(options.spike_kb));
+
+    // Not a repeating pattern, a block in the wrong place shows in the check.
+    // Not a whole number of blocks either, so the short last frame is sent.
+    std::vector<uint8_t> data(options.kb * 1024 + 100);
+    uint32_t seed = 12345;
+    for(uint8_t & byte : data)
+    {
+        seed = seed * 1103515245 + 12345;
+        byte = seed >> 24;
+    }
+
+    const Setup setups[] = {
+        { "Stop&wait", 1, 1 },
+        { "Single", 1, UploadReceiver::kWindowBlocks },
+        { "Double", UploadReceiver::kMaxBuffers, UploadReceiver::kWindowBlocks },
+    };
+    Result results[3];
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        results[i] = Run(setups[i], options, data);
+    }
+
+    // Payload the line could carry, 10 bits a byte less the frame overhead
+    double line_rate = options.baud / 10.0 * UploadReceiver::kBlockSize /
+                       (UploadReceiver::kBlockSize + UploadReceiver::kFrameOverhead);
+
+    printf("+---------------------------+------------+------------+------------+\n");
+    printf("| %-25s | %10s | %10s | %10s |\n", "", setups[0].name, setups[1].name, setups[2].name);
+    printf("+---------------------------+------------+------------+------------+\n");
+
+#define UPLOAD_ROW(label, format, expression)                               \
+    printf("| %-25s |", label);                                             \
+    for(const Result & r : results)                                        \
+    {                                                                       \
+        printf(" " format " |", expression);                                \
+    }                                                                       \
+    printf("\n");
+
+    UPLOAD_ROW("Time (s)", "%10.2f", r.sender.stats.elapsed / 1e9);
+    UPLOAD_ROW("Payload (B/s)", "%10.0f", r.sender.stats.elapsed ? data.size() / (r.sender.stats.elapsed / 1e9) : 0.0);
+    UPLOAD_ROW("Of line rate (%)", "%10.1f",
+               r.sender.stats.elapsed ? 100.0 * data.size() / (r.sender.stats.elapsed / 1e9) / line_rate : 0.0);
+    UPLOAD_ROW("Frames sent", "%10u", r.sender.stats.frames);
+    UPLOAD_ROW("Frames resent", "%10u", r.sender.stats.resent);
+    UPLOAD_ROW("Corrupted by sender", "%10u", r.sender.stats.corrupted);
+    UPLOAD_ROW("CRC errors", "%10u", r.crc_errors);
+    UPLOAD_ROW("Out of order", "%10u", r.out_of_order);
+    UPLOAD_ROW("Duplicates", "%10u", r.duplicates);
+    UPLOAD_ROW("Past the window", "%10u", r.no_room);
+    UPLOAD_ROW("NAKs sent", "%10u", r.naks);
+    UPLOAD_ROW("Sender timeouts", "%10u", r.sender.stats.timeouts);
+    UPLOAD_ROW("Card writes", "%10u", r.writes);
+    UPLOAD_ROW("Card busy (%)", "%10.1f",
+               r.sender.stats.elapsed ? 100.0 * r.card_time / r.sender.stats.elapsed : 0.0);
+    UPLOAD_ROW("Longest write (ms)", "%10.1f", r.max_card_time / 1e6);
+    UPLOAD_ROW("File check", "%10s", (r.sender.ok && r.file_ok) ? "ok" : "FAILED");
+#undef UPLOAD_ROW
+    printf("+---------------------------+------------+------------+------------+\n");
+
+    f_unlink(kUploadPath);
+    ImageDisk::Close();
+    bool clean = true;
+    for(const Result & r : results)
+    {
+        clean = clean && r.sender.ok && r.file_ok;
+    }
+    return clean ? 0 : 2;
+}
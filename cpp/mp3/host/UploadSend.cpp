@@ -0,0 +1,79 @@
+// Uploads a file to the player's SD card through a USB serial adapter on
+// the stream UART, for 'upload <file> <bytes>'. Runs the same UploadSender
+// as upload_bench.
+//
+// usage: upload_send <file> <tty> [--baud=921600]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+#include "StreamSender.hpp"
+#include "UploadSender.hpp"
+
+int main(int argc, char * argv[])
+{
+    const char * path = nullptr;
+    const char * tty = nullptr;
+    UploadSender::Options options;
+    uint32_t baud = 921600;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strncmp(argv[i], "--baud=", 7) == 0)
+        {
+            baud = strtoul(argv[i] + 7, nullptr, 0);
+        }
+        else if(!path)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            tty = argv[i];
+        }
+    }
+    if(!path || !tty)
+    {
+        printf("usage: %s <file> <tty> [--baud=N]\n", argv[0]);
+        return 1;
+    }
+
+    FILE * file = fopen(path, "rb");
+    if(!file)
+    {
+        printf("Could not open %s\n", path);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t block[4096];
+    size_t count;
+    while((count = fread(block, 1, sizeof(block), file)) > 0)
+    {
+        data.insert(data.end(), block, block + count);
+    }
+    fclose(file);
+
+    int fd = StreamSender::OpenSerial(tty, baud);
+    if(fd < 0)
+    {
+        printf("Could not open %s at %lu baud\n", tty, static_cast<unsigned long>(baud));
+        return 1;
+    }
+
+    // Type 'upload <name> <bytes>' on the player first, it sends the ready
+    const char * name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    printf("Waiting for 'upload %s %zu'\n", name, data.size());
+    fflush(stdout);
+
+    UploadSender sender(fd, options);
+    bool ok = sender.Send(data.data(), data.size());
+    const UploadSender::Stats & stats = sender.GetStats();
+    printf("%s, %zu bytes in %.1f s, %.0f B/s, %u frames, %u resent, %u NAKs, %u timeouts\n",
+           ok ? "Done" : "FAILED", data.size(), stats.elapsed / 1e9,
+           stats.elapsed ? data.size() / (stats.elapsed / 1e9) : 0.0, stats.frames, stats.resent, stats.naks,
+           stats.timeouts);
+    close(fd);
+    return ok ? 0 : 2;
+}
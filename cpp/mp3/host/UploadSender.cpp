@@ -0,0 +1,212 @@
+#include "UploadSender.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace
+{
+// How far ahead of the line pacing may write, what a USB serial adapter
+// buffers anyway
+constexpr uint64_t kLineSlack = 2000000;                // ns
+
+uint64_t WallNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+UploadSender::UploadSender(int fd, const Options& options)
+    : fd(fd), options(options)
+{
+    memset(&out, 0, sizeof(out));
+    memset(&stats, 0, sizeof(stats));
+    base = 0;
+    next = 0;
+    highest = 0;
+    reply_bytes = 0;
+    ready = false;
+    last_progress = 0;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void UploadSender::BuildFrame(const uint8_t * data, size_t size, uint32_t block)
+{
+    size_t offset = size_t(block) * UploadReceiver::kBlockSize;
+    uint16_t length = std::min<size_t>(size - offset, UploadReceiver::kBlockSize);
+    uint16_t crc = 0xFFFF;
+
+    out.bytes[0] = UploadReceiver::kStartOfFrame;
+    out.bytes[1] = static_cast<uint8_t>(block);
+    out.bytes[2] = length & 0xFF;
+    out.bytes[3] = length >> 8;
+    memcpy(&out.bytes[4], data + offset, length);
+    for(uint16_t i = 1; i < 4 + length; i++)
+    {
+        crc = UploadReceiver::Crc16(crc, out.bytes[i]);
+    }
+    out.bytes[4 + length] = crc & 0xFF;
+    out.bytes[5 + length] = crc >> 8;
+    out.length = length + UploadReceiver::kFrameOverhead;
+    out.offset = 0;
+
+    stats.frames++;
+    if(block < highest)
+    {
+        stats.resent++;
+    }
+    if(options.corrupt_every && stats.frames % options.corrupt_every == 0 && length)
+    {
+        // After the CRC, the player has to catch it
+        out.bytes[4] ^= 0xFF;
+        stats.corrupted++;
+    }
+}
+
+void UploadSender::ReadReplies(uint32_t total)
+{
+    uint8_t bytes[64];
+    ssize_t count;
+
+    while((count = read(fd, bytes, sizeof(bytes))) > 0)
+    {
+        for(ssize_t i = 0; i < count; i++)
+        {
+            if(reply_bytes == 0 && bytes[i] != UploadReceiver::kAck && bytes[i] != UploadReceiver::kNak)
+            {
+                continue;
+            }
+            reply[reply_bytes++] = bytes[i];
+            if(reply_bytes < 2)
+            {
+                continue;
+            }
+            reply_bytes = 0;
+
+            if(reply[0] == UploadReceiver::kAck)
+            {
+                // Last block taken, somewhere from base - 1 to next - 1
+                uint32_t acked = base + static_cast<uint8_t>(reply[1] - static_cast<uint8_t>(base - 1));
+                if(acked >= base && acked <= next)
+                {
+                    base = acked;
+                    last_progress = WallNow();
+                }
+            }
+            else
+            {
+                // Block wanted next, somewhere from base to next
+                uint32_t wanted = base + static_cast<uint8_t>(reply[1] - static_cast<uint8_t>(base));
+                if(!ready)
+                {
+                    // The player is listening
+                    ready = true;
+                }
+                else if(wanted <= next && wanted < total)
+                {
+                    next = wanted;
+                    stats.naks++;
+                }
+                last_progress = WallNow();
+            }
+        }
+    }
+}
+
+void UploadSender::Wait(uint32_t microseconds)
+{
+    struct pollfd descriptor = { fd, POLLIN, 0 };
+    struct timespec timeout = { 0, long(microseconds) * 1000 };
+    ppoll(&descriptor, 1, &timeout, nullptr);
+}
+
+bool UploadSender::Send(const uint8_t * data, size_t size)
+{
+    uint32_t total = (size + UploadReceiver::kBlockSize - 1) / UploadReceiver::kBlockSize;
+    uint64_t deadline = WallNow() + options.ready_ms * 1000000ULL;
+
+    while(!ready)
+    {
+        if(WallNow() >= deadline)
+        {
+            return false;
+        }
+        ReadReplies(total);
+        Wait(1000);
+    }
+
+    uint64_t start = WallNow();
+    uint64_t line_free = start;
+    last_progress = start;
+
+    while(base < total)
+    {
+        // Replies first, they move last_progress on
+        ReadReplies(total);
+        uint64_t now = WallNow();
+        if(base == total)
+        {
+            break;
+        }
+
+        if(out.offset == out.length)
+        {
+            if(next < total && next < base + options.window)
+            {
+                BuildFrame(data, size, next);
+                next++;
+                highest = std::max(highest, next);
+            }
+            else if(now - last_progress >= options.resend_ms * 1000000ULL)
+            {
+                // Nothing heard for a while, start over from the oldest block
+                next = base;
+                last_progress = now;
+                stats.timeouts++;
+                continue;
+            }
+            else
+            {
+                Wait(200);
+                continue;
+            }
+        }
+
+        uint64_t allowed = out.length - out.offset;
+        if(options.pace_baud)
+        {
+            // The line never catches up on time it sat idle
+            line_free = std::max(line_free, now);
+            allowed = std::min<uint64_t>(allowed, (now + kLineSlack - line_free) * (options.pace_baud / 10) / 1000000000ULL);
+        }
+        if(allowed == 0)
+        {
+            Wait(200);
+            continue;
+        }
+
+        ssize_t written = write(fd, &out.bytes[out.offset], allowed);
+        if(written < 0)
+        {
+            if(errno != EAGAIN && errno != EINTR)
+            {
+                return false;
+            }
+            Wait(200);
+            continue;
+        }
+        out.offset += written;
+        stats.wire_bytes += written;
+        if(options.pace_baud)
+        {
+            line_free += written * 10000000000ULL / options.pace_baud;
+        }
+    }
+    stats.elapsed = WallNow() - start;
+    return true;
+}
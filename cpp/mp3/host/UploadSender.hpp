@@ -0,0 +1,73 @@
+// Host side of the upload protocol in source/UploadReceiver.hpp, shared by
+// upload_send (a real USB serial adapter) and upload_bench (a pty).
+//
+// Waits for the player's ready, then keeps up to a window of frames in
+// flight. A NAK sends again from the block it names, and so does a timeout
+// with no ACK, which covers a lost NAK or a frame the player never saw.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "UploadReceiver.hpp"
+
+class UploadSender
+{
+    public:
+        struct Options
+        {
+            // Limits writes to what the line could have carried at baud, 10
+            // bits a byte. A real tty does that itself, a pty does not.
+            uint32_t pace_baud = 0;
+            uint8_t window = UploadReceiver::kWindowBlocks;
+            // Flips a payload byte of every nth frame, 0 for none
+            uint32_t corrupt_every = 0;
+            // After the last ACK or NAK, longer than a card's erase stall
+            uint32_t resend_ms = 500;
+            uint32_t ready_ms = 30000;          // longest wait for the player
+        };
+
+        struct Stats
+        {
+            uint64_t wire_bytes;
+            uint64_t elapsed;                   // ns, ready to the last ACK
+            uint32_t frames;
+            uint32_t resent;                    // frames sent more than once
+            uint32_t naks;
+            uint32_t timeouts;
+            uint32_t corrupted;
+        };
+
+        /// @param fd - tty or pty, switched to non-blocking
+        UploadSender(int fd, const Options& options);
+
+        /// @return true once the player has acknowledged every block
+        bool Send(const uint8_t * data, size_t size);
+
+        const Stats& GetStats() const { return stats; }
+
+    private:
+        // Frame being written, at most one
+        struct Outgoing
+        {
+            uint8_t bytes[UploadReceiver::kBlockSize + UploadReceiver::kFrameOverhead];
+            uint16_t length;
+            uint16_t offset;
+        };
+
+        void BuildFrame(const uint8_t * data, size_t size, uint32_t block);
+        void ReadReplies(uint32_t total);
+        void Wait(uint32_t microseconds);
+
+        int fd;
+        Options options;
+        Outgoing out;
+        uint32_t base;                          // oldest block not acknowledged
+        uint32_t next;                          // next block to send
+        uint32_t highest;                       // blocks sent at least once
+        uint8_t reply[2];
+        uint8_t reply_bytes;
+        bool ready;
+        uint64_t last_progress;
+        Stats stats;
+};
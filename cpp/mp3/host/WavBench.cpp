@@ -0,0 +1,203 @@
+// Host benchmark of CD quality WAV playback (16 bit, 44.1 kHz, stereo,
+// 176.4 KB/s) through the real ZonePipeline, WavFile, VS1053 and LabSpi code.
+//
+// main.cpp's SD reader and consumer run for one zone in simulated time under
+// SimulatedPlayer, like zone_bench, on the first .wav of the image. Two
+// setups play it:
+//
+//   before  2 chunk queue read as soon as a slot is free, SSP at divide 48
+//           (2 MHz)
+//   after   --queue chunks, read once half of them are free with every free
+//           slot in one f_read, SSP at divide 28 (3.4 MHz)
+//
+// A disk read costs --sd-read-us plus --sd-byte-ns per byte. Busy is the
+// simulated time no task was asleep: SPI transfers, DREQ waits and SD reads.
+// Headroom is elapsed over busy, how many times the stream rate the setup
+// could carry; below 1.0 it cannot keep up at all.
+//
+// usage: wav_bench <sd.img> [--seconds=30] [--sd-read-us=500]
+//        [--sd-byte-ns=1000] [--queue=4]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ff.h"
+#include "ImageDisk.hpp"
+#include "SimulatedPlayer.hpp"
+#include "utility/time.hpp"
+#include "VS1053.hpp"
+#include "WavFile.hpp"
+
+namespace
+{
+using SimulatedPlayer::kMaxQueueDepth;
+// The peripheral clock the 2 MHz default of the other benches assumes
+constexpr uint32_t kPeripheralClock = 96000000;
+constexpr uint8_t kBeforeDivide = 48;
+constexpr uint8_t kBeforeQueue = 2;
+
+struct Options
+{
+    const char * image = nullptr;
+    uint32_t seconds = 30;
+    uint32_t sd_read_us = 500;
+    uint32_t sd_byte_ns = 1000;
+    uint32_t queue = 4;
+};
+
+struct Setup
+{
+    const char * name;
+    uint8_t divide;
+    uint32_t queue;
+    uint32_t batch;
+};
+
+struct Result
+{
+    SimulatedVs1053::Stats stats;
+    uint64_t elapsed;
+    uint64_t idle;
+    uint32_t reads;
+    uint64_t read_time;
+};
+
+FATFS fs;
+
+bool ParseOption(const char * arg, const char * name, uint32_t * value)
+{
+    size_t length = strlen(name);
+    if(strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = strtoul(arg + length + 1, nullptr, 0);
+        return true;
+    }
+    return false;
+}
+
+bool Run(const Setup & setup, const Options & options, const WavFile::Format & format, Result * result)
+{
+    SimulatedPlayer::Options player;
+    player.queue_depth = setup.queue;
+    player.read_batch = setup.batch;
+    player.spi_hz = kPeripheralClock / setup.divide;
+    player.bitrate[0] = WavFile::ByteRate(format) * 8;
+    player.is_track = WavFile::IsWavName;
+
+    memset(result, 0, sizeof(*result));
+    if(!SimulatedPlayer::Start(player))
+    {
+        return false;
+    }
+    uint32_t reads = SimulatedPlayer::GetScheduler().GetServed(0);
+    uint64_t read_time = ImageDisk::GetReadTime();
+    uint64_t start_time = sim::Now();
+
+    result->idle = SimulatedPlayer::RunUntil(start_time + options.seconds * 1000000000ULL);
+    SimulatedPlayer::Stop();
+    result->stats = SimulatedPlayer::GetDecoder(0).GetStats();
+    result->elapsed = sim::Now() - start_time;
+    result->reads = SimulatedPlayer::GetScheduler().GetServed(0) - reads;
+    result->read_time = ImageDisk::GetReadTime() - read_time;
+    return true;
+}
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!ParseOption(argv[i], "--seconds", &options.seconds) &&
+           !ParseOption(argv[i], "--sd-read-us", &options.sd_read_us) &&
+           !ParseOption(argv[i], "--sd-byte-ns", &options.sd_byte_ns) &&
+           !ParseOption(argv[i], "--queue", &options.queue))
+        {
+            options.image = argv[i];
+        }
+    }
+
+    if(!options.image || options.queue < 1 || options.queue > kMaxQueueDepth ||
+       !ImageDisk::Open(options.image))
+    {
+        printf("usage: %s <sd.img> [--seconds=N] [--sd-read-us=N] [--sd-byte-ns=N] "
+               "[--queue=1-%u]\n", argv[0], kMaxQueueDepth);
+        return 1;
+    }
+    if(f_mount(&fs, "", 1) != FR_OK)
+    {
+        printf("Could not mount %s\n", options.image);
+        return 1;
+    }
+
+    ImageDisk::SetReadCost(options.sd_read_us * 1000, options.sd_byte_ns);
+
+    // The player's scan finds the same first .wav
+    FIL file;
+    WavFile::Format format;
+    WavFile::Status status = WavFile::Status::kNotWav;
+    const char * song = "";
+    SimulatedPlayer::Options scan;
+    scan.is_track = WavFile::IsWavName;
+    if(SimulatedPlayer::Start(scan))
+    {
+        SimulatedPlayer::Stop();
+        song = SimulatedPlayer::GetSongName(0);
+        if(f_open(&file, song, FA_READ) == FR_OK)
+        {
+            status = WavFile::Parse(&file, &format);
+            f_close(&file);
+        }
+    }
+    if(status != WavFile::Status::kOk)
+    {
+        printf("No playable .wav in %s (%s)\n", options.image, WavFile::StatusToString(status));
+        return 1;
+    }
+    printf("%s: %u ch, %lu Hz, %u bit, samples at %lu, %lu bytes, %lu B/s\n", song,
+           format.channels, static_cast<unsigned long>(format.sample_rate), format.bits_per_sample,
+           static_cast<unsigned long>(format.data_offset), static_cast<unsigned long>(format.data_size),
+           static_cast<unsigned long>(WavFile::ByteRate(format)));
+
+    const Setup setups[] = {
+        { "Before", kBeforeDivide, kBeforeQueue, 1 },
+        { "After", VS1053::kStreamDivide, options.queue, (options.queue + 1) / 2 },
+    };
+    Result results[2];
+    for(uint8_t i = 0; i < 2; i++)
+    {
+        if(!Run(setups[i], options, format, &results[i]))
+        {
+            printf("No .wav files in %s\n", options.image);
+            return 1;
+        }
+    }
+
+    printf("+---------------------------+--------------+--------------+\n");
+    printf("| %-25s | %12s | %12s |\n", "", setups[0].name, setups[1].name);
+    printf("+---------------------------+--------------+--------------+\n");
+
+#define WAV_ROW(label, format, expression)                                  \
+    printf("| %-25s |", label);                                             \
+    for(const Result & r : results)                                        \
+    {                                                                       \
+        printf(" " format " |", expression);                                \
+    }                                                                       \
+    printf("\n");
+
+    double seconds = options.seconds;
+    WAV_ROW("SPI clock (kHz)", "%12u", kPeripheralClock / setups[&r - results].divide / 1000);
+    WAV_ROW("SDI throughput (B/s)", "%12.0f", r.stats.sdi_bytes / seconds);
+    WAV_ROW("Underruns", "%12u", r.stats.underruns);
+    WAV_ROW("Starved time (ms)", "%12.1f", r.stats.starved_time / 1e6);
+    WAV_ROW("Lowest FIFO level (B)", "%12u", r.stats.min_fifo_level);
+    WAV_ROW("SD reads", "%12u", r.reads);
+    WAV_ROW("SD time per second (ms)", "%12.1f", r.read_time / 1e6 / seconds);
+    WAV_ROW("Busy (%)", "%12.1f", 100.0 * (r.elapsed - r.idle) / r.elapsed);
+    WAV_ROW("Headroom (x stream)", "%12.2f", double(r.elapsed) / (r.elapsed - r.idle));
+#undef WAV_ROW
+    printf("+---------------------------+--------------+--------------+\n");
+
+    ImageDisk::Close();
+    return (results[1].stats.underruns == 0) ? 0 : 2;
+}
@@ -0,0 +1,143 @@
+// Host benchmark of multi-zone playback: one VS1053 per SSP port, each with
+// its own queue and consumer, fed by a single SD reader.
+//
+// The real ZonePipeline runs every zone in simulated time under
+// SimulatedPlayer: the consumers (priority 3) empty their queues into their
+// decoders, and the reader (priority 2) asks the real ZoneScheduler which
+// zone to read for, paying --sd-read-us per disk read. Bytes go through the
+// real VS1053 and LabSpi code into one SimulatedVs1053 per port, so
+// underruns are per zone.
+//
+// usage: zone_bench <sd.img> [--zones=2] [--bitrate=128000]
+//        [--bitrate2=320000] [--seconds=60] [--spi=2000000]
+//        [--sd-read-us=1000] [--round-robin=0]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ff.h"
+#include "ImageDisk.hpp"
+#include "SimulatedPlayer.hpp"
+#include "utility/time.hpp"
+
+namespace
+{
+using SimulatedPlayer::kMaxZones;
+
+struct Options
+{
+    const char * image = nullptr;
+    uint32_t zones = 2;
+    uint32_t bitrate[kMaxZones] = { 128000, 320000 };
+    uint32_t seconds = 60;
+    uint32_t spi_hz = 2000000;
+    uint32_t sd_read_us = 1000;
+    uint32_t round_robin = 0;
+};
+
+FATFS fs;
+
+bool ParseOption(const char * arg, const char * name, uint32_t * value)
+{
+    size_t length = strlen(name);
+    if(strncmp(arg, name, length) == 0 && arg[length] == '=')
+    {
+        *value = strtoul(arg + length + 1, nullptr, 0);
+        return true;
+    }
+    return false;
+}
+}
+
+int main(int argc, char * argv[])
+{
+    Options options;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!ParseOption(argv[i], "--zones", &options.zones) &&
+           !ParseOption(argv[i], "--bitrate", &options.bitrate[0]) &&
+           !ParseOption(argv[i], "--bitrate2", &options.bitrate[1]) &&
+           !ParseOption(argv[i], "--seconds", &options.seconds) &&
+           !ParseOption(argv[i], "--spi", &options.spi_hz) &&
+           !ParseOption(argv[i], "--sd-read-us", &options.sd_read_us) &&
+           !ParseOption(argv[i], "--round-robin", &options.round_robin))
+        {
+            options.image = argv[i];
+        }
+    }
+
+    if(!options.image || options.zones < 1 || options.zones > kMaxZones ||
+       !ImageDisk::Open(options.image))
+    {
+        printf("usage: %s <sd.img> [--zones=1|2] [--bitrate=N] [--bitrate2=N] [--seconds=N] "
+               "[--spi=HZ] [--sd-read-us=N] [--round-robin=0|1]\n", argv[0]);
+        return 1;
+    }
+    if(f_mount(&fs, "", 1) != FR_OK)
+    {
+        printf("Could not mount %s\n", options.image);
+        return 1;
+    }
+
+    SimulatedPlayer::Options player;
+    player.zones = options.zones;
+    player.spi_hz = options.spi_hz;
+    for(uint8_t z = 0; z < kMaxZones; z++)
+    {
+        player.bitrate[z] = options.bitrate[z];
+    }
+    if(!SimulatedPlayer::Start(player))
+    {
+        printf("No .mp3 files in %s\n", options.image);
+        return 1;
+    }
+    ImageDisk::SetReadCost(options.sd_read_us * 1000, 0);
+
+    ZoneScheduler& scheduler = SimulatedPlayer::GetScheduler();
+    if(options.round_robin)
+    {
+        scheduler.SetPolicy(ZoneScheduler::Policy::kRoundRobin);
+    }
+
+    SimulatedPlayer::RunUntil(sim::Now() + options.seconds * 1000000000ULL);
+    SimulatedPlayer::Stop();
+
+    printf("+---------------------------+--------------+--------------+\n");
+    printf("| %-25s | %12s | %12s |\n",
+           options.round_robin ? "Round robin" : "Earliest deadline",
+           "Zone 1", "Zone 2");
+    printf("+---------------------------+--------------+--------------+\n");
+
+    uint32_t underruns = 0;
+    const SimulatedVs1053::Stats* stats[kMaxZones];
+    for(uint8_t z = 0; z < options.zones; z++)
+    {
+        stats[z] = &SimulatedPlayer::GetDecoder(z).GetStats();
+        underruns += stats[z]->underruns;
+    }
+
+#define ZONE_ROW(label, format, expression)                                 \
+    printf("| %-25s |", label);                                             \
+    for(uint8_t z = 0; z < kMaxZones; z++)                                  \
+    {                                                                       \
+        if(z < options.zones) { printf(" " format " |", expression); }      \
+        else { printf(" %12s |", "-"); }                                    \
+    }                                                                       \
+    printf("\n");
+
+    double seconds = options.seconds;
+    ZONE_ROW("Stream rate (B/s)", "%12u", options.bitrate[z] / 8);
+    ZONE_ROW("SDI throughput (B/s)", "%12.0f", stats[z]->sdi_bytes / seconds);
+    ZONE_ROW("Underruns", "%12u", stats[z]->underruns);
+    ZONE_ROW("Starved time (ms)", "%12.1f", stats[z]->starved_time / 1e6);
+    ZONE_ROW("Lowest FIFO level (B)", "%12u", stats[z]->min_fifo_level);
+    ZONE_ROW("SD reads", "%12u", scheduler.GetServed(z));
+    ZONE_ROW("Reads past deadline", "%12u", scheduler.GetLate(z));
+    ZONE_ROW("Least slack (ms)", "%12.1f",
+             scheduler.GetMinSlack(z) == UINT64_MAX ? 0.0 : scheduler.GetMinSlack(z) / 1e3);
+#undef ZONE_ROW
+    printf("+---------------------------+--------------+--------------+\n");
+
+    ImageDisk::Close();
+    return (underruns == 0) ? 0 : 2;
+}
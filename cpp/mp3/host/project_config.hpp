@@ -0,0 +1,6 @@
+// Host stand-in for ../project_config.hpp, the same switches without the
+// SJSU-Dev2 config.hpp behind them
+#pragma once
+
+#define MP3_DREQ_LATENCY 1
+#define MP3_PCM_DSP 1
@@ -0,0 +1,4 @@
+#pragma once
+
+// See FreeRTOS.h, every fake is declared there
+#include "FreeRTOS.h"
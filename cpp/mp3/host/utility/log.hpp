@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+#define LOG_DEBUG(format, ...)
+#define LOG_INFO(format, ...)    printf("INFO: " format "\n", ##__VA_ARGS__)
+#define LOG_WARNING(format, ...) printf("WARNING: " format "\n", ##__VA_ARGS__)
+#define LOG_ERROR(format, ...)   printf("ERROR: " format "\n", ##__VA_ARGS__)
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// Simulated time. Nothing advances it except the fake peripherals (each
+// register access and SPI byte costs time) and the bench itself.
+namespace sim
+{
+uint64_t Now();                 // nanoseconds
+void Advance(uint64_t nanoseconds);
+}
+
+/// @return simulated uptime in microseconds
+inline uint64_t Uptime()
+{
+    return sim::Now() / 1000;
+}
+
+inline void Delay(uint32_t milliseconds)
+{
+    sim::Advance(milliseconds * 1000000ULL);
+}
@@ -0,0 +1,7 @@
+TESTS += $(LIBRARY_DIR)/utility/math/test/limits_test.cpp
+TESTS += $(LIBRARY_DIR)/utility/test/bit_test.cpp
+TESTS += $(LIBRARY_DIR)/utility/test/allocator_test.cpp
+
+# RAM and flash use of every region on each link, SJSU-Dev2 and newlib
+# included. main.cpp's static_assert covers the player's own share.
+LINKFLAGS += -Wl,--print-memory-usage
@@ -0,0 +1,21 @@
+// This file overrides the default configuration options in the
+// library/config.hpp file. Open library/config.hpp to see which configuration
+// options you can change.
+#pragma once
+
+#define SJ2_LOG_LEVEL SJ2_LOG_LEVEL_INFO
+
+// DREQ service latency histogram (dreq command), set to 0 for release
+// builds to compile it out of the audio path
+#define MP3_DREQ_LATENCY 1
+
+// Decoders fed from the one SD card. 1 is the single player on SSP1, 2 adds
+// a second VS1053 on SSP2 that plays on its own (pins in main.cpp, control
+// through the zone command)
+#define MP3_ZONE_COUNT 1
+
+// EQ, gain and soft limiter on 16 bit WAV tracks, run by the SD reader
+// (dsp command), set to 0 to build without it
+#define MP3_PCM_DSP 1
+
+#include "config.hpp"
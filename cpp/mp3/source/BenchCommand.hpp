@@ -0,0 +1,240 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include <FreeRTOS.h>
+#include "semphr.h"
+
+#include "ff.h"
+#include "L0_LowLevel/LPC40xx.h"
+#include "L3_Application/commandline.hpp"
+#include "utility/time.hpp"
+#include "VS1053.hpp"
+
+// "bench [file] [save]" runs microbenchmarks of the SSP1, SCI and SD paths
+// and prints them in the same table style as the rtos command. With a file
+// name, f_read is measured on it at several chunk sizes. With "save" the
+// rows are also appended to BENCH.TXT for tracking over time.
+//
+// Every measurement takes SPI_MUTEX or SD_MUTEX for one batch at a time, so
+// playback keeps running (and competing) while the benchmark runs.
+class BenchCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Benchmark SSP1, SCI and f_read. Usage: bench [file] [save]";
+        static constexpr const char kDivider[] =
+            "+------------------+------------+------------+------------+";
+        static constexpr const char kHeader[] =
+            "|    Benchmark     |   Cycles   |  Time per  |    Rate    |\r\n"
+            "|                  |   per op   |   op (us)  |   (KB/s)   |";
+        static constexpr const char kLogFile[] = "BENCH.TXT";
+
+        static constexpr uint16_t kSpiBatch = 512;
+        static constexpr uint16_t kSpiBatches = 64;
+        static constexpr uint16_t kSciReads = 256;
+        static constexpr uint32_t kReadTotal = 64 * 1024;
+        static constexpr uint16_t kMaxChunk = 4096;
+
+        BenchCommand(VS1053* vs1053, SemaphoreHandle_t* spi_mutex, SemaphoreHandle_t* sd_mutex)
+            : Command("bench", kDescription), decoder(vs1053), spi(spi_mutex), sd(sd_mutex)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            const char * file_name = (argc > 1 && strcmp(argv[1], "save") != 0) ? argv[1] : nullptr;
+            save = (strcmp(argv[argc - 1], "save") == 0);
+            log_open = save && OpenLog();
+
+            EnableCycleCounter();
+            puts(kDivider);
+            puts(kHeader);
+            puts(kDivider);
+
+            BenchSpi();
+            BenchSci();
+            if(file_name)
+            {
+                for(uint16_t chunk = 512; chunk <= kMaxChunk; chunk *= 2)
+                {
+                    BenchRead(file_name, chunk);
+                }
+            }
+
+            puts(kDivider);
+            CloseLog();
+            return 0;
+        }
+
+    private:
+        static void EnableCycleCounter()
+        {
+            CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+            DWT->CYCCNT = 0;
+            DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        }
+
+        void BenchSpi()
+        {
+            uint32_t cycles = 0;
+            uint64_t time = 0;
+            uint32_t start_cycles;
+            uint64_t start_time;
+
+            memset(buffer, 0xFF, kSpiBatch);
+            for(uint16_t i = 0; i < kSpiBatches; i++)
+            {
+                if(xSemaphoreTake(*spi, portMAX_DELAY))
+                {
+                    start_time = Uptime();
+                    start_cycles = DWT->CYCCNT;
+                    decoder->transferIdle(buffer, kSpiBatch);
+                    cycles += DWT->CYCCNT - start_cycles;
+                    time += Uptime() - start_time;
+                    xSemaphoreGive(*spi);
+                }
+            }
+            PrintRow("SSP1 byte", cycles, time, kSpiBatch * kSpiBatches, kSpiBatch * kSpiBatches);
+        }
+
+        void BenchSci()
+        {
+            uint32_t cycles = 0;
+            uint64_t time = 0;
+            uint32_t start_cycles;
+            uint64_t start_time;
+
+            for(uint16_t i = 0; i < kSciReads; i++)
+            {
+                if(xSemaphoreTake(*spi, portMAX_DELAY))
+                {
+                    start_time = Uptime();
+                    start_cycles = DWT->CYCCNT;
+                    decoder->readRegister(0x0);     // SCI_MODE
+                    cycles += DWT->CYCCNT - start_cycles;
+                    time += Uptime() - start_time;
+                    xSemaphoreGive(*spi);
+                }
+            }
+            PrintRow("SCI read", cycles, time, kSciReads, kSciReads * 4);
+        }
+
+        void BenchRead(const char * file_name, uint16_t chunk)
+        {
+            FIL file;
+            UINT bytes_read = 0;
+            uint32_t total = 0;
+            uint32_t reads = 0;
+            uint32_t cycles = 0;
+            uint64_t time = 0;
+            uint32_t start_cycles;
+            uint64_t start_time;
+            char name[17];
+
+            if(!xSemaphoreTake(*sd, portMAX_DELAY))
+            {
+                return;
+            }
+            if(f_open(&file, file_name, FA_READ) != FR_OK)
+            {
+                xSemaphoreGive(*sd);
+                printf("| %-16s | could not open file                  |\n", file_name);
+                return;
+            }
+            xSemaphoreGive(*sd);
+
+            while(total < kReadTotal)
+            {
+                if(xSemaphoreTake(*sd, portMAX_DELAY))
+                {
+                    start_time = Uptime();
+                    start_cycles = DWT->CYCCNT;
+                    f_read(&file, buffer, chunk, &bytes_read);
+                    cycles += DWT->CYCCNT - start_cycles;
+                    time += Uptime() - start_time;
+                    xSemaphoreGive(*sd);
+                }
+                if(bytes_read == 0)
+                {
+                    break;  // Shorter than kReadTotal
+                }
+                total += bytes_read;
+                reads++;
+            }
+
+            if(xSemaphoreTake(*sd, portMAX_DELAY))
+            {
+                f_close(&file);
+                xSemaphoreGive(*sd);
+            }
+
+            snprintf(name, sizeof(name), "f_read %u B", chunk);
+            PrintRow(name, cycles, time, reads, total);
+        }
+
+        void PrintRow(const char * name, uint32_t cycles, uint64_t time, uint32_t operations, uint32_t bytes)
+        {
+            char row[80];
+            uint32_t rate = (time) ? static_cast<uint32_t>(bytes * 1000ULL / time) : 0;  // B/ms = KB/s
+
+            if(operations == 0)
+            {
+                return;
+            }
+            snprintf(row, sizeof(row), "| %-16s | %10lu | %10lu | %10lu |",
+                     name, cycles / operations,
+                     static_cast<uint32_t>(time / operations), rate);
+            puts(row);
+
+            if(log_open)
+            {
+                UINT written;
+                char line[96];
+                int length = snprintf(line, sizeof(line), "%lu,%s,%lu,%lu,%lu\r\n",
+                                      static_cast<uint32_t>(Uptime() / 1000), name, cycles / operations,
+                                      static_cast<uint32_t>(time / operations), rate);
+                if(xSemaphoreTake(*sd, portMAX_DELAY))
+                {
+                    f_write(&log, line, length, &written);
+                    xSemaphoreGive(*sd);
+                }
+            }
+        }
+
+        bool OpenLog()
+        {
+            bool opened = false;
+            if(xSemaphoreTake(*sd, portMAX_DELAY))
+            {
+                opened = (f_open(&log, kLogFile, FA_WRITE | FA_OPEN_APPEND) == FR_OK);
+                xSemaphoreGive(*sd);
+            }
+            if(!opened)
+            {
+                printf("Could not open %s, results will not be saved\n", kLogFile);
+            }
+            return opened;
+        }
+
+        void CloseLog()
+        {
+            if(log_open && xSemaphoreTake(*sd, portMAX_DELAY))
+            {
+                f_close(&log);
+                xSemaphoreGive(*sd);
+                printf("Results appended to %s\n", kLogFile);
+            }
+            log_open = false;
+        }
+
+        VS1053* decoder;
+        SemaphoreHandle_t* spi;
+        SemaphoreHandle_t* sd;
+
+        bool save = false;
+        bool log_open = false;
+        FIL log;
+        uint8_t buffer[kMaxChunk];
+};
@@ -0,0 +1,135 @@
+#include "ClockController.hpp"
+
+ClockController::ClockController()
+{
+    // Same as the fixed 0x6000 used before: 3.0x
+    step = 3;
+    floor = kMinStep;
+    stable_periods = 0;
+    polls_with_data = 0;
+    dreq_high_with_data = 0;
+    raises = 0;
+    drops = 0;
+}
+
+void ClockController::RecordDreq(bool dreq_high, bool data_queued)
+{
+    // DREQ while starved says nothing about decoder load
+    if(data_queued)
+    {
+        polls_with_data++;
+        if(dreq_high)
+        {
+            dreq_high_with_data++;
+        }
+    }
+}
+
+void ClockController::NewTrack()
+{
+    floor = kMinStep;
+    stable_periods = 0;
+}
+
+void ClockController::Raise(uint8_t new_step)
+{
+    if(new_step > kMaxStep)
+    {
+        new_step = kMaxStep;
+    }
+    if(new_step > step)
+    {
+        step = new_step;
+        raises++;
+    }
+    stable_periods = 0;
+}
+
+bool ClockController::Update(DecoderTelemetry::Format format, uint32_t bitrate, uint32_t supply_rate)
+{
+    uint8_t previous_step = step;
+    uint16_t polls = polls_with_data;
+    uint16_t dreq_high = dreq_high_with_data;
+    polls_with_data = 0;
+    dreq_high_with_data = 0;
+
+    // Feed forward, raise at once for a more demanding stream
+    uint8_t needed = RequiredStep(format, bitrate);
+    if(needed > floor)
+    {
+        floor = needed;
+    }
+    if(step < floor)
+    {
+        Raise(floor + kHeadroomSteps);
+        return true;
+    }
+
+    // Feedback, only meaningful with a known rate and enough samples
+    uint32_t byte_rate = bitrate / 8;
+    bool short_feed = (byte_rate > 0) &&
+                      (supply_rate * 100 < byte_rate * (100 - kShortfallPercent));
+    bool decoder_busy = (polls >= kMinPolls) &&
+                        ((polls - dreq_high) * 100 >= polls * kBusyDutyPercent);
+
+    if(short_feed && decoder_busy)
+    {
+        Raise(step + 2);
+        floor = step;
+    }
+    else if(short_feed)
+    {
+        // Feed problem rather than decoder load, hold the clock
+        stable_periods = 0;
+    }
+    else if(++stable_periods >= kStablePeriods)
+    {
+        stable_periods = 0;
+        if(step > floor)
+        {
+            step--;
+            drops++;
+        }
+    }
+
+    return (step != previous_step);
+}
+
+uint16_t ClockController::StepToClockf(uint8_t step)
+{
+    // SC_MULT is CLOCKF[15:13], SC_ADD and SC_FREQ stay 0 for a 12.288 MHz XTALI
+    return static_cast<uint16_t>(step << 13);
+}
+
+uint8_t ClockController::StepToMultiplier(uint8_t step)
+{
+    return (step == 0) ? 10 : static_cast<uint8_t>(15 + step * 5);
+}
+
+uint8_t ClockController::RequiredStep(DecoderTelemetry::Format format, uint32_t bitrate)
+{
+    switch(format)
+    {
+        case DecoderTelemetry::Format::kMp3:
+            if(bitrate <= 128000)
+            {
+                return 1;   // 2.0x
+            }
+            if(bitrate <= 192000)
+            {
+                return 2;   // 2.5x
+            }
+            return 3;       // 3.0x
+        case DecoderTelemetry::Format::kWav:
+        case DecoderTelemetry::Format::kMidi:
+            return 1;       // 2.0x
+        case DecoderTelemetry::Format::kAac:
+        case DecoderTelemetry::Format::kOgg:
+        case DecoderTelemetry::Format::kWma:
+            return 4;       // 3.5x
+        case DecoderTelemetry::Format::kFlac:
+            return 6;       // 4.5x
+        default:
+            return 3;       // Unknown, keep the old fixed 3.0x
+    }
+}
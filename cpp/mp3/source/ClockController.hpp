@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+#include "DecoderTelemetry.hpp"
+
+// Picks the VS1053 clock multiplier (SCI_CLOCKF SC_MULT) from measured
+// decoder headroom instead of running every stream at 3.0x.
+//
+// - Feed forward: the stream's format and bitrate give a minimum step.
+//   When a stream needs more than the current step the clock is raised at
+//   once, plus one step of headroom.
+// - Feedback: the consumer records DREQ on every chunk. If DREQ is low for
+//   almost every poll while data was queued, the decoder FIFO is full and
+//   the decoder is the bottleneck; if the SDI feed rate also falls short
+//   of the stream byte rate, the decoder is overloaded and the clock is
+//   raised two steps and the floor pinned there for the rest of the track.
+// - Decay: after kStablePeriods healthy updates the clock drops one step,
+//   never below the floor.
+//
+// Nothing here touches hardware, so the loop can be driven by a simulated
+// decoder on the host.
+class ClockController
+{
+    public:
+        // SC_MULT 0-7 = 1.0x, 2.0x, 2.5x ... 5.0x XTALI
+        static constexpr uint8_t kSteps = 8;
+        // SCI reads are limited to CLKI / 7, below 2.0x the SPI clock is too fast
+        static constexpr uint8_t kMinStep = 1;
+        static constexpr uint8_t kMaxStep = kSteps - 1;
+        static constexpr uint8_t kHeadroomSteps = 1;
+        static constexpr uint8_t kStablePeriods = 10;
+        // Fraction of polls that must see DREQ low for the decoder to count as busy
+        static constexpr uint8_t kBusyDutyPercent = 90;
+        // Feed may fall this far below the stream byte rate before it counts as short
+        static constexpr uint8_t kShortfallPercent = 5;
+        static constexpr uint16_t kMinPolls = 8;
+
+        ClockController();
+
+        /// Called by the SDI consumer each time it checks the decoder.
+        void RecordDreq(bool dreq_high, bool data_queued);
+        /// Called when a new track starts, releases the floor.
+        void NewTrack();
+        /// Runs one control period.
+        ///
+        /// @param format      - current stream format
+        /// @param bitrate     - current stream bitrate in bits per second
+        /// @param supply_rate - SDI bytes per second accepted over the period
+        /// @return true if the step changed and CLOCKF must be rewritten
+        bool Update(DecoderTelemetry::Format format, uint32_t bitrate, uint32_t supply_rate);
+
+        uint8_t GetStep() const { return step; }
+        uint16_t GetClockf() const { return StepToClockf(step); }
+        uint32_t GetRaises() const { return raises; }
+        uint32_t GetDrops() const { return drops; }
+
+        static uint16_t StepToClockf(uint8_t step);
+        /// @return clock multiplier times 10, e.g. 30 for 3.0x
+        static uint8_t StepToMultiplier(uint8_t step);
+        /// @return lowest step expected to decode the stream in real time
+        static uint8_t RequiredStep(DecoderTelemetry::Format format, uint32_t bitrate);
+
+    private:
+        void Raise(uint8_t new_step);
+
+        uint8_t step;
+        uint8_t floor;
+        uint8_t stable_periods;
+
+        volatile uint16_t polls_with_data;
+        volatile uint16_t dreq_high_with_data;
+
+        uint32_t raises;
+        uint32_t drops;
+};
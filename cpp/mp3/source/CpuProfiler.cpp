@@ -0,0 +1,155 @@
+#include "CpuProfiler.hpp"
+#include "utility/time.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+constexpr const char CpuProfiler::kDivider[];
+constexpr const char CpuProfiler::kHeader[];
+
+const char * CpuProfiler::RtosStateToString(eTaskState state)
+{
+    switch (state)
+    {
+        case eTaskState::eBlocked: return "BLOCKED";
+        case eTaskState::eDeleted: return "DELETED";
+        case eTaskState::eInvalid: return "INVALID";
+        case eTaskState::eReady: return "READY";
+        case eTaskState::eRunning: return "RUNNING";
+        case eTaskState::eSuspended: return "SUSPENDED";
+        default: return "UNKNOWN";
+    }
+}
+
+CpuProfiler::CpuProfiler()
+{
+    previous_count = 0;
+    previous_total = 0;
+    pending_length = 0;
+    file_offset = 0;
+    enabled = false;
+    interval = kDefaultIntervalMs;
+    samples = 0;
+    dropped = 0;
+    sectors = 0;
+    last_sample_time = 0;
+    max_sample_time = 0;
+    last_write_time = 0;
+    max_write_time = 0;
+}
+
+void CpuProfiler::Sample(uint64_t now)
+{
+    uint64_t start_time = Uptime();
+    uint32_t total;
+    char line[96];
+    int length;
+
+    if(pending_length > kSectorSize)
+    {
+        // SD writes are behind, skip this sample, the next delta covers it
+        dropped++;
+        return;
+    }
+
+    // Suspends the scheduler while it walks the task lists
+    UBaseType_t count = uxTaskGetSystemState(status, kMaxTasks, &total);
+    uint32_t elapsed = total - previous_total;
+
+    length = snprintf(line, sizeof(line), "\r\nUptime: %lu ms\r\n%s\r\n",
+                      static_cast<uint32_t>(now / 1000), kDivider);
+    Append(line, length);
+    Append(kHeader, sizeof(kHeader) - 1);
+    length = snprintf(line, sizeof(line), "\r\n%s\r\n", kDivider);
+    Append(line, length);
+
+    for(UBaseType_t i = 0; i < count; i++)
+    {
+        uint32_t run_time = status[i].ulRunTimeCounter - PreviousRunTime(status[i].xTaskNumber);
+        uint32_t percent = (elapsed) ? static_cast<uint32_t>(run_time * 100ULL / elapsed) : 0;
+
+        length = snprintf(line, sizeof(line), "| %-16s | %9s | %4lu | %10u | %4lu : %-4lu |\r\n",
+                          status[i].pcTaskName,
+                          RtosStateToString(status[i].eCurrentState),
+                          percent,
+                          status[i].usStackHighWaterMark,
+                          static_cast<uint32_t>(status[i].uxBasePriority),
+                          static_cast<uint32_t>(status[i].uxCurrentPriority));
+        Append(line, length);
+    }
+    length = snprintf(line, sizeof(line), "%s\r\n", kDivider);
+    Append(line, length);
+
+    // Keep the counters for the next delta, deleted tasks drop out
+    for(UBaseType_t i = 0; i < count; i++)
+    {
+        previous[i].number = status[i].xTaskNumber;
+        previous[i].run_time = status[i].ulRunTimeCounter;
+    }
+    previous_count = count;
+    previous_total = total;
+
+    samples++;
+    last_sample_time = Uptime() - start_time;
+    if(last_sample_time > max_sample_time)
+    {
+        max_sample_time = last_sample_time;
+    }
+}
+
+uint32_t CpuProfiler::PreviousRunTime(UBaseType_t number) const
+{
+    for(uint8_t i = 0; i < previous_count; i++)
+    {
+        if(previous[i].number == number)
+        {
+            return previous[i].run_time;
+        }
+    }
+    return 0;   // Task was created since the last sample
+}
+
+void CpuProfiler::Append(const char * text, uint16_t length)
+{
+    if(pending_length + length > sizeof(pending))
+    {
+        length = sizeof(pending) - pending_length;
+    }
+    memcpy(&pending[pending_length], text, length);
+    pending_length += length;
+}
+
+void CpuProfiler::ChunkWritten(uint16_t length, uint64_t write_time)
+{
+    memmove(pending, &pending[length], pending_length - length);
+    pending_length -= length;
+    file_offset += length;
+
+    sectors++;
+    last_write_time = write_time;
+    if(last_write_time > max_write_time)
+    {
+        max_write_time = last_write_time;
+    }
+}
+
+void CpuProfiler::Enable(bool enable)
+{
+    if(enable && !enabled)
+    {
+        // First sample after enabling covers the time since the last one,
+        // start the deltas fresh instead
+        previous_count = uxTaskGetSystemState(status, kMaxTasks, &previous_total);
+        for(uint8_t i = 0; i < previous_count; i++)
+        {
+            previous[i].number = status[i].xTaskNumber;
+            previous[i].run_time = status[i].ulRunTimeCounter;
+        }
+    }
+    enabled = enable;
+}
+
+void CpuProfiler::SetInterval(uint32_t milliseconds)
+{
+    interval = (milliseconds < kMinIntervalMs) ? kMinIntervalMs : milliseconds;
+}
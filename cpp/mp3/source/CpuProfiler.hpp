@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+
+#include <FreeRTOS.h>
+#include "task.h"
+
+// Periodic FreeRTOS runtime stats for CPU.TXT.
+//
+// Sample() snapshots every task with uxTaskGetSystemState() and appends a
+// table (same layout as the rtos command) with each task's CPU% since the
+// previous sample rather than since boot. The text is staged here and
+// handed out one sector at a time so the file only ever sees whole,
+// sector-aligned writes, and the caller chooses when the SD card is free.
+class CpuProfiler
+{
+    public:
+        static constexpr uint8_t kMaxTasks = 16;
+        static constexpr uint16_t kSectorSize = 512;
+        static constexpr uint32_t kDefaultIntervalMs = 5000;
+        static constexpr uint32_t kMinIntervalMs = 500;
+
+        static constexpr const char kDivider[] =
+            "+------------------+-----------+------+------------+-------------+";
+        static constexpr const char kHeader[] =
+            "|    Task Name     |   State   | CPU% | Stack Left |   Priority  |\r\n"
+            "|                  |           |      |  in words  | Base : Curr |";
+
+        static const char * RtosStateToString(eTaskState state);
+
+        CpuProfiler();
+
+        /// Takes a snapshot and appends its table to the staged text. If
+        /// more than a sector is still waiting to be written the sample is
+        /// skipped and counted as dropped.
+        ///
+        /// @param now - Uptime() in microseconds
+        void Sample(uint64_t now);
+
+        /// @param size - current size of the file, so the first chunk ends
+        ///               on a sector boundary
+        void SetFileOffset(uint32_t size) { file_offset = size; }
+        /// @return true when a chunk that ends on a sector boundary is staged
+        bool ChunkReady() const { return pending_length >= ChunkLength(); }
+        const char * GetChunk() const { return pending; }
+        uint16_t ChunkLength() const { return kSectorSize - (file_offset % kSectorSize); }
+        uint16_t GetPendingLength() const { return pending_length; }
+        /// Drops what was just written from the front of the staging buffer.
+        ///
+        /// @param length     - bytes written, normally ChunkLength()
+        /// @param write_time - how long the write held the SD card
+        void ChunkWritten(uint16_t length, uint64_t write_time);
+
+        void Enable(bool enable);
+        bool IsEnabled() const { return enabled; }
+        void SetInterval(uint32_t milliseconds);
+        uint32_t GetInterval() const { return interval; }
+
+        uint32_t GetSamples() const { return samples; }
+        uint32_t GetDropped() const { return dropped; }
+        uint32_t GetSectors() const { return sectors; }
+        uint64_t GetLastSampleTime() const { return last_sample_time; }
+        uint64_t GetMaxSampleTime() const { return max_sample_time; }
+        uint64_t GetLastWriteTime() const { return last_write_time; }
+        uint64_t GetMaxWriteTime() const { return max_write_time; }
+
+    private:
+        struct Previous
+        {
+            UBaseType_t number;
+            uint32_t run_time;
+        };
+
+        void Append(const char * text, uint16_t length);
+        uint32_t PreviousRunTime(UBaseType_t number) const;
+
+        TaskStatus_t status[kMaxTasks];
+        Previous previous[kMaxTasks];
+        uint8_t previous_count;
+        uint32_t previous_total;
+
+        // A full sector still waiting plus a worst case table
+        char pending[kSectorSize * 4];
+        uint16_t pending_length;
+        uint32_t file_offset;
+
+        volatile bool enabled;
+        volatile uint32_t interval;
+
+        uint32_t samples;
+        uint32_t dropped;
+        uint32_t sectors;
+        uint64_t last_sample_time;
+        uint64_t max_sample_time;
+        uint64_t last_write_time;
+        uint64_t max_write_time;
+};
@@ -0,0 +1,141 @@
+#include "DecoderTelemetry.hpp"
+
+namespace
+{
+// Layer III bitrates in kbit/s indexed by HDAT0[15:12]
+const uint16_t kMpeg1Bitrates[16] = {
+    0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0
+};
+const uint16_t kMpeg2Bitrates[16] = {
+    0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0
+};
+}
+
+DecoderTelemetry::DecoderTelemetry()
+{
+    format = Format::kUnknown;
+    bitrate = 0;
+    sample_rate = 0;
+    channels = 0;
+    elapsed = 0;
+    Reset();
+}
+
+void DecoderTelemetry::Reset()
+{
+    supply_rate = 0;
+    last_bytes_sent = 0;
+    last_update_time = 0;
+    starved = false;
+    underruns = 0;
+    updates = 0;
+    max_spi_time = 0;
+}
+
+void DecoderTelemetry::Update(const Registers& registers, uint32_t bytes_sent, uint64_t now)
+{
+    format = DecodeFormat(registers.hdat1);
+    if(format == Format::kMp3)
+    {
+        bitrate = DecodeMp3Bitrate(registers.hdat0, registers.hdat1);
+    }
+    else
+    {
+        // Every other format reports its data rate in bytes per second
+        bitrate = registers.hdat0 * 8UL;
+    }
+
+    // AUDATA[15:1] is the sample rate divided by two, bit 0 is set for stereo
+    sample_rate = registers.audata & 0xFFFE;
+    channels = (registers.audata & 1) ? 2 : 1;
+    elapsed = registers.decode_time;
+
+    if(updates > 0 && now > last_update_time)
+    {
+        supply_rate = static_cast<uint64_t>(bytes_sent - last_bytes_sent) * 1000000ULL /
+                      (now - last_update_time);
+    }
+    last_bytes_sent = bytes_sent;
+    last_update_time = now;
+    updates++;
+}
+
+void DecoderTelemetry::RecordStarvation(bool is_starved)
+{
+    // Count each starved stretch once, not every poll during it
+    if(is_starved && !starved)
+    {
+        underruns++;
+    }
+    starved = is_starved;
+}
+
+void DecoderTelemetry::RecordSpiTime(uint64_t spi_time)
+{
+    if(spi_time > max_spi_time)
+    {
+        max_spi_time = spi_time;
+    }
+}
+
+int32_t DecoderTelemetry::GetMargin() const
+{
+    if(bitrate == 0)
+    {
+        return 0;
+    }
+    uint32_t byte_rate = bitrate / 8;
+    return static_cast<int32_t>((static_cast<int64_t>(supply_rate) - byte_rate) * 100 / byte_rate);
+}
+
+DecoderTelemetry::Format DecoderTelemetry::DecodeFormat(uint16_t hdat1)
+{
+    if((hdat1 & 0xFFE0) == 0xFFE0)
+    {
+        return Format::kMp3;    // MPEG frame sync
+    }
+    switch(hdat1)
+    {
+        case 0x7665: return Format::kWav;   // "ve"
+        case 0x4154:                        // "AT" ADTS
+        case 0x4144:                        // "AD" ADIF
+        case 0x4D34: return Format::kAac;   // "M4" MP4
+        case 0x4F67: return Format::kOgg;   // "Og"
+        case 0x574D: return Format::kWma;   // "WM"
+        case 0x664C: return Format::kFlac;  // "fL"
+        case 0x4D54: return Format::kMidi;  // "MT"
+        default: return Format::kUnknown;
+    }
+}
+
+uint32_t DecoderTelemetry::DecodeMp3Bitrate(uint16_t hdat0, uint16_t hdat1)
+{
+    uint8_t id = (hdat1 >> 3) & 0x3;        // 3 = MPEG 1, 2 = MPEG 2, 0 = MPEG 2.5
+    uint8_t layer = (hdat1 >> 1) & 0x3;     // 1 = Layer III
+    uint8_t index = (hdat0 >> 12) & 0xF;
+
+    if(layer != 1)
+    {
+        return 0;
+    }
+    if(id == 3)
+    {
+        return kMpeg1Bitrates[index] * 1000UL;
+    }
+    return kMpeg2Bitrates[index] * 1000UL;
+}
+
+const char * DecoderTelemetry::FormatToString(Format format)
+{
+    switch(format)
+    {
+        case Format::kMp3: return "MP3";
+        case Format::kWav: return "WAV";
+        case Format::kAac: return "AAC";
+        case Format::kOgg: return "OGG";
+        case Format::kWma: return "WMA";
+        case Format::kFlac: return "FLAC";
+        case Format::kMidi: return "MIDI";
+        default: return "UNKNOWN";
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+// Derives what the VS1053 is playing from its status registers and keeps
+// track of how well the SDI feed keeps up with it.
+//
+// Update() is given a snapshot of SCI_DECODETIME, SCI_HDAT0, SCI_HDAT1 and
+// SCI_AUDATA taken in one SPI_MUTEX hold, plus the running count of bytes
+// sent over SDI, so it never touches the bus itself.
+class DecoderTelemetry
+{
+    public:
+        enum class Format : uint8_t
+        {
+            kUnknown = 0,
+            kMp3,
+            kWav,
+            kAac,
+            kOgg,
+            kWma,
+            kFlac,
+            kMidi
+        };
+
+        struct Registers
+        {
+            uint16_t decode_time;
+            uint16_t hdat0;
+            uint16_t hdat1;
+            uint16_t audata;
+        };
+
+        DecoderTelemetry();
+
+        /// @param registers  - status register snapshot
+        /// @param bytes_sent - total SDI bytes sent so far
+        /// @param now        - Uptime() in microseconds when the snapshot was taken
+        void Update(const Registers& registers, uint32_t bytes_sent, uint64_t now);
+        /// Call whenever the decoder is checked for data: counts every time
+        /// DREQ is high (decoder wants data) while the audio buffer is empty.
+        void RecordStarvation(bool starved);
+        /// Records how long the register snapshot held the SPI bus.
+        void RecordSpiTime(uint64_t spi_time);
+        /// Clears the rate and underrun history, e.g. on a track change.
+        void Reset();
+
+        Format GetFormat() const { return format; }
+        /// @return bitrate in bits per second, 0 if unknown
+        uint32_t GetBitrate() const { return bitrate; }
+        uint16_t GetSampleRate() const { return sample_rate; }
+        uint8_t GetChannels() const { return channels; }
+        /// @return playback position in seconds
+        uint16_t GetElapsed() const { return elapsed; }
+        /// @return SDI feed rate in bytes per second over the last update
+        uint32_t GetSupplyRate() const { return supply_rate; }
+        /// @return how far the feed rate is above (+) or below (-) the
+        ///         stream's byte rate in percent, 0 if the bitrate is unknown
+        int32_t GetMargin() const;
+        uint32_t GetUnderruns() const { return underruns; }
+        uint32_t GetUpdates() const { return updates; }
+        uint64_t GetMaxSpiTime() const { return max_spi_time; }
+
+        static const char * FormatToString(Format format);
+        static Format DecodeFormat(uint16_t hdat1);
+        static uint32_t DecodeMp3Bitrate(uint16_t hdat0, uint16_t hdat1);
+
+    private:
+        Format format;
+        uint32_t bitrate;
+        uint16_t sample_rate;
+        uint8_t channels;
+        uint16_t elapsed;
+
+        uint32_t supply_rate;
+        uint32_t last_bytes_sent;
+        uint64_t last_update_time;
+
+        bool starved;
+        uint32_t underruns;
+        uint32_t updates;
+        uint64_t max_spi_time;
+};
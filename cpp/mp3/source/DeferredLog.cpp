@@ -0,0 +1,88 @@
+#include "DeferredLog.hpp"
+#include "utility/time.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+DeferredLog::DeferredLog()
+{
+    for(uint32_t i = 0; i < kSize; i++)
+    {
+        entries[i].sequence = i;
+    }
+    head = 0;
+    tail = 0;
+    logged = 0;
+    dropped = 0;
+    max_pending = 0;
+    sd_enabled = false;
+}
+
+void DeferredLog::Push(const char * format, const Word * words)
+{
+    uint32_t position = head.load(std::memory_order_relaxed);
+    Entry* entry;
+
+    while(1)
+    {
+        entry = &entries[position & (kSize - 1)];
+        int32_t lag = static_cast<int32_t>(entry->sequence.load(std::memory_order_acquire) - position);
+        if(lag == 0)
+        {
+            // Slot is free, claim it unless another writer got there first
+            if(head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if(lag < 0)
+        {
+            // Reader has not drained this slot yet, the ring is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->format = format;
+    entry->time = Uptime();
+    memcpy(entry->args, words, sizeof(entry->args));
+    entry->sequence.store(position + 1, std::memory_order_release);
+    logged.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool DeferredLog::Drain(char * line, size_t size)
+{
+    Entry& entry = entries[tail & (kSize - 1)];
+    if(entry.sequence.load(std::memory_order_acquire) != tail + 1)
+    {
+        return false;
+    }
+
+    uint32_t pending = head - tail;
+    if(pending > max_pending)
+    {
+        max_pending = pending;
+    }
+
+    uint32_t milliseconds = static_cast<uint32_t>(entry.time / 1000);
+    int length = snprintf(line, size, "[%7" PRIu32 ".%03" PRIu32 "] ",
+                          milliseconds / 1000, milliseconds % 1000);
+    length += snprintf(line + length, size - length - 1, entry.format,
+                       entry.args[0], entry.args[1], entry.args[2], entry.args[3]);
+    if(length > static_cast<int>(size) - 2)
+    {
+        length = size - 2;
+    }
+    line[length] = '\n';
+    line[length + 1] = '\0';
+
+    // Hand the slot back to writers one lap ahead
+    entry.sequence.store(tail + kSize, std::memory_order_release);
+    tail++;
+    return true;
+}
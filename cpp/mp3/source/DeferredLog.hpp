@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Logger that keeps formatting and UART time off the caller.
+//
+// Log() only stores the format string pointer, a timestamp and up to
+// kMaxArgs raw argument words in a ring; vLogTask formats and prints them
+// later at idle priority. Writers claim a slot with a compare-and-swap, so
+// Log() is safe from tasks and ISRs and never blocks: when the ring is full
+// the message is counted as dropped instead.
+//
+// Because formatting happens later, a %s argument must point at storage
+// that outlives the message (literals, global tables), and arguments must
+// fit in a word, so no doubles or 64-bit values.
+class DeferredLog
+{
+    public:
+        typedef uintptr_t Word;
+
+        static constexpr uint32_t kSize = 64;
+        static_assert((kSize & (kSize - 1)) == 0, "Log size must be a power of two");
+        static constexpr uint8_t kMaxArgs = 4;
+        static constexpr uint16_t kLineLength = 128;
+
+        DeferredLog();
+
+        template <typename... Args>
+        void Log(const char * format, Args... args)
+        {
+            static_assert(sizeof...(Args) <= kMaxArgs, "Too many arguments for a deferred log");
+            const Word words[kMaxArgs] = { ToWord(args)... };
+            Push(format, words);
+        }
+
+        /// Formats the oldest message into line, ending in "\n". Only one
+        /// task may drain.
+        ///
+        /// @return false if the ring is empty
+        bool Drain(char * line, size_t size);
+
+        void EnableSd(bool enable) { sd_enabled = enable; }
+        bool IsSdEnabled() const { return sd_enabled; }
+
+        uint32_t GetLogged() const { return logged; }
+        uint32_t GetDropped() const { return dropped; }
+        uint32_t GetPending() const { return head - tail; }
+        uint32_t GetMaxPending() const { return max_pending; }
+
+    private:
+        struct Entry
+        {
+            // Slot is free for the writer at position n when sequence == n,
+            // and holds a message for the reader when sequence == n + 1
+            std::atomic<uint32_t> sequence;
+            const char * format;
+            uint64_t time;
+            Word args[kMaxArgs];
+        };
+
+        template <typename T>
+        static Word ToWord(T value)
+        {
+            static_assert(sizeof(T) <= sizeof(Word), "Deferred log arguments must fit in a word");
+            return (Word)value;
+        }
+
+        void Push(const char * format, const Word * words);
+
+        Entry entries[kSize];
+        std::atomic<uint32_t> head;
+        uint32_t tail;
+        std::atomic<uint32_t> logged;
+        std::atomic<uint32_t> dropped;
+        uint32_t max_pending;
+        volatile bool sd_enabled;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "DreqLatency.hpp"
+#include "L3_Application/commandline.hpp"
+
+// "dreq"            prints the DREQ service latency histogram
+// "dreq reset"      clears it
+// "dreq alarm <us>" logs every wait longer than this
+class DreqCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "DREQ service latency. Usage: dreq [reset|alarm <us>]";
+
+        explicit DreqCommand(DreqLatency* dreq_latency)
+            : Command("dreq", kDescription), latency(dreq_latency)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+#if MP3_DREQ_LATENCY
+            if(argc > 1 && strcmp(argv[1], "reset") == 0)
+            {
+                latency->Reset();
+                printf("DREQ latency cleared\n");
+                return 0;
+            }
+            if(argc > 2 && strcmp(argv[1], "alarm") == 0)
+            {
+                latency->SetAlarm(strtoul(argv[2], nullptr, 10));
+            }
+
+            const LatencyHistogram& histogram = latency->GetHistogram();
+            printf("Samples : %lu\n", histogram.GetCount());
+            printf("Min     : %lu us\n", histogram.GetMin());
+            printf("Mean    : %lu us\n", histogram.GetMean());
+            printf("p99     : %lu us\n", histogram.Percentile(99));
+            printf("Max     : %lu us\n", histogram.GetMax());
+            printf("Alarm   : over %lu us, %lu times\n", latency->GetAlarm(), latency->GetAlarms());
+            for(uint8_t bucket = 0; bucket < LatencyHistogram::kBuckets; bucket++)
+            {
+                if(histogram.GetBucket(bucket))
+                {
+                    printf("  >= %8lu us : %lu\n", LatencyHistogram::BucketFloor(bucket),
+                           histogram.GetBucket(bucket));
+                }
+            }
+#else
+            printf("DREQ latency is compiled out, set MP3_DREQ_LATENCY in project_config.hpp\n");
+#endif
+            return 0;
+        }
+
+    private:
+        DreqLatency* latency;
+};
@@ -0,0 +1,38 @@
+#include "DreqLatency.hpp"
+
+#if MP3_DREQ_LATENCY
+
+DreqLatency::DreqLatency(DeferredLog* log)
+{
+    alarm_log = log;
+    rise_time = 0;
+    alarm = kDefaultAlarmUs;
+    Reset();
+}
+
+void DreqLatency::ServiceStart(uint64_t now)
+{
+    uint32_t rise = rise_time;
+    if(rise == 0)
+    {
+        return;     // DREQ not seen high yet, the send stops short of it
+    }
+
+    // 32-bit difference is fine, waits are far shorter than the 71 minute wrap
+    last_latency = static_cast<uint32_t>(now) - rise;
+    histogram.Record(last_latency);
+    if(last_latency > alarm)
+    {
+        alarms++;
+        alarm_log->Log("DREQ waited %lu us for data", last_latency);
+    }
+}
+
+void DreqLatency::Reset()
+{
+    alarms = 0;
+    last_latency = 0;
+    histogram.Reset();
+}
+
+#endif
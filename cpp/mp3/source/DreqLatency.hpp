@@ -0,0 +1,77 @@
+#pragma once
+
+#include <project_config.hpp>
+
+#include <cstdint>
+
+#include "DeferredLog.hpp"
+#include "LatencyHistogram.hpp"
+
+// Set MP3_DREQ_LATENCY to 0 in project_config.hpp to compile the
+// measurement out, every call below then becomes an empty inline.
+#ifndef MP3_DREQ_LATENCY
+#define MP3_DREQ_LATENCY 1
+#endif
+
+// Measures how long the VS1053 waits for data: from the first time DREQ is
+// seen high with no chunk in flight to the start of the next send to it.
+//
+// DREQ (P1.23) is on a port without GPIO interrupts, so Sample() is called
+// from the tick hook (when configUSE_TICK_HOOK is set) and from the
+// consumer loop. The rise is seen up to one tick late, so a recorded
+// latency can be short by that much but is never too long.
+class DreqLatency
+{
+    public:
+        static constexpr uint32_t kDefaultAlarmUs = 50000;
+
+#if MP3_DREQ_LATENCY
+        /// @param log - where waits over the alarm threshold are reported
+        explicit DreqLatency(DeferredLog* log);
+
+        /// Safe from ISRs. A decoder that is paused, recording or between
+        /// streams is not waiting for data, so a rise seen before playback
+        /// stopped is dropped rather than timed across the gap.
+        ///
+        /// @param dreq    - current DREQ level
+        /// @param playing - the zone is playing, its consumer feeding it
+        /// @param now     - Uptime() in microseconds
+        inline void Sample(bool dreq, bool playing, uint64_t now)
+        {
+            if(!playing)
+            {
+                rise_time = 0;
+            }
+            else if(dreq && rise_time == 0)
+            {
+                rise_time = static_cast<uint32_t>(now) | 1;
+            }
+        }
+        /// Call right before bytes go to the decoder. Waits over the alarm
+        /// threshold are counted and logged.
+        void ServiceStart(uint64_t now);
+        /// Call right after the send, DREQ is sampled afresh from here.
+        void ServiceEnd() { rise_time = 0; }
+
+        void SetAlarm(uint32_t microseconds) { alarm = microseconds; }
+        uint32_t GetAlarm() const { return alarm; }
+        uint32_t GetAlarms() const { return alarms; }
+        uint32_t GetLastLatency() const { return last_latency; }
+        const LatencyHistogram& GetHistogram() const { return histogram; }
+        void Reset();
+
+    private:
+        // Low 32 bits of Uptime(), odd so 0 can mean no rise pending
+        volatile uint32_t rise_time;
+        uint32_t alarm;
+        uint32_t alarms;
+        uint32_t last_latency;
+        LatencyHistogram histogram;
+        DeferredLog* alarm_log;
+#else
+        explicit DreqLatency(DeferredLog*) {}
+        inline void Sample(bool, bool, uint64_t) {}
+        inline void ServiceStart(uint64_t) {}
+        inline void ServiceEnd() {}
+#endif
+};
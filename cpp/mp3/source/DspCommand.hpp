@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "L0_LowLevel/LPC40xx.h"
+#include "L3_Application/commandline.hpp"
+#include "PcmDsp.hpp"
+#include "utility/time.hpp"
+
+// "dsp"                          EQ, gain and limiter settings for WAV tracks
+// "dsp on|off"                   switches the stage in or out
+// "dsp band <n> off"             takes one band out
+// "dsp band <n> peak|low|high <hz> <db> [q x10]"
+//                                sets a peaking, low shelf or high shelf band
+// "dsp gain <db>"                output gain before the limiter
+// "dsp bench"                    cycles per sample of the scalar and SIMD
+//                                paths on the current settings, and whether
+//                                they agree bit for bit
+class DspCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "PCM EQ and limiter. Usage: dsp [on|off|band <n> ...|gain <db>|bench]";
+        static constexpr const char * kTypeNames[] = { "off", "peak", "low", "high" };
+
+        static constexpr uint16_t kBenchFrames = 256;
+        static constexpr uint8_t kBenchPasses = 32;
+
+        explicit DspCommand(PcmDsp* pcm_dsp)
+            : Command("dsp", kDescription), dsp(pcm_dsp)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+#if MP3_PCM_DSP
+            if(argc > 1 && (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0))
+            {
+                dsp->SetEnabled(strcmp(argv[1], "on") == 0);
+            }
+            else if(argc > 3 && strcmp(argv[1], "band") == 0)
+            {
+                if(!SetBand(argc, argv))
+                {
+                    printf("Band is 0-%u, %u-20000 Hz, %d to +%d dB, Q x10 %u-%u\n",
+                           PcmDsp::kMaxBands - 1, PcmDsp::kMinFrequency, PcmDsp::kMinBandGain,
+                           PcmDsp::kMaxBandGain, PcmDsp::kMinQ, PcmDsp::kMaxQ);
+                    return 1;
+                }
+            }
+            else if(argc > 2 && strcmp(argv[1], "gain") == 0)
+            {
+                dsp->SetGain(strtol(argv[2], nullptr, 10));
+            }
+            else if(argc > 1 && strcmp(argv[1], "bench") == 0)
+            {
+                Bench();
+                return 0;
+            }
+
+            printf("Stage   : %s, %s path\n", dsp->IsEnabled() ? "on" : "off",
+                   dsp->HasSimd() ? "SIMD" : "scalar");
+            printf("Format  : %lu Hz, %u ch\n", dsp->GetSampleRate(), dsp->GetChannels());
+            printf("Gain    : %d dB\n", dsp->GetGain());
+            for(uint8_t band = 0; band < PcmDsp::kMaxBands; band++)
+            {
+                const PcmDsp::Band& settings = dsp->GetBand(band);
+                printf("Band %u  : %-4s %5u Hz %+3d dB Q %u.%u\n", band,
+                       kTypeNames[static_cast<uint8_t>(settings.type)], settings.frequency,
+                       settings.gain_db, settings.q_tenths / 10, settings.q_tenths % 10);
+            }
+            printf("Limited : %lu of %lu samples\n", dsp->GetLimited(), dsp->GetSamples());
+#else
+            printf("The PCM DSP stage is compiled out, set MP3_PCM_DSP in project_config.hpp\n");
+#endif
+            return 0;
+        }
+
+    private:
+        bool SetBand(int argc, const char * const argv[])
+        {
+            PcmDsp::Band settings;
+            uint8_t band = strtoul(argv[2], nullptr, 10);
+            uint8_t type = 0;
+
+            while(type < 4 && strcmp(argv[3], kTypeNames[type]) != 0)
+            {
+                type++;
+            }
+            if(type == 4 || band >= PcmDsp::kMaxBands)
+            {
+                return false;
+            }
+
+            settings = dsp->GetBand(band);
+            settings.type = static_cast<PcmDsp::BandType>(type);
+            if(argc > 5)
+            {
+                settings.frequency = strtoul(argv[4], nullptr, 10);
+                settings.gain_db = strtol(argv[5], nullptr, 10);
+            }
+            if(argc > 6)
+            {
+                settings.q_tenths = strtoul(argv[6], nullptr, 10);
+            }
+            return dsp->SetBand(band, settings);
+        }
+
+        // Both paths on copies of the live settings, so playback is not
+        // disturbed, fed the same -6 dBFS noise
+        void Bench()
+        {
+            uint32_t seed = 1;
+            uint32_t scalar_cycles = 0;
+            uint32_t simd_cycles = 0;
+            uint64_t simd_time = 0;
+            uint32_t differ = 0;
+            uint32_t start_cycles;
+            uint64_t start_time;
+            uint32_t samples = kBenchFrames * dsp->GetChannels();
+
+            CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+            DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+            PcmDsp scalar = *dsp;
+            PcmDsp simd = *dsp;
+            scalar.SetEnabled(true);
+            simd.SetEnabled(true);
+
+            for(uint8_t pass = 0; pass < kBenchPasses; pass++)
+            {
+                for(uint32_t i = 0; i < samples; i++)
+                {
+                    seed = seed * 1664525 + 1013904223;
+                    scalar_samples[i] = static_cast<int16_t>(seed >> 16) / 2;
+                    simd_samples[i] = scalar_samples[i];
+                }
+
+                start_cycles = DWT->CYCCNT;
+                scalar.ProcessScalar(scalar_samples, kBenchFrames);
+                scalar_cycles += DWT->CYCCNT - start_cycles;
+
+                start_time = Uptime();
+                start_cycles = DWT->CYCCNT;
+                simd.ProcessSimd(simd_samples, kBenchFrames);
+                simd_cycles += DWT->CYCCNT - start_cycles;
+                simd_time += Uptime() - start_time;
+
+                for(uint32_t i = 0; i < samples; i++)
+                {
+                    differ += (scalar_samples[i] != simd_samples[i]);
+                }
+            }
+
+            samples *= kBenchPasses;
+            printf("Scalar    : %lu cycles per sample\n", scalar_cycles / samples);
+            printf("SIMD      : %lu cycles per sample\n", simd_cycles / samples);
+            printf("Bit exact : %s, %lu of %lu samples differ\n", differ ? "no" : "yes", differ, samples);
+            // Share of real time the SIMD path needs at the current format
+            printf("Load      : %lu.%02lu%% at %lu Hz, %u ch\n",
+                   static_cast<uint32_t>(simd_time * dsp->GetSampleRate() * dsp->GetChannels() / samples / 10000),
+                   static_cast<uint32_t>(simd_time * dsp->GetSampleRate() * dsp->GetChannels() / samples / 100 % 100),
+                   dsp->GetSampleRate(), dsp->GetChannels());
+        }
+
+        PcmDsp* dsp;
+        int16_t scalar_samples[kBenchFrames * PcmDsp::kMaxChannels];
+        int16_t simd_samples[kBenchFrames * PcmDsp::kMaxChannels];
+};
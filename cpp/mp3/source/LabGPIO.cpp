@@ -72,16 +72,6 @@ void LabGPIO::SetDirection(Direction direction)
     }
 }
 
-void LabGPIO::SetHigh()
-{
-    LPC_GPIOx->PIN |= (1 << _pin); 
-}
-
-void LabGPIO::SetLow()
-{
-    LPC_GPIOx->PIN &= ~(1 << _pin); 
-}
-
 void LabGPIO::set(State state)
 {
     if(state == State::kHigh)
@@ -100,11 +90,6 @@ LabGPIO::State LabGPIO::Read()
     return static_cast<State>(result);
 }
 
-bool LabGPIO::ReadBool()
-{
-    return (LPC_GPIOx->PIN >> _pin) & 1;
-}
-
 void LabGPIO::AttachInterruptHandler(IsrPointer isr, Edge edge)
 {
     pin_isr_map[_port][_pin] = isr;
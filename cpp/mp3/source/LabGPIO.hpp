@@ -41,9 +41,11 @@ class LabGPIO
         /// @param output - true => output, false => set pin to input
         void SetDirection(Direction direction);
         /// Set voltage of pin to HIGH
-        void SetHigh();
+        /// Inline, like SetLow() and ReadBool(), so drivers polling or
+        /// toggling a pin in a loop do not pay for a call each time.
+        void SetHigh() { LPC_GPIOx->PIN |= (1 << _pin); }
         /// Set voltage of pin to LOW 
-        void SetLow();
+        void SetLow() { LPC_GPIOx->PIN &= ~(1 << _pin); }
         /// Set pin state to high or low depending on the input state parameter.
         /// Has no effect if the pin is set as "input".
         ///
@@ -56,7 +58,7 @@ class LabGPIO
         /// Should return the state of the pin (input or output, doesn't matter)
         ///
         /// @return level of pin high => true, low => false
-        bool ReadBool();
+        bool ReadBool() { return (LPC_GPIOx->PIN >> _pin) & 1; }
         // This handler should place a function pointer within the lookup table for 
         // the GpioInterruptHandler() to find.
         //
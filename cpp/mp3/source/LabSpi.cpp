@@ -17,14 +17,28 @@ bool LabSpi::Initialize(uint8_t data_size_select, FrameModes format, uint8_t div
     }
 
 
-    if(port == kPort1)
+    if(port == kPort0)
+    {
+        LOG_INFO("Enable SSP0");
+        LOG_INFO("Initializing P2.22 as SSP0_SCK");
+        LOG_INFO("Initializing P2.27 as SSP0_MOSI");
+        LOG_INFO("Initializing P2.26 as SSP0_MISO");
+
+        LPC_SC->PCONP |=  (1 << 21);                                // Enable power for SSP0 (PCSSP0)
+        LPC_IOCON->P2_22 = (LPC_IOCON->P2_22 & ~(0b111)) | 0b010;   // Sets P2_22 as SSP0_SCK
+        LPC_IOCON->P2_27 = (LPC_IOCON->P2_27 & ~(0b111)) | 0b010;   // Sets P2_27 as SSP0_MOSI
+        LPC_IOCON->P2_26 = (LPC_IOCON->P2_26 & ~(0b111)) | 0b010;   // Sets P2_26 as SSP0_MISO
+
+        LPC_SSPx = LPC_SSP0;
+    }
+    else if(port == kPort1)
     {
         LOG_INFO("Enable SSP1");
         LOG_INFO("Initializing P0.7 as SSP1_SCK");
         LOG_INFO("Initializing P0.9 as SSP1_MOSI");
         LOG_INFO("Initializing P0.8 as SSP1_MISO");
 
-        LPC_SC->PCONP |=  (1 << 20);                            // Enable power for SSP1 (PCSSP1)
+        LPC_SC->PCONP |=  (1 << 10);                            // Enable power for SSP1 (PCSSP1)
         LPC_IOCON->P0_7 = (LPC_IOCON->P0_7 & ~(0b111)) | 0b010; // Sets P0_7 as SSP1_SCK
         LPC_IOCON->P0_9 = (LPC_IOCON->P0_9 & ~(0b111)) | 0b010; // Sets P0_9 as SSP1_MOSI
         LPC_IOCON->P0_8 = (LPC_IOCON->P0_8 & ~(0b111)) | 0b010; // Sets P0_8 as SSP1_MISO
@@ -68,21 +82,4 @@ bool LabSpi::Initialize(uint8_t data_size_select, FrameModes format, uint8_t div
     LPC_SSPx->CR1 |= (1 << 1);       // Enable SSP2
 
     return true;
-}
-
-uint8_t LabSpi::Transfer(uint8_t send) 
-{
-    uint8_t result_byte = 0;
-
-    // Set SSP2 Data Register to send value
-    LPC_SSPx->DR = send; 
-
-    while(LPC_SSPx->SR & (1 << 4))
-    {
-        continue;   // BSY is set, currently sending/receiving frame
-    }
-
-    // When BSY bit is set, SSP2 Data Register holds value read from d
-    result_byte = LPC_SSPx->DR;
-    return result_byte;
 }
\ No newline at end of file
@@ -39,12 +39,84 @@ class LabSpi
      * Transfers a byte via SSP to an external device using the SSP data register.
      * This region must be protected by a mutex static to this class.
      *
+     * Inline so a driver's transfer loop is one store, a busy poll and a
+     * load per byte instead of a call.
+     *
      * @return received byte from external device via SSP data register.
      */
     uint8_t Transfer(uint8_t send);
+
+    /**
+     * Sends a block with the transmit FIFO kept full, so frames go out back
+     * to back instead of waiting out each one like Transfer(). Received
+     * bytes are dropped. Returns once the last frame is on the wire.
+     */
+    void Write(const uint8_t * data, uint16_t size);
+
+    /**
+     * Changes the SSP clock prescaler after Initialize(), e.g. to speed up
+     * once the device on the bus can take a faster clock.
+     *
+     * @param divide even number between 2 and 254
+     */
+    void SetDivider(uint8_t divide) { LPC_SSPx->CPSR = divide; }
     
  
  private:
+    enum StatusBits : uint32_t
+    {
+        kTransmitNotFull    = (1 << 1),
+        kReceiveNotEmpty    = (1 << 2),
+        kBusy               = (1 << 4)
+    };
+
+
     LPC_SSP_TypeDef* LPC_SSPx;
 };
+
+inline uint8_t LabSpi::Transfer(uint8_t send)
+{
+    uint8_t result_byte = 0;
+
+    // Set SSP2 Data Register to send value
+    LPC_SSPx->DR = send; 
+
+    while(LPC_SSPx->SR & (1 << 4))
+    {
+        continue;   // BSY is set, currently sending/receiving frame
+    }
+
+    // When BSY bit is set, SSP2 Data Register holds value read from d
+    result_byte = LPC_SSPx->DR;
+    return result_byte;
+}
+
+inline void LabSpi::Write(const uint8_t * data, uint16_t size)
+{
+    uint8_t discard = 0;
+
+    for(uint16_t i = 0; i < size; i++)
+    {
+        while(!(LPC_SSPx->SR & kTransmitNotFull))
+        {
+            continue;   // 8 frames queued already
+        }
+        LPC_SSPx->DR = data[i];
+        // Empty the receive FIFO as it fills so it never overruns
+        while(LPC_SSPx->SR & kReceiveNotEmpty)
+        {
+            discard = LPC_SSPx->DR;
+        }
+    }
+    while(LPC_SSPx->SR & kBusy)
+    {
+        continue;
+    }
+    while(LPC_SSPx->SR & kReceiveNotEmpty)
+    {
+        discard = LPC_SSPx->DR;
+    }
+    (void)discard;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "LabUart.hpp"
+#include "L0_LowLevel/interrupt.hpp"
+#include "utility/log.hpp"
+
+LabUart* LabUart::ports[4] = { nullptr };
+
+namespace
+{
+enum LineStatus : uint32_t
+{
+    kReceiveReady   = (1 << 0),
+    kLineErrors     = (0b1111 << 1),    // overrun, parity, framing, break
+    kTransmitEmpty  = (1 << 5)
+};
+
+constexpr uint32_t kDivisorLatch = (1 << 7);
+constexpr uint32_t k8N1 = 0b11;
+constexpr uint32_t kFifoEnable = (1 << 0);
+constexpr uint32_t kFifoReset = (0b11 << 1);
+constexpr uint32_t kTrigger8 = (0b10 << 6);
+constexpr uint32_t kReceiveInterrupts = (1 << 0) | (1 << 2);   // data and line status
+}
+
+bool LabUart::Initialize(Port port, uint32_t baud, ReceiveHandler handler)
+{
+    uint32_t best_divisor = 0;
+    uint32_t best_mul = 1;
+    uint32_t best_add = 0;
+    uint32_t best_error = UINT32_MAX;
+
+    // baud = PCLK / (16 * divisor * (1 + add / mul)), add 0 or a divisor of
+    // at least 3 as the user manual requires
+    for(uint32_t mul = 1; mul <= 15; mul++)
+    {
+        for(uint32_t add = 0; add < mul; add++)
+        {
+            uint32_t divisor = (kPeripheralClock * mul + 8 * baud * (mul + add)) / (16 * baud * (mul + add));
+            if(divisor == 0 || divisor > 0xFFFF || (add && divisor < 3))
+            {
+                continue;
+            }
+            uint32_t actual = kPeripheralClock * mul / (16 * divisor * (mul + add));
+            uint32_t error = (actual > baud) ? actual - baud : baud - actual;
+            if(error < best_error)
+            {
+                best_error = error;
+                best_divisor = divisor;
+                best_mul = mul;
+                best_add = add;
+            }
+        }
+    }
+    if(best_divisor == 0 || best_error > baud / 50)
+    {
+        LOG_WARNING("UART%u FAILED to initialize: %lu baud is out of reach", port, baud);
+        return false;
+    }
+
+    if(port == kPort2)
+    {
+        LOG_INFO("Enable UART2, P2.8 TXD2, P2.9 RXD2");
+        LPC_SC->PCONP |= (1 << 24);                                 // PCUART2
+        LPC_IOCON->P2_8 = (LPC_IOCON->P2_8 & ~(0b111)) | 0b010;     // TXD2
+        LPC_IOCON->P2_9 = (LPC_IOCON->P2_9 & ~(0b111)) | 0b010;     // RXD2
+        LPC_UARTx = LPC_UART2;
+    }
+    else if(port == kPort3)
+    {
+        LOG_INFO("Enable UART3, P4.28 TXD3, P4.29 RXD3");
+        LPC_SC->PCONP |= (1 << 25);                                 // PCUART3
+        LPC_IOCON->P4_28 = (LPC_IOCON->P4_28 & ~(0b111)) | 0b010;   // TXD3
+        LPC_IOCON->P4_29 = (LPC_IOCON->P4_29 & ~(0b111)) | 0b010;   // RXD3
+        LPC_UARTx = LPC_UART3;
+    }
+    else
+    {
+        LOG_WARNING("UART FAILED to initialize: Invalid Port is used.");
+        return false;
+    }
+
+    receive = handler;
+    actual_baud = kPeripheralClock * best_mul / (16 * best_divisor * (best_mul + best_add));
+    line_errors = 0;
+    ports[port] = this;
+
+    LPC_UARTx->IER = 0;
+    LPC_UARTx->LCR = kDivisorLatch | k8N1;
+    LPC_UARTx->DLL = best_divisor & 0xFF;
+    LPC_UARTx->DLM = best_divisor >> 8;
+    LPC_UARTx->FDR = (best_mul << 4) | best_add;
+    LPC_UARTx->LCR = k8N1;
+    LPC_UARTx->FCR = kFifoEnable | kFifoReset | kTrigger8;
+    LPC_UARTx->IER = kReceiveInterrupts;
+
+    RegisterIsr((port == kPort2) ? UART2_IRQn : UART3_IRQn,
+                (port == kPort2) ? Uart2Handler : Uart3Handler);
+    return true;
+}
+
+void LabUart::Disable()
+{
+    LPC_UARTx->IER = 0;
+}
+
+void LabUart::Send(uint8_t byte)
+{
+    while(!(LPC_UARTx->LSR & kTransmitEmpty));
+    LPC_UARTx->THR = byte;
+}
+
+void LabUart::Uart2Handler()
+{
+    ports[kPort2]->HandleInterrupt();
+}
+
+void LabUart::Uart3Handler()
+{
+    ports[kPort3]->HandleInterrupt();
+}
+
+void LabUart::HandleInterrupt()
+{
+    uint32_t status;
+
+    // Empties the FIFO, which also clears the data and timeout interrupts.
+    // Reading LSR clears a line status interrupt.
+    while((status = LPC_UARTx->LSR) & kReceiveReady)
+    {
+        if(status & kLineErrors)
+        {
+            line_errors++;
+        }
+        receive(LPC_UARTx->RBR);
+    }
+    if(status & kLineErrors)
+    {
+        line_errors++;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+#include "L0_LowLevel/LPC40xx.h"
+
+// Interrupt driven UART for byte streams from a host, on the ports the
+// command line does not use. Each received byte is handed to a callback
+// from the interrupt, so the caller decides where it is buffered.
+class LabUart
+{
+    public:
+        enum Port : uint8_t
+        {
+            kPort2 = 2,         // P2.8 TXD2, P2.9 RXD2
+            kPort3 = 3          // P4.28 TXD3, P4.29 RXD3
+        };
+
+        typedef void (*ReceiveHandler)(uint8_t byte);
+
+        // What the SSP dividers are worked out against as well
+        static constexpr uint32_t kPeripheralClock = 96000000;
+        // Receive interrupt once this many bytes are in the 16 byte FIFO,
+        // or after 4 quiet character times with fewer
+        static constexpr uint8_t kReceiveTrigger = 8;
+
+        /// Powers the port, sets its pins and the closest baud rate the
+        /// fractional divider gives, 8N1, and enables the receive interrupt.
+        ///
+        /// @return false for a port this class does not drive, or a baud
+        ///         rate more than 2% off
+        bool Initialize(Port port, uint32_t baud, ReceiveHandler handler);
+        /// Masks the port's interrupts, received bytes are no longer handed on
+        void Disable();
+
+        /// Waits for room in the transmit holding register
+        void Send(uint8_t byte);
+
+        uint32_t GetBaud() const { return actual_baud; }
+        /// @return overrun, parity, framing and break errors since Initialize()
+        uint32_t GetLineErrors() const { return line_errors; }
+
+    private:
+        static void Uart2Handler();
+        static void Uart3Handler();
+        void HandleInterrupt();
+
+        static LabUart* ports[4];
+
+        LPC_UART_TypeDef* LPC_UARTx;
+        ReceiveHandler receive;
+        uint32_t actual_baud;
+        volatile uint32_t line_errors;
+};
@@ -0,0 +1,61 @@
+#include "LatencyHistogram.hpp"
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+void LatencyHistogram::Record(uint32_t microseconds)
+{
+    uint8_t bucket = (microseconds == 0) ? 0 : 32 - __builtin_clz(microseconds);
+    if(bucket >= kBuckets)
+    {
+        bucket = kBuckets - 1;
+    }
+    buckets[bucket]++;
+
+    if(count == 0 || microseconds < min)
+    {
+        min = microseconds;
+    }
+    if(microseconds > max)
+    {
+        max = microseconds;
+    }
+    total += microseconds;
+    count++;
+}
+
+void LatencyHistogram::Reset()
+{
+    for(uint8_t i = 0; i < kBuckets; i++)
+    {
+        buckets[i] = 0;
+    }
+    count = 0;
+    min = 0;
+    max = 0;
+    total = 0;
+}
+
+uint32_t LatencyHistogram::Percentile(uint8_t percent) const
+{
+    // Smallest number of samples that covers percent of them
+    uint32_t target = (static_cast<uint64_t>(count) * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    if(count == 0)
+    {
+        return 0;
+    }
+    for(uint8_t bucket = 0; bucket < kBuckets; bucket++)
+    {
+        seen += buckets[bucket];
+        if(seen >= target)
+        {
+            uint32_t upper = (bucket + 1 < kBuckets) ? BucketFloor(bucket + 1) - 1 : max;
+            return (upper < max) ? upper : max;
+        }
+    }
+    return max;
+}
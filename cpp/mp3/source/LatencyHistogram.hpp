@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Log2-bucketed latency histogram in microseconds. Bucket 0 counts 0 us
+// and bucket k counts [2^(k-1), 2^k) us, so 24 buckets reach past 8 s
+// while keeping a few percent resolution where it matters. Percentiles
+// are reported as the upper edge of the bucket they fall in.
+class LatencyHistogram
+{
+    public:
+        static constexpr uint8_t kBuckets = 24;
+
+        LatencyHistogram();
+
+        void Record(uint32_t microseconds);
+        void Reset();
+
+        uint32_t GetCount() const { return count; }
+        uint32_t GetMin() const { return (count) ? min : 0; }
+        uint32_t GetMax() const { return max; }
+        uint32_t GetMean() const { return (count) ? static_cast<uint32_t>(total / count) : 0; }
+        uint32_t GetBucket(uint8_t bucket) const { return buckets[bucket]; }
+        /// @param percent - 1 to 100
+        /// @return upper bound in microseconds, never more than GetMax()
+        uint32_t Percentile(uint8_t percent) const;
+
+        /// @return first microsecond value counted in bucket
+        static uint32_t BucketFloor(uint8_t bucket)
+        {
+            return (bucket == 0) ? 0 : (1UL << (bucket - 1));
+        }
+
+    private:
+        uint32_t buckets[kBuckets];
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        uint64_t total;
+};
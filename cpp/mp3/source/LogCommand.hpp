@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "DeferredLog.hpp"
+#include "L0_LowLevel/LPC40xx.h"
+#include "L3_Application/commandline.hpp"
+
+// "log"              prints deferred log counters
+// "log sd on|off"    also appends drained lines to LOG.TXT
+// "log bench"        measures the per call cost of a deferred log against
+//                    formatting and printing the same line directly
+class LogCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Deferred log. Usage: log [sd on|off] [bench]";
+        static constexpr uint8_t kBenchCalls = 16;
+        static constexpr uint8_t kBenchPrints = 4;
+
+        explicit LogCommand(DeferredLog* deferred_log)
+            : Command("log", kDescription), log(deferred_log)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 2 && strcmp(argv[1], "sd") == 0)
+            {
+                log->EnableSd(strcmp(argv[2], "on") == 0);
+                printf("Logging to SD %s\n", log->IsSdEnabled() ? "on" : "off");
+            }
+            else if(argc > 1 && strcmp(argv[1], "bench") == 0)
+            {
+                Bench();
+            }
+            else
+            {
+                printf("Logged:      %lu\n", log->GetLogged());
+                printf("Dropped:     %lu\n", log->GetDropped());
+                printf("Pending:     %lu of %lu\n", log->GetPending(), DeferredLog::kSize);
+                printf("Max pending: %lu\n", log->GetMaxPending());
+                printf("SD:          %s\n", log->IsSdEnabled() ? "on" : "off");
+            }
+            return 0;
+        }
+
+    private:
+        void Bench()
+        {
+            char line[DeferredLog::kLineLength];
+            uint32_t start_cycles;
+            uint32_t deferred_cycles;
+            uint32_t format_cycles;
+            uint32_t print_cycles;
+
+            CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+            DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+            start_cycles = DWT->CYCCNT;
+            for(uint8_t i = 0; i < kBenchCalls; i++)
+            {
+                log->Log("log bench %u volume %u", i, 50);
+            }
+            deferred_cycles = (DWT->CYCCNT - start_cycles) / kBenchCalls;
+
+            start_cycles = DWT->CYCCNT;
+            for(uint8_t i = 0; i < kBenchCalls; i++)
+            {
+                snprintf(line, sizeof(line), "log bench %u volume %u\n", i, 50);
+            }
+            format_cycles = (DWT->CYCCNT - start_cycles) / kBenchCalls;
+
+            start_cycles = DWT->CYCCNT;
+            for(uint8_t i = 0; i < kBenchPrints; i++)
+            {
+                printf("direct bench %u volume %u\n", i, 50);
+            }
+            print_cycles = (DWT->CYCCNT - start_cycles) / kBenchPrints;
+
+            printf("Cycles per call:\n");
+            printf("  deferred log  %lu\n", deferred_cycles);
+            printf("  snprintf      %lu\n", format_cycles);
+            printf("  printf        %lu\n", print_cycles);
+        }
+
+        DeferredLog* log;
+};
@@ -0,0 +1,5 @@
+#include "OledPanel.hpp"
+
+// The definitions live in OledFramebuffer.hpp so host tests can plug in a
+// fake panel. The SSD1306 framebuffer is built here once.
+template class BasicOledFramebuffer<OledPanel>;
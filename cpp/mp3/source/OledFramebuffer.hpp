@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "OledFont.hpp"
+#include "utility/time.hpp"
+
+// Character-cell framebuffer that draws straight into the SSD1306's display
+// RAM.
+//
+// The 128x64 panel is 8 pages tall (one page = 8 pixel rows = one text row)
+// and 16 characters wide. Callers draw into the pending buffer with the same
+// Clear/SetCursor/printf calls they used on OledTerminal, then call Flush()
+// to push only the changed column span of each page: a column and page
+// window, then the glyph columns of the cells in it.
+//
+// Panel is anything with the calls of OledPanel (OledPanel.hpp):
+//
+//   void Command(uint8_t command)
+//   void Data(const uint8_t * bytes, uint16_t count)
+//
+// Host tests plug in a fake that keeps its own display RAM.
+template <class Panel>
+class BasicOledFramebuffer
+{
+    public:
+        static constexpr uint8_t kColumns = 16;
+        static constexpr uint8_t kPages = 8;
+        // Each character cell is 8 pixel columns, one byte per column per page.
+        static constexpr uint8_t kBytesPerCell = 8;
+        // Column and page window in front of every dirty span
+        static constexpr uint8_t kWindowBytes = 6;
+
+        // Inclusive range of dirty columns in a page. A clean page has
+        // first > last.
+        struct Span
+        {
+            uint8_t first;
+            uint8_t last;
+            bool IsDirty() const { return first <= last; }
+        };
+
+        explicit BasicOledFramebuffer(Panel* panel);
+
+        /// Blanks the pending buffer and homes the cursor. Nothing is sent
+        /// to the panel until Flush().
+        void Clear();
+        /// Moves the cursor to a character cell.
+        ///
+        /// @param column - 0 to kColumns - 1
+        /// @param page   - 0 to kPages - 1
+        void SetCursor(uint8_t column, uint8_t page);
+        /// Writes formatted text at the cursor. Text wraps at the right edge,
+        /// '\n' moves to the start of the next page and anything written past
+        /// the last page is dropped.
+        void printf(const char * format, ...);
+        /// Sends every dirty span to the panel and marks it clean.
+        ///
+        /// @return bytes written to the panel, commands and display data
+        uint32_t Flush();
+        /// Marks the whole panel dirty, e.g. after something else drew on it.
+        void Invalidate();
+
+        /// Computes the smallest span of columns that differs between what is
+        /// on the panel and what is pending for one page.
+        static Span Diff(const char * shown, const char * pending, uint8_t length);
+
+        uint32_t GetLastFlushBytes() const { return last_flush_bytes; }
+        uint64_t GetLastFlushTime() const { return last_flush_time; }
+        uint32_t GetTotalFlushBytes() const { return total_flush_bytes; }
+
+    private:
+        void Put(char character);
+        // Sends one page's span, @return bytes written
+        uint32_t SendSpan(uint8_t page, Span span);
+
+        Panel* oled;
+
+        char shown[kPages][kColumns];
+        char pending[kPages][kColumns];
+
+        uint8_t cursor_column;
+        uint8_t cursor_page;
+
+        uint32_t last_flush_bytes;
+        uint64_t last_flush_time;
+        uint32_t total_flush_bytes;
+};
+
+#define OLED_TEMPLATE template <class Panel>
+#define OLED_CLASS BasicOledFramebuffer<Panel>
+
+OLED_TEMPLATE
+OLED_CLASS::BasicOledFramebuffer(Panel* panel)
+{
+    oled = panel;
+    cursor_column = 0;
+    cursor_page = 0;
+    last_flush_bytes = 0;
+    last_flush_time = 0;
+    total_flush_bytes = 0;
+
+    // Panel is assumed blank after its Initialize()
+    memset(shown, ' ', sizeof(shown));
+    memset(pending, ' ', sizeof(pending));
+}
+
+OLED_TEMPLATE
+void OLED_CLASS::Clear()
+{
+    memset(pending, ' ', sizeof(pending));
+    cursor_column = 0;
+    cursor_page = 0;
+}
+
+OLED_TEMPLATE
+void OLED_CLASS::SetCursor(uint8_t column, uint8_t page)
+{
+    cursor_column = (column < kColumns) ? column : kColumns - 1;
+    cursor_page = (page < kPages) ? page : kPages - 1;
+}
+
+OLED_TEMPLATE
+void OLED_CLASS::printf(const char * format, ...)
+{
+    char line[kColumns * kPages + 1];
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if(length > static_cast<int>(sizeof(line)) - 1)
+    {
+        length = sizeof(line) - 1;
+    }
+    for(int i = 0; i < length; i++)
+    {
+        Put(line[i]);
+    }
+}
+
+OLED_TEMPLATE
+void OLED_CLASS::Put(char character)
+{
+    if(cursor_page >= kPages)
+    {
+        return;     // Past the bottom of the panel
+    }
+
+    if(character == '\n')
+    {
+        cursor_column = 0;
+        cursor_page++;
+        return;
+    }
+
+    pending[cursor_page][cursor_column] = character;
+    if(++cursor_column == kColumns)
+    {
+        cursor_column = 0;
+        cursor_page++;
+    }
+}
+
+OLED_TEMPLATE
+typename OLED_CLASS::Span OLED_CLASS::Diff(const char * shown, const char * pending, uint8_t length)
+{
+    Span span = { 1, 0 };
+    uint8_t first = 0;
+    uint8_t last = length;
+
+    while(first < length && shown[first] == pending[first])
+    {
+        first++;
+    }
+    if(first == length)
+    {
+        return span;    // Page is clean
+    }
+    while(shown[last - 1] == pending[last - 1])
+    {
+        last--;
+    }
+
+    span.first = first;
+    span.last = last - 1;
+    return span;
+}
+
+OLED_TEMPLATE
+uint32_t OLED_CLASS::SendSpan(uint8_t page, Span span)
+{
+    uint8_t columns[kColumns * kBytesPerCell];
+    uint16_t count = 0;
+
+    // Glyph one column in from the cell's left edge, blank columns around it
+    for(uint8_t cell = span.first; cell <= span.last; cell++)
+    {
+        const uint8_t * glyph = oled_font::Glyph(pending[page][cell]);
+        columns[count++] = 0;
+        memcpy(&columns[count], glyph, oled_font::kWidth);
+        count += oled_font::kWidth;
+        while(count % kBytesPerCell)
+        {
+            columns[count++] = 0;
+        }
+    }
+
+    // Horizontal addressing, so the data fills the window left to right
+    oled->Command(0x21);
+    oled->Command(span.first * kBytesPerCell);
+    oled->Command((span.last + 1) * kBytesPerCell - 1);
+    oled->Command(0x22);
+    oled->Command(page);
+    oled->Command(page);
+    oled->Data(columns, count);
+    return kWindowBytes + count;
+}
+
+OLED_TEMPLATE
+uint32_t OLED_CLASS::Flush()
+{
+    uint64_t start_time = Uptime();
+    uint32_t bytes = 0;
+
+    for(uint8_t page = 0; page < kPages; page++)
+    {
+        Span span = Diff(shown[page], pending[page], kColumns);
+        if(!span.IsDirty())
+        {
+            continue;
+        }
+
+        bytes += SendSpan(page, span);
+        memcpy(&shown[page][span.first], &pending[page][span.first], span.last - span.first + 1);
+    }
+
+    last_flush_bytes = bytes;
+    last_flush_time = Uptime() - start_time;
+    total_flush_bytes += bytes;
+    return bytes;
+}
+
+OLED_TEMPLATE
+void OLED_CLASS::Invalidate()
+{
+    // Force every cell to differ from the pending buffer
+    memset(shown, 0, sizeof(shown));
+}
+
+#undef OLED_CLASS
+#undef OLED_TEMPLATE
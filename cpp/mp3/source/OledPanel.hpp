@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include "L2_HAL/displays/oled/ssd1306.hpp"
+#include "OledFramebuffer.hpp"
+
+// The SJTwo's SSD1306 as BasicOledFramebuffer's panel. Commands and display
+// data go straight to the controller, without Ssd1306's pixel bitmap or
+// OledTerminal's repaint of the whole panel on every printf.
+class OledPanel
+{
+    public:
+        /// Brings the controller up and blanks its display RAM.
+        void Initialize()
+        {
+            ssd1306.Initialize();
+            ssd1306.Clear();
+            ssd1306.Update();
+        }
+        void Command(uint8_t command)
+        {
+            ssd1306.Write(command, Ssd1306::Transaction::kCommand);
+        }
+        void Data(const uint8_t * bytes, uint16_t count)
+        {
+            for(uint16_t i = 0; i < count; i++)
+            {
+                ssd1306.Write(bytes[i], Ssd1306::Transaction::kData);
+            }
+        }
+
+    private:
+        Ssd1306 ssd1306;
+};
+
+using OledFramebuffer = BasicOledFramebuffer<OledPanel>;
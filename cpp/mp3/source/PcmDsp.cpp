@@ -0,0 +1,360 @@
+#include "PcmDsp.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#include "L0_LowLevel/LPC40xx.h"
+#endif
+
+namespace
+{
+constexpr float kPi = 3.14159265f;
+// Bits the shift back to 16 drops
+constexpr uint32_t kErrorMask = (1 << PcmDsp::kCoefficientBits) - 1;
+
+// The Cortex-M4 DSP instructions the SIMD path is written in. Off target
+// they are emulated with the exact same results, so the host can check the
+// path against ProcessScalar().
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+constexpr bool kHasSimd = true;
+
+inline uint32_t Smlad(uint32_t x, uint32_t y, uint32_t accumulator)
+{
+    return __SMLAD(x, y, accumulator);
+}
+
+inline uint32_t Pkhbt(uint32_t low, uint32_t high)
+{
+    return __PKHBT(low, high, 16);
+}
+
+inline int32_t Ssat16(int32_t value)
+{
+    return __SSAT(value, 16);
+}
+#else
+constexpr bool kHasSimd = false;
+
+// Sum of the products of both halves, wrapping like the instruction
+inline uint32_t Smlad(uint32_t x, uint32_t y, uint32_t accumulator)
+{
+    int32_t low = static_cast<int16_t>(x) * static_cast<int16_t>(y);
+    int32_t high = static_cast<int16_t>(x >> 16) * static_cast<int16_t>(y >> 16);
+    return accumulator + static_cast<uint32_t>(low) + static_cast<uint32_t>(high);
+}
+
+// Bottom half of low, top half of high shifted up
+inline uint32_t Pkhbt(uint32_t low, uint32_t high)
+{
+    return (low & 0xFFFF) | (high << 16);
+}
+
+inline int32_t Ssat16(int32_t value)
+{
+    return (value > 32767) ? 32767 : (value < -32768) ? -32768 : value;
+}
+#endif
+
+int16_t ToFixed(float value)
+{
+    float scaled = value * (1 << PcmDsp::kCoefficientBits);
+    scaled = (scaled > 32767.0f) ? 32767.0f : (scaled < -32768.0f) ? -32768.0f : scaled;
+    return static_cast<int16_t>(lrintf(scaled));
+}
+}
+
+PcmDsp::PcmDsp()
+{
+    static const uint16_t kDefaultFrequencies[kMaxBands] = { 100, 1000, 3000, 10000 };
+
+    for(uint8_t band = 0; band < kMaxBands; band++)
+    {
+        bands[band] = { BandType::kOff, 0, 7, kDefaultFrequencies[band] };
+    }
+    gain_db = 0;
+    sample_rate = 44100;
+    channels = 2;
+    enabled = false;
+    changed = true;
+    stages = 0;
+    gain = 1 << kGainBits;
+    active = false;
+    Reset();
+}
+
+void PcmDsp::SetFormat(uint32_t rate, uint8_t channel_count)
+{
+    if(rate != sample_rate || channel_count != channels)
+    {
+        sample_rate = rate;
+        channels = (channel_count > kMaxChannels) ? kMaxChannels : channel_count;
+        changed = true;
+    }
+}
+
+bool PcmDsp::SetBand(uint8_t band, const Band& settings)
+{
+    if(band >= kMaxBands ||
+       settings.gain_db < kMinBandGain || settings.gain_db > kMaxBandGain ||
+       settings.q_tenths < kMinQ || settings.q_tenths > kMaxQ ||
+       settings.frequency < kMinFrequency)
+    {
+        return false;
+    }
+    bands[band] = settings;
+    changed = true;
+    return true;
+}
+
+void PcmDsp::SetGain(int8_t db)
+{
+    gain_db = (db > kMaxGain) ? kMaxGain : (db < kMinGain) ? kMinGain : db;
+    changed = true;
+}
+
+void PcmDsp::SetEnabled(bool enable)
+{
+    enabled = enable;
+    changed = true;
+}
+
+bool PcmDsp::HasSimd() const
+{
+    return kHasSimd;
+}
+
+void PcmDsp::Reset()
+{
+    memset(x_state, 0, sizeof(x_state));
+    memset(y_state, 0, sizeof(y_state));
+    memset(error_state, 0, sizeof(error_state));
+    limited = 0;
+    samples_processed = 0;
+}
+
+void PcmDsp::Prepare()
+{
+    if(changed)
+    {
+        changed = false;
+        Design();
+        memset(x_state, 0, sizeof(x_state));
+        memset(y_state, 0, sizeof(y_state));
+        memset(error_state, 0, sizeof(error_state));
+    }
+}
+
+// RBJ audio EQ cookbook biquads, normalized to a0 = 1
+void PcmDsp::Design()
+{
+    float boost_db = 0;
+
+    stages = 0;
+    for(uint8_t band = 0; band < kMaxBands; band++)
+    {
+        const Band& settings = bands[band];
+        // Bands at or over Nyquist can not be designed, leave them out
+        if(settings.type == BandType::kOff || settings.gain_db == 0 ||
+           settings.frequency * 2 >= sample_rate)
+        {
+            continue;
+        }
+
+        float a = powf(10.0f, settings.gain_db / 40.0f);
+        float w0 = 2 * kPi * settings.frequency / sample_rate;
+        float cosine = cosf(w0);
+        float alpha = sinf(w0) / (2 * (settings.q_tenths / 10.0f));
+        float shelf = 2 * sqrtf(a) * alpha;
+        // b1 is fitted to the rounded poles below
+        float b0, b2, a0, a1, a2;
+
+        switch(settings.type)
+        {
+            case BandType::kLowShelf:
+                b0 = a * ((a + 1) - (a - 1) * cosine + shelf);
+                b2 = a * ((a + 1) - (a - 1) * cosine - shelf);
+                a0 = (a + 1) + (a - 1) * cosine + shelf;
+                a1 = -2 * ((a - 1) + (a + 1) * cosine);
+                a2 = (a + 1) + (a - 1) * cosine - shelf;
+                break;
+            case BandType::kHighShelf:
+                b0 = a * ((a + 1) + (a - 1) * cosine + shelf);
+                b2 = a * ((a + 1) + (a - 1) * cosine - shelf);
+                a0 = (a + 1) - (a - 1) * cosine + shelf;
+                a1 = 2 * ((a - 1) - (a + 1) * cosine);
+                a2 = (a + 1) - (a - 1) * cosine - shelf;
+                break;
+            case BandType::kPeaking:
+            default:
+                b0 = 1 + alpha * a;
+                b2 = 1 - alpha * a;
+                a0 = 1 + alpha / a;
+                a1 = -2 * cosine;
+                a2 = 1 - alpha / a;
+                break;
+        }
+
+        // A boost peaks at 0 dB here, the gain stage puts it back
+        float scale = 1 / a0;
+        float dc_gain = (settings.type == BandType::kLowShelf) ? a * a : 1;
+        float nyquist_gain = (settings.type == BandType::kHighShelf) ? a * a : 1;
+        if(settings.gain_db > 0)
+        {
+            scale /= a * a;
+            dc_gain /= a * a;
+            nyquist_gain /= a * a;
+            boost_db += settings.gain_db;
+        }
+
+        Coefficients& stage = coefficients[stages++];
+        stage.a1 = ToFixed(-a1 / a0);
+        stage.a2 = ToFixed(-a2 / a0);
+        // Low corners put the poles so close to 1 that rounding the
+        // coefficients moves the shelf's gain by dBs. Fitting the zeros to
+        // the rounded poles keeps the gain at DC and Nyquist exact, and
+        // moves the corner a little instead.
+        int32_t one = 1 << kCoefficientBits;
+        int32_t dc = lrintf(dc_gain * (one - stage.a1 - stage.a2));             // b0 + b1 + b2
+        int32_t nyquist = lrintf(nyquist_gain * (one + stage.a1 - stage.a2));   // b0 - b1 + b2
+        int32_t difference = lrintf((b0 - b2) * scale * one);                   // b0 - b2
+        // Both sums need the same parity to split into whole coefficients,
+        // Nyquist is the larger one and minds less
+        nyquist += (dc ^ nyquist) & 1;
+        stage.b1 = static_cast<int16_t>((dc - nyquist) / 2);
+        stage.b0 = static_cast<int16_t>(((dc + nyquist) / 2 + difference) / 2);
+        stage.b2 = static_cast<int16_t>((dc + nyquist) / 2 - stage.b0);
+    }
+
+    gain = static_cast<int32_t>(lrintf(powf(10.0f, (gain_db + boost_db) / 20.0f) * (1 << kGainBits)));
+    active = (stages > 0 || gain_db != 0);
+}
+
+void PcmDsp::Process(int16_t * samples, uint32_t frames)
+{
+    if(kHasSimd)
+    {
+        ProcessSimd(samples, frames);
+    }
+    else
+    {
+        ProcessScalar(samples, frames);
+    }
+}
+
+void PcmDsp::ProcessScalar(int16_t * samples, uint32_t frames)
+{
+    Prepare();
+    if(!enabled || !active)
+    {
+        return;
+    }
+
+    for(uint8_t stage = 0; stage < stages; stage++)
+    {
+        const Coefficients& c = coefficients[stage];
+        for(uint8_t channel = 0; channel < channels; channel++)
+        {
+            int32_t x1 = static_cast<int16_t>(x_state[stage][channel]);
+            int32_t x2 = static_cast<int16_t>(x_state[stage][channel] >> 16);
+            int32_t y1 = static_cast<int16_t>(y_state[stage][channel]);
+            int32_t y2 = static_cast<int16_t>(y_state[stage][channel] >> 16);
+            uint32_t error = error_state[stage][channel];
+            int16_t * sample = samples + channel;
+
+            for(uint32_t frame = 0; frame < frames; frame++)
+            {
+                int32_t x0 = *sample;
+                // Wraps the way SMLAD does, not that a band ever gets there
+                uint32_t sum = error + static_cast<uint32_t>(c.b0 * x0) + static_cast<uint32_t>(c.b1 * x1) +
+                               static_cast<uint32_t>(c.b2 * x2) + static_cast<uint32_t>(c.a1 * y1) +
+                               static_cast<uint32_t>(c.a2 * y2);
+                int32_t y0 = static_cast<int32_t>(sum) >> kCoefficientBits;
+                error = sum & kErrorMask;
+                y0 = (y0 > 32767) ? 32767 : (y0 < -32768) ? -32768 : y0;
+
+                x2 = x1;
+                x1 = x0;
+                y2 = y1;
+                y1 = y0;
+                *sample = static_cast<int16_t>(y0);
+                sample += channels;
+            }
+
+            x_state[stage][channel] = (x1 & 0xFFFF) | (static_cast<uint32_t>(x2) << 16);
+            y_state[stage][channel] = (y1 & 0xFFFF) | (static_cast<uint32_t>(y2) << 16);
+            error_state[stage][channel] = error;
+        }
+    }
+    GainAndLimit(samples, frames * channels);
+}
+
+void PcmDsp::ProcessSimd(int16_t * samples, uint32_t frames)
+{
+    Prepare();
+    if(!enabled || !active)
+    {
+        return;
+    }
+
+    for(uint8_t stage = 0; stage < stages; stage++)
+    {
+        const Coefficients& c = coefficients[stage];
+        // Paired the way the state is: (x[n], x[n-1]) and (x[n-2], y[n-1])
+        uint32_t b0_b1 = Pkhbt(c.b0, c.b1);
+        uint32_t b2_a1 = Pkhbt(c.b2, c.a1);
+        int32_t a2 = c.a2;
+
+        for(uint8_t channel = 0; channel < channels; channel++)
+        {
+            uint32_t xs = x_state[stage][channel];      // (x[n-1], x[n-2])
+            uint32_t ys = y_state[stage][channel];      // (y[n-1], y[n-2])
+            uint32_t error = error_state[stage][channel];
+            int16_t * sample = samples + channel;
+
+            for(uint32_t frame = 0; frame < frames; frame++)
+            {
+                uint32_t x0_x1 = Pkhbt(*sample, xs);
+                uint32_t x2_y1 = Pkhbt(xs >> 16, ys);
+                uint32_t sum = Smlad(x0_x1, b0_b1, error);
+                sum = Smlad(x2_y1, b2_a1, sum);
+                sum += a2 * static_cast<int16_t>(ys >> 16);
+                int32_t y0 = Ssat16(static_cast<int32_t>(sum) >> kCoefficientBits);
+                error = sum & kErrorMask;
+
+                xs = x0_x1;
+                ys = Pkhbt(y0, ys);
+                *sample = static_cast<int16_t>(y0);
+                sample += channels;
+            }
+
+            x_state[stage][channel] = xs;
+            y_state[stage][channel] = ys;
+            error_state[stage][channel] = error;
+        }
+    }
+    GainAndLimit(samples, frames * channels);
+}
+
+// Shared by both paths, a divide only for the few samples over the knee
+void PcmDsp::GainAndLimit(int16_t * samples, uint32_t count)
+{
+    constexpr int32_t kRange = kFullScale - kLimiterKnee;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        int32_t value = static_cast<int32_t>((static_cast<int64_t>(gain) * samples[i]) >> kGainBits);
+        int32_t magnitude = (value < 0) ? -value : value;
+
+        if(magnitude > kLimiterKnee)
+        {
+            // Approaches full scale as the excess grows, with the slope
+            // of the unlimited signal at the knee
+            magnitude = kFullScale - kRange * kRange / (magnitude - kLimiterKnee + kRange);
+            value = (value < 0) ? -magnitude : magnitude;
+            limited++;
+        }
+        samples[i] = static_cast<int16_t>(value);
+    }
+    samples_processed += count;
+}
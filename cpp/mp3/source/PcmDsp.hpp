@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+
+// Equalizer, gain and soft limiter for 16 bit PCM, applied by the SD reader
+// to WAV samples before they are queued for the decoder.
+//
+// SCI_BASS gives one bass and one treble shelf at fixed steps. Here every
+// band is a biquad of any type, frequency and gain. Coefficients and filter
+// state are 16 bit (Q14 coefficients, ±2), so one sample through one band
+// is five 16x16 multiply-accumulates. On the Cortex-M4 ProcessSimd() does
+// them as two SMLADs and one MLA, with SSAT to saturate. ProcessScalar() is
+// plain C++ that computes the same integers, the reference the host bench
+// checks the SIMD path against bit for bit.
+//
+// A boosting band would clip inside the cascade, so it is designed to peak
+// at 0 dB and the gain stage adds its boost back afterwards. Each dB of
+// boost costs that much resolution in the 16 bit state. The limiter then
+// rounds off peaks over kLimiterKnee instead of hard clipping them.
+class PcmDsp
+{
+    public:
+        static constexpr uint8_t kMaxBands = 4;
+        static constexpr uint8_t kMaxChannels = 2;
+        static constexpr uint8_t kCoefficientBits = 14;
+        static constexpr uint8_t kGainBits = 16;
+        static constexpr int8_t kMaxBandGain = 12;
+        static constexpr int8_t kMinBandGain = -24;
+        static constexpr int8_t kMaxGain = 12;
+        static constexpr int8_t kMinGain = -24;
+        static constexpr int32_t kLimiterKnee = 24576;     // -2.5 dBFS
+        static constexpr int32_t kFullScale = 32767;
+        // Below this 16 bit coefficients put the band's gain dBs off. Low
+        // shelf cuts are the weakest, up to 200 Hz they can be 1 dB short.
+        static constexpr uint16_t kMinFrequency = 80;
+        static constexpr uint8_t kMinQ = 3;             // 0.3
+        static constexpr uint8_t kMaxQ = 100;           // 10
+
+        enum class BandType : uint8_t
+        {
+            kOff = 0,
+            kPeaking,
+            kLowShelf,
+            kHighShelf
+        };
+
+        typedef struct
+        {
+            BandType type;
+            int8_t gain_db;
+            uint8_t q_tenths;           // Q times ten, the slope for shelves
+            uint16_t frequency;         // Hz
+        } Band;
+
+        PcmDsp();
+
+        /// Settings take effect at the start of the next Process(), so they
+        /// can be changed from any task while the reader is running.
+        void SetFormat(uint32_t sample_rate, uint8_t channels);
+        /// @return false if the band number or its settings are out of range
+        bool SetBand(uint8_t band, const Band& settings);
+        void SetGain(int8_t db);
+        void SetEnabled(bool enable);
+
+        /// Filters interleaved samples in place with the fastest path there
+        /// is. Does nothing while disabled or when every band is off and the
+        /// gain is 0 dB.
+        void Process(int16_t * samples, uint32_t frames);
+        void ProcessScalar(int16_t * samples, uint32_t frames);
+        /// Portable emulation of the same instructions off target.
+        void ProcessSimd(int16_t * samples, uint32_t frames);
+
+        bool IsEnabled() const { return enabled; }
+        bool IsActive() const { return enabled && active; }
+        bool HasSimd() const;
+        uint32_t GetSampleRate() const { return sample_rate; }
+        uint8_t GetChannels() const { return channels; }
+        const Band& GetBand(uint8_t band) const { return bands[band]; }
+        int8_t GetGain() const { return gain_db; }
+        /// @return samples the limiter has changed since boot
+        uint32_t GetLimited() const { return limited; }
+        uint32_t GetSamples() const { return samples_processed; }
+
+    private:
+        typedef struct
+        {
+            int16_t b0, b1, b2;
+            int16_t a1, a2;             // negated, so every term is added
+        } Coefficients;
+
+        void Reset();
+        void Prepare();
+        void Design();
+        void GainAndLimit(int16_t * samples, uint32_t count);
+
+        Band bands[kMaxBands];
+        int8_t gain_db;
+        uint32_t sample_rate;
+        uint8_t channels;
+        bool enabled;
+        volatile bool changed;
+
+        // Designed by Design() from the settings above
+        Coefficients coefficients[kMaxBands];
+        uint8_t stages;
+        int32_t gain;                   // Q16, adds back every band's boost
+        bool active;
+
+        // Per band and channel: x[n-1] and x[n-2], y[n-1] and y[n-2], each
+        // packed low half first the way the SIMD path keeps them
+        uint32_t x_state[kMaxBands][kMaxChannels];
+        uint32_t y_state[kMaxBands][kMaxChannels];
+        // What the shift back to 16 bits dropped, added to the next sum
+        uint32_t error_state[kMaxBands][kMaxChannels];
+
+        uint32_t limited;
+        uint32_t samples_processed;
+};
@@ -0,0 +1,166 @@
+#include "PluginLoader.hpp"
+#include "utility/time.hpp"
+
+PluginLoader::PluginLoader(VS1053* decoder)
+{
+    vs1053 = decoder;
+    end_of_file = true;
+    head = 0;
+    tail = 0;
+    state = State::kAddress;
+    address = 0;
+    remaining = 0;
+    repeat_value = 0;
+    words_written = 0;
+    slices = 0;
+    start_time = 0;
+    load_time = 0;
+    max_slice_time = 0;
+}
+
+bool PluginLoader::Open(const char * path)
+{
+    head = 0;
+    tail = 0;
+    state = State::kAddress;
+    words_written = 0;
+    slices = 0;
+    load_time = 0;
+    max_slice_time = 0;
+    start_time = Uptime();
+
+    end_of_file = (f_open(&file, path, FA_READ) != FR_OK);
+    if(end_of_file)
+    {
+        state = State::kError;
+    }
+    return !end_of_file;
+}
+
+void PluginLoader::Close()
+{
+    f_close(&file);
+    end_of_file = true;
+}
+
+bool PluginLoader::NeedsData() const
+{
+    return (head == tail) && !end_of_file &&
+           (state != State::kRepeat) && (state != State::kError);
+}
+
+bool PluginLoader::Refill()
+{
+    UINT bytes_read = 0;
+
+    if(f_read(&file, buffer, sizeof(buffer), &bytes_read) != FR_OK)
+    {
+        state = State::kError;
+        end_of_file = true;
+        return false;
+    }
+
+    head = 0;
+    tail = bytes_read / sizeof(uint16_t);
+    end_of_file = (bytes_read < sizeof(buffer));
+    return true;
+}
+
+uint16_t PluginLoader::Write(uint16_t max_words)
+{
+    uint64_t slice_start = Uptime();
+    uint16_t written = 0;
+    uint16_t count;
+
+    while(written < max_words && (head < tail || state == State::kRepeat))
+    {
+        switch(state)
+        {
+            case State::kAddress:
+                address = buffer[head++];
+                state = State::kCount;
+                break;
+
+            case State::kCount:
+                remaining = buffer[head++];
+                if(remaining & 0x8000)
+                {
+                    remaining &= 0x7FFF;
+                    state = State::kRepeatValue;
+                }
+                else
+                {
+                    state = (remaining) ? State::kData : State::kAddress;
+                }
+                break;
+
+            case State::kRepeatValue:
+                repeat_value = buffer[head++];
+                state = State::kRepeat;
+                break;
+
+            case State::kRepeat:
+                count = max_words - written;
+                if(count > remaining)
+                {
+                    count = remaining;
+                }
+                vs1053->sciFill(address, repeat_value, count);
+                remaining -= count;
+                written += count;
+                if(remaining == 0)
+                {
+                    state = State::kAddress;
+                }
+                break;
+
+            case State::kData:
+                count = max_words - written;
+                if(count > remaining)
+                {
+                    count = remaining;
+                }
+                if(count > tail - head)
+                {
+                    count = tail - head;
+                }
+                vs1053->sciWriteBurst(address, &buffer[head], count);
+                head += count;
+                remaining -= count;
+                written += count;
+                if(remaining == 0)
+                {
+                    state = State::kAddress;
+                }
+                break;
+
+            case State::kError:
+                return written;
+        }
+    }
+
+    uint64_t slice_time = Uptime() - slice_start;
+    if(slice_time > max_slice_time)
+    {
+        max_slice_time = slice_time;
+    }
+    slices++;
+    words_written += written;
+
+    if(Done())
+    {
+        load_time = Uptime() - start_time;
+    }
+    return written;
+}
+
+bool PluginLoader::Done() const
+{
+    return (state == State::kError) ||
+           (end_of_file && head == tail && state != State::kRepeat);
+}
+
+bool PluginLoader::Succeeded() const
+{
+    return Done() && (state == State::kAddress);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ff.h"
+#include "VS1053.hpp"
+
+// Streams a VLSI compressed plugin image (.plg converted to .bin, little
+// endian 16-bit words) from the SD card into the VS1053.
+//
+// The image is a list of records: register, count, then either count words
+// or, when bit 15 of count is set, one word repeated (count & 0x7FFF) times.
+// Each run of words is sent as one SCI multiple write, so XCS toggles once
+// per run instead of once per word.
+//
+// Loading is split so the caller can hold each mutex only as long as needed:
+// Refill() reads the next block from SD and Write() sends at most a given
+// number of words over SCI, then returns so SDI data can be sent in between.
+class PluginLoader
+{
+    public:
+        static constexpr uint16_t kBufferWords = 256;
+
+        explicit PluginLoader(VS1053* decoder);
+
+        bool Open(const char * path);
+        void Close();
+
+        /// @return true when the buffer is empty and more of the file is needed
+        bool NeedsData() const;
+        /// Reads the next block of the image into the buffer.
+        ///
+        /// @return false on a read error
+        bool Refill();
+        /// Decodes buffered records and writes up to max_words of them.
+        ///
+        /// @return number of words written to the decoder
+        uint16_t Write(uint16_t max_words);
+        /// @return true once the whole image has been written or loading failed
+        bool Done() const;
+        /// @return true if the image ended on a record boundary
+        bool Succeeded() const;
+
+        uint32_t GetWordsWritten() const { return words_written; }
+        uint32_t GetSlices() const { return slices; }
+        uint64_t GetLoadTime() const { return load_time; }
+        uint64_t GetMaxSliceTime() const { return max_slice_time; }
+
+    private:
+        enum class State : uint8_t
+        {
+            kAddress,
+            kCount,
+            kRepeatValue,
+            kRepeat,
+            kData,
+            kError
+        };
+
+        VS1053* vs1053;
+        FIL file;
+        bool end_of_file;
+
+        uint16_t buffer[kBufferWords];
+        uint16_t head;
+        uint16_t tail;
+
+        State state;
+        uint8_t address;
+        uint16_t remaining;
+        uint16_t repeat_value;
+
+        uint32_t words_written;
+        uint32_t slices;
+        uint64_t start_time;
+        uint64_t load_time;
+        uint64_t max_slice_time;
+};
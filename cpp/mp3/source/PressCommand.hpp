@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "L3_Application/commandline.hpp"
+#include "PressLatency.hpp"
+
+// "press"        prints where the time goes between a remote press and its
+//                effect, per stage and end to end
+// "press reset"  clears the histograms
+class PressCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Remote press latency. Usage: press [reset]";
+
+        explicit PressCommand(PressLatency* press_latency)
+            : Command("press", kDescription), latency(press_latency)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 1 && strcmp(argv[1], "reset") == 0)
+            {
+                latency->Reset();
+                printf("Press latency cleared\n");
+                return 0;
+            }
+            latency->Print();
+            return 0;
+        }
+
+    private:
+        PressLatency* latency;
+};
@@ -0,0 +1,194 @@
+#include "PressLatency.hpp"
+
+#include <cstdio>
+
+#include <FreeRTOS.h>
+#include "task.h"
+
+PressLatency::PressLatency(StampCallback callback)
+{
+    on_stamp = callback;
+    next = 0;
+    for(uint8_t i = 0; i < kInFlight; i++)
+    {
+        presses[i].active = false;
+        presses[i].awaiting_flush = false;
+    }
+    Reset();
+}
+
+uint8_t PressLatency::Begin(uint64_t now)
+{
+    UBaseType_t state = taskENTER_CRITICAL_FROM_ISR();
+    uint8_t press = next;
+    next = (next + 1) % kInFlight;
+    Start(press, now);
+    taskEXIT_CRITICAL_FROM_ISR(state);
+    return press;
+}
+
+void PressLatency::Start(uint8_t press, uint64_t now)
+{
+    if(presses[press].active)
+    {
+        abandoned++;    // Never finished, e.g. dropped by a full queue
+    }
+    presses[press].active = true;
+    presses[press].awaiting_flush = false;
+    presses[press].stamped = 0;
+    Record(press, kIsr, now);
+}
+
+void PressLatency::Stamp(uint8_t press, Stage stage, uint64_t now)
+{
+    taskENTER_CRITICAL();
+    Record(press, stage, now);
+    taskEXIT_CRITICAL();
+}
+
+void PressLatency::Record(uint8_t press, Stage stage, uint64_t now)
+{
+    if(press >= kInFlight || !presses[press].active)
+    {
+        return;
+    }
+    presses[press].time[stage] = static_cast<uint32_t>(now);
+    presses[press].stamped |= (1 << stage);
+    if(on_stamp)
+    {
+        on_stamp(press, stage);
+    }
+}
+
+void PressLatency::Posted(uint8_t press, uint64_t now)
+{
+    taskENTER_CRITICAL();
+    Record(press, kPosted, now);
+    if(press < kInFlight)
+    {
+        presses[press].awaiting_flush = true;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void PressLatency::Flushed(uint64_t now)
+{
+    taskENTER_CRITICAL();
+    for(uint8_t press = 0; press < kInFlight; press++)
+    {
+        if(presses[press].awaiting_flush)
+        {
+            presses[press].awaiting_flush = false;
+            Record(press, kApplied, now);
+            Finish(press);
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+void PressLatency::Complete(uint8_t press)
+{
+    taskENTER_CRITICAL();
+    Finish(press);
+    taskEXIT_CRITICAL();
+}
+
+void PressLatency::Finish(uint8_t press)
+{
+    if(press >= kInFlight || !presses[press].active)
+    {
+        return;
+    }
+    Press& entry = presses[press];
+    uint8_t previous = kIsr;
+
+    for(uint8_t stage = kIsr + 1; stage < kStageCount; stage++)
+    {
+        if(entry.stamped & (1 << stage))
+        {
+            stages[stage].Record(entry.time[stage] - entry.time[previous]);
+            previous = stage;
+        }
+    }
+    total.Record(entry.time[previous] - entry.time[kIsr]);
+
+    entry.active = false;
+    if(on_stamp)
+    {
+        on_stamp(press, kDone);
+    }
+}
+
+bool PressLatency::IsForwarded(uint8_t press) const
+{
+    taskENTER_CRITICAL();
+    bool forwarded = press < kInFlight && (presses[press].stamped & (1 << kSettingsQueued));
+    taskEXIT_CRITICAL();
+    return forwarded;
+}
+
+void PressLatency::Replay(uint8_t press, uint8_t stage, uint64_t now)
+{
+    if(press >= kInFlight)
+    {
+        return;
+    }
+    if(stage == kIsr)
+    {
+        Start(press, now);
+    }
+    else if(stage == kDone)
+    {
+        Finish(press);
+    }
+    else if(stage < kStageCount)
+    {
+        Record(press, static_cast<Stage>(stage), now);
+    }
+}
+
+void PressLatency::Print() const
+{
+    printf("%-16s %8s %10s %10s %10s\n", "stage (us)", "count", "p50", "p99", "max");
+    for(uint8_t stage = kIsr + 1; stage < kStageCount; stage++)
+    {
+        printf("%-16s %8lu %10lu %10lu %10lu\n", StageToString(stage),
+               static_cast<unsigned long>(stages[stage].GetCount()),
+               static_cast<unsigned long>(stages[stage].Percentile(50)),
+               static_cast<unsigned long>(stages[stage].Percentile(99)),
+               static_cast<unsigned long>(stages[stage].GetMax()));
+    }
+    printf("%-16s %8lu %10lu %10lu %10lu\n", "total",
+           static_cast<unsigned long>(total.GetCount()),
+           static_cast<unsigned long>(total.Percentile(50)),
+           static_cast<unsigned long>(total.Percentile(99)),
+           static_cast<unsigned long>(total.GetMax()));
+    printf("%lu presses never finished\n", static_cast<unsigned long>(abandoned));
+}
+
+void PressLatency::Reset()
+{
+    taskENTER_CRITICAL();
+    for(uint8_t stage = 0; stage < kStageCount; stage++)
+    {
+        stages[stage].Reset();
+    }
+    total.Reset();
+    abandoned = 0;
+    taskEXIT_CRITICAL();
+}
+
+const char * PressLatency::StageToString(uint8_t stage)
+{
+    switch(stage)
+    {
+        case kIsr: return "isr";
+        case kIrTask: return "ir task";
+        case kSettingsQueued: return "settings queued";
+        case kSettingsTask: return "settings task";
+        case kPosted: return "posted";
+        case kApplied: return "applied";
+        case kDone: return "done";
+        default: return "unknown";
+    }
+}
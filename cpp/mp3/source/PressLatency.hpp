@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+
+#include "LatencyHistogram.hpp"
+
+// Follows each remote press from the IR ISR to the moment it takes effect
+// and keeps a histogram of the time spent in every stage on the way:
+//
+//   kIsr             opcode decoded in readIR_ISR
+//   kIrTask          vIrRemoteTask took it off irRemoteQueueHandle
+//   kSettingsQueued  vIrRemoteTask put a command on the settings queue
+//   kSettingsTask    vSettingsTask took it off the settings queue
+//   kPosted          register change posted to the VS1053 mailbox
+//   kApplied         SCI write done by the consumer (or song opened)
+//
+// Presses that only change the UI finish at kIrTask. Each stamp can be
+// reported through a callback, which is how they reach the trace ring;
+// host/press_replay feeds a trace dump back through this class to print
+// the same report off target.
+//
+// The IR ISR and several tasks stamp the same slots, so every public call
+// runs in a critical section (Begin uses the FromISR form). Print() only
+// reads the histograms and is left unlocked so printf never runs with
+// interrupts masked; a stamp landing mid print can skew one row.
+class PressLatency
+{
+    public:
+        enum Stage : uint8_t
+        {
+            kIsr = 0,
+            kIrTask,
+            kSettingsQueued,
+            kSettingsTask,
+            kPosted,
+            kApplied,
+            kStageCount
+        };
+
+        // Passed as the stage to the callback when a press completes
+        static constexpr uint8_t kDone = kStageCount;
+        // Press id for commands that did not come from the remote
+        static constexpr uint8_t kNoPress = 0xFF;
+        static constexpr uint8_t kInFlight = 8;
+
+        typedef void (*StampCallback)(uint8_t press, uint8_t stage);
+
+        explicit PressLatency(StampCallback callback = nullptr);
+
+        /// Starts tracking a press, only called from the IR ISR.
+        ///
+        /// @param now - Uptime() in microseconds
+        /// @return id to carry along with the command
+        uint8_t Begin(uint64_t now);
+        void Stamp(uint8_t press, Stage stage, uint64_t now);
+        /// Stamps kPosted and waits for the next register flush.
+        void Posted(uint8_t press, uint64_t now);
+        /// Call after flushRegisters() wrote something, applies every press
+        /// waiting on it.
+        void Flushed(uint64_t now);
+        /// Records the stage times of a press and frees its slot.
+        void Complete(uint8_t press);
+        bool IsForwarded(uint8_t press) const;
+        /// Applies one stamp reported by the callback, used to rebuild the
+        /// report from a trace.
+        void Replay(uint8_t press, uint8_t stage, uint64_t now);
+
+        /// Prints the per stage and total latency table with printf.
+        void Print() const;
+        void Reset();
+
+        uint32_t GetPresses() const { return total.GetCount(); }
+        uint32_t GetAbandoned() const { return abandoned; }
+        static const char * StageToString(uint8_t stage);
+
+    private:
+        // Unlocked bodies of Begin, Stamp and Complete, the caller holds
+        // the critical section
+        void Start(uint8_t press, uint64_t now);
+        void Record(uint8_t press, Stage stage, uint64_t now);
+        void Finish(uint8_t press);
+
+        struct Press
+        {
+            volatile bool active;
+            volatile bool awaiting_flush;
+            uint8_t stamped;                // bit per Stage
+            uint32_t time[kStageCount];     // low 32 bits of Uptime()
+        };
+
+        Press presses[kInFlight];
+        uint8_t next;
+        uint32_t abandoned;
+        StampCallback on_stamp;
+
+        // Entry k is the time from the previous stamped stage to stage k
+        LatencyHistogram stages[kStageCount];
+        LatencyHistogram total;
+};
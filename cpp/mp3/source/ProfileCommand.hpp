@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "CpuProfiler.hpp"
+#include "L3_Application/commandline.hpp"
+
+// "profile"              prints profiler state and its own overhead
+// "profile on [ms]"      starts appending runtime stats to CPU.TXT every
+//                        ms milliseconds (default 5000)
+// "profile off"          stops it and writes out what is staged
+class ProfileCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Log runtime stats to CPU.TXT. Usage: profile [on [ms]|off]";
+
+        explicit ProfileCommand(CpuProfiler* cpu_profiler)
+            : Command("profile", kDescription), profiler(cpu_profiler)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 1 && strcmp(argv[1], "on") == 0)
+            {
+                if(argc > 2)
+                {
+                    profiler->SetInterval(strtoul(argv[2], nullptr, 10));
+                }
+                profiler->Enable(true);
+            }
+            else if(argc > 1 && strcmp(argv[1], "off") == 0)
+            {
+                profiler->Enable(false);
+            }
+
+            printf("Profiler    : %s, every %lu ms\n", profiler->IsEnabled() ? "on" : "off",
+                   profiler->GetInterval());
+            printf("Samples     : %lu (%lu skipped)\n", profiler->GetSamples(), profiler->GetDropped());
+            printf("Sectors     : %lu written to CPU.TXT\n", profiler->GetSectors());
+            printf("Sample Time : %lu us last, %lu us max\n",
+                   static_cast<uint32_t>(profiler->GetLastSampleTime()),
+                   static_cast<uint32_t>(profiler->GetMaxSampleTime()));
+            printf("Write Time  : %lu us last, %lu us max\n",
+                   static_cast<uint32_t>(profiler->GetLastWriteTime()),
+                   static_cast<uint32_t>(profiler->GetMaxWriteTime()));
+            return 0;
+        }
+
+    private:
+        CpuProfiler* profiler;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "L3_Application/commandline.hpp"
+#include "RecordWriter.hpp"
+#include "VS1053.hpp"
+
+// "record"                       counters of the current or last recording
+// "record start <file> [line]"   loads the Ogg Vorbis encoder and records the
+//                                microphone, or line in, to <file>. Playback
+//                                stops until the recording ends.
+// "record stop"                  finishes the stream, closes the file and
+//                                restarts the current track
+class RecordCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Ogg Vorbis recording. Usage: record [start <file> [line]|stop]";
+
+        // Run in the terminal task, they block until the decoder has switched
+        typedef bool (*StartFunction)(const char * path, bool line_input);
+        typedef bool (*StopFunction)();
+
+        RecordCommand(RecordWriter* record_writer, StartFunction start_function, StopFunction stop_function)
+            : Command("record", kDescription), writer(record_writer), start(start_function),
+              stop(stop_function)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 2 && strcmp(argv[1], "start") == 0)
+            {
+                if(!start(argv[2], argc > 3 && strcmp(argv[3], "line") == 0))
+                {
+                    printf("Could not start recording to %s\n", argv[2]);
+                    return 1;
+                }
+                printf("Recording to %s\n", argv[2]);
+                return 0;
+            }
+            else if(argc > 1 && strcmp(argv[1], "stop") == 0)
+            {
+                if(!stop())
+                {
+                    printf("Not recording\n");
+                    return 1;
+                }
+            }
+
+            printf("Recording   : %s\n", writer->IsOpen() ? "yes" : "no");
+            printf("Written     : %lu bytes in %lu writes, %lu errors\n", writer->GetBytesWritten(),
+                   writer->GetWrites(), writer->GetWriteErrors());
+            printf("Write Time  : %lu ms total, %lu ms longest\n",
+                   static_cast<uint32_t>(writer->GetWriteTime() / 1000),
+                   static_cast<uint32_t>(writer->GetMaxWriteTime() / 1000));
+            printf("SCI Batches : %lu\n", writer->GetBatches());
+            printf("Encoder     : %u of %u words at most\n", writer->GetPeakLevel(),
+                   VS1053::kRecordBufferWords);
+            printf("Buffers     : %u words free at least\n", writer->GetMinRoom());
+            printf("Dropped     : %lu words\n", writer->GetDroppedWords());
+            return 0;
+        }
+
+    private:
+        RecordWriter* writer;
+        StartFunction start;
+        StopFunction stop;
+};
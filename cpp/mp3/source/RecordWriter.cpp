@@ -0,0 +1,195 @@
+#include "RecordWriter.hpp"
+#include "utility/time.hpp"
+
+RecordWriter::RecordWriter(uint8_t (*sector_buffers)[kBufferSize], uint8_t buffers)
+{
+    storage = sector_buffers;
+    open = false;
+    buffer_count = (buffers >= 1 && buffers <= kMaxBuffers) ? buffers : kMaxBuffers;
+    for(uint8_t i = 0; i < kMaxBuffers; i++)
+    {
+        full[i] = false;
+    }
+    fill_index = 0;
+    fill_bytes = 0;
+    write_index = 0;
+    unsynced_bytes = 0;
+    bytes_written = 0;
+    dropped_words = 0;
+    writes = 0;
+    write_errors = 0;
+    max_write_time = 0;
+    write_time = 0;
+    batches = 0;
+    peak_level = 0;
+    min_room = 0;
+}
+
+bool RecordWriter::Open(const char * path)
+{
+    for(uint8_t i = 0; i < kMaxBuffers; i++)
+    {
+        full[i] = false;
+    }
+    fill_index = 0;
+    fill_bytes = 0;
+    write_index = 0;
+    unsynced_bytes = 0;
+    bytes_written = 0;
+    dropped_words = 0;
+    writes = 0;
+    write_errors = 0;
+    max_write_time = 0;
+    write_time = 0;
+    batches = 0;
+    peak_level = 0;
+    min_room = buffer_count * kBufferSize / 2;
+
+    open = (f_open(&file, path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+    return open;
+}
+
+bool RecordWriter::Write(const uint8_t * data, UINT length)
+{
+    UINT written = 0;
+    uint64_t start_time = Uptime();
+    bool succeeded = (f_write(&file, data, length, &written) == FR_OK) && (written == length);
+
+    unsynced_bytes += written;
+    if(unsynced_bytes >= kSyncBytes)
+    {
+        // Directory entry and FAT up to date, the file survives a power cut
+        succeeded = (f_sync(&file) == FR_OK) && succeeded;
+        unsynced_bytes = 0;
+    }
+
+    uint64_t elapsed = Uptime() - start_time;
+    write_time += elapsed;
+    if(elapsed > max_write_time)
+    {
+        max_write_time = elapsed;
+    }
+    bytes_written += written;
+    writes++;
+    if(!succeeded)
+    {
+        write_errors++;
+    }
+    return succeeded;
+}
+
+bool RecordWriter::WriteNext()
+{
+    if(!open || !full[write_index])
+    {
+        return false;
+    }
+    Write(storage[write_index], kBufferSize);
+    // Data first, flag second, the SPI side only refills a released buffer
+    full[write_index] = false;
+    write_index = (write_index + 1) % buffer_count;
+    return true;
+}
+
+bool RecordWriter::Close(bool odd_byte)
+{
+    if(!open)
+    {
+        return false;
+    }
+    while(WriteNext());
+
+    uint16_t length = fill_bytes;
+    if(odd_byte && length)
+    {
+        length--;
+    }
+    if(length)
+    {
+        Write(storage[fill_index], length);
+    }
+    else if(odd_byte && bytes_written)
+    {
+        // The half used word went out with the last full buffer
+        if(f_lseek(&file, bytes_written - 1) != FR_OK || f_truncate(&file) != FR_OK)
+        {
+            write_errors++;
+        }
+        bytes_written--;
+    }
+    fill_bytes = 0;
+
+    if(f_close(&file) != FR_OK)
+    {
+        write_errors++;
+    }
+    open = false;
+    return write_errors == 0;
+}
+
+uint16_t RecordWriter::GetRoomWords() const
+{
+    uint32_t room = 0;
+    uint8_t index = fill_index;
+
+    if(full[index])
+    {
+        return 0;
+    }
+    room = kBufferSize - fill_bytes;
+    for(uint8_t i = 1; i < buffer_count; i++)
+    {
+        index = (index + 1) % buffer_count;
+        if(full[index])
+        {
+            break;
+        }
+        room += kBufferSize;
+    }
+    return room / 2;
+}
+
+uint16_t RecordWriter::WordsToDrain(uint16_t level, bool finishing)
+{
+    uint16_t room = GetRoomWords();
+
+    if(level > peak_level)
+    {
+        peak_level = level;
+    }
+    if(room < min_room)
+    {
+        min_room = room;
+    }
+    if(level < kDrainWords && !finishing)
+    {
+        return 0;
+    }
+    // The rest waits in the encoder, all but kHighWater of it
+    if(level > room)
+    {
+        level = (level - room > kHighWater) ? level - kHighWater : room;
+    }
+    return level;
+}
+
+void RecordWriter::Append(const uint16_t * words, uint16_t count)
+{
+    batches++;
+    for(uint16_t i = 0; i < count; i++)
+    {
+        if(full[fill_index])
+        {
+            dropped_words += count - i;
+            return;
+        }
+        storage[fill_index][fill_bytes++] = words[i] >> 8;
+        storage[fill_index][fill_bytes++] = words[i] & 0xFF;
+        if(fill_bytes == kBufferSize)
+        {
+            full[fill_index] = true;
+            fill_index = (fill_index + 1) % buffer_count;
+            fill_bytes = 0;
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ff.h"
+#include "VS1053.hpp"
+
+// Takes the words the VS1053's encoder hands over during a recording and
+// writes them to the SD card.
+//
+// The SPI side (the consumer task) appends into one buffer while the SD side
+// (the reader task) writes the other, so a card that stalls for a few
+// hundred milliseconds mid-write only holds up the buffer being written.
+// Buffers are whole sectors and only ever written whole, so every f_write
+// starts and ends on a sector boundary and FatFS passes it straight to the
+// card without its own sector buffer. Only Close() writes a partial buffer.
+//
+// WordsToDrain() decides how much to read from the encoder: nothing until
+// kDrainWords are waiting, so each read is one long batch, and no more than
+// there is room for. The encoder's own buffer then carries a stall as well,
+// up to kHighWater, which leaves it room for one more poll period. Words
+// past that would be lost inside the chip where nobody can count them, so
+// the oldest are read anyway and dropped here instead, which
+// GetDroppedWords() reports. With two 2 KB buffers a 250 ms card stall is
+// covered up to about 110 kbps (host/RecordBench.cpp).
+//
+// One task appends and one writes, the flags between them need no lock.
+class RecordWriter
+{
+    public:
+        static constexpr uint16_t kSectorSize = 512;
+        static constexpr uint16_t kBufferSize = 4 * kSectorSize;
+        static constexpr uint8_t kMaxBuffers = 2;
+        // Most words read from the encoder in one go, the caller's buffer
+        static constexpr uint16_t kBatchWords = 256;
+        static constexpr uint16_t kDrainWords = kBatchWords / 2;
+        static constexpr uint16_t kHighWater = VS1053::kRecordBufferWords - kDrainWords;
+        // f_sync this often, a power cut loses at most this much
+        static constexpr uint32_t kSyncBytes = 64 * 1024;
+
+        /// @param sector_buffers - kMaxBuffers buffers, the caller's so
+        ///                         they can be shared with a user that never
+        ///                         runs at the same time
+        /// @param buffers - 1 writes and fills the same buffer in turn, only
+        ///                  for comparison in the host bench
+        explicit RecordWriter(uint8_t (*sector_buffers)[kBufferSize], uint8_t buffers = kMaxBuffers);
+
+        /// SD side. Creates or truncates the file and clears the counters.
+        bool Open(const char * path);
+        /// SD side. Writes the oldest full buffer.
+        ///
+        /// @return false if no buffer was full
+        bool WriteNext();
+        /// SD side. Writes what is left, the last byte of the last word only
+        /// if odd_byte is false, and closes the file.
+        ///
+        /// @return false if any write since Open() failed
+        bool Close(bool odd_byte);
+
+        /// SPI side. How many words to read with the encoder holding level.
+        /// @param finishing - stop was requested, small amounts are read too
+        uint16_t WordsToDrain(uint16_t level, bool finishing);
+        /// SPI side. Stores words big endian, the byte order of the stream.
+        /// Words that do not fit are dropped.
+        void Append(const uint16_t * words, uint16_t count);
+
+        /// @return true if a full buffer is waiting for WriteNext()
+        bool HasPending() const { return full[write_index]; }
+        bool IsOpen() const { return open; }
+        uint16_t GetRoomWords() const;
+
+        uint32_t GetBytesWritten() const { return bytes_written; }
+        uint32_t GetDroppedWords() const { return dropped_words; }
+        uint32_t GetWrites() const { return writes; }
+        uint32_t GetWriteErrors() const { return write_errors; }
+        uint64_t GetMaxWriteTime() const { return max_write_time; }
+        uint64_t GetWriteTime() const { return write_time; }
+        uint32_t GetBatches() const { return batches; }
+        uint16_t GetPeakLevel() const { return peak_level; }
+        uint16_t GetMinRoom() const { return min_room; }
+
+    private:
+        bool Write(const uint8_t * data, UINT length);
+
+        FIL file;
+        bool open;
+        uint8_t buffer_count;
+        uint8_t (*storage)[kBufferSize];
+        volatile bool full[kMaxBuffers];
+        uint8_t fill_index;             // SPI side
+        uint16_t fill_bytes;
+        uint8_t write_index;            // SD side
+        uint32_t unsynced_bytes;
+
+        uint32_t bytes_written;
+        uint32_t dropped_words;
+        uint32_t writes;
+        uint32_t write_errors;
+        uint64_t max_write_time;
+        uint64_t write_time;
+        uint32_t batches;
+        uint16_t peak_level;
+        uint16_t min_room;              // words, lowest seen before an append
+};
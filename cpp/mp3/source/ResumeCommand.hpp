@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <FreeRTOS.h>
+#include "semphr.h"
+
+#include "L3_Application/commandline.hpp"
+#include "ResumeJournal.hpp"
+
+// "resume"               prints what was resumed at boot and what the
+//                        journal has cost the card since
+// "resume interval <ms>" time between periodic saves
+// "resume clear"         forget the position, next boot starts at track 0
+class ResumeCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Resume journal. Usage: resume [interval <ms>|clear]";
+
+        ResumeCommand(ResumeJournal* resume_journal, SemaphoreHandle_t* sd_mutex)
+            : Command("resume", kDescription), journal(resume_journal), sd(sd_mutex)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 2 && strcmp(argv[1], "interval") == 0)
+            {
+                journal->SetInterval(strtoul(argv[2], nullptr, 10));
+            }
+            else if(argc > 1 && strcmp(argv[1], "clear") == 0)
+            {
+                if(xSemaphoreTake(*sd, portMAX_DELAY))
+                {
+                    journal->Clear();
+                    xSemaphoreGive(*sd);
+                }
+                printf("Resume journal cleared\n");
+                return 0;
+            }
+
+            if(journal->IsResumed())
+            {
+                printf("Resumed     : at byte %lu, seek %lu us (%s)\n", journal->GetResumeOffset(),
+                       static_cast<uint32_t>(journal->GetSeekTime()),
+                       journal->UsedFastSeek() ? "fast seek" : "cluster walk");
+                printf("To Audio    : %lu ms from power on\n",
+                       static_cast<uint32_t>(journal->GetResumeToAudio() / 1000));
+            }
+            else
+            {
+                printf("Resumed     : no, started from the top\n");
+            }
+            printf("Interval    : %lu ms\n", journal->GetInterval());
+            printf("Saves       : %lu (%lu unchanged, %lu errors)\n", journal->GetSaves(),
+                   journal->GetUnchanged(), journal->GetErrors());
+            printf("Written     : %lu record bytes\n", journal->GetPayloadBytes());
+            printf("Write Time  : %lu us last, %lu us max\n",
+                   static_cast<uint32_t>(journal->GetLastWriteTime()),
+                   static_cast<uint32_t>(journal->GetMaxWriteTime()));
+            return 0;
+        }
+
+    private:
+        ResumeJournal* journal;
+        SemaphoreHandle_t* sd;
+};
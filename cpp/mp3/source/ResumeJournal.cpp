@@ -0,0 +1,190 @@
+#include "ResumeJournal.hpp"
+#include "ff.h"
+#include "utility/time.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+ResumeJournal::ResumeJournal(const char * journal_path)
+{
+    path = journal_path;
+    interval_ms = kDefaultIntervalMs;
+
+    memset(&saved, 0, sizeof(saved));
+    has_saved = false;
+    sequence = 1;
+    slot = 0;
+    last_save = 0;
+
+    saves = 0;
+    unchanged = 0;
+    errors = 0;
+    last_write_time = 0;
+    max_write_time = 0;
+
+    resumed = false;
+    resume_offset = 0;
+    seek_time = 0;
+    fast_seek = false;
+    resume_to_audio = 0;
+}
+
+uint32_t ResumeJournal::Checksum(const Record& record)
+{
+    const uint8_t * bytes = reinterpret_cast<const uint8_t *>(&record);
+    uint32_t hash = 2166136261u;
+
+    for(uint8_t i = 0; i < offsetof(Record, checksum); i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool ResumeJournal::IsValid(const Record& record)
+{
+    return record.magic == kMagic && record.checksum == Checksum(record);
+}
+
+int8_t ResumeJournal::Newest(const Record * records, uint8_t count)
+{
+    int8_t newest = -1;
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if(!IsValid(records[i]))
+        {
+            continue;
+        }
+        // Signed difference so the sequence number can wrap
+        if(newest < 0 || static_cast<int32_t>(records[i].sequence - records[newest].sequence) > 0)
+        {
+            newest = i;
+        }
+    }
+    return newest;
+}
+
+bool ResumeJournal::SameState(const State& a, const State& b)
+{
+    return memcmp(&a, &b, sizeof(State)) == 0;
+}
+
+bool ResumeJournal::Load(State * state)
+{
+    Record records[kSlots];
+    FIL file;
+    UINT bytes_read = 0;
+
+    memset(records, 0, sizeof(records));
+    if(f_open(&file, path, FA_READ) != FR_OK)
+    {
+        return false;
+    }
+    f_read(&file, records, sizeof(records), &bytes_read);
+    f_close(&file);
+
+    int8_t newest = Newest(records, kSlots);
+    if(newest < 0)
+    {
+        return false;
+    }
+
+    *state = records[newest].state;
+    saved = *state;
+    has_saved = true;
+    sequence = records[newest].sequence + 1;
+    slot = (newest + 1) % kSlots;
+    return true;
+}
+
+bool ResumeJournal::IsDue(uint64_t now) const
+{
+    return now - last_save >= interval_ms * 1000ULL;
+}
+
+bool ResumeJournal::Save(const State& state, uint64_t now, bool force)
+{
+    Record record;
+    FIL file;
+    UINT written = 0;
+
+    if(!force && !IsDue(now))
+    {
+        return false;
+    }
+    last_save = now;
+    if(has_saved && SameState(state, saved))
+    {
+        unchanged++;
+        return false;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.magic = kMagic;
+    record.sequence = sequence;
+    record.state = state;
+    record.checksum = Checksum(record);
+
+    uint64_t start_time = Uptime();
+    if(f_open(&file, path, FA_WRITE | FA_OPEN_ALWAYS) != FR_OK)
+    {
+        errors++;
+        return false;
+    }
+    if(f_lseek(&file, slot * sizeof(Record)) == FR_OK)
+    {
+        f_write(&file, &record, sizeof(record), &written);
+    }
+    f_close(&file);
+
+    last_write_time = Uptime() - start_time;
+    if(last_write_time > max_write_time)
+    {
+        max_write_time = last_write_time;
+    }
+    if(written != sizeof(record))
+    {
+        errors++;
+        return false;
+    }
+
+    saved = state;
+    has_saved = true;
+    sequence++;
+    slot = (slot + 1) % kSlots;
+    saves++;
+    return true;
+}
+
+void ResumeJournal::Clear()
+{
+    Record records[kSlots];
+    FIL file;
+    UINT written = 0;
+
+    memset(records, 0, sizeof(records));
+    if(f_open(&file, path, FA_WRITE | FA_OPEN_ALWAYS) != FR_OK)
+    {
+        errors++;
+        return;
+    }
+    f_write(&file, records, sizeof(records), &written);
+    f_close(&file);
+
+    has_saved = false;
+    slot = 0;
+}
+
+void ResumeJournal::SetInterval(uint32_t interval)
+{
+    interval_ms = (interval < kMinIntervalMs) ? kMinIntervalMs : interval;
+}
+
+void ResumeJournal::SetResumed(uint32_t offset, uint64_t seek, bool fast)
+{
+    resumed = true;
+    resume_offset = offset;
+    seek_time = seek;
+    fast_seek = fast;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+
+// Where playback was, kept on the SD card so a power cycle picks up the same
+// track at the same byte.
+//
+// The journal is one 512 byte sector of kSlots fixed size records. Every save
+// goes to the next slot with a higher sequence number and Load() takes the
+// newest record whose checksum holds, so a write torn by power loss only
+// costs the latest save. Saves are rate limited to one per interval unless
+// forced on pause and skipped when nothing changed.
+class ResumeJournal
+{
+    public:
+        static constexpr uint8_t kSlots = 16;
+        static constexpr uint32_t kMagic = 0x4D503352;     // "MP3R"
+        static constexpr uint32_t kDefaultIntervalMs = 10000;
+        static constexpr uint32_t kMinIntervalMs = 1000;
+        static constexpr uint16_t kSectorSize = 512;
+
+        // What gets restored. A track is identified by its first cluster and
+        // size so it is still found if files are added or renamed.
+        struct State
+        {
+            uint32_t cluster;
+            uint32_t size;
+            uint32_t offset;    // bytes already handed to the decoder
+            uint8_t track;      // index when saved, only a hint
+            uint8_t volume;
+            uint8_t treble;
+            uint8_t bass;
+        };
+
+        struct Record
+        {
+            uint32_t magic;
+            uint32_t sequence;
+            State state;
+            uint32_t reserved;
+            uint32_t checksum;  // FNV-1a of everything above
+        };
+
+        explicit ResumeJournal(const char * path);
+
+        /// Reads the newest valid record. Touches the SD card, so the caller
+        /// must hold SD_MUTEX.
+        ///
+        /// @return false if there is no journal or no valid record in it
+        bool Load(State * state);
+        /// @return true when the interval has passed since the last save,
+        ///         cheap enough to call for every chunk
+        bool IsDue(uint64_t now) const;
+        /// Writes state to the next slot if it differs from the last save.
+        /// Touches the SD card, so the caller must hold SD_MUTEX.
+        ///
+        /// @param force - save even if the interval has not passed
+        /// @return true if a record was written
+        bool Save(const State& state, uint64_t now, bool force);
+        /// Invalidates every slot so the next boot starts from the top.
+        /// Caller must hold SD_MUTEX.
+        void Clear();
+
+        void SetInterval(uint32_t interval_ms);
+        uint32_t GetInterval() const { return interval_ms; }
+
+        /// Boot side measurements, set by the caller
+        void SetResumed(uint32_t offset, uint64_t seek_time, bool fast_seek);
+        void SetResumeToAudio(uint64_t time) { resume_to_audio = time; }
+
+        static uint32_t Checksum(const Record& record);
+        static bool IsValid(const Record& record);
+        /// @return slot holding the newest valid record, -1 if none
+        static int8_t Newest(const Record * records, uint8_t count);
+
+        uint32_t GetSaves() const { return saves; }
+        uint32_t GetUnchanged() const { return unchanged; }
+        uint32_t GetErrors() const { return errors; }
+        uint32_t GetPayloadBytes() const { return saves * sizeof(Record); }
+        uint64_t GetLastWriteTime() const { return last_write_time; }
+        uint64_t GetMaxWriteTime() const { return max_write_time; }
+        bool IsResumed() const { return resumed; }
+        uint32_t GetResumeOffset() const { return resume_offset; }
+        uint64_t GetSeekTime() const { return seek_time; }
+        bool UsedFastSeek() const { return fast_seek; }
+        uint64_t GetResumeToAudio() const { return resume_to_audio; }
+
+    private:
+        static bool SameState(const State& a, const State& b);
+
+        const char * path;
+        uint32_t interval_ms;
+
+        State saved;
+        bool has_saved;
+        uint32_t sequence;
+        uint8_t slot;
+        uint64_t last_save;
+
+        uint32_t saves;
+        uint32_t unchanged;
+        uint32_t errors;
+        uint64_t last_write_time;
+        uint64_t max_write_time;
+
+        bool resumed;
+        uint32_t resume_offset;
+        uint64_t seek_time;
+        bool fast_seek;
+        uint64_t resume_to_audio;
+};
+
+static_assert(sizeof(ResumeJournal::Record) * ResumeJournal::kSlots == ResumeJournal::kSectorSize,
+              "Resume journal must fill exactly one sector");
@@ -0,0 +1,134 @@
+#include "SerialStream.hpp"
+
+SerialStream::SerialStream()
+{
+    head = 0;
+    tail = 0;
+    active = false;
+    unpaid_bytes = 0;
+    owed_credits = 0;
+    owe_window = false;
+    last_received = 0;
+    last_activity = 0;
+    received = 0;
+    overruns = 0;
+    credits_sent = 0;
+    windows_sent = 0;
+    peak_level = 0;
+}
+
+void SerialStream::Start(uint32_t now_ms)
+{
+    // The interrupt side stores nothing while the ring is reset
+    active = false;
+    head = 0;
+    tail = 0;
+    unpaid_bytes = 0;
+    owed_credits = 0;
+    owe_window = true;
+    last_received = 0;
+    last_activity = now_ms;
+    received = 0;
+    overruns = 0;
+    credits_sent = 0;
+    windows_sent = 0;
+    peak_level = 0;
+    active = true;
+}
+
+void SerialStream::Stop()
+{
+    active = false;
+    owe_window = false;
+    owed_credits = 0;
+}
+
+uint16_t SerialStream::Receive(uint8_t byte)
+{
+    uint16_t level = head - tail;
+
+    if(!active || level == kBufferSize)
+    {
+        overruns++;
+        return level;
+    }
+    ring[head % kBufferSize] = byte;
+    // Byte first, index second, the reader only looks below head
+    head = head + 1;
+    received = received + 1;
+    level++;
+    if(level > peak_level)
+    {
+        peak_level = level;
+    }
+    return level;
+}
+
+uint16_t SerialStream::Read(uint8_t * data, uint16_t max)
+{
+    uint16_t count = Available();
+    uint16_t index;
+
+    if(count > max)
+    {
+        count = max;
+    }
+    for(uint16_t i = 0; i < count; i++)
+    {
+        index = tail + i;
+        data[i] = ring[index % kBufferSize];
+    }
+    tail = tail + count;
+
+    unpaid_bytes += count;
+    while(unpaid_bytes >= kCreditBytes)
+    {
+        unpaid_bytes -= kCreditBytes;
+        owed_credits++;
+    }
+    return count;
+}
+
+void SerialStream::Poll(uint32_t now_ms)
+{
+    if(received != last_received)
+    {
+        last_received = received;
+        last_activity = now_ms;
+        return;
+    }
+    // The sender may hold credits the ring no longer backs after a regrant,
+    // so only while nothing is buffered, owed or arriving
+    if(active && !owe_window && Available() == 0 && owed_credits == 0 &&
+       now_ms - last_activity >= kResyncMs)
+    {
+        unpaid_bytes = 0;
+        owe_window = true;
+        last_activity = now_ms;
+    }
+}
+
+uint8_t SerialStream::TakeTokens(uint8_t * tokens, uint8_t max)
+{
+    uint8_t count = 0;
+
+    if(!active)
+    {
+        return 0;
+    }
+    if(owe_window && count < max)
+    {
+        // A window replaces whatever credits were still owed
+        tokens[count++] = kWindowToken;
+        owe_window = false;
+        owed_credits = 0;
+        windows_sent++;
+    }
+    while(owed_credits && count < max)
+    {
+        tokens[count++] = kCreditToken;
+        owed_credits--;
+        credits_sent++;
+    }
+    return count;
+}
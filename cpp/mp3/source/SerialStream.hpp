@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+
+// Receive side of an MP3 byte stream from a host, the second audio source
+// next to the SD card.
+//
+// The UART interrupt hands every byte to Receive(), the SD reader task
+// takes them out in chunks with Read(). The ring between them has one
+// writer and one reader and needs no lock.
+//
+// Flow control is by credit. The sender may have at most kBufferSize bytes
+// outstanding, so the ring can never overflow while it plays by the rules.
+// Every kCreditBytes the reader takes out earns one kCreditToken back, which
+// lets the sender send kCreditBytes more. Start() queues a kWindowToken,
+// which grants the whole ring afresh. A sender that connected late missed
+// it, so the window is granted again after kResyncMs with the ring empty
+// and nothing arriving, which is also when nothing can be in flight.
+//
+// Tokens are single bytes on the wire back to the host, TakeTokens() hands
+// them to whoever sends them.
+class SerialStream
+{
+    public:
+        static constexpr uint16_t kBufferSize = 2048;
+        static constexpr uint16_t kCreditBytes = 128;
+        static constexpr uint8_t kWindowCredits = kBufferSize / kCreditBytes;
+        static constexpr uint8_t kCreditToken = 'C';
+        static constexpr uint8_t kWindowToken = 'W';
+        static constexpr uint32_t kResyncMs = 1000;
+
+        SerialStream();
+
+        /// Empties the ring, clears the counters and queues a window token
+        void Start(uint32_t now_ms);
+        /// Bytes received from here on are dropped
+        void Stop();
+        bool IsActive() const { return active; }
+
+        /// Interrupt side. Stores a byte, or counts an overrun if the ring is
+        /// full or the stream is stopped.
+        ///
+        /// @return bytes waiting afterwards
+        uint16_t Receive(uint8_t byte);
+
+        /// Reader side
+        uint16_t Available() const { return head - tail; }
+        /// Reader side. Copies out up to max bytes and earns their credits.
+        ///
+        /// @return bytes copied
+        uint16_t Read(uint8_t * data, uint16_t max);
+        /// Reader side. Notes whether bytes arrived since the last call and
+        /// grants the window again after kResyncMs of an idle, empty ring.
+        void Poll(uint32_t now_ms);
+        /// @return milliseconds since Poll() last saw a byte arrive
+        uint32_t GetIdleMs(uint32_t now_ms) const { return now_ms - last_activity; }
+        /// Reader side. Moves the tokens owed to the sender into tokens.
+        ///
+        /// @param max - room in tokens, kWindowCredits + 1 takes them all
+        /// @return tokens to send
+        uint8_t TakeTokens(uint8_t * tokens, uint8_t max);
+
+        uint32_t GetReceived() const { return received; }
+        uint32_t GetOverruns() const { return overruns; }
+        uint32_t GetCredits() const { return credits_sent; }
+        uint32_t GetWindows() const { return windows_sent; }
+        uint16_t GetPeakLevel() const { return peak_level; }
+
+    private:
+        uint8_t ring[kBufferSize];
+        volatile uint16_t head;             // interrupt side, free running
+        volatile uint16_t tail;             // reader side, free running
+        volatile bool active;
+
+        uint16_t unpaid_bytes;              // read but not yet worth a credit
+        uint8_t owed_credits;
+        bool owe_window;
+        uint32_t last_received;
+        uint32_t last_activity;
+
+        volatile uint32_t received;
+        volatile uint32_t overruns;
+        uint32_t credits_sent;
+        uint32_t windows_sent;
+        uint16_t peak_level;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "L3_Application/commandline.hpp"
+#include "ClockController.hpp"
+#include "DecoderTelemetry.hpp"
+#include "UiStats.hpp"
+#include "VS1053.hpp"
+
+// "stats" prints what the decoder is playing, how well it is being fed and
+// how quickly the panel and the spectrum analyzer follow. "stats reset" clears the feed rate,
+// underrun and UI maximum history.
+class StatsCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Display decoder telemetry. Use 'stats reset' to clear counters.";
+
+        StatsCommand(DecoderTelemetry* decoder_telemetry, VS1053* vs1053, ClockController* clock_controller,
+                     UiStats* ui_stats, SpectrumStats* spectrum_stats)
+            : Command("stats", kDescription), telemetry(decoder_telemetry), decoder(vs1053),
+              clock(clock_controller), ui(ui_stats), spectrum(spectrum_stats)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 1 && strcmp(argv[1], "reset") == 0)
+            {
+                telemetry->Reset();
+                ui->max_frame_time = 0;
+                ui->max_latency = 0;
+                spectrum->max_spi_time = 0;
+                printf("Decoder telemetry cleared\n");
+                return 0;
+            }
+
+            uint16_t elapsed = telemetry->GetElapsed();
+            printf("Format      : %s\n", DecoderTelemetry::FormatToString(telemetry->GetFormat()));
+            printf("Bitrate     : %lu bps\n", telemetry->GetBitrate());
+            printf("Sample Rate : %u Hz, %u ch\n", telemetry->GetSampleRate(), telemetry->GetChannels());
+            printf("Elapsed     : %02u:%02u\n", elapsed / 60, elapsed % 60);
+            printf("Feed Rate   : %lu B/s (%+ld%% margin)\n", telemetry->GetSupplyRate(), telemetry->GetMargin());
+            printf("Underruns   : %lu\n", telemetry->GetUnderruns());
+            printf("SPI Time    : %lu us max per sample\n", static_cast<uint32_t>(telemetry->GetMaxSpiTime()));
+            printf("SCI Writes  : %lu sent, %lu saved\n", decoder->getSciWrites(), decoder->getSciWritesSaved());
+            uint8_t multiplier = ClockController::StepToMultiplier(clock->GetStep());
+            printf("Clock       : %u.%ux (%lu raises, %lu drops)\n", multiplier / 10, multiplier % 10,
+                   clock->GetRaises(), clock->GetDrops());
+            printf("UI Frames   : %lu drawn, %lu requests coalesced\n", ui->frames, ui->coalesced_requests);
+            printf("Frame Time  : %lu us last, %lu us max, %lu B to panel\n",
+                   static_cast<uint32_t>(ui->last_frame_time), static_cast<uint32_t>(ui->max_frame_time),
+                   ui->last_flush_bytes);
+            printf("UI Latency  : %lu us last, %lu us max\n", static_cast<uint32_t>(ui->last_latency),
+                   static_cast<uint32_t>(ui->max_latency));
+            printf("Spectrum    : %lu frames, %lu us SPI last, %lu us max, loaded in %lu us\n", spectrum->frames,
+                   static_cast<uint32_t>(spectrum->last_spi_time), static_cast<uint32_t>(spectrum->max_spi_time),
+                   static_cast<uint32_t>(spectrum->load_time));
+            return 0;
+        }
+
+    private:
+        DecoderTelemetry* telemetry;
+        VS1053* decoder;
+        ClockController* clock;
+        UiStats* ui;
+        SpectrumStats* spectrum;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "L3_Application/commandline.hpp"
+#include "LabUart.hpp"
+#include "SerialStream.hpp"
+
+// "stream"         counters of the current or last serial stream
+// "stream on"      the main zone plays what arrives on the stream UART
+//                  instead of the SD card
+// "stream off"     back to the SD card, the current track starts again
+class StreamCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "MP3 stream over serial. Usage: stream [on|off]";
+
+        // Run in the terminal task
+        typedef bool (*SwitchFunction)();
+
+        StreamCommand(SerialStream* serial_stream, LabUart* stream_uart, SwitchFunction start_function,
+                      SwitchFunction stop_function)
+            : Command("stream", kDescription), stream(serial_stream), uart(stream_uart),
+              start(start_function), stop(stop_function)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 1 && strcmp(argv[1], "on") == 0)
+            {
+                if(!start())
+                {
+                    printf("Already streaming, or recording\n");
+                    return 1;
+                }
+                printf("Streaming at %lu baud, send with host/stream_send\n", uart->GetBaud());
+                return 0;
+            }
+            else if(argc > 1 && strcmp(argv[1], "off") == 0)
+            {
+                if(!stop())
+                {
+                    printf("Not streaming\n");
+                    return 1;
+                }
+            }
+
+            printf("Streaming   : %s\n", stream->IsActive() ? "yes" : "no");
+            printf("Received    : %lu bytes\n", stream->GetReceived());
+            printf("Buffer      : %u of %u bytes at most\n", stream->GetPeakLevel(),
+                   SerialStream::kBufferSize);
+            printf("Credits     : %lu sent, %lu windows\n", stream->GetCredits(), stream->GetWindows());
+            printf("Overruns    : %lu bytes, %lu line errors\n", stream->GetOverruns(),
+                   uart->GetLineErrors());
+            return 0;
+        }
+
+    private:
+        SerialStream* stream;
+        LabUart* uart;
+        SwitchFunction start;
+        SwitchFunction stop;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "L0_LowLevel/LPC40xx.h"
+#include "TraceEvents.hpp"
+
+// Fixed-size trace ring that is safe to record into from tasks and ISRs
+// without locks: a writer claims a slot with one atomic increment
+// (LDREX/STREX on the M4) and then fills it, so the cost of Record() is a
+// handful of cycles. When full the oldest records are overwritten.
+//
+// Recording is paused while the ring is being dumped.
+class TraceBuffer
+{
+    public:
+        // 256 records * 8 bytes = 2 KB, over a second of 128 kbps playback now
+        // that DREQ is only traced as it rises
+        static constexpr uint32_t kSize = 256;
+        static_assert((kSize & (kSize - 1)) == 0, "Trace size must be a power of two");
+
+        TraceBuffer() : head(0), enabled(true)
+        {
+        }
+
+        /// Starts the DWT cycle counter used for timestamps.
+        static void Initialize()
+        {
+            CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+            DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        }
+
+        inline void Record(trace::Event event, uint16_t arg)
+        {
+            if(!enabled)
+            {
+                return;
+            }
+            uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+            trace::Record& record = records[index & (kSize - 1)];
+            record.cycles = DWT->CYCCNT;
+            record.event = event;
+            record.arg = arg;
+        }
+
+        void Enable(bool enable) { enabled = enable; }
+        void Clear() { head = 0; }
+
+        uint32_t GetCount() const
+        {
+            uint32_t total = head;
+            return (total < kSize) ? total : kSize;
+        }
+        uint32_t GetDropped() const
+        {
+            uint32_t total = head;
+            return (total < kSize) ? 0 : total - kSize;
+        }
+        /// @param i - 0 is the oldest record still in the ring
+        const trace::Record& Get(uint32_t i) const
+        {
+            uint32_t total = head;
+            uint32_t oldest = (total < kSize) ? 0 : total - kSize;
+            return records[(oldest + i) & (kSize - 1)];
+        }
+
+    private:
+        trace::Record records[kSize];
+        std::atomic<uint32_t> head;
+        volatile bool enabled;
+};
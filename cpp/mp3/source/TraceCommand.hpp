@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "L3_Application/commandline.hpp"
+#include "TraceBuffer.hpp"
+#include "TraceEvents.hpp"
+#include "utility/time.hpp"
+
+// "trace"        prints how many events are recorded
+// "trace dump"   writes the ring to the console in binary (see TraceEvents.hpp),
+//                decode the capture with host/trace_decode
+// "trace clear"  empties the ring
+class TraceCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Event trace. Usage: trace [dump|clear]";
+
+        explicit TraceCommand(TraceBuffer* trace_buffer)
+            : Command("trace", kDescription), buffer(trace_buffer)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 1 && strcmp(argv[1], "clear") == 0)
+            {
+                buffer->Clear();
+                printf("Trace cleared\n");
+            }
+            else if(argc > 1 && strcmp(argv[1], "dump") == 0)
+            {
+                Dump();
+            }
+            else
+            {
+                printf("%lu events recorded, %lu overwritten\n",
+                       buffer->GetCount(), buffer->GetDropped());
+            }
+            return 0;
+        }
+
+    private:
+        void Dump()
+        {
+            trace::Header header = { { 'M', 'P', '3', 'T' }, 0, 0, 0 };
+
+            // Cycle counter rate, so the host can convert to time
+            uint32_t start_cycles = DWT->CYCCNT;
+            uint64_t start_time = Uptime();
+            Delay(10);
+            header.cycles_per_us = (DWT->CYCCNT - start_cycles) /
+                                   static_cast<uint32_t>(Uptime() - start_time);
+
+            buffer->Enable(false);
+            header.count = buffer->GetCount();
+            header.dropped = buffer->GetDropped();
+            fwrite(&header, sizeof(header), 1, stdout);
+            for(uint32_t i = 0; i < header.count; i++)
+            {
+                fwrite(&buffer->Get(i), sizeof(trace::Record), 1, stdout);
+            }
+            fflush(stdout);
+            buffer->Enable(true);
+        }
+
+        TraceBuffer* buffer;
+};
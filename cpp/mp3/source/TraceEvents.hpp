@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+// Binary format shared by the on-target trace ring and the host decoder.
+namespace trace
+{
+enum Event : uint8_t
+{
+    kNone = 0,
+    kDreqHigh,          // arg: queued chunks when DREQ was seen rising
+    kChunkQueued,       // arg: song index
+    kChunkSent,         // arg: bytes
+    kSdReadStart,       // arg: requested bytes
+    kSdReadEnd,         // arg: bytes read
+    kIrOpcode,          // arg: opcode, recorded in the ISR
+    kMutexWait,         // arg: kSpiMutex or kSdMutex
+    kMutexAcquired,     // arg: kSpiMutex or kSdMutex
+    kUnderrun,          // arg: underrun count
+    kSongChange,        // arg: song index
+    kPressStage,        // arg: press id << 8 | PressLatency::Stage (or kDone)
+    kEventCount
+};
+
+enum Mutex : uint16_t
+{
+    kSpiMutex = 0,
+    kSdMutex = 1
+};
+
+struct Record
+{
+    uint32_t cycles;    // DWT->CYCCNT
+    uint8_t event;
+    uint8_t reserved;
+    uint16_t arg;
+} __attribute__((packed));
+
+// Dump layout: Header, then count Records oldest first
+struct Header
+{
+    char magic[4];              // "MP3T"
+    uint32_t count;
+    uint32_t dropped;           // records overwritten before the dump
+    uint32_t cycles_per_us;
+} __attribute__((packed));
+
+static_assert(sizeof(Record) == 8, "Trace records must stay 8 bytes");
+
+inline const char * EventToString(uint8_t event)
+{
+    switch(event)
+    {
+        case kDreqHigh: return "DREQ_HIGH";
+        case kChunkQueued: return "CHUNK_QUEUED";
+        case kChunkSent: return "CHUNK_SENT";
+        case kSdReadStart: return "SD_READ_START";
+        case kSdReadEnd: return "SD_READ_END";
+        case kIrOpcode: return "IR_OPCODE";
+        case kMutexWait: return "MUTEX_WAIT";
+        case kMutexAcquired: return "MUTEX_ACQUIRED";
+        case kUnderrun: return "UNDERRUN";
+        case kSongChange: return "SONG_CHANGE";
+        case kPressStage: return "PRESS_STAGE";
+        default: return "UNKNOWN";
+    }
+}
+}
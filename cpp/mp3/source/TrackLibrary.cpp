@@ -0,0 +1,177 @@
+#include "TrackLibrary.hpp"
+#include "ff.h"
+
+#include <cstring>
+
+static_assert(sizeof(TrackLibrary) < 48 * TrackLibrary::kMaxTracks,
+              "a track must cost under 48 bytes");
+
+TrackLibrary::TrackLibrary()
+{
+    Clear();
+}
+
+void TrackLibrary::Clear()
+{
+    count = 0;
+    arena_used = 0;
+    arena_saved = 0;
+    overflows = 0;
+    arena_full = 0;
+    for(uint16_t slot = 0; slot < kHashSlots; slot++)
+    {
+        slots[slot] = kNoTrack;
+    }
+}
+
+TrackLibrary::Status TrackLibrary::Add(const char * name, const ID3v1_t * tag, uint32_t size,
+                                       uint32_t cluster)
+{
+    char title[31] = "";
+
+    if(count == kMaxTracks)
+    {
+        overflows++;
+        return Status::kListFull;
+    }
+
+    Track& track = tracks[count];
+    track.name = Store(name);
+    if(track.name == kNoString)
+    {
+        arena_full++;
+        return Status::kArenaFull;
+    }
+
+    if(tag && memcmp(tag->header, "TAG", 3) == 0)
+    {
+        CopyField(title, tag->title, sizeof(tag->title));
+    }
+    track.title = (title[0]) ? InternTitle(title) : track.name;
+    if(track.title == kNoString)
+    {
+        arena_full++;
+        track.title = track.name;
+    }
+
+    track.size = size;
+    track.cluster = cluster;
+    count++;
+    return Status::kAdded;
+}
+
+void TrackLibrary::Update(uint8_t track, uint32_t size, uint32_t cluster)
+{
+    tracks[track].size = size;
+    tracks[track].cluster = cluster;
+}
+
+uint16_t TrackLibrary::Hash(const char * string)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while(*string)
+    {
+        hash = (hash ^ static_cast<uint8_t>(*string++)) * 16777619u;
+    }
+    return static_cast<uint16_t>(hash ^ (hash >> 16));
+}
+
+uint16_t TrackLibrary::Store(const char * string)
+{
+    uint16_t length = strlen(string) + 1;
+
+    if(arena_used + length > kArenaSize)
+    {
+        return kNoString;
+    }
+    uint16_t offset = arena_used;
+    memcpy(&arena[offset], string, length);
+    arena_used += length;
+    return offset;
+}
+
+uint16_t TrackLibrary::InternTitle(const char * title)
+{
+    uint8_t slot = Hash(title) & (kHashSlots - 1);
+    uint16_t offset;
+
+    // Artist-less rips and albums repeat titles, look for a copy first
+    while(slots[slot] != kNoTrack)
+    {
+        offset = tracks[slots[slot]].title;
+        if(strcmp(&arena[offset], title) == 0)
+        {
+            arena_saved += strlen(title) + 1;
+            return offset;
+        }
+        slot = (slot + 1) & (kHashSlots - 1);
+    }
+
+    // Indexed under the track being added, Add() lists it as count
+    offset = Store(title);
+    if(offset != kNoString)
+    {
+        slots[slot] = count;
+    }
+    return offset;
+}
+
+void TrackLibrary::CopyField(char * destination, const uint8_t * field, uint8_t width)
+{
+    uint8_t length = 0;
+    while(length < width && field[length] != '\0')
+    {
+        length++;
+    }
+    while(length > 0 && field[length - 1] == ' ')
+    {
+        length--;
+    }
+    memcpy(destination, field, length);
+    destination[length] = '\0';
+}
+
+const char * TrackLibrary::StatusToString(Status status)
+{
+    switch(status)
+    {
+        case Status::kAdded: return "added";
+        case Status::kListFull: return "track list full";
+        case Status::kArenaFull: return "no room for the name";
+        default: return "unknown";
+    }
+}
+
+bool TrackLibrary::LoadDetails(uint8_t track, Details * details) const
+{
+    FIL file;
+    UINT bytes_read = 0;
+    ID3v1_t tag;
+
+    memset(details, 0, sizeof(*details));
+    if(track >= count || GetSize(track) < kTagSize)
+    {
+        return false;
+    }
+    if(f_open(&file, GetName(track), FA_READ) != FR_OK)
+    {
+        return false;
+    }
+    if(f_lseek(&file, GetSize(track) - kTagSize) == FR_OK)
+    {
+        f_read(&file, tag.buffer, sizeof(tag.buffer), &bytes_read);
+    }
+    f_close(&file);
+
+    if(bytes_read != sizeof(tag.buffer) || memcmp(tag.header, "TAG", 3) != 0)
+    {
+        return false;
+    }
+    CopyField(details->artist, tag.artist, sizeof(tag.artist));
+    CopyField(details->album, tag.album, sizeof(tag.album));
+    CopyField(details->year, tag.year, sizeof(tag.year));
+    CopyField(details->comment, tag.comment, sizeof(tag.comment));
+    details->genre = tag.genre;
+    return true;
+}
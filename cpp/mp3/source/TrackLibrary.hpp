@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+
+typedef union
+{
+    uint8_t buffer[128];
+    struct 
+    {
+        uint8_t header[3];
+        uint8_t title[30];
+        uint8_t artist[30];
+        uint8_t album[30];
+        uint8_t year[4];
+        uint8_t comment[28];
+        uint8_t zero;
+        uint8_t track;
+        uint8_t genre;
+    } __attribute__((packed));
+} ID3v1_t;
+
+// Track list kept to what the UI needs on every frame.
+//
+// File names and titles go into one packed arena and are referenced by
+// 16-bit offsets. Names are unique within the directory and stored as they
+// are, titles repeat across an album and are interned through a small
+// index of tracks. A track costs a 12 byte hot entry, its share of the
+// arena and of the index, under 48 bytes in total against 384 for a 256
+// byte name plus a whole ID3v1 tag. Everything else in the tag is cold:
+// LoadDetails() reads it back from the file when a track starts playing.
+class TrackLibrary
+{
+    public:
+        static constexpr uint8_t kMaxTracks = 100;
+        // Sized for kMaxTracks at 34.4 bytes of strings each, a repeated
+        // title is only stored once. Long file names can fill it before
+        // kMaxTracks, which Add() reports as kArenaFull rather than
+        // growing this into the 28 KB that 100 worst case names would take.
+        static constexpr uint16_t kArenaSize = 3440;
+        static constexpr uint8_t kTagSize = sizeof(ID3v1_t);
+
+        // Cold ID3v1 fields, NUL terminated
+        struct Details
+        {
+            char artist[31];
+            char album[31];
+            char year[5];
+            char comment[29];
+            uint8_t genre;
+        };
+
+        TrackLibrary();
+
+        enum class Status : uint8_t
+        {
+            kAdded = 0,
+            kListFull,          // kMaxTracks already listed
+            kArenaFull          // no room left for the file name
+        };
+
+        /// Adds a track. When the arena is full the title falls back to the
+        /// file name, and when even the name does not fit the track is
+        /// skipped; both count towards GetArenaFull().
+        ///
+        /// @param name    - file name
+        /// @param tag     - last 128 bytes of the file, nullptr if unknown
+        /// @param size    - file size in bytes
+        /// @param cluster - first cluster of the file
+        Status Add(const char * name, const ID3v1_t * tag, uint32_t size, uint32_t cluster);
+        /// Points a listed track at a file written over it. The title stays
+        /// until the next scan, the arena only grows.
+        void Update(uint8_t track, uint32_t size, uint32_t cluster);
+        void Clear();
+
+        uint8_t GetCount() const { return count; }
+        const char * GetName(uint8_t track) const { return &arena[tracks[track].name]; }
+        /// @return ID3 title, or the file name when the tag has none
+        const char * GetTitle(uint8_t track) const { return &arena[tracks[track].title]; }
+        uint32_t GetSize(uint8_t track) const { return tracks[track].size; }
+        uint32_t GetCluster(uint8_t track) const { return tracks[track].cluster; }
+
+        /// Reads the cold fields of a track from its ID3v1 tag. Touches the
+        /// SD card, so the caller must hold SD_MUTEX.
+        ///
+        /// @return false, with empty fields, if the file has no tag
+        bool LoadDetails(uint8_t track, Details * details) const;
+        /// Copies a fixed width tag field, dropping the space or NUL padding.
+        static void CopyField(char * destination, const uint8_t * field, uint8_t width);
+        static const char * StatusToString(Status status);
+
+        uint16_t GetArenaUsed() const { return arena_used; }
+        uint16_t GetArenaSaved() const { return arena_saved; }
+        /// @return tracks skipped because the list was full
+        uint32_t GetOverflows() const { return overflows; }
+        /// @return tracks skipped or left untitled because the arena was full
+        uint32_t GetArenaFull() const { return arena_full; }
+
+    private:
+        // Hot per-track entry, 12 bytes
+        struct Track
+        {
+            uint16_t name;
+            uint16_t title;
+            uint32_t size;
+            uint32_t cluster;
+        };
+
+        /// @return offset of string, appended to the arena, or kNoString
+        ///         if it does not fit
+        uint16_t Store(const char * string);
+        /// @return offset of the title of a track listed earlier when it is
+        ///         the same, else Store(title)
+        uint16_t InternTitle(const char * title);
+
+        static uint16_t Hash(const char * string);
+
+        static constexpr uint16_t kNoString = 0xFFFF;
+        static constexpr uint8_t kNoTrack = 0xFF;
+        // Open addressed index of titles by track, one title per track
+        // keeps it under 80% full
+        static constexpr uint8_t kHashSlots = 128;
+        static_assert((kHashSlots & (kHashSlots - 1)) == 0, "kHashSlots must be a power of two");
+        static_assert(kHashSlots > kMaxTracks, "every title needs a slot");
+
+        Track tracks[kMaxTracks];
+        char arena[kArenaSize];
+        uint8_t slots[kHashSlots];      // track whose title it is, kNoTrack if free
+        uint16_t arena_used;
+        uint16_t arena_saved;       // bytes not stored thanks to interning
+        uint32_t overflows;
+        uint32_t arena_full;
+        uint8_t count;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// UI timing kept by the render task, all times in Uptime() units.
+//
+// request_time is written by every task that asks for a frame and cleared
+// by the render task. It is 64 bits, two stores on the Cortex-M4, so both
+// sides only touch it inside a critical section.
+struct UiStats
+{
+    uint64_t request_time;              // oldest render request not yet drawn, 0 if none
+    uint32_t coalesced_requests;        // requests merged into an already pending frame
+    uint32_t frames;
+    uint64_t last_frame_time;
+    uint64_t max_frame_time;
+    uint64_t last_latency;              // render request to panel updated
+    uint64_t max_latency;
+    uint32_t last_flush_bytes;          // sent to the panel by the last frame
+};
+
+// Spectrum analyzer SPI cost, all times in Uptime() units
+struct SpectrumStats
+{
+    uint64_t load_time;                 // plugin load at boot
+    uint32_t frames;
+    uint64_t last_spi_time;
+    uint64_t max_spi_time;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "L3_Application/commandline.hpp"
+#include "UploadReceiver.hpp"
+
+// "upload"                   counters of the last upload
+// "upload <file> <bytes>"    receives <file> on the stream UART, sent with
+//                            host/upload_send, and adds it to the track list.
+//                            Blocks the command line until it is done.
+class UploadCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "File upload to SD over serial. Usage: upload [<file> <bytes>]";
+
+        // Run in the terminal task, returns once the file is complete or
+        // the host has gone quiet
+        typedef bool (*ReceiveFunction)(const char * path, uint32_t size);
+
+        UploadCommand(UploadReceiver* upload_receiver, ReceiveFunction receive_function)
+            : Command("upload", kDescription), receiver(upload_receiver), receive(receive_function)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            int result = 0;
+
+            if(argc > 2)
+            {
+                printf("Waiting for %s, %s bytes\n", argv[1], argv[2]);
+                if(!receive(argv[1], strtoul(argv[2], nullptr, 10)))
+                {
+                    printf("Upload of %s FAILED\n", argv[1]);
+                    result = 1;
+                }
+            }
+
+            printf("Received    : %lu of %lu bytes\n", receiver->GetBytesReceived(), receiver->GetSize());
+            printf("Written     : %lu bytes in %lu writes, %lu errors\n", receiver->GetBytesWritten(),
+                   receiver->GetWrites(), receiver->GetWriteErrors());
+            printf("Write Time  : %lu ms total, %lu ms longest\n",
+                   static_cast<uint32_t>(receiver->GetWriteTime() / 1000),
+                   static_cast<uint32_t>(receiver->GetMaxWriteTime() / 1000));
+            printf("Frames      : %lu, %lu CRC errors, %lu out of order, %lu resent\n",
+                   receiver->GetFrames(), receiver->GetCrcErrors(), receiver->GetOutOfOrder(),
+                   receiver->GetDuplicates());
+            printf("NAKs        : %lu, %lu past the window\n", receiver->GetNaks(), receiver->GetNoRoom());
+            return result;
+        }
+
+    private:
+        UploadReceiver* receiver;
+        ReceiveFunction receive;
+};
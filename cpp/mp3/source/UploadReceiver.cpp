@@ -0,0 +1,288 @@
+#include "UploadReceiver.hpp"
+#include "utility/time.hpp"
+
+UploadReceiver::UploadReceiver(uint8_t (*sector_buffers)[kBufferSize], uint8_t buffers, uint8_t window_blocks)
+{
+    storage = sector_buffers;
+    open = false;
+    buffer_count = (buffers >= 1 && buffers <= kMaxBuffers) ? buffers : kMaxBuffers;
+    // Never more than the buffers can take once the host has sent it all
+    window = (window_blocks >= 1 && window_blocks <= buffer_count * kBufferBlocks) ?
+             window_blocks : kWindowBlocks;
+    size = 0;
+    total_blocks = 0;
+    blocks_received = 0;
+    blocks_written = 0;
+    blocks_acked = 0;
+}
+
+bool UploadReceiver::Open(uint32_t file_size)
+{
+    // The interrupt side takes nothing until everything is reset
+    open = false;
+    for(uint8_t i = 0; i < kMaxBuffers; i++)
+    {
+        full[i] = false;
+        lengths[i] = 0;
+    }
+    fill_index = 0;
+    fill_bytes = 0;
+    write_index = 0;
+    field = Field::kStart;
+    target = nullptr;
+    size = file_size;
+    total_blocks = (file_size + kBlockSize - 1) / kBlockSize;
+    blocks_received = 0;
+    blocks_written = 0;
+    blocks_acked = 0;
+    ack_again = false;
+    nak_pending = true;             // the ready
+    nak_sent = false;
+    started = false;
+    last_ready = 0;
+    bytes_written = 0;
+    frames = 0;
+    crc_errors = 0;
+    out_of_order = 0;
+    duplicates = 0;
+    naks = 0;
+    no_room = 0;
+    writes = 0;
+    write_errors = 0;
+    max_write_time = 0;
+    write_time = 0;
+
+    open = (f_open(&file, kTempName, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK);
+    return open;
+}
+
+bool UploadReceiver::WriteNext()
+{
+    UINT written = 0;
+    uint16_t buffer_length;
+
+    if(!open || !full[write_index])
+    {
+        return false;
+    }
+    buffer_length = lengths[write_index];
+
+    uint64_t start_time = Uptime();
+    if(f_write(&file, storage[write_index], buffer_length, &written) != FR_OK || written != buffer_length)
+    {
+        write_errors++;
+    }
+    uint64_t elapsed = Uptime() - start_time;
+    write_time += elapsed;
+    if(elapsed > max_write_time)
+    {
+        max_write_time = elapsed;
+    }
+    bytes_written += written;
+    writes++;
+
+    // Buffer first, count second, the count is what lets the ACKs move on
+    full[write_index] = false;
+    blocks_written = blocks_written + (buffer_length + kBlockSize - 1) / kBlockSize;
+    write_index = (write_index + 1) % buffer_count;
+    return true;
+}
+
+bool UploadReceiver::Close(const char * path)
+{
+    bool complete;
+
+    if(!open)
+    {
+        return false;
+    }
+    open = false;
+    complete = path && IsComplete() && write_errors == 0;
+    if(f_close(&file) != FR_OK)
+    {
+        complete = false;
+    }
+    if(complete)
+    {
+        // f_rename() does not replace, the old file goes first
+        FRESULT result = f_unlink(path);
+        complete = (result == FR_OK || result == FR_NO_FILE) && f_rename(kTempName, path) == FR_OK;
+    }
+    if(!complete)
+    {
+        // Never the target, an old file under its name is left as it was
+        f_unlink(kTempName);
+    }
+    return complete;
+}
+
+uint16_t UploadReceiver::BlockLength(uint32_t block) const
+{
+    return (block + 1 < total_blocks || size % kBlockSize == 0) ? kBlockSize : size % kBlockSize;
+}
+
+bool UploadReceiver::Receive(uint8_t byte)
+{
+    if(!open)
+    {
+        return false;
+    }
+    started = true;
+
+    switch(field)
+    {
+        case Field::kStart:
+            // Anything else is line noise or the tail of a broken frame
+            if(byte == kStartOfFrame)
+            {
+                crc = 0xFFFF;
+                field = Field::kSequence;
+            }
+            break;
+        case Field::kSequence:
+            sequence = byte;
+            crc = Crc16(crc, byte);
+            field = Field::kLengthLow;
+            break;
+        case Field::kLengthLow:
+            length = byte;
+            crc = Crc16(crc, byte);
+            field = Field::kLengthHigh;
+            break;
+        case Field::kLengthHigh:
+            length |= byte << 8;
+            crc = Crc16(crc, byte);
+            if(length > kBlockSize)
+            {
+                crc_errors++;
+                field = Field::kStart;
+                break;
+            }
+            // Only the block wanted next is kept, straight into its place
+            target = nullptr;
+            if(sequence == static_cast<uint8_t>(blocks_received) && blocks_received < total_blocks &&
+               length == BlockLength(blocks_received) && !full[fill_index])
+            {
+                target = &storage[fill_index][fill_bytes];
+            }
+            position = 0;
+            field = (length > 0) ? Field::kPayload : Field::kCrcLow;
+            break;
+        case Field::kPayload:
+            if(target)
+            {
+                target[position] = byte;
+            }
+            crc = Crc16(crc, byte);
+            if(++position == length)
+            {
+                field = Field::kCrcLow;
+            }
+            break;
+        case Field::kCrcLow:
+            frame_crc = byte;
+            field = Field::kCrcHigh;
+            break;
+        case Field::kCrcHigh:
+            frame_crc |= byte << 8;
+            field = Field::kStart;
+            EndFrame();
+            return true;
+    }
+    return false;
+}
+
+void UploadReceiver::EndFrame()
+{
+    uint8_t expected = blocks_received;
+    uint8_t behind = expected - sequence;
+    bool bad = false;
+
+    frames = frames + 1;
+    if(crc != frame_crc)
+    {
+        crc_errors = crc_errors + 1;
+        bad = true;
+    }
+    else if(sequence == expected && blocks_received < total_blocks)
+    {
+        if(!target)
+        {
+            // Wrong length, or the host went past its window
+            no_room = no_room + 1;
+            bad = true;
+        }
+        else
+        {
+            fill_bytes += length;
+            blocks_received = blocks_received + 1;
+            nak_sent = false;
+            if(fill_bytes == kBufferSize || blocks_received == total_blocks)
+            {
+                // Length first, flag second, the SD side only writes a full buffer
+                lengths[fill_index] = fill_bytes;
+                full[fill_index] = true;
+                fill_index = (fill_index + 1) % buffer_count;
+                fill_bytes = 0;
+            }
+        }
+    }
+    else if(behind >= 1 && behind <= 2 * window && behind <= blocks_received)
+    {
+        // Resent after a lost ACK, the host only needs the ACK again
+        duplicates = duplicates + 1;
+        ack_again = true;
+    }
+    else
+    {
+        // A block went missing in between
+        out_of_order = out_of_order + 1;
+        bad = true;
+    }
+
+    if(bad && !nak_sent)
+    {
+        nak_sent = true;
+        nak_pending = true;
+    }
+}
+
+uint8_t UploadReceiver::TakeReplies(uint8_t * replies, uint8_t max, uint32_t now_ms)
+{
+    uint8_t count = 0;
+    uint32_t received = blocks_received;
+    uint32_t room = blocks_written + buffer_count * kBufferBlocks - window;
+    uint32_t grant = (received < room) ? received : room;
+
+    if(!open)
+    {
+        return 0;
+    }
+    if(!started && now_ms - last_ready >= kReadyMs)
+    {
+        nak_pending = true;
+    }
+
+    if((grant > blocks_acked || (ack_again && blocks_acked)) && count + 2 <= max)
+    {
+        ack_again = false;
+        if(grant > blocks_acked)
+        {
+            blocks_acked = grant;
+        }
+        replies[count++] = kAck;
+        replies[count++] = static_cast<uint8_t>(blocks_acked - 1);
+    }
+    if(nak_pending && count + 2 <= max)
+    {
+        nak_pending = false;
+        replies[count++] = kNak;
+        replies[count++] = static_cast<uint8_t>(blocks_received);
+        naks++;
+        if(!started)
+        {
+            last_ready = now_ms;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ff.h"
+
+// Receives a file from a host over the serial stream UART and writes it to
+// the SD card.
+//
+// The host sends the file in frames:
+//
+//   kStartOfFrame, sequence, length low, length high, payload, CRC low, CRC high
+//
+// Every frame but the last carries kBlockSize bytes. The sequence is the
+// block number modulo 256 and the CRC is CRC-16/CCITT over the sequence,
+// length and payload. Replies are two bytes: kAck and the sequence of the
+// last block taken, or kNak and the sequence the receiver wants next. A NAK
+// with sequence 0 before any block is also the "ready" that starts the
+// host, repeated every kReadyMs until the first byte arrives.
+//
+// The window is go-back-N: blocks are only taken in order, a bad CRC or a
+// gap gets one NAK and the host resends from there, a resent block that was
+// already taken only gets its ACK again.
+//
+// The interrupt side parses frames and copies each payload straight into
+// the buffer being filled, a block's place is only kept once its CRC
+// matches. The SD side (a task) writes whole buffers, so every f_write
+// starts on a sector boundary and covers several sectors, and the card's
+// latency only holds up the buffer being written. The host may have the
+// window's worth of blocks unacknowledged, so a block is acknowledged only
+// once there is room for a whole window behind it: with two buffers the
+// host is never told to send more than fits, however long a write takes.
+//
+// The file is received under kTempName and only renamed over the target
+// once every byte is written, a failed upload leaves the old file as it was.
+//
+// One interrupt fills and one task writes, the flags between them need no
+// lock.
+class UploadReceiver
+{
+    public:
+        static constexpr uint16_t kSectorSize = 512;
+        static constexpr uint16_t kBlockSize = kSectorSize;
+        static constexpr uint16_t kBufferSize = 4 * kSectorSize;
+        static constexpr uint8_t kBufferBlocks = kBufferSize / kBlockSize;
+        static constexpr uint8_t kMaxBuffers = 2;
+        // Blocks the host may send past the last ACK
+        static constexpr uint8_t kWindowBlocks = kBufferBlocks;
+        static constexpr uint8_t kStartOfFrame = 0x01;
+        static constexpr uint8_t kAck = 'A';
+        static constexpr uint8_t kNak = 'N';
+        static constexpr uint8_t kFrameOverhead = 6;
+        static constexpr uint32_t kReadyMs = 1000;
+        // Not a track name, the scan never lists a file left by a power cut
+        static constexpr const char * kTempName = "UPLOAD.TMP";
+
+        /// @param sector_buffers - kMaxBuffers buffers, the caller's so
+        ///                         they can be shared with a user that never
+        ///                         runs at the same time
+        /// @param buffers - 1 fills and writes the same buffer in turn, and
+        /// @param window  - 1 is stop and wait, both only for comparison in
+        ///                  the host bench
+        explicit UploadReceiver(uint8_t (*sector_buffers)[kBufferSize], uint8_t buffers = kMaxBuffers,
+                                uint8_t window = kWindowBlocks);
+
+        /// SD side. Creates or truncates kTempName and clears the counters,
+        /// then frames are taken.
+        bool Open(uint32_t size);
+        /// SD side. Writes the oldest full buffer.
+        ///
+        /// @return false if no buffer was full
+        bool WriteNext();
+        /// SD side. Closes the file and renames it over path once every
+        /// byte was received and written, else deletes it.
+        ///
+        /// @param path - name the file takes, nullptr deletes it anyway
+        /// @return true if the file is complete and renamed
+        bool Close(const char * path);
+
+        /// Interrupt side.
+        ///
+        /// @return true when the byte ended a frame, good or bad
+        bool Receive(uint8_t byte);
+
+        /// SD side. Moves the replies owed to the host into replies.
+        ///
+        /// @param now_ms - repeats the ready NAK every kReadyMs until the
+        ///                 first byte arrives
+        /// @return bytes to send
+        uint8_t TakeReplies(uint8_t * replies, uint8_t max, uint32_t now_ms);
+
+        /// CRC-16/CCITT (0x1021, from 0xFFFF) of one more byte, four bits
+        /// at a time from a 16 entry table. Inline, so the host sender
+        /// needs no receiver.
+        static uint16_t Crc16(uint16_t crc, uint8_t byte)
+        {
+            crc = (crc << 4) ^ kCrcNibbles[(crc >> 12) ^ (byte >> 4)];
+            crc = (crc << 4) ^ kCrcNibbles[(crc >> 12) ^ (byte & 0x0F)];
+            return crc;
+        }
+
+        bool IsOpen() const { return open; }
+        /// @return true once every block is written
+        bool IsComplete() const { return blocks_written == total_blocks; }
+        bool HasPending() const { return full[write_index]; }
+        uint32_t GetSize() const { return size; }
+
+        uint32_t GetBytesReceived() const
+        {
+            return (blocks_received == total_blocks) ? size : blocks_received * uint32_t(kBlockSize);
+        }
+        uint32_t GetBytesWritten() const { return bytes_written; }
+        uint32_t GetFrames() const { return frames; }
+        uint32_t GetCrcErrors() const { return crc_errors; }
+        uint32_t GetOutOfOrder() const { return out_of_order; }
+        uint32_t GetDuplicates() const { return duplicates; }
+        uint32_t GetNaks() const { return naks; }
+        uint32_t GetNoRoom() const { return no_room; }
+        uint32_t GetWrites() const { return writes; }
+        uint32_t GetWriteErrors() const { return write_errors; }
+        uint64_t GetMaxWriteTime() const { return max_write_time; }
+        uint64_t GetWriteTime() const { return write_time; }
+
+    private:
+        static constexpr uint16_t kCrcNibbles[16] = {
+            0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+            0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+        };
+
+        enum class Field : uint8_t
+        {
+            kStart = 0,
+            kSequence,
+            kLengthLow,
+            kLengthHigh,
+            kPayload,
+            kCrcLow,
+            kCrcHigh
+        };
+
+        uint16_t BlockLength(uint32_t block) const;
+        void EndFrame();
+
+        FIL file;
+        volatile bool open;
+        uint8_t buffer_count;
+        uint8_t window;
+        uint32_t size;
+        uint32_t total_blocks;
+
+        uint8_t (*storage)[kBufferSize];
+        volatile uint16_t lengths[kMaxBuffers];
+        volatile bool full[kMaxBuffers];
+        uint8_t fill_index;                 // interrupt side
+        uint16_t fill_bytes;
+        uint8_t write_index;                // SD side
+
+        // Frame being parsed, interrupt side
+        Field field;
+        uint8_t sequence;
+        uint16_t length;
+        uint16_t position;
+        uint16_t crc;
+        uint16_t frame_crc;
+        uint8_t * target;                   // nullptr when the payload is not kept
+
+        volatile uint32_t blocks_received;
+        volatile uint32_t blocks_written;
+        uint32_t blocks_acked;              // SD side
+        volatile bool ack_again;
+        volatile bool nak_pending;
+        bool nak_sent;                      // interrupt side, one NAK per gap
+        volatile bool started;
+        uint32_t last_ready;
+
+        uint32_t bytes_written;
+        volatile uint32_t frames;
+        volatile uint32_t crc_errors;
+        volatile uint32_t out_of_order;
+        volatile uint32_t duplicates;
+        uint32_t naks;
+        volatile uint32_t no_room;
+        uint32_t writes;
+        uint32_t write_errors;
+        uint64_t max_write_time;
+        uint64_t write_time;
+};
@@ -1,22 +1,119 @@
 #pragma once
 
+#include <cstdio>
+#include <cstring>
+
+#include "DeferredLog.hpp"
+#include "ff.h"
 #include "LabGPIO.hpp"
-#include "LabSPI.hpp"
+#include "LabSpi.hpp"
+#include "utility/time.hpp"
 
-class VS1053 {
+// VS1053 driver over any SPI bus and pin types with the same calls as LabSpi
+// and LabGPIO, resolved at compile time:
+//
+//   SpiBus   - Initialize(data_size, LabSpi::FrameModes, divide, LabSpi::SPI_Port),
+//              SetDivider(divide), uint8_t Transfer(uint8_t) and
+//              Write(const uint8_t*, uint16_t)
+//   pins     - SetAsOutput(), SetAsInput(), SetHigh(), SetLow(), bool ReadBool()
+//
+// No virtual calls, so with LabSpi/LabGPIO every DREQ check, chip select and
+// data register access in SendData() is inlined into the burst loop. Host
+// tools plug in recording fakes (host/RecordingBus.hpp) instead.
+template <class SpiBus, class CsPin, class DcsPin, class DreqPin, class ResetPin = CsPin>
+class BasicVs1053 {
     public:
-        VS1053(LabGPIO* data, LabGPIO* select, LabGPIO* reset, LabGPIO* dreq);
+        // Each decoder gets its own SSP port, so several can play at once
+        BasicVs1053(DcsPin* data, CsPin* select, ResetPin* reset, DreqPin* dreq,
+                    LabSpi::SPI_Port port = LabSpi::SPI_Port::kPort1);
         bool init();
 
-        void playSong(char * song_name);
+        // Plays a whole file, blocking. f_open's result goes to log.
+        void playSong(char * song_name, DeferredLog* log);
         void SendData(uint8_t* buffer, uint16_t buffer_size);
+        // Sends bursts only while DREQ is high and returns as soon as it
+        // drops, so the caller can sleep instead of spinning on the FIFO.
+        // @return bytes sent, 0 if DREQ was already low
+        uint16_t SendReady(const uint8_t* buffer, uint16_t buffer_size);
 
         void setVolume(uint8_t vol);
         void setBass(uint8_t amplitude, uint8_t freq);
         void setTreble(uint8_t amplitude, uint8_t freq);
-        
+        // Posts a new SCI_CLOCKF value, applied at the next register flush
+        void setClock(uint16_t clockf);
+
 
         void sineTest(uint8_t frequency);
+
+        // SCI multiple write: XCS is held low and every word goes to the same
+        // register, e.g. kWRAM which auto-increments kWRAMADDR.
+        void sciWriteBurst(uint8_t address, const uint16_t* data, uint16_t count);
+        void sciFill(uint8_t address, uint16_t data, uint16_t count);
+
+        // Reads the current level (0-63) of up to max_bands spectrum analyzer
+        // bands. Spectrum analyzer plugin must be loaded first.
+        uint8_t readSpectrum(uint8_t* bands, uint8_t max_bands);
+
+        static constexpr uint8_t kSpectrumMaxBands = 23;
+        // SDI bytes the decoder always accepts once DREQ is high
+        static constexpr uint8_t kBurstSize = 32;
+        // SSP prescaler while CLKI is still XTALI, SCI writes must stay under XTALI / 4
+        static constexpr uint8_t kInitDivide = 48;
+        // Once CLOCKF is set. SCI reads are the slowest at CLKI / 7, and the
+        // clock controller never goes below 2.0x (24.576 MHz), so 28 (3.4 MHz)
+        // is safe for everything. Enough for CD quality PCM at 176.4 KB/s.
+        static constexpr uint8_t kStreamDivide = 28;
+        // Encoded words the recording buffer holds, HDAT1 never reads more
+        static constexpr uint16_t kRecordBufferWords = 1024;
+
+        // Stops the current stream mid-file: SM_CANCEL, then end fill bytes
+        // until the decoder drops it, soft reset if it never does. Needed
+        // before switching tracks mid-stream, as a cut short WAV would play
+        // the next track's bytes as samples.
+        // @return false if it took a soft reset
+        bool cancelPlayback();
+
+        // Ogg Vorbis recording through VLSI's encoder plugin. The plugin is
+        // loaded with PluginLoader between prepareRecording() and
+        // startRecording(). Nothing plays while recording, endRecording()
+        // soft resets back to playback, which also drops every plugin.
+        void prepareRecording();
+        // @param gain - 1024 is 1x, 0 lets the encoder's AGC choose
+        void startRecording(bool line_input, uint16_t gain);
+        // Encoded words ready to read, from SCI_HDAT1
+        uint16_t recordedWords();
+        // Reads count words from SCI_HDAT0, DREQ checked once for the batch.
+        // count must not be more than recordedWords() returned.
+        void readRecorded(uint16_t* words, uint16_t count);
+        // Asks the encoder to finish the stream, it keeps producing words
+        // until recordingDone()
+        void stopRecording();
+        // @return true once the encoder has written its last page, odd_byte
+        //         set if the last word read holds only one byte
+        bool recordingDone(bool* odd_byte);
+        void endRecording();
+
+        // Reads one SCI register
+        uint16_t readRegister(uint8_t address);
+        // Clocks bytes out with XCS and XDCS both high, the decoder ignores
+        // them. Used to measure raw SSP throughput.
+        void transferIdle(const uint8_t* buffer, uint16_t buffer_size);
+
+        // Reads the playback status registers back to back
+        void readStatus(uint16_t* decode_time, uint16_t* hdat0, uint16_t* hdat1, uint16_t* audata);
+
+        // Register mailbox. postRegister() only records the value, so it is
+        // safe to call from any task without the SPI bus. flushRegisters() is
+        // called by the SPI owner between SDI chunks and sends each posted
+        // register once, with only the last value posted since the previous
+        // flush, and skips it if the decoder already holds that value.
+        void postRegister(uint8_t address, uint16_t data);
+        uint8_t flushRegisters();
+
+        uint32_t getSciWrites() const { return sci_writes; }
+        uint32_t getSciWritesSaved() const { return sci_writes_skipped + posts_coalesced; }
+
+        static constexpr uint8_t kRegisterCount = 16;
     private:
         enum INSTRUCTION : uint8_t
         {
@@ -34,12 +131,56 @@ class VS1053 {
             kAUDATA     = 0x5,
             kWRAM       = 0x6,
             kWRAMADDR   = 0x7,
+            kHDAT0      = 0x8,
+            kHDAT1      = 0x9,
             kAIADDR     = 0xA,
-            kVOLUME     = 0xB
+            kVOLUME     = 0xB,
+            kAICTRL0    = 0xC,
+            kAICTRL1    = 0xD,
+            kAICTRL2    = 0xE,
+            kAICTRL3    = 0xF
         };
 
-        typedef union 
-        {   
+        enum SPECTRUM_WRAM : uint16_t
+        {
+            kSpectrumBandCount = 0x1802,
+            kSpectrumBands     = 0x1804
+        };
+
+        enum MODE_BITS : uint16_t
+        {
+            kSmReset    = (1 << 2),
+            kSmCancel   = (1 << 3),
+            kSmSdiNew   = (1 << 11),
+            kSmAdpcm    = (1 << 12),
+            kSmLine1    = (1 << 14)
+        };
+
+        enum RECORD_CONTROL : uint16_t
+        {
+            kRecordStop     = (1 << 0),     // AICTRL3, set by us
+            kRecordDone     = (1 << 1),     // AICTRL3, set by the encoder
+            kRecordOddByte  = (1 << 2)
+        };
+
+        // Extra parameter holding the byte to pad a stream with
+        static constexpr uint16_t kEndFillByte = 0x1E06;
+        // Datasheet limit for SM_CANCEL to clear before a reset is needed
+        static constexpr uint16_t kCancelLimit = 2048;
+        // New SDI mode with line in selected, what init() sets
+        static constexpr uint16_t kPlaybackMode = kSmSdiNew | kSmLine1;
+        // 3.0x, what init() and a soft reset set before the fast SSP clock
+        static constexpr uint16_t kInitClock = 0x6000;
+        // 4.5x, the encoder needs the full clock
+        static constexpr uint16_t kRecordClock = 0xC000;
+        // Plugin start address of the encoder application
+        static constexpr uint16_t kEncoderStart = 0x34;
+        // Interrupt enable register, only SCI stays on while the encoder loads
+        static constexpr uint16_t kIntEnable = 0xC01A;
+        static constexpr uint16_t kIntEnableSci = 0x0002;
+
+        typedef union
+        {
             uint16_t word;
             struct
             {
@@ -50,17 +191,529 @@ class VS1053 {
             }__attribute__((packed));
         } bassReg;
 
-        void readFile(char * song_name);
-       
+        void readFile(char * song_name, DeferredLog* log);
+
 
         uint16_t sciRead(uint8_t address);
         void sciWrite(uint8_t address, uint16_t data);
+        void wramRead(uint16_t address, uint16_t* data, uint16_t count);
+        // SM_RESET, then puts back what the reset cleared
+        void softReset(uint16_t mode);
+
+        // Registers whose writes have no side effect beyond storing the value,
+        // so a write equal to the shadow can be dropped
+        static constexpr uint16_t kCachedRegisters =
+            (1 << SCI_REG::kBASS) | (1 << SCI_REG::kCLOCKF) | (1 << SCI_REG::kVOLUME);
 
         bassReg bass_reg;
 
-        LabGPIO* XDCS; // Find SPI pin to use
-        LabGPIO* XCS; // Find SPI pin to use
-        LabGPIO* DREQ;
-        LabGPIO* RST;
-        LabSpi SPI; 
-};
\ No newline at end of file
+        uint16_t shadow[kRegisterCount];
+        uint16_t shadow_valid;
+        volatile uint16_t mailbox[kRegisterCount];
+        volatile bool mailbox_full[kRegisterCount];
+
+        uint32_t sci_writes;
+        uint32_t sci_writes_skipped;
+        uint32_t posts_coalesced;
+
+        DcsPin* XDCS; // Find SPI pin to use
+        CsPin* XCS; // Find SPI pin to use
+        DreqPin* DREQ;
+        ResetPin* RST;
+        SpiBus SPI;
+        LabSpi::SPI_Port spi_port;
+};
+
+// The driver the player has always used. Compiled once in VS1053.cpp.
+using VS1053 = BasicVs1053<LabSpi, LabGPIO, LabGPIO, LabGPIO>;
+extern template class BasicVs1053<LabSpi, LabGPIO, LabGPIO, LabGPIO>;
+
+#define VS1053_TEMPLATE template <class SpiBus, class CsPin, class DcsPin, class DreqPin, class ResetPin>
+#define VS1053_CLASS BasicVs1053<SpiBus, CsPin, DcsPin, DreqPin, ResetPin>
+
+VS1053_TEMPLATE
+VS1053_CLASS::BasicVs1053(DcsPin* xdcs, CsPin* xcs, ResetPin* rst, DreqPin* dreq, LabSpi::SPI_Port port)
+{
+    XDCS = xdcs;
+    XCS = xcs;
+    RST = rst;
+    DREQ = dreq;
+    spi_port = port;
+
+    bass_reg.word = 0;
+    shadow_valid = 0;
+    sci_writes = 0;
+    sci_writes_skipped = 0;
+    posts_coalesced = 0;
+    for(uint8_t i = 0; i < kRegisterCount; i++)
+    {
+        shadow[i] = 0;
+        mailbox[i] = 0;
+        mailbox_full[i] = false;
+    }
+}
+
+VS1053_TEMPLATE
+bool VS1053_CLASS::init()
+{
+    bool status;
+    if((XDCS == NULL) || (XCS == NULL) || (RST == NULL) || (DREQ == NULL))
+    {
+        status = false;
+    }
+    else
+    {
+        XDCS->SetAsOutput();
+        XCS->SetAsOutput();
+        RST->SetAsOutput();
+        DREQ->SetAsInput();
+
+        XDCS->SetHigh();
+        XCS->SetHigh();
+        RST->SetHigh();
+
+        SPI.Initialize(8, LabSpi::FrameModes::kSPI, kInitDivide, spi_port);
+        sciWrite(SCI_REG::kMODE, kPlaybackMode);
+        sciWrite(SCI_REG::kCLOCKF, kInitClock);
+        while(DREQ->ReadBool() != 1);   // Clock settles
+        SPI.SetDivider(kStreamDivide);
+
+        status = true;
+    }
+    return status;
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::sciWrite(uint8_t address, uint16_t data)
+{
+    uint16_t mask = 1 << address;
+    if((kCachedRegisters & mask) && (shadow_valid & mask) && shadow[address] == data)
+    {
+        sci_writes_skipped++;
+        return;
+    }
+    shadow[address] = data;
+    shadow_valid |= mask;
+    sci_writes++;
+
+    while(DREQ->ReadBool() != 1);
+    XCS->SetLow();
+    SPI.Transfer(kWrite);
+    SPI.Transfer(address);
+    SPI.Transfer(data >> 8);    // Send upper 8 bits
+    SPI.Transfer(data & 0xFF);  // Send lower 8 bits
+    XCS->SetHigh();
+}
+
+VS1053_TEMPLATE
+uint16_t VS1053_CLASS::sciRead(uint8_t address)
+{
+    uint16_t read_data;
+
+    while(DREQ->ReadBool() != 1);
+    XCS->SetLow();
+    SPI.Transfer(kRead);
+    SPI.Transfer(address);
+
+    read_data = SPI.Transfer(0xFF);
+    read_data = read_data << 8;
+    read_data |= SPI.Transfer(0xFF);
+    XCS->SetHigh();
+
+    return read_data;
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::sciWriteBurst(uint8_t address, const uint16_t* data, uint16_t count)
+{
+    while(DREQ->ReadBool() != 1);
+    XCS->SetLow();
+    SPI.Transfer(kWrite);
+    SPI.Transfer(address);
+    for(uint16_t i = 0; i < count; i++)
+    {
+        while(DREQ->ReadBool() != 1);
+        SPI.Transfer(data[i] >> 8);     // Send upper 8 bits
+        SPI.Transfer(data[i] & 0xFF);   // Send lower 8 bits
+    }
+    XCS->SetHigh();
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::sciFill(uint8_t address, uint16_t data, uint16_t count)
+{
+    while(DREQ->ReadBool() != 1);
+    XCS->SetLow();
+    SPI.Transfer(kWrite);
+    SPI.Transfer(address);
+    for(uint16_t i = 0; i < count; i++)
+    {
+        while(DREQ->ReadBool() != 1);
+        SPI.Transfer(data >> 8);        // Send upper 8 bits
+        SPI.Transfer(data & 0xFF);      // Send lower 8 bits
+    }
+    XCS->SetHigh();
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::wramRead(uint16_t address, uint16_t* data, uint16_t count)
+{
+    sciWrite(SCI_REG::kWRAMADDR, address);
+
+    // Reads do not drop DREQ, so only wait once for the whole batch.
+    // Every read of kWRAM advances kWRAMADDR by one.
+    while(DREQ->ReadBool() != 1);
+    for(uint16_t i = 0; i < count; i++)
+    {
+        XCS->SetLow();
+        SPI.Transfer(kRead);
+        SPI.Transfer(kWRAM);
+        data[i] = SPI.Transfer(0xFF) << 8;
+        data[i] |= SPI.Transfer(0xFF);
+        XCS->SetHigh();
+    }
+}
+
+VS1053_TEMPLATE
+uint8_t VS1053_CLASS::readSpectrum(uint8_t* bands, uint8_t max_bands)
+{
+    uint16_t words[kSpectrumMaxBands];
+    uint16_t band_count;
+
+    wramRead(kSpectrumBandCount, &band_count, 1);
+    if(band_count > kSpectrumMaxBands)
+    {
+        band_count = kSpectrumMaxBands;
+    }
+    if(band_count > max_bands)
+    {
+        band_count = max_bands;
+    }
+
+    wramRead(kSpectrumBands, words, band_count);
+    for(uint8_t i = 0; i < band_count; i++)
+    {
+        bands[i] = words[i] & 0x3F;     // Bits 5:0 hold the current level
+    }
+    return band_count;
+}
+
+VS1053_TEMPLATE
+uint16_t VS1053_CLASS::readRegister(uint8_t address)
+{
+    return sciRead(address);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::transferIdle(const uint8_t* buffer, uint16_t buffer_size)
+{
+    for(uint16_t i = 0; i < buffer_size; i++)
+    {
+        SPI.Transfer(buffer[i]);
+    }
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::readStatus(uint16_t* decode_time, uint16_t* hdat0, uint16_t* hdat1, uint16_t* audata)
+{
+    *decode_time = sciRead(SCI_REG::kDECODETIME);
+    *hdat0 = sciRead(SCI_REG::kHDAT0);
+    *hdat1 = sciRead(SCI_REG::kHDAT1);
+    *audata = sciRead(SCI_REG::kAUDATA);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::postRegister(uint8_t address, uint16_t data)
+{
+    if(mailbox_full[address])
+    {
+        posts_coalesced++;  // Previous value never reached the decoder
+    }
+    // Value first, flag second: a flush that races with this sees either the
+    // old value and flags it again, or the new one
+    mailbox[address] = data;
+    mailbox_full[address] = true;
+}
+
+VS1053_TEMPLATE
+uint8_t VS1053_CLASS::flushRegisters()
+{
+    uint8_t flushed = 0;
+    for(uint8_t address = 0; address < kRegisterCount; address++)
+    {
+        if(mailbox_full[address])
+        {
+            mailbox_full[address] = false;
+            sciWrite(address, mailbox[address]);
+            flushed++;
+        }
+    }
+    return flushed;
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::playSong(char * song_name, DeferredLog* log)
+{
+    readFile(song_name, log);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::readFile(char * song_name, DeferredLog* log)
+{
+    char full_song_path[100];
+    FIL file;
+    size_t file_size;
+    UINT bytes_read;
+
+    size_t total_read = 0;
+    bool read_file = false;
+    uint8_t buffer[512] = {0};
+
+    snprintf(full_song_path, sizeof(full_song_path), "/%s", song_name);
+    FRESULT result = f_open(&file, full_song_path, FA_READ);
+    file_size = f_size(&file);
+    // Formatted later by the log task, so only song_name (which lives in
+    // the caller's file table) may be passed as a string, not full_song_path
+    log->Log("song: %s f_open: %i file size: %u", song_name, result, file_size);
+
+    while(total_read < file_size)
+    {
+        if(!read_file)
+        {
+            f_read(&file, buffer, sizeof(buffer), &bytes_read);
+            // printf("total_read: %i bytes_read: %i\n", total_read, bytes_read);
+            total_read += bytes_read;
+            read_file = true;
+        }
+        if(DREQ->ReadBool())
+        {
+            SendData(buffer, sizeof(buffer));
+            read_file = false;
+        }
+    }
+    f_close(&file);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::SendData(uint8_t* buffer, uint16_t buffer_size)
+{
+    // printf("\nTrying to send\n");
+    while(!(DREQ->ReadBool()));
+    XDCS->SetLow();
+    for(uint16_t i = 0; i < buffer_size; i += kBurstSize)
+    {
+        // check DREQ every 32 bytes, then stream them through the FIFO
+        while(!(DREQ->ReadBool()));
+        SPI.Write(buffer + i, (buffer_size - i < kBurstSize) ? buffer_size - i : kBurstSize);
+    }
+    XDCS->SetHigh();
+}
+
+VS1053_TEMPLATE
+uint16_t VS1053_CLASS::SendReady(const uint8_t* buffer, uint16_t buffer_size)
+{
+    uint16_t sent = 0;
+    uint16_t burst;
+
+    if(!DREQ->ReadBool())
+    {
+        return 0;
+    }
+    XDCS->SetLow();
+    // DREQ high means room for at least one more burst
+    while(sent < buffer_size && DREQ->ReadBool())
+    {
+        burst = (buffer_size - sent < kBurstSize) ? buffer_size - sent : kBurstSize;
+        SPI.Write(buffer + sent, burst);
+        sent += burst;
+    }
+    XDCS->SetHigh();
+    return sent;
+}
+
+VS1053_TEMPLATE
+bool VS1053_CLASS::cancelPlayback()
+{
+    uint16_t end_fill;
+    uint8_t fill[kBurstSize];
+    uint16_t mode = shadow[SCI_REG::kMODE];
+
+    wramRead(kEndFillByte, &end_fill, 1);
+    memset(fill, end_fill & 0xFF, sizeof(fill));
+
+    sciWrite(SCI_REG::kMODE, mode | kSmCancel);
+    for(uint16_t sent = 0; sent < kCancelLimit; sent += sizeof(fill))
+    {
+        SendData(fill, sizeof(fill));
+        if(!(sciRead(SCI_REG::kMODE) & kSmCancel))
+        {
+            shadow[SCI_REG::kMODE] = mode;
+            return true;
+        }
+    }
+
+    // Stuck, soft reset
+    softReset(mode);
+    return false;
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::softReset(uint16_t mode)
+{
+    uint16_t clockf = shadow[SCI_REG::kCLOCKF];
+
+    // The reset puts CLKI back on XTALI, so the bus slows down until CLOCKF
+    // is set again, as in init()
+    SPI.SetDivider(kInitDivide);
+    sciWrite(SCI_REG::kMODE, mode | kSmReset);
+    sciWrite(SCI_REG::kMODE, mode);
+    shadow_valid = (1 << SCI_REG::kMODE);
+    sciWrite(SCI_REG::kCLOCKF, kInitClock);
+    while(DREQ->ReadBool() != 1);   // Clock settles
+    SPI.SetDivider(kStreamDivide);
+    sciWrite(SCI_REG::kCLOCKF, clockf);
+    sciWrite(SCI_REG::kVOLUME, shadow[SCI_REG::kVOLUME]);
+    sciWrite(SCI_REG::kBASS, shadow[SCI_REG::kBASS]);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::prepareRecording()
+{
+    uint16_t clockf = shadow[SCI_REG::kCLOCKF];
+    uint16_t bass = shadow[SCI_REG::kBASS];
+
+    // Playback's clock and tone stay in the shadow for endRecording()
+    sciWrite(SCI_REG::kCLOCKF, kRecordClock);
+    sciWrite(SCI_REG::kBASS, 0);
+    shadow[SCI_REG::kCLOCKF] = clockf;
+    shadow[SCI_REG::kBASS] = bass;
+    shadow_valid &= ~((1 << SCI_REG::kCLOCKF) | (1 << SCI_REG::kBASS));
+    sciWrite(SCI_REG::kAIADDR, 0);
+    sciWrite(SCI_REG::kWRAMADDR, kIntEnable);
+    sciWrite(SCI_REG::kWRAM, kIntEnableSci);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::startRecording(bool line_input, uint16_t gain)
+{
+    sciWrite(SCI_REG::kMODE, kSmSdiNew | kSmAdpcm | (line_input ? kSmLine1 : 0));
+    sciWrite(SCI_REG::kAICTRL1, gain);
+    sciWrite(SCI_REG::kAICTRL2, 0);     // AGC's own gain limit
+    sciWrite(SCI_REG::kAICTRL3, 0);
+    sciWrite(SCI_REG::kAIADDR, kEncoderStart);
+}
+
+VS1053_TEMPLATE
+uint16_t VS1053_CLASS::recordedWords()
+{
+    return sciRead(SCI_REG::kHDAT1);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::readRecorded(uint16_t* words, uint16_t count)
+{
+    // Same as wramRead(), every read of kHDAT0 takes the next word
+    while(DREQ->ReadBool() != 1);
+    for(uint16_t i = 0; i < count; i++)
+    {
+        XCS->SetLow();
+        SPI.Transfer(kRead);
+        SPI.Transfer(kHDAT0);
+        words[i] = SPI.Transfer(0xFF) << 8;
+        words[i] |= SPI.Transfer(0xFF);
+        XCS->SetHigh();
+    }
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::stopRecording()
+{
+    sciWrite(SCI_REG::kAICTRL3, kRecordStop);
+}
+
+VS1053_TEMPLATE
+bool VS1053_CLASS::recordingDone(bool* odd_byte)
+{
+    uint16_t control = sciRead(SCI_REG::kAICTRL3);
+    *odd_byte = (control & kRecordOddByte) != 0;
+    return (control & kRecordDone) != 0;
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::endRecording()
+{
+    softReset(kPlaybackMode);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::setVolume(uint8_t vol)
+{
+    uint16_t volume = (vol << 8) | vol;
+    postRegister(SCI_REG::kVOLUME, volume);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::setClock(uint16_t clockf)
+{
+    postRegister(SCI_REG::kCLOCKF, clockf);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::setTreble(uint8_t amplitude, uint8_t freq)
+{
+    bass_reg.treble_amp = amplitude;
+    bass_reg.treble_freq = freq;
+    postRegister(SCI_REG::kBASS, bass_reg.word);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::setBass(uint8_t amplitude, uint8_t freq)
+{
+    bass_reg.bass_amp = amplitude;
+    bass_reg.bass_freq = freq;
+    postRegister(SCI_REG::kBASS, bass_reg.word);
+}
+
+VS1053_TEMPLATE
+void VS1053_CLASS::sineTest(uint8_t frequency)
+{
+    XCS->SetLow();
+    SPI.Transfer(kWrite);
+    SPI.Transfer(kMODE);
+    SPI.Transfer(0x08);
+    SPI.Transfer(0x24);
+    XCS->SetHigh();
+
+    Delay(5);
+
+    while(!DREQ->ReadBool());
+
+    Delay(5);
+
+    XDCS->SetLow();
+    SPI.Transfer(0x53);
+    SPI.Transfer(0xef);
+    SPI.Transfer(0x6e);
+    SPI.Transfer(frequency);
+    SPI.Transfer(0x00);
+    SPI.Transfer(0x00);
+    SPI.Transfer(0x00);
+    SPI.Transfer(0x00);
+    XDCS->SetHigh();
+
+    Delay(2000);
+
+    XDCS->SetLow();
+    SPI.Transfer(0x45);
+    SPI.Transfer(0x78);
+    SPI.Transfer(0x69);
+    SPI.Transfer(0x74);
+    SPI.Transfer(0x00);
+    SPI.Transfer(0x00);
+    SPI.Transfer(0x00);
+    SPI.Transfer(0x00);
+    XDCS->SetHigh();
+}
+
+#undef VS1053_CLASS
+#undef VS1053_TEMPLATE
@@ -0,0 +1,147 @@
+#include "WavFile.hpp"
+
+#include <cstring>
+
+namespace
+{
+constexpr uint16_t kFormatPcm = 0x0001;
+constexpr uint16_t kFormatExtensible = 0xFFFE;
+// Enough of "fmt " for the extensible sub format
+constexpr uint16_t kFormatChunkMax = 26;
+
+uint16_t ReadLe16(const uint8_t * data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+uint32_t ReadLe32(const uint8_t * data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+void WriteLe16(uint8_t * data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+}
+
+void WriteLe32(uint8_t * data, uint32_t value)
+{
+    WriteLe16(data, value & 0xFFFF);
+    WriteLe16(data + 2, value >> 16);
+}
+
+bool ReadAt(FIL * file, uint32_t offset, uint8_t * buffer, UINT size)
+{
+    UINT bytes_read = 0;
+    return f_lseek(file, offset) == FR_OK &&
+           f_read(file, buffer, size, &bytes_read) == FR_OK &&
+           bytes_read == size;
+}
+}
+
+WavFile::Status WavFile::Parse(FIL * file, Format * format)
+{
+    uint8_t header[12];
+    uint8_t chunk[kFormatChunkMax];
+    uint32_t file_size = f_size(file);
+    uint32_t offset = sizeof(header);
+    bool have_format = false;
+
+    memset(format, 0, sizeof(*format));
+    if(!ReadAt(file, 0, header, sizeof(header)))
+    {
+        return Status::kReadError;
+    }
+    if(memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        return Status::kNotWav;
+    }
+
+    for(uint8_t i = 0; i < kMaxChunks && offset + 8 <= file_size; i++)
+    {
+        if(!ReadAt(file, offset, chunk, 8))
+        {
+            return Status::kReadError;
+        }
+        uint32_t size = ReadLe32(chunk + 4);
+        uint32_t body = offset + 8;
+
+        if(memcmp(chunk, "fmt ", 4) == 0)
+        {
+            UINT length = (size < kFormatChunkMax) ? size : kFormatChunkMax;
+            if(length < 16 || !ReadAt(file, body, chunk, length))
+            {
+                return Status::kReadError;
+            }
+            uint16_t tag = ReadLe16(chunk);
+            if(tag == kFormatExtensible && length >= kFormatChunkMax)
+            {
+                tag = ReadLe16(chunk + 24);     // First two bytes of the sub format GUID
+            }
+            format->channels = ReadLe16(chunk + 2);
+            format->sample_rate = ReadLe32(chunk + 4);
+            format->bits_per_sample = ReadLe16(chunk + 14);
+            if(tag != kFormatPcm || format->channels < 1 || format->channels > 2 ||
+               format->sample_rate == 0 || format->sample_rate > kMaxSampleRate ||
+               (format->bits_per_sample != 8 && format->bits_per_sample != 16))
+            {
+                return Status::kUnsupported;
+            }
+            have_format = true;
+        }
+        else if(memcmp(chunk, "data", 4) == 0)
+        {
+            if(!have_format)
+            {
+                return Status::kNoData;
+            }
+            // Recorders that never finished the file leave 0 or 0xFFFFFFFF here
+            uint32_t available = file_size - body;
+            format->data_offset = body;
+            format->data_size = (size == 0 || size > available) ? available : size;
+            format->data_size -= format->data_size % BlockAlign(*format);
+            return Status::kOk;
+        }
+
+        // Chunks are padded to an even length
+        offset = body + size + (size & 1);
+    }
+    return Status::kNoData;
+}
+
+uint16_t WavFile::WriteHeader(const Format & format, uint32_t data_size, uint8_t * buffer)
+{
+    memcpy(buffer, "RIFF", 4);
+    WriteLe32(buffer + 4, kHeaderSize - 8 + data_size);
+    memcpy(buffer + 8, "WAVEfmt ", 8);
+    WriteLe32(buffer + 16, 16);
+    WriteLe16(buffer + 20, kFormatPcm);
+    WriteLe16(buffer + 22, format.channels);
+    WriteLe32(buffer + 24, format.sample_rate);
+    WriteLe32(buffer + 28, ByteRate(format));
+    WriteLe16(buffer + 32, BlockAlign(format));
+    WriteLe16(buffer + 34, format.bits_per_sample);
+    memcpy(buffer + 36, "data", 4);
+    WriteLe32(buffer + 40, data_size);
+    return kHeaderSize;
+}
+
+bool WavFile::IsWavName(const char * name)
+{
+    const char * extension = strrchr(name, '.');
+    return extension && (strcmp(extension, ".wav") == 0 || strcmp(extension, ".WAV") == 0);
+}
+
+const char * WavFile::StatusToString(Status status)
+{
+    switch(status)
+    {
+        case Status::kOk:           return "ok";
+        case Status::kNotWav:       return "not a RIFF WAVE file";
+        case Status::kUnsupported:  return "not 8/16 bit PCM up to 48 kHz";
+        case Status::kNoData:       return "no sample data";
+        case Status::kReadError:    return "read error";
+        default:                    return "?";
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ff.h"
+
+// RIFF WAVE support for the SD reader.
+//
+// The VS1053 plays linear PCM itself, but only from a plain 44 byte header
+// followed by samples. Files off a PC often carry LIST/INFO or other chunks
+// before the samples, WAVE_FORMAT_EXTENSIBLE instead of plain PCM, or tags
+// after them. Parse() walks the chunks to the format and the sample data,
+// and the reader sends a rebuilt header with only the samples behind it.
+// Rebuilding it also lets playback start anywhere in the samples, e.g. when
+// resuming, with the header giving what is left.
+class WavFile
+{
+    public:
+        static constexpr uint16_t kHeaderSize = 44;
+        // VS1053 PCM limits
+        static constexpr uint32_t kMaxSampleRate = 48000;
+        static constexpr uint8_t kMaxChunks = 16;   // before giving up on finding "data"
+
+        enum class Status : uint8_t
+        {
+            kOk = 0,
+            kNotWav,            // no RIFF/WAVE header
+            kUnsupported,       // not 8/16 bit PCM, mono/stereo, up to 48 kHz
+            kNoData,            // no "data" chunk, or no "fmt " before it
+            kReadError
+        };
+
+        typedef struct
+        {
+            uint16_t channels;
+            uint16_t bits_per_sample;
+            uint32_t sample_rate;
+            uint32_t data_offset;       // file offset of the first sample
+            uint32_t data_size;         // 0 when the file is not WAV
+        } Format;
+
+        /// Finds the format and samples of an open file. Leaves the file
+        /// position anywhere, seek to data_offset before reading samples.
+        static Status Parse(FIL * file, Format * format);
+        /// Writes a canonical PCM header for data_size bytes of samples.
+        /// @return kHeaderSize
+        static uint16_t WriteHeader(const Format & format, uint32_t data_size, uint8_t * buffer);
+        /// @return true for a .wav or .WAV file name
+        static bool IsWavName(const char * name);
+        static const char * StatusToString(Status status);
+
+        static uint32_t ByteRate(const Format & format)
+        {
+            return format.sample_rate * BlockAlign(format);
+        }
+        static uint16_t BlockAlign(const Format & format)
+        {
+            return format.channels * (format.bits_per_sample / 8);
+        }
+};
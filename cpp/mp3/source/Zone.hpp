@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+#include <FreeRTOS.h>
+#include "queue.h"
+#include "semphr.h"
+
+#include "DecoderTelemetry.hpp"
+#include "ff.h"
+#include "LabGPIO.hpp"
+#include "VS1053.hpp"
+#include "WavFile.hpp"
+
+// SDI bytes per queue item, what the reader queues and the consumer sends
+constexpr uint16_t kZoneChunkSize = 512;
+
+// One decoder with everything it needs to play on its own. The shared SD
+// reader opens the zone's tracks and fills its queue, the zone's consumer
+// task empties the queue into the decoder.
+struct Zone
+{
+    VS1053* decoder;
+    LabGPIO* dreq;
+    SemaphoreHandle_t* bus;             // mutex of the SSP port the decoder is on
+    DecoderTelemetry* telemetry;
+    QueueHandle_t queue;
+    FIL file;
+    uint32_t file_size;                 // end of what the decoder gets, for WAV the end of the samples
+    uint32_t total_bytes_read;          // file offset of the next read
+    WavFile::Format wav;                // data_size is 0 for anything but WAV
+    bool wav_header;                    // next chunk starts with a rebuilt WAV header
+    volatile uint32_t bytes_sent;
+    uint8_t song_index;                 // the main zone mirrors the UI's song_index
+    volatile bool playing;
+    volatile bool changing;             // end of track, waiting for the next one
+    volatile bool skip;                 // 'zone <n> next', handled by the reader
+    volatile bool cancel;               // track changed mid-stream, the consumer cancels first
+    volatile uint8_t generation;        // bumped when the stream is cut, older reads are not queued
+    volatile bool streaming;            // fed from the serial stream, the SD reader skips its file
+    // Chunk the consumer took off the queue, sent a burst at a time while
+    // DREQ allows; all of it is sent when chunk_sent == chunk_length
+    uint8_t chunk[kZoneChunkSize];
+    uint16_t chunk_length;
+    uint16_t chunk_sent;
+};
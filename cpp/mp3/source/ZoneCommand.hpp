@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "L3_Application/commandline.hpp"
+#include "Zone.hpp"
+#include "ZoneScheduler.hpp"
+
+// "zone"                    per zone playback, SD share and underruns
+// "zone <n> play|pause"     starts or stops feeding one zone
+// "zone <n> next"           skips to the zone's next track
+// "zone <n> volume <0-254>" sets one zone's attenuation, 0 is loudest
+class ZoneCommand final : public Command
+{
+    public:
+        static constexpr const char kDescription[] =
+            "Multi-zone playback. Usage: zone [<n> play|pause|next|volume <v>]";
+
+        ZoneCommand(Zone* zone_table, ZoneScheduler* zone_scheduler)
+            : Command("zone", kDescription), zones(zone_table), scheduler(zone_scheduler)
+        {
+        }
+
+        int Program(int argc, const char * const argv[]) override
+        {
+            if(argc > 2)
+            {
+                uint8_t index = strtoul(argv[1], nullptr, 10);
+                if(index >= scheduler->GetZoneCount())
+                {
+                    printf("No zone %u, there are %u\n", index, scheduler->GetZoneCount());
+                    return 1;
+                }
+
+                Zone& zone = zones[index];
+                if(strcmp(argv[2], "play") == 0)
+                {
+                    zone.playing = true;
+                }
+                else if(strcmp(argv[2], "pause") == 0)
+                {
+                    zone.playing = false;
+                }
+                else if(strcmp(argv[2], "next") == 0)
+                {
+                    zone.skip = true;
+                }
+                else if(argc > 3 && strcmp(argv[2], "volume") == 0)
+                {
+                    // Only posted, the zone's consumer writes it between chunks
+                    zone.decoder->setVolume(strtoul(argv[3], nullptr, 10));
+                }
+            }
+
+            printf("Zone  Track  State    Bitrate  Underruns  SD Reads  Late  Least Slack\n");
+            for(uint8_t index = 0; index < scheduler->GetZoneCount(); index++)
+            {
+                Zone& zone = zones[index];
+                uint64_t slack = scheduler->GetMinSlack(index);
+                printf("%4u  %5u  %-7s  %7lu  %9lu  %8lu  %4lu  %8lu ms\n", index, zone.song_index,
+                       zone.playing ? "playing" : "paused", zone.telemetry->GetBitrate(),
+                       zone.telemetry->GetUnderruns(), scheduler->GetServed(index),
+                       scheduler->GetLate(index),
+                       (slack == UINT64_MAX) ? 0 : static_cast<uint32_t>(slack / 1000));
+            }
+            return 0;
+        }
+
+    private:
+        Zone* zones;
+        ZoneScheduler* scheduler;
+};
@@ -0,0 +1,349 @@
+#include "ZonePipeline.hpp"
+
+#include <project_config.hpp>
+
+#include <cstring>
+
+#include "utility/time.hpp"
+#include "WavFile.hpp"
+
+ZonePipeline::ZonePipeline(Zone* zone_table, uint8_t count, ZoneScheduler* zone_scheduler,
+                           SemaphoreHandle_t* card_mutex, uint8_t read_batch, SerialStream* serial_stream,
+                           const Hooks& pipeline_hooks, const Instruments& pipeline_instruments)
+{
+    zones = zone_table;
+    zone_count = count;
+    scheduler = zone_scheduler;
+    sd_mutex = card_mutex;
+    batch = read_batch;
+    stream = serial_stream;
+    hooks = pipeline_hooks;
+    instruments = pipeline_instruments;
+    first_audio = false;
+    dreq_high = false;
+}
+
+void ZonePipeline::Open(uint8_t zone, uint8_t index, const char * name)
+{
+    Zone& target = zones[zone];
+    WavFile::Status status;
+
+    // Cut short, the decoder is still inside the old stream
+    if(target.total_bytes_read < target.file_size)
+    {
+        Cut(zone);
+    }
+
+    f_close(&target.file);
+    f_open(&target.file, name, FA_READ);
+    target.file_size = f_size(&target.file);
+    target.total_bytes_read = 0;
+    target.wav.data_size = 0;
+    target.wav_header = false;
+    if(WavFile::IsWavName(name))
+    {
+        status = WavFile::Parse(&target.file, &target.wav);
+        if(status == WavFile::Status::kOk)
+        {
+            // Only the samples are read, behind a rebuilt header
+            target.file_size = target.wav.data_offset + target.wav.data_size;
+            target.total_bytes_read = target.wav.data_offset;
+            target.wav_header = true;
+            if(zone == kMainZone)
+            {
+                instruments.dsp->SetFormat(target.wav.sample_rate, target.wav.channels);
+            }
+        }
+        else
+        {
+            instruments.log->Log("Skipping WAV track %u: %s", index, WavFile::StatusToString(status));
+            target.total_bytes_read = target.file_size;
+        }
+        f_lseek(&target.file, target.total_bytes_read);
+    }
+    target.song_index = index;
+    target.changing = false;
+    hooks.wake_reader();
+}
+
+void ZonePipeline::Cut(uint8_t zone)
+{
+    Zone& target = zones[zone];
+
+    // The queue is the consumer's to drop: it may already hold a chunk
+    // taken off it, and the reader cannot queue past the new generation
+    target.generation++;
+    target.cancel = true;
+}
+
+uint32_t ZonePipeline::ZonesWithRoom() const
+{
+    uint32_t room = 0;
+
+    for(uint8_t zone = 0; zone < zone_count; zone++)
+    {
+        Zone& target = zones[zone];
+        if(target.playing && !target.changing && !target.streaming && !target.cancel && target.file_size &&
+           (target.skip || uxQueueSpacesAvailable(target.queue) >= batch))
+        {
+            room |= (1 << zone);
+        }
+    }
+    return room;
+}
+
+bool ZonePipeline::Read(uint8_t * buffer)
+{
+    TraceBuffer& ring = *instruments.trace;
+    UINT bytes_read = 0;
+    uint16_t header = 0;
+    uint16_t length;
+    uint32_t to_read;
+    uint8_t zone;
+
+    zone = scheduler->Next(ZonesWithRoom(), Uptime());
+    if(zone == ZoneScheduler::kNoZone)
+    {
+        return false;
+    }
+
+    Zone& target = zones[zone];
+    uint8_t generation = target.generation;
+    if(target.skip || target.total_bytes_read >= target.file_size)
+    {
+        // A skip that could not start stays set for the next try
+        if(!hooks.next_song(zone))
+        {
+            return false;
+        }
+        target.skip = false;
+        return true;
+    }
+
+    ring.Record(trace::kMutexWait, trace::kSdMutex);
+    if(xSemaphoreTake(*sd_mutex, portMAX_DELAY))
+    {
+        // Cut since it was picked, the consumer drops the queue first
+        if(target.cancel)
+        {
+            xSemaphoreGive(*sd_mutex);
+            return true;
+        }
+        generation = target.generation;
+        if(target.wav_header)
+        {
+            header = WavFile::WriteHeader(target.wav, target.file_size - target.total_bytes_read, buffer);
+            target.wav_header = false;
+        }
+        to_read = uxQueueSpacesAvailable(target.queue) * kChunkSize - header;
+        if(to_read > target.file_size - target.total_bytes_read)
+        {
+            to_read = target.file_size - target.total_bytes_read;
+        }
+
+        ring.Record(trace::kMutexAcquired, trace::kSdMutex);
+        ring.Record(trace::kSdReadStart, to_read);
+        f_read(&target.file, &buffer[header], to_read, &bytes_read);
+        ring.Record(trace::kSdReadEnd, bytes_read);
+        target.total_bytes_read += bytes_read;
+        if(bytes_read == 0)
+        {
+            target.total_bytes_read = target.file_size;     // Read error, move on
+        }
+        hooks.card_read(zone);
+        xSemaphoreGive(*sd_mutex);
+    }
+
+#if MP3_PCM_DSP
+    // Outside SD_MUTEX, the card is free while the samples are filtered
+    if(zone == kMainZone && target.wav.data_size && target.wav.bits_per_sample == 16)
+    {
+        instruments.dsp->Process(reinterpret_cast<int16_t*>(&buffer[header]),
+                                 bytes_read / WavFile::BlockAlign(target.wav));
+    }
+#endif
+
+    // Zero padded to whole chunks, the decoder skips past a WAV's data
+    // size and resyncs after an MP3's last frame
+    length = header + bytes_read;
+    if(length % kChunkSize)
+    {
+        memset(&buffer[length], 0, kChunkSize - length % kChunkSize);
+    }
+    // Queued under SD_MUTEX like Cut(), so a read from before a cut is
+    // dropped here and never reaches the new track's queue. Next() only
+    // picks zones with room, so this never blocks.
+    if(xSemaphoreTake(*sd_mutex, portMAX_DELAY))
+    {
+        for(uint16_t offset = 0; target.generation == generation && offset < length; offset += kChunkSize)
+        {
+            xQueueSend(target.queue, &buffer[offset], 0);
+            scheduler->Queued(zone, kChunkSize);
+            ring.Record(trace::kChunkQueued, (zone << 8) | target.song_index);
+        }
+        xSemaphoreGive(*sd_mutex);
+    }
+    return true;
+}
+
+void ZonePipeline::PumpStream(uint8_t * buffer, uint32_t now_ms)
+{
+    Zone& target = zones[kMainZone];
+    uint8_t tokens[SerialStream::kWindowCredits + 1];
+    uint8_t count;
+    uint16_t length;
+    bool ended;
+
+    stream->Poll(now_ms);
+    // Padding mid-stream would play zeros between the sender's bytes, so a
+    // partial chunk stays in the ring until the stream has ended
+    ended = stream->GetIdleMs(now_ms) >= kStreamEndMs;
+    // Under SD_MUTEX like Cut(), so no chunk of a stopped stream follows it
+    if(xSemaphoreTake(*sd_mutex, portMAX_DELAY))
+    {
+        while(target.playing && !target.cancel && stream->IsActive() && uxQueueSpacesAvailable(target.queue) &&
+              (stream->Available() >= kChunkSize || (ended && stream->Available())))
+        {
+            length = stream->Read(buffer, kChunkSize);
+            memset(&buffer[length], 0, kChunkSize - length);
+            xQueueSend(target.queue, buffer, 0);
+            instruments.trace->Record(trace::kChunkQueued, (kMainZone << 8) | target.song_index);
+        }
+        xSemaphoreGive(*sd_mutex);
+    }
+
+    count = stream->TakeTokens(tokens, sizeof(tokens));
+    for(uint8_t i = 0; i < count; i++)
+    {
+        hooks.send_token(tokens[i]);
+    }
+}
+
+bool ZonePipeline::HasWork(uint8_t index) const
+{
+    const Zone& zone = zones[index];
+    return zone.cancel || zone.chunk_sent < zone.chunk_length || uxQueueMessagesWaiting(zone.queue) != 0;
+}
+
+ZonePipeline::Pass ZonePipeline::Consume(uint8_t index, TickType_t wait)
+{
+    Zone& zone = zones[index];
+    bool main = (index == kMainZone);
+    TraceBuffer& ring = *instruments.trace;
+    bool dreq;
+    bool queued;
+    Pass pass = Pass::kDecoderFull;
+    uint32_t underruns;
+
+    dreq = zone.dreq->ReadBool();
+    queued = zone.chunk_sent < zone.chunk_length || uxQueueMessagesWaiting(zone.queue) != 0;
+
+    // Decoder asking for data with nothing buffered is an underrun
+    underruns = zone.telemetry->GetUnderruns();
+    zone.telemetry->RecordStarvation(zone.playing && !queued && dreq);
+
+    if(main)
+    {
+        instruments.dreq_latency->Sample(dreq, zone.playing, Uptime());
+        // Once per rise, a DREQ that stays high is one request
+        if(dreq && !dreq_high)
+        {
+            ring.Record(trace::kDreqHigh, uxQueueMessagesWaiting(zone.queue));
+        }
+        dreq_high = dreq;
+        if(zone.telemetry->GetUnderruns() != underruns)
+        {
+            ring.Record(trace::kUnderrun, zone.telemetry->GetUnderruns());
+        }
+        instruments.clock->RecordDreq(dreq, queued);
+    }
+
+    // Cut: everything held or queued is the old stream's. Cleared last,
+    // the reader only fills the queue again once it is empty.
+    if(zone.cancel)
+    {
+        zone.chunk_sent = zone.chunk_length;
+        xQueueReset(zone.queue);
+        scheduler->Reset(index);
+        if(xSemaphoreTake(*zone.bus, portMAX_DELAY))
+        {
+            zone.decoder->cancelPlayback();
+            xSemaphoreGive(*zone.bus);
+        }
+        zone.cancel = false;
+        hooks.wake_reader();
+        return Pass::kSent;
+    }
+
+    if(zone.chunk_sent == zone.chunk_length)
+    {
+        if(!xQueueReceive(zone.queue, zone.chunk, wait))
+        {
+            if(xSemaphoreTake(*zone.bus, portMAX_DELAY))
+            {
+                // Paused or starved, still apply settings
+                if(zone.decoder->flushRegisters() && main)
+                {
+                    instruments.press->Flushed(Uptime());
+                }
+                xSemaphoreGive(*zone.bus);
+            }
+            return Pass::kIdle;
+        }
+        zone.chunk_length = kChunkSize;
+        zone.chunk_sent = 0;
+
+        // Room for another chunk, wake the reader
+        scheduler->Consumed(index, kChunkSize, Uptime());
+        hooks.wake_reader();
+    }
+
+    if(main)
+    {
+        ring.Record(trace::kMutexWait, trace::kSpiMutex);
+    }
+    if(xSemaphoreTake(*zone.bus, portMAX_DELAY))
+    {
+        if(main)
+        {
+            ring.Record(trace::kMutexAcquired, trace::kSpiMutex);
+        }
+        if(zone.chunk_sent < zone.chunk_length)
+        {
+            if(main)
+            {
+                instruments.dreq_latency->ServiceStart(Uptime());
+            }
+            // Never waits on DREQ, a full decoder hands the CPU back with
+            // the bus free
+            zone.chunk_sent += zone.decoder->SendReady(&zone.chunk[zone.chunk_sent],
+                                                       zone.chunk_length - zone.chunk_sent);
+            if(main)
+            {
+                instruments.dreq_latency->ServiceEnd();
+            }
+        }
+        if(zone.chunk_sent == zone.chunk_length)
+        {
+            zone.bytes_sent += zone.chunk_length;
+            pass = Pass::kSent;
+            if(main)
+            {
+                ring.Record(trace::kChunkSent, zone.chunk_length);
+                if(!first_audio)
+                {
+                    first_audio = true;
+                    hooks.first_audio();
+                }
+            }
+        }
+        // Posted settings go out in the gaps, an SCI write waits for DREQ
+        // too so only when it is high
+        if(zone.dreq->ReadBool() && zone.decoder->flushRegisters() && main)
+        {
+            instruments.press->Flushed(Uptime());
+        }
+        xSemaphoreGive(*zone.bus);
+    }
+    return pass;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+
+#include <FreeRTOS.h>
+#include "queue.h"
+#include "semphr.h"
+
+#include "ClockController.hpp"
+#include "DeferredLog.hpp"
+#include "DreqLatency.hpp"
+#include "PcmDsp.hpp"
+#include "PressLatency.hpp"
+#include "SerialStream.hpp"
+#include "TraceBuffer.hpp"
+#include "Zone.hpp"
+#include "ZoneScheduler.hpp"
+
+// The audio path of the player: the one SD reader that fills every zone's
+// queue, and the consumer that empties a zone's queue into its decoder.
+//
+// Every call is one pass of a task's loop. A pass only blocks on a mutex or
+// for the wait it is given, the sleeps between passes are the caller's.
+// vDecoderProducerTask and vDecoderConsumerTask in main.cpp are these
+// passes in a loop; the host benches run the same passes from a simulated
+// scheduler, so what they measure is this code.
+//
+// The main zone is the one the display and the remote follow. The DREQ
+// latency, clock control, press latency, trace and PCM DSP only see it.
+class ZonePipeline
+{
+    public:
+        static constexpr uint16_t kChunkSize = kZoneChunkSize;
+        static constexpr uint8_t kMainZone = 0;
+        // Nothing arriving for this long is the end of the stream, and only
+        // then is its tail queued as a zero padded chunk. A sender's pause
+        // is shorter, its partial chunk waits for the rest.
+        static constexpr uint32_t kStreamEndMs = 500;
+
+        // How a consumer pass ended
+        enum class Pass : uint8_t
+        {
+            kSent = 0,          // the rest of a chunk went to the decoder
+            kDecoderFull,       // DREQ dropped first, the chunk is part sent
+            kIdle               // nothing queued within the wait
+        };
+
+        // What the pipeline leaves to the rest of the player, every one set
+        struct Hooks
+        {
+            // A zone is at the end of its track or was asked to skip,
+            // false if the change could not be started and the reader
+            // should try again later
+            bool (*next_song)(uint8_t zone);
+            // After every card read, SD_MUTEX still held
+            void (*card_read)(uint8_t zone);
+            // The main zone's first chunk went to its decoder
+            void (*first_audio)();
+            // A chunk was taken or a track opened, the reader has work
+            void (*wake_reader)();
+            // A flow control token owed to the stream's sender
+            void (*send_token)(uint8_t token);
+        };
+
+        struct Instruments
+        {
+            TraceBuffer* trace;
+            DreqLatency* dreq_latency;
+            ClockController* clock;
+            PressLatency* press;
+            PcmDsp* dsp;
+            DeferredLog* log;
+        };
+
+        /// @param read_batch - free slots a zone's queue needs before the
+        ///                     reader picks it, so every f_read covers
+        ///                     several chunks
+        ZonePipeline(Zone* zone_table, uint8_t count, ZoneScheduler* zone_scheduler,
+                     SemaphoreHandle_t* card_mutex, uint8_t read_batch, SerialStream* serial_stream,
+                     const Hooks& pipeline_hooks, const Instruments& pipeline_instruments);
+
+        /// Opens a track for the reader to feed a zone. A track cut short is
+        /// cut first, as by Cut(). Caller must hold SD_MUTEX.
+        void Open(uint8_t zone, uint8_t index, const char * name);
+        /// Ends the stream a zone's decoder is in. The consumer drops the
+        /// chunk it holds and everything queued, then cancels the decoder;
+        /// until it has, the reader leaves the zone alone and a read that
+        /// was under way is not queued. Caller must hold SD_MUTEX.
+        void Cut(uint8_t zone);
+
+        /// One pass of the SD reader: picks the zone whose audio runs out
+        /// first among those with room and fills every free slot of its
+        /// queue in one f_read, or moves it to its next track.
+        ///
+        /// @param buffer - room for a full queue, int16_t aligned for the DSP
+        /// @return false if no zone had anything to read, the reader sleeps
+        ///         until a consumer wakes it
+        bool Read(uint8_t * buffer);
+        /// The main zone's serial stream in place of its card reads: whole
+        /// chunks go to the queue while it has room, a partial one only after
+        /// kStreamEndMs of quiet, and the credits they earn go back to the
+        /// sender. A full queue holds the credits back, which is what paces
+        /// the sender.
+        ///
+        /// @param buffer - room for one chunk
+        void PumpStream(uint8_t * buffer, uint32_t now_ms);
+        /// One pass of a zone's consumer: as much of the next chunk as the
+        /// decoder takes without waiting on DREQ, then any posted register
+        /// writes. A cut stream is cancelled instead, and without a chunk
+        /// the registers still go out.
+        ///
+        /// @param wait - ticks to wait for a chunk
+        /// @return kDecoderFull when the consumer should sleep before the
+        ///         next pass rather than poll DREQ
+        Pass Consume(uint8_t zone, TickType_t wait);
+        /// @return true if a zone's consumer has a chunk queued or part
+        ///         sent, or a cut stream to cancel
+        bool HasWork(uint8_t zone) const;
+
+        /// @return bit per zone the reader can do something for: playing
+        ///         from the card, a track open, no cut pending and
+        ///         read_batch free slots in the queue, or a skip to handle
+        uint32_t ZonesWithRoom() const;
+
+    private:
+        Zone* zones;
+        uint8_t zone_count;
+        ZoneScheduler* scheduler;
+        SemaphoreHandle_t* sd_mutex;
+        uint8_t batch;
+        SerialStream* stream;
+        Hooks hooks;
+        Instruments instruments;
+        bool first_audio;
+        // The main zone's DREQ at the consumer's last poll
+        bool dreq_high;
+};
@@ -0,0 +1,140 @@
+#include "ZoneScheduler.hpp"
+
+#include <cstring>
+
+#include <FreeRTOS.h>
+#include "task.h"
+
+ZoneScheduler::ZoneScheduler(uint8_t count)
+{
+    zone_count = (count > kMaxZones) ? kMaxZones : count;
+    policy = Policy::kEarliestDeadline;
+    last_served = zone_count - 1;
+
+    memset(zones, 0, sizeof(zones));
+    for(uint8_t zone = 0; zone < kMaxZones; zone++)
+    {
+        zones[zone].byte_rate = kDefaultByteRate;
+        zones[zone].min_slack = UINT64_MAX;
+    }
+}
+
+void ZoneScheduler::SetByteRate(uint8_t zone, uint32_t bytes_per_second)
+{
+    if(zone < zone_count && bytes_per_second)
+    {
+        zones[zone].byte_rate = bytes_per_second;
+    }
+}
+
+uint64_t ZoneScheduler::ToTime(uint8_t zone, uint32_t bytes) const
+{
+    return bytes * 1000000ULL / zones[zone].byte_rate;
+}
+
+uint64_t ZoneScheduler::Deadline(uint8_t zone, uint64_t now) const
+{
+    const State& state = zones[zone];
+    uint64_t played_until = (state.played_until > now) ? state.played_until : now;
+    return played_until + state.queued_time;
+}
+
+uint64_t ZoneScheduler::GetSlack(uint8_t zone, uint64_t now) const
+{
+    taskENTER_CRITICAL();
+    uint64_t slack = Deadline(zone, now) - now;
+    taskEXIT_CRITICAL();
+    return slack;
+}
+
+uint64_t ZoneScheduler::GetMinSlack(uint8_t zone) const
+{
+    taskENTER_CRITICAL();
+    uint64_t slack = zones[zone].min_slack;
+    taskEXIT_CRITICAL();
+    return slack;
+}
+
+uint8_t ZoneScheduler::Next(uint32_t room, uint64_t now)
+{
+    uint8_t next = kNoZone;
+    uint64_t earliest = UINT64_MAX;
+
+    taskENTER_CRITICAL();
+    // Start after the zone served last so equal deadlines take turns
+    for(uint8_t i = 1; i <= zone_count; i++)
+    {
+        uint8_t zone = (last_served + i) % zone_count;
+        if(!(room & (1 << zone)))
+        {
+            continue;
+        }
+        if(policy == Policy::kRoundRobin)
+        {
+            next = zone;
+            break;
+        }
+        uint64_t deadline = Deadline(zone, now);
+        if(deadline < earliest)
+        {
+            earliest = deadline;
+            next = zone;
+        }
+    }
+    if(next == kNoZone)
+    {
+        taskEXIT_CRITICAL();
+        return kNoZone;
+    }
+
+    // A zone that has not played since its last reset has nothing to miss
+    State& state = zones[next];
+    if(state.played_until)
+    {
+        uint64_t slack = Deadline(next, now) - now;
+        if(slack == 0)
+        {
+            state.late++;
+        }
+        if(slack < state.min_slack)
+        {
+            state.min_slack = slack;
+        }
+    }
+    state.served++;
+    last_served = next;
+    taskEXIT_CRITICAL();
+    return next;
+}
+
+void ZoneScheduler::Queued(uint8_t zone, uint32_t bytes)
+{
+    uint64_t time = ToTime(zone, bytes);
+
+    taskENTER_CRITICAL();
+    zones[zone].queued_time += time;
+    taskEXIT_CRITICAL();
+}
+
+void ZoneScheduler::Consumed(uint8_t zone, uint32_t bytes, uint64_t now)
+{
+    State& state = zones[zone];
+    uint64_t time = ToTime(zone, bytes);
+
+    taskENTER_CRITICAL();
+    state.queued_time = (state.queued_time > time) ? state.queued_time - time : 0;
+    if(state.played_until < now)
+    {
+        state.played_until = now;
+    }
+    state.played_until += time;
+    taskEXIT_CRITICAL();
+}
+
+void ZoneScheduler::Reset(uint8_t zone)
+{
+    taskENTER_CRITICAL();
+    zones[zone].played_until = 0;
+    zones[zone].queued_time = 0;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+// Decides which zone the shared SD reader fills next.
+//
+// Every zone has a deadline: the time its decoder runs out of audio if the
+// reader never comes back to it. That is the audio already handed to the
+// decoder plus what is waiting in the zone's queue, both converted to time
+// at the zone's byte rate. Next() serves the zone with the earliest
+// deadline among those that have room for another chunk, so a 320 kbps
+// zone is read more often than a 128 kbps one and neither waits behind the
+// other for a full round. Nothing here touches the card, the reader and
+// consumers report what they did. They do so from different tasks, and
+// the 64-bit times take two loads or stores on the Cortex-M4, so every
+// call that touches them runs in a critical section.
+class ZoneScheduler
+{
+    public:
+        static constexpr uint8_t kMaxZones = 4;
+        static constexpr uint8_t kNoZone = 0xFF;
+        // 128 kbps until a zone's real bitrate is known
+        static constexpr uint32_t kDefaultByteRate = 16000;
+
+        enum class Policy : uint8_t
+        {
+            kEarliestDeadline = 0,
+            kRoundRobin             // for comparison in the host bench
+        };
+
+        explicit ZoneScheduler(uint8_t zone_count);
+
+        /// @param bytes_per_second - stream rate, 0 keeps the current rate
+        void SetByteRate(uint8_t zone, uint32_t bytes_per_second);
+        void SetPolicy(Policy new_policy) { policy = new_policy; }
+
+        /// Picks the zone to read for.
+        ///
+        /// @param room - bit per zone that can take a chunk now (queue not
+        ///               full, playing, a track open)
+        /// @param now  - Uptime() in microseconds
+        /// @return zone index, kNoZone if no zone has room
+        uint8_t Next(uint32_t room, uint64_t now);
+        /// The reader queued a chunk for a zone.
+        void Queued(uint8_t zone, uint32_t bytes);
+        /// A zone's consumer handed a chunk to its decoder.
+        void Consumed(uint8_t zone, uint32_t bytes, uint64_t now);
+        /// Forgets a zone's buffered audio, e.g. after a track change or pause.
+        void Reset(uint8_t zone);
+
+        /// @return microseconds of audio a zone has left at now, 0 if it is
+        ///         already past its deadline
+        uint64_t GetSlack(uint8_t zone, uint64_t now) const;
+        uint8_t GetZoneCount() const { return zone_count; }
+        uint32_t GetByteRate(uint8_t zone) const { return zones[zone].byte_rate; }
+        uint32_t GetServed(uint8_t zone) const { return zones[zone].served; }
+        /// @return reads that started after the zone's deadline had passed
+        uint32_t GetLate(uint8_t zone) const { return zones[zone].late; }
+        /// @return least slack seen when a zone was served, in microseconds
+        uint64_t GetMinSlack(uint8_t zone) const;
+
+    private:
+        struct State
+        {
+            uint32_t byte_rate;
+            uint64_t played_until;      // decoder runs dry here without more data
+            uint64_t queued_time;       // audio waiting in the queue, microseconds
+            uint32_t served;
+            uint32_t late;
+            uint64_t min_slack;
+        };
+
+        uint64_t ToTime(uint8_t zone, uint32_t bytes) const;
+        // Unlocked, the caller holds the critical section
+        uint64_t Deadline(uint8_t zone, uint64_t now) const;
+
+        uint8_t zone_count;
+        Policy policy;
+        uint8_t last_served;
+        State zones[kMaxZones];
+};
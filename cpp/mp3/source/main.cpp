@@ -2,17 +2,45 @@
 #include <FreeRTOS.h>
 
 #include "../../library/third_party/fatfs/source/ff.h"
+#include "BenchCommand.hpp"
 #include "event_groups.h"
 #include "L0_LowLevel/interrupt.hpp"
 #include "L3_Application/commandline.hpp"
 #include "L3_Application/commands/common.hpp"
 #include "L3_Application/commands/lpc_system_command.hpp"
 #include "L3_Application/commands/rtos_command.hpp"
-#include "L3_Application/oled_terminal.hpp"
+#include "ClockController.hpp"
+#include "CpuProfiler.hpp"
+#include "DecoderTelemetry.hpp"
+#include "DreqCommand.hpp"
+#include "DreqLatency.hpp"
+#include "DspCommand.hpp"
+#include "DeferredLog.hpp"
 #include "LabGPIO.hpp"
+#include "LabUart.hpp"
+#include "LogCommand.hpp"
+#include "OledPanel.hpp"
+#include "PcmDsp.hpp"
+#include "PluginLoader.hpp"
+#include "PressCommand.hpp"
+#include "PressLatency.hpp"
+#include "ProfileCommand.hpp"
 #include "queue.h"
+#include "RecordCommand.hpp"
+#include "RecordWriter.hpp"
+#include "ResumeCommand.hpp"
+#include "ResumeJournal.hpp"
 #include "semphr.h"
+#include "SerialStream.hpp"
+#include "StatsCommand.hpp"
+#include "StreamCommand.hpp"
+#include "TraceBuffer.hpp"
+#include "TraceCommand.hpp"
 #include "task.h"
+#include "TrackLibrary.hpp"
+#include "UploadCommand.hpp"
+#include "UiStats.hpp"
+#include "UploadReceiver.hpp"
 #include "third_party/fatfs/source/ff.h"
 #include "third_party/FreeRTOS/Source/include/semphr.h"
 #include "third_party/FreeRTOS/Source/include/task.h"
@@ -20,11 +48,54 @@
 #include "utility/rtos.hpp"
 #include "utility/time.hpp"
 #include "VS1053.hpp"
+#include "WavFile.hpp"
+#include "Zone.hpp"
+#include "ZoneCommand.hpp"
+#include "ZonePipeline.hpp"
+#include "ZoneScheduler.hpp"
 #include <cinttypes>
 #include <iterator>
 
 
-const uint32_t STACK_SIZE = 512;
+const uint32_t kMaxFramesPerSecond = 20;
+const uint32_t kSpectrumFramesPerSecond = 10;
+const uint32_t kTelemetryPeriodMs = 1000;
+// Longest a posted volume/tone change waits for the consumer when no audio is flowing
+const uint32_t kRegisterFlushTimeoutMs = 20;
+// Longest the SD reader sleeps with every zone full or paused. Consumers
+// wake it as soon as they take a chunk, this only bounds a missed wakeup.
+const uint32_t kReaderIdleMs = 20;
+// Consumer sleep once its decoder's FIFO is full. At CD quality PCM the
+// FIFO still holds over 10 ms, so a tick is never an underrun.
+const uint32_t kDecoderFullMs = 1;
+// Plugin words per SPI_MUTEX hold, keeps each slice well under one 512 byte
+// chunk of playback so the consumer never starves while a plugin loads
+const uint16_t kPluginWordsPerSlice = 256;
+// How often the log task drains the deferred log, and the longest a
+// partial sector of LOG.TXT is held before it is written out padded
+const uint32_t kLogPeriodMs = 50;
+const uint32_t kLogSdFlushMs = 1000;
+const uint16_t kLogSectorSize = 512;
+// Longest the profiler waits for the producer to finish an SD read before
+// writing a CPU.TXT sector anyway (the producer reads at most every 45 ms)
+const uint32_t kProfilerWindowWaitMs = 100;
+// How often the consumer looks at the encoder's level while recording. At
+// 200 kbps that is 125 words, inside the encoder's margin over kHighWater.
+const uint32_t kRecordPollMs = 10;
+// Longest the encoder gets to write its last page after a stop, the
+// recording is then ended with what was read
+const uint32_t kRecordStopTimeoutMs = 1000;
+// VLSI's Ogg Vorbis encoder profile, converted to .bin like spectrum.bin
+const char kEncoderPlugin[] = "encoder.bin";
+// Serial stream line rate, 92 KB/s, a 320 kbps MP3 twice over. 96 MHz / 16
+// / (4 * 1.625) is 923077, 0.16% fast.
+const uint32_t kStreamBaud = 921600;
+// Longest the terminal task sleeps during an upload when no frame ends, it
+// still has buffers to write and replies to send
+const uint32_t kUploadPollMs = 5;
+// An upload gives up after this long without a frame, the first one
+// included, which leaves time to start the host side
+const uint32_t kUploadTimeoutMs = 20000;
 #define START_TIME 0
 #define END_TIME 1
 
@@ -35,27 +106,17 @@ const uint32_t STACK_SIZE = 512;
 
 
 // --------------- S T R U C T S ------------------------
-typedef union
-{
-    uint8_t buffer[128];
-    struct 
-    {
-        uint8_t header[3];
-        uint8_t title[30];
-        uint8_t artist[30];
-        uint8_t album[30];
-        uint8_t year[4];
-        uint8_t comment[28];
-        uint8_t zero;
-        uint8_t track;
-        uint8_t genre;
-    } __attribute__((packed));
-} ID3v1_t;
-
 typedef struct SettingsCommand
 {
     uint8_t type;
     uint8_t value;
+    uint8_t press;      // PressLatency id, kNoPress if not from the remote
+};
+
+struct RemotePress
+{
+    uint16_t opcode;
+    uint8_t press;      // PressLatency id
 };
 
 
@@ -65,6 +126,7 @@ enum Menu
     kSongInfo = 0,
     kSongList,
     kSettings,
+    kSpectrum,
     kMenuMaxSize
 };
 
@@ -73,7 +135,8 @@ enum CommandValues
     kVolumeCommand = 0,
     kTrebleCommand,
     kBassCommand,
-    kSongCommand
+    kSongCommand,
+    kSaveCommand        // force a resume journal save, e.g. on pause
 };
 
 enum Constants
@@ -115,13 +178,25 @@ LabGPIO IR(0, 18);
 LabGPIO BUTTON1(0, 18);
 LabGPIO BUTTON2(0, 15);
 
+// What readIR_ISR() keeps between edges of the remote's signal
+struct IrDecoder
+{
+    uint8_t sample;             // bits of the opcode so far
+    uint16_t opcode;
+    uint32_t start_time;        // Uptime() of the last rising edge
+    uint16_t prev_opcode;
+    uint64_t prev_sent_time;
+};
+IrDecoder ir_decoder = {0};
+
 LabGPIO XDCS(1, 30);
 LabGPIO XCS(1, 14);
 LabGPIO XRST(0, 25);
 LabGPIO DREQ(1, 23);
 
 VS1053 Decoder(&XDCS, &XCS, &XRST, &DREQ);
-OledTerminal oled;
+OledPanel oled;
+OledFramebuffer display(&oled);
 
 uint8_t volume_level = kVolumeMin;
 uint8_t treble_level = kTrebleMin;
@@ -136,32 +211,139 @@ uint8_t pages = songNumber / 8;
 uint8_t current_page = 0;
 
 uint8_t song_count;
-ID3v1_t mp3_files[100];
-char fileName[100][256];
-
-uint32_t file_size = 0;
-uint32_t total_bytes_read = 0;
+TrackLibrary library;
+TrackLibrary::Details now_playing;     // cold tag fields of song_index
 
 FATFS fs;
-FIL song_file;
+#if FF_USE_FASTSEEK
+// Cluster link map for seeking into the main zone's file without walking the FAT,
+// enough for a file in 31 fragments
+const uint8_t kLinkMapSize = 64;
+DWORD song_link_map[kLinkMapSize];
+constexpr uint32_t kLinkMapBytes = sizeof(song_link_map);
+#else
+constexpr uint32_t kLinkMapBytes = 0;
+#endif
 
-bool play_pause = true;
 bool treble_bass = true;
 bool mute = false;
+bool card_error = false;    // SD card did not mount, RenderView shows only that
+
+DecoderTelemetry telemetry;
+ClockController clock_controller;
+UiStats ui_stats = {0};
+SpectrumStats spectrum_stats = {0};
 
 CommandList_t<32> command_list;
 RtosCommand rtos_command;
+StatsCommand stats_command(&telemetry, &Decoder, &clock_controller, &ui_stats, &spectrum_stats);
 CommandLine<command_list> ci;
 
-QueueHandle_t decoderQueueHandle;
 xQueueHandle irRemoteQueueHandle;
 xQueueHandle settingsCommandQueueHandle;
 
 TaskHandle_t prod;
+TaskHandle_t render;
+TaskHandle_t profiler;
+
+
+uint8_t spectrum_bands[OledFramebuffer::kColumns];
+uint8_t spectrum_band_count = 0;
+PluginLoader plugin_loader(&Decoder);
 
 SemaphoreHandle_t SPI_MUTEX = NULL;
 SemaphoreHandle_t SD_MUTEX = NULL;
 
+#if MP3_ZONE_COUNT > 1
+// Second zone's decoder on SSP0 (P2.22 SCK, P2.26 MISO, P2.27 MOSI), a bus
+// of its own: SSP1 has the main decoder and the OLED, SSP2 the SD card.
+SemaphoreHandle_t SSP0_MUTEX = NULL;
+LabGPIO XDCS2(2, 0);
+LabGPIO XCS2(2, 1);
+LabGPIO XRST2(2, 2);
+LabGPIO DREQ2(2, 4);
+VS1053 Decoder2(&XDCS2, &XCS2, &XRST2, &DREQ2, LabSpi::SPI_Port::kPort0);
+DecoderTelemetry telemetry2;
+#endif
+
+const uint8_t kMainZone = ZonePipeline::kMainZone;     // the zone the OLED and IR remote control
+const uint8_t kZoneCount = MP3_ZONE_COUNT;
+static_assert(kZoneCount >= 1 && kZoneCount <= 2, "Decoders go on SSP1 and SSP0, so one or two zones");
+
+Zone zones[kZoneCount] = {
+    { &Decoder, &DREQ, &SPI_MUTEX, &telemetry },
+#if MP3_ZONE_COUNT > 1
+    { &Decoder2, &DREQ2, &SSP0_MUTEX, &telemetry2 },
+#endif
+};
+Zone& main_zone = zones[kMainZone];
+ZoneScheduler zone_scheduler(kZoneCount);
+ZoneCommand zone_command(zones, &zone_scheduler);
+
+BenchCommand bench_command(&Decoder, &SPI_MUTEX, &SD_MUTEX);
+
+TraceBuffer trace_buffer;
+TraceCommand trace_command(&trace_buffer);
+
+DeferredLog deferred_log;
+LogCommand log_command(&deferred_log);
+
+CpuProfiler cpu_profiler;
+ProfileCommand profile_command(&cpu_profiler);
+
+DreqLatency dreq_latency(&deferred_log);
+DreqCommand dreq_command(&dreq_latency);
+
+PcmDsp pcm_dsp;             // main zone's WAV tracks only
+DspCommand dsp_command(&pcm_dsp);
+
+// Recording replaces playback on the main decoder. The terminal task starts
+// and stops it, the consumer drains the encoder, the SD reader writes.
+enum RecordState
+{
+    kRecordOff = 0,
+    kRecordStarting,        // encoder loading, the consumer keeps off the decoder
+    kRecordRunning,
+    kRecordStopping,        // stop requested, waiting for the encoder's last page
+    kRecordClosing          // every word read, the reader closes the file
+};
+volatile RecordState record_state = kRecordOff;
+bool record_odd_byte = false;
+uint64_t record_stop_time = 0;     // Uptime() of the stop request
+// Recording and uploads never run at the same time, each refuses to start
+// during the other, so they write the card from the same two buffers
+static_assert(RecordWriter::kBufferSize == UploadReceiver::kBufferSize &&
+              RecordWriter::kMaxBuffers == UploadReceiver::kMaxBuffers,
+              "Recording and upload share their sector buffers");
+uint8_t card_write_buffers[RecordWriter::kMaxBuffers][RecordWriter::kBufferSize];
+RecordWriter record_writer(card_write_buffers);
+bool StartRecording(const char * path, bool line_input);
+bool StopRecording();
+RecordCommand record_command(&record_writer, StartRecording, StopRecording);
+
+// A byte stream from the host in place of the SD card on the main zone. The
+// UART interrupt fills the ring, the SD reader moves it into the zone's queue.
+LabUart stream_uart;
+SerialStream serial_stream;
+bool StartStream();
+bool StopStream();
+StreamCommand stream_command(&serial_stream, &stream_uart, StartStream, StopStream);
+
+// File upload on the stream UART. The interrupt fills the receiver's
+// buffers, the terminal task running the command writes them.
+UploadReceiver upload_receiver(card_write_buffers);
+bool ReceiveUpload(const char * path, uint32_t size);
+UploadCommand upload_command(&upload_receiver, ReceiveUpload);
+
+void RecordPressStage(uint8_t press, uint8_t stage);
+PressLatency press_latency(RecordPressStage);
+PressCommand press_command(&press_latency);
+
+ResumeJournal resume_journal("RESUME.DAT");
+ResumeCommand resume_command(&resume_journal, &SD_MUTEX);
+ResumeJournal::State resume_state;  // loaded from the journal at boot
+bool resume_pending = false;        // scan task is still looking for resume_state's track
+
 
 // ------------- C O N S T A N T S ---------------
 char STATUS[11][17] = {
@@ -186,6 +368,14 @@ void button2ISR();
 void printSongList();
 void vIrRemoteTask(void * pvParameter);
 void vSettingsTask(void * pvParameter);
+void vRenderTask(void * pvParameter);
+void vSpectrumTask(void * pvParameter);
+void vTelemetryTask(void * pvParameter);
+void vLogTask(void * pvParameter);
+void vProfilerTask(void * pvParameter);
+void vScanTask(void * pvParameter);
+void RequestRender();
+void RenderView();
 volatile uint32_t low = 0;
 
 
@@ -193,109 +383,307 @@ volatile uint32_t low = 0;
 void MP3Init();
 void printMetaData(ID3v1_t mp3);
 void ReadSDCard(char* path, uint8_t* file_count);
+void OpenSong(uint8_t index);
+void OpenZoneSong(uint8_t zone, uint8_t index);
+bool NextSong(uint8_t zone);
+void SeekSong(uint32_t offset);
+bool IsBootTrack(uint8_t track);
+bool SongsReady();
+ResumeJournal::State CurrentResumeState();
+void SaveResumeIfDue();
+bool LoadPlugin(const char * path);
+void ResumePlayback();
+void ServiceRecording();
+void WriteRecording();
+void ReceiveSerialByte(uint8_t byte);
+void CardRead(uint8_t zone);
+void FirstAudio();
+void WakeReader();
+void SendStreamToken(uint8_t token);
+bool ReadTag(FIL * file, ID3v1_t * tag);
+void AddUploadedTrack(const char * path);
+uint8_t FindTrack(const char * path);
+bool IsZoneTrack(const char * path);
+void AppendFile(const char * path, const char * data, uint16_t length);
+void WriteFileAt(const char * path, uint32_t offset, const char * data, uint16_t length);
+uint16_t ReadFileTail(const char * path, uint32_t* offset, char * data);
+void SendSettingsCommand(SettingsCommand * command);
+
+
+
+
+// ------------- T A S K S  ---------------
+void vDecoderProducerTask(void *p);
+void vDecoderConsumerTask(void *p);
+
+
+void vFileTask(void *p);
+void vTerminalTask(void *p);
+
 
+// ------------- S T A T I C   A L L O C A T I O N  ---------------
+#if !configSUPPORT_STATIC_ALLOCATION
+#error "Player tasks and queues are statically allocated, enable configSUPPORT_STATIC_ALLOCATION"
+#endif
 
+enum TaskId
+{
+    kProducerTask = 0,
+    kConsumerTask,
+    kSettingsTask,
+    kTerminalTask,
+    kRenderTask,
+    kSpectrumTask,
+    kTelemetryTask,
+    kLogTask,
+    kProfilerTask,
+    kIrRemoteTask,
+    kScanTask,
+#if MP3_ZONE_COUNT > 1
+    kZoneConsumerTask,
+#endif
+    kTaskCount
+};
 
+struct TaskSpec
+{
+    TaskFunction_t function;
+    const char * name;
+    uint16_t stack_words;
+    UBaseType_t priority;
+    void * parameter;
+};
 
-// RTOS COMMAND constants for writing to CPU.TXT
-static constexpr const char kDescription[] =
-    "Display FreeRTOS runtime stats.";
-static constexpr const char kDivider[] =
-    "+------------------+-----------+------+------------+-------------+";
-static constexpr const char kHeader[] =
-    "|    Task Name     |   State   | CPU% | Stack Left |   Priority  |\r\n"
-    "|                  |           |      |  in words  | Base : Curr |";
+// Every task's stack size and priority in one place, in TaskId order.
+// Check 'profile' or the low stack warnings before shrinking a stack.
+constexpr TaskSpec kTaskTable[kTaskCount] = {
+    { vDecoderProducerTask, "PRODUCER",      1280, 2, nullptr },
+    { vDecoderConsumerTask, "CONSUMER",       896, 3, &zones[kMainZone] },
+    { vSettingsTask,        "SETTINGS",      1024, 2, nullptr },
+    { vTerminalTask,        "TERMINAL",      1024, 1, nullptr },
+    { vRenderTask,          "RENDER",        1024, 1, nullptr },
+    { vSpectrumTask,        "SPECTRUM",       512, 1, nullptr },
+    { vTelemetryTask,       "TELEMETRY",      512, 1, nullptr },
+    { vLogTask,             "LOG",            512, tskIDLE_PRIORITY, nullptr },
+    { vProfilerTask,        "PROFILER",       512, 1, nullptr },
+    { vIrRemoteTask,        "vIrRemoteTask",  512, 4, nullptr },
+    { vScanTask,            "SCAN",           768, 2, nullptr },
+#if MP3_ZONE_COUNT > 1
+    { vDecoderConsumerTask, "CONSUMER2",      384, 3, &zones[1] },
+#endif
+};
 
-static const char * RtosStateToString(eTaskState state)
+constexpr uint32_t StackOffset(uint8_t task)
 {
-    switch (state)
+    uint32_t offset = 0;
+    for(uint8_t i = 0; i < task; i++)
     {
-        case eTaskState::eBlocked: return "BLOCKED";
-        case eTaskState::eDeleted: return "DELETED";
-        case eTaskState::eInvalid: return "INVALID";
-        case eTaskState::eReady: return "READY";
-        case eTaskState::eRunning: return "RUNNING";
-        case eTaskState::eSuspended: return "SUSPENDED";
-        default: return "UNKNOWN";
+        offset += kTaskTable[i].stack_words;
     }
+    return offset;
 }
 
+const uint16_t kChunkSize = ZonePipeline::kChunkSize;
+// One zone gets the RAM of two zones' queues, enough to batch the reads a
+// 176.4 KB/s WAV needs
+const uint8_t kDecoderQueueDepth = (kZoneCount == 1) ? 4 : 2;
+// Free slots a zone needs before the reader picks it, so every f_read
+// covers several chunks
+const uint8_t kReadBatch = (kDecoderQueueDepth + 1) / 2;
+const uint8_t kIrQueueDepth = 10;
+const uint8_t kSettingsQueueDepth = 10;
+// Bytes read from the card that may still be queued or in the decoder's
+// FIFO, a resumed song backs up by this much
+const uint32_t kResumeRewind = (kDecoderQueueDepth + 1) * kChunkSize;
+// Warn when a task gets within this many words of the end of its stack
+const uint16_t kStackWarningWords = 64;
+
+constexpr uint32_t kStackWords = StackOffset(kTaskCount);
+constexpr uint32_t kStackBytes = kStackWords * sizeof(StackType_t);
+constexpr uint32_t kTaskBlockBytes = kTaskCount * sizeof(StaticTask_t);
+constexpr uint32_t kQueueBytes = kZoneCount * kDecoderQueueDepth * kChunkSize
+                               + kIrQueueDepth * sizeof(RemotePress)
+                               + kSettingsQueueDepth * sizeof(SettingsCommand)
+                               + (2 + kZoneCount) * sizeof(StaticQueue_t)
+                               + (1 + kZoneCount) * sizeof(StaticSemaphore_t)
+                               + sizeof(StaticEventGroup_t);
+constexpr uint32_t kRtosBytes = kStackBytes + kTaskBlockBytes + kQueueBytes;
+
+StackType_t task_stacks[kStackWords];
+StaticTask_t task_blocks[kTaskCount];
+TaskHandle_t task_handles[kTaskCount];
+uint32_t low_stack_warnings = 0;   // bit per TaskId, each task warns once
+
+uint8_t decoder_queue_storage[kZoneCount][kDecoderQueueDepth * kChunkSize];
+uint8_t ir_queue_storage[kIrQueueDepth * sizeof(RemotePress)];
+uint8_t settings_queue_storage[kSettingsQueueDepth * sizeof(SettingsCommand)];
+StaticQueue_t decoder_queues[kZoneCount];
+StaticQueue_t ir_queue;
+StaticQueue_t settings_queue;
+StaticSemaphore_t spi_mutex;
+StaticSemaphore_t sd_mutex;
+#if MP3_ZONE_COUNT > 1
+StaticSemaphore_t ssp0_mutex;
+#endif
+StaticEventGroup_t boot_event_group;
+EventGroupHandle_t boot_events;
+
+ZonePipeline pipeline(zones, kZoneCount, &zone_scheduler, &SD_MUTEX, kReadBatch, &serial_stream,
+                      { NextSong, CardRead, FirstAudio, WakeReader, SendStreamToken },
+                      { &trace_buffer, &dreq_latency, &clock_controller, &press_latency, &pcm_dsp,
+                        &deferred_log });
+
+// Every object above and every static inside a function, all of it in the
+// 64 KB main SRAM. The linker also fails the build on an overflow and
+// prints each region's use on every link (project.mk), which counts
+// SJSU-Dev2's and newlib's own statics too; kRuntimeReserve is kept for
+// those, so this assert fails first and names the player's share.
+constexpr uint32_t kPlayerBytes =
+    // Audio path
+    sizeof(zones) + sizeof(Decoder) + sizeof(XDCS) + sizeof(XCS) + sizeof(XRST) + sizeof(DREQ) +
+    sizeof(telemetry) + sizeof(clock_controller) + sizeof(zone_scheduler) + sizeof(pipeline) +
+    sizeof(pcm_dsp) + sizeof(plugin_loader) + sizeof(spectrum_bands) + sizeof(spectrum_stats) +
+#if MP3_ZONE_COUNT > 1
+    sizeof(Decoder2) + sizeof(XDCS2) + sizeof(XCS2) + sizeof(XRST2) + sizeof(DREQ2) + sizeof(telemetry2) +
+    sizeof(SSP0_MUTEX) +
+#endif
+    // Card, library and the files written to it
+    sizeof(fs) + sizeof(library) + sizeof(now_playing) + kLinkMapBytes +
+    sizeof(card_write_buffers) + sizeof(record_writer) + sizeof(upload_receiver) +
+    sizeof(resume_journal) + kLogSectorSize + sizeof(FILINFO) +
+    // Serial stream, display, remote and buttons
+    sizeof(stream_uart) + sizeof(serial_stream) + sizeof(oled) + sizeof(display) + sizeof(ui_stats) +
+    sizeof(IR) + sizeof(BUTTON1) + sizeof(BUTTON2) + sizeof(ir_decoder) + sizeof(press_latency) +
+    // Instruments
+    sizeof(trace_buffer) + sizeof(deferred_log) + sizeof(cpu_profiler) + sizeof(dreq_latency) +
+    // Terminal
+    sizeof(command_list) + sizeof(ci) + sizeof(rtos_command) + sizeof(stats_command) +
+    sizeof(zone_command) + sizeof(bench_command) + sizeof(trace_command) + sizeof(log_command) +
+    sizeof(profile_command) + sizeof(dreq_command) + sizeof(dsp_command) + sizeof(record_command) +
+    sizeof(stream_command) + sizeof(upload_command) + sizeof(press_command) + sizeof(resume_command) +
+    // Menu, levels and the bar graph
+    sizeof(volume_level) + sizeof(treble_level) + sizeof(bass_level) + sizeof(menu_index) +
+    sizeof(song_index) + sizeof(cursor_position) + sizeof(songNumber) + sizeof(pages) +
+    sizeof(current_page) + sizeof(song_count) + sizeof(treble_bass) + sizeof(mute) +
+    sizeof(card_error) + sizeof(spectrum_band_count) + sizeof(STATUS) + sizeof(low) +
+    // Recording and resume state
+    sizeof(record_state) + sizeof(record_odd_byte) + sizeof(record_stop_time) + sizeof(resume_state) +
+    sizeof(resume_pending) +
+    // Handles
+    sizeof(task_handles) + sizeof(low_stack_warnings) + sizeof(irRemoteQueueHandle) +
+    sizeof(settingsCommandQueueHandle) + sizeof(prod) + sizeof(render) + sizeof(profiler) +
+    sizeof(SPI_MUTEX) + sizeof(SD_MUTEX) + sizeof(boot_events);
+constexpr uint32_t kMainRamSize = 64 * 1024;
+constexpr uint32_t kRuntimeReserve = 2 * 1024;
+static_assert(kRtosBytes + kPlayerBytes <= kMainRamSize - kRuntimeReserve,
+              "Static RAM is over budget, see the linker's memory usage report");
+
+
+// ------------- B O O T   S T A G E S  ---------------
+// Stages that finish in MP3Init() are done before the scheduler starts,
+// the rest are set by the tasks that own them. A task waits only on the
+// stages it actually needs, so a slow card scan does not hold up the UI.
+enum BootStage
+{
+    kBootDisplay = 0,       // Splash screen, command line and IR input
+    kBootDecoder,           // VS1053 reset and volume set, consumer task
+    kBootMount,             // SD card mounted, scan task
+    kBootTrack,             // Current track found and opened, scan task
+    kBootFirstAudio,        // First chunk sent to the decoder, consumer task
+    kBootLibrary,           // Whole card scanned, scan task
+    kBootStageCount
+};
 
+const char * const kBootStageNames[kBootStageCount] = {
+    "display", "decoder", "mount", "track", "first audio", "library"
+};
 
-// ------------- T A S K S  ---------------
-void vDecoderProducerTask(void *p);
-void vDecoderConsumerTask(void *p);
-
-
-void vFileTask(void *p);
-void vTerminalTask(void *p);
+constexpr EventBits_t BootBit(BootStage stage)
+{
+    return static_cast<EventBits_t>(1) << stage;
+}
 
+void BootStageDone(BootStage stage);
+void WaitForBoot(EventBits_t stages);
+void CheckStacks();
 
 
-    
 int main(void)
 {
+    boot_events = xEventGroupCreateStatic(&boot_event_group);
+
     MP3Init();
 
-    SPI_MUTEX = xSemaphoreCreateMutex();
-    SD_MUTEX = xSemaphoreCreateMutex();
+    SPI_MUTEX = xSemaphoreCreateMutexStatic(&spi_mutex);
+    SD_MUTEX = xSemaphoreCreateMutexStatic(&sd_mutex);
+#if MP3_ZONE_COUNT > 1
+    SSP0_MUTEX = xSemaphoreCreateMutexStatic(&ssp0_mutex);
+#endif
 
-    // // OPTIMIZE WITH TYPEDEF OR SOMETHING
-    uint8_t chunk_buffer[512] = {0};
-    decoderQueueHandle = xQueueCreate(2, sizeof(chunk_buffer));
+    for(uint8_t zone = 0; zone < kZoneCount; zone++)
+    {
+        zones[zone].queue = xQueueCreateStatic(kDecoderQueueDepth, kChunkSize,
+                                               decoder_queue_storage[zone], &decoder_queues[zone]);
+        zones[zone].playing = true;
+    }
 
     LOG_INFO("Starting IR Application. . . .");
-    irRemoteQueueHandle = xQueueCreate(10, sizeof(uint16_t));
-    settingsCommandQueueHandle = xQueueCreate(10, sizeof(SettingsCommand));
-
-    xTaskCreate(
-            vDecoderProducerTask, 
-            "PRODUCER", 
-            2048, 
-            NULL, 
-            2, 
-            &prod
-        );
-    xTaskCreate(
-            vDecoderConsumerTask, 
-            "CONSUMER", 
-            1024, 
-            NULL, 
-            3, 
-            NULL
-        );
-
-    
-    xTaskCreate(
-            vSettingsTask, 
-            "SETTINGS", 
-            1024, 
-            NULL, 
-            2, 
-            NULL
-        );
-    xTaskCreate(
-            vTerminalTask,
-            "TERMINAL",
-            1024,
-            NULL,
-            1,
-            NULL
-        );
-    xTaskCreate(
-            vIrRemoteTask,           /* Function that implements the task. */
-            "vIrRemoteTask",         /* Text name for the task. */
-            STACK_SIZE,              /* Stack size in words, not bytes. */
-            NULL,                    /* Parameter passed into the task. */
-            4,                       /* Priority at which the task is created. */
-            NULL                     /* Used to pass out the created task's handle. */
-        );                         
+    irRemoteQueueHandle = xQueueCreateStatic(kIrQueueDepth, sizeof(RemotePress),
+                                             ir_queue_storage, &ir_queue);
+    settingsCommandQueueHandle = xQueueCreateStatic(kSettingsQueueDepth, sizeof(SettingsCommand),
+                                                    settings_queue_storage, &settings_queue);
 
+    for(uint8_t task = 0; task < kTaskCount; task++)
+    {
+        task_handles[task] = xTaskCreateStatic(
+                kTaskTable[task].function,
+                kTaskTable[task].name,
+                kTaskTable[task].stack_words,
+                kTaskTable[task].parameter,
+                kTaskTable[task].priority,
+                &task_stacks[StackOffset(task)],
+                &task_blocks[task]
+            );
+    }
+    prod = task_handles[kProducerTask];
+    render = task_handles[kRenderTask];
+    profiler = task_handles[kProfilerTask];
 
     vTaskStartScheduler();
   return 0;
 }
 
+void BootStageDone(BootStage stage)
+{
+    deferred_log.Log("Boot: %s at %lu ms", kBootStageNames[stage],
+                     static_cast<uint32_t>(Uptime() / 1000));
+    xEventGroupSetBits(boot_events, BootBit(stage));
+}
+
+void WaitForBoot(EventBits_t stages)
+{
+    xEventGroupWaitBits(boot_events, stages, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+void CheckStacks()
+{
+    for(uint8_t task = 0; task < kTaskCount; task++)
+    {
+        // Terminal and spectrum tasks can delete themselves
+        if((low_stack_warnings & (1 << task)) || eTaskGetState(task_handles[task]) == eDeleted)
+        {
+            continue;
+        }
+        UBaseType_t left = uxTaskGetStackHighWaterMark(task_handles[task]);
+        if(left < kStackWarningWords)
+        {
+            low_stack_warnings |= (1 << task);
+            deferred_log.Log("Stack low: %s has %u of %u words left", kTaskTable[task].name,
+                             left, kTaskTable[task].stack_words);
+        }
+    }
+}
+
 void ReadSDCard(char* path, uint8_t* file_count)
 {
     *file_count = 0; 
@@ -304,86 +692,342 @@ void ReadSDCard(char* path, uint8_t* file_count)
     DIR dir;
     static FILINFO fno;
     FIL fsrc;                                               /* File object */
-    BYTE buffer[4096];                                      /* File copy buffer */
     FRESULT fr;                                             /* FatFs function common result code */
-    UINT br;                                                /* File read/write count */
-    FSIZE_t f_rd;                                           /* File read/write pointer */
+    DWORD cluster;                                          /* File start cluster */
     ID3v1_t mp3_info;
-
+    bool tagged;
+    bool added;
+    TrackLibrary::Status status;
+    bool opened = false;
+    bool opened_now;
+    uint16_t entry = 0;                                     /* Directory entries read so far */
+
+    if(!xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        return;
+    }
     res = f_opendir(&dir, path);                            /* Open the directory */
+    xSemaphoreGive(SD_MUTEX);
+
     if (res == FR_OK) 
     {
         while (1) 
         {
+            /* The card is shared with playback once the current track is open,
+               so the mutex is only held for one directory entry at a time */
+            xSemaphoreTake(SD_MUTEX, portMAX_DELAY);
             res = f_readdir(&dir, &fno);                    /* Read a directory item */
             
-            if (res != FR_OK || fno.fname[0] == 0) break;   /* Break on error or end of dir */
+            if (res != FR_OK || fno.fname[0] == 0)          /* Break on error or end of dir */
+            {
+                xSemaphoreGive(SD_MUTEX);
+                break;
+            }
 
-            if(strstr(fno.fname, ".mp3"))
+            entry++;
+            added = false;
+            opened_now = false;
+            if(strstr(fno.fname, ".mp3") || WavFile::IsWavName(fno.fname))
             {
-                /* Open and Read mp3 files */
+                /* Open and Read mp3 and wav files, either may end in an ID3v1 tag */
                 fr = f_open(&fsrc, fno.fname, FA_READ);
-                fr = f_read(&fsrc, buffer, sizeof(buffer), &br);   /* Read a chunk of source file */
-                if (fr || br == 0) break;                         /* error or eof */
-
-                
-                /* Record filenames */
-                uint16_t i = 0;
-                while (fno.fname[i] && i < 256) {
-                    fileName[*file_count][i] = fno.fname[i];
-                    i++;
+                if (fr)
+                {
+                    xSemaphoreGive(SD_MUTEX);
+                    break;
                 }
-                fileName[*file_count][i] = '\0';
-
-                br = 128;
-                f_rd = fno.fsize - 128;
-                fr = f_lseek(&fsrc, f_rd);
-                if(fr) break;
 
-                fr = f_read(&fsrc, mp3_info.buffer, sizeof(mp3_info.buffer), &br);    /* Read metadata into temp ID3v1 struct */
-                if (fr || br == 0) break;                               /* error or eof */
+                /* Read metadata into temp ID3v1 struct */
+                tagged = ReadTag(&fsrc, &mp3_info);
+                cluster = fsrc.obj.sclust;                        /* First cluster of the file */
+                f_close(&fsrc);
 
-                // printMetaData(mp3_info);
-                mp3_files[*file_count] = mp3_info;   /* store ID3v1 var into mp3_file arrray */
+                /* Only the title is kept, the rest is read back when the song plays */
+                status = library.Add(fno.fname, tagged ? &mp3_info : nullptr, fno.fsize, cluster);
+                added = (status == TrackLibrary::Status::kAdded);
+                if (!added)
+                {
+                    // fno is overwritten by the next f_readdir, long before the
+                    // log task formats this, so the entry's number stands in
+                    deferred_log.Log("Skipping directory entry %u: %s", entry,
+                                     TrackLibrary::StatusToString(status));
+                }
+                else if (!opened && IsBootTrack(*file_count))
+                {
+                    /* Start playing as soon as the current track turns up */
+                    song_index = *file_count;
+                    OpenSong(song_index);
+                    if (resume_pending)
+                    {
+                        SeekSong(resume_state.offset);
+                    }
+                    opened = true;
+                    opened_now = true;
+                }
+            }
+            xSemaphoreGive(SD_MUTEX);
 
+            if (added)
+            {
                 (*file_count)++;                /* Save total number of files on sd card */
+                if (opened_now)
+                {
+                    BootStageDone(kBootTrack);
+                }
             }
         }
+        xSemaphoreTake(SD_MUTEX, portMAX_DELAY);
         f_closedir(&dir);
+        xSemaphoreGive(SD_MUTEX);
 
         printf("File Count: %d \n",*file_count);
-        int j = 0;
-        for (int i = 0; i < *file_count; i++) 
+        printf("Track list: %u of %u arena bytes used, %u saved by sharing\n",
+               library.GetArenaUsed(), TrackLibrary::kArenaSize, library.GetArenaSaved());
+        if (library.GetArenaFull())
+        {
+            printf("Track list: names did not fit, %lu tracks skipped or shown by file name\n",
+                   static_cast<unsigned long>(library.GetArenaFull()));
+        }
+    }
+}
+
+// Reads the ID3v1 tag from the end of an open track. Caller must hold
+// SD_MUTEX.
+bool ReadTag(FIL * file, ID3v1_t * tag)
+{
+    UINT bytes_read = 0;
+    FSIZE_t size = f_size(file);
+
+    if(size >= sizeof(tag->buffer) && f_lseek(file, size - sizeof(tag->buffer)) == FR_OK)
+    {
+        f_read(file, tag->buffer, sizeof(tag->buffer), &bytes_read);
+    }
+    return bytes_read == sizeof(tag->buffer);
+}
+
+// Puts an uploaded track at the end of the list without rescanning the
+// card, or points the listed track at a file uploaded over it. Caller must
+// hold SD_MUTEX.
+void AddUploadedTrack(const char * path)
+{
+    FIL file;
+    ID3v1_t tag;
+    bool tagged;
+    uint8_t track;
+    TrackLibrary::Status status;
+
+    // The scan lists names without the root's '/', "/a.mp3" is "a.mp3"
+    if(path[0] == '/')
+    {
+        path++;
+    }
+    if(!strstr(path, ".mp3") && !WavFile::IsWavName(path))
+    {
+        return;
+    }
+    if(f_open(&file, path, FA_READ) != FR_OK)
+    {
+        return;
+    }
+    // Names are logged from the library, path is the terminal's to reuse
+    track = FindTrack(path);
+    if(track < song_count)
+    {
+        // No zone has it open, ReceiveUpload() checked under SD_MUTEX
+        library.Update(track, f_size(&file), file.obj.sclust);
+        deferred_log.Log("Track %u replaced: %s", track, library.GetName(track));
+    }
+    else
+    {
+        tagged = ReadTag(&file, &tag);
+        // Entry first, count second, the UI only looks below song_count
+        status = library.Add(path, tagged ? &tag : nullptr, f_size(&file), file.obj.sclust);
+        if(status == TrackLibrary::Status::kAdded)
+        {
+            song_count++;
+            deferred_log.Log("Track %u added: %s", track, library.GetName(track));
+        }
+        else
+        {
+            deferred_log.Log("Upload not listed: %s", TrackLibrary::StatusToString(status));
+        }
+    }
+    f_close(&file);
+}
+
+// @return the track listed under path, or song_count if there is none
+uint8_t FindTrack(const char * path)
+{
+    uint8_t track = 0;
+
+    if(path[0] == '/')
+    {
+        path++;
+    }
+    while(track < song_count && strcmp(library.GetName(track), path) != 0)
+    {
+        track++;
+    }
+    return track;
+}
+
+// A zone keeps its track's file open until it opens the next one, playing
+// or paused. Caller must hold SD_MUTEX.
+bool IsZoneTrack(const char * path)
+{
+    uint8_t track = FindTrack(path);
+
+    for(uint8_t zone = 0; zone < kZoneCount && track < song_count; zone++)
+    {
+        if(zones[zone].song_index == track)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Opens a track on the main zone and loads its details for the display.
+// Caller must hold SD_MUTEX.
+void OpenSong(uint8_t index)
+{
+    OpenZoneSong(kMainZone, index);
+    library.LoadDetails(index, &now_playing);
+}
+
+// Opens a track for the SD reader to feed a zone. Caller must hold SD_MUTEX.
+void OpenZoneSong(uint8_t zone, uint8_t index)
+{
+    pipeline.Open(zone, index, library.GetName(index));
+}
+
+// End of a zone's track. The main zone goes through the settings task like
+// a remote press, the others open their next track here. With the settings
+// queue full nothing changes and the reader tries again after its sleep.
+bool NextSong(uint8_t zone)
+{
+    SettingsCommand command;
+    uint8_t previous = song_index;
+
+    zones[zone].changing = true;
+    if(zone == kMainZone)
+    {
+        // AUTOPLAY
+        if(song_index != song_count - 1)
+        {
+            song_index++;
+        }
+        else
+        {
+            song_index = kFirstSong;
+        }
+
+        // Send Command For kSongCommand
+        command.type = kSongCommand;
+        command.value = song_index;
+        command.press = PressLatency::kNoPress;
+        if(xQueueSend(settingsCommandQueueHandle, &command, 0) != pdTRUE)
         {
-            printf("File Name: %s\n", fileName[i]);
+            song_index = previous;
+            zones[zone].changing = false;
+            return false;
         }
     }
+    else if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        OpenZoneSong(zone, (zones[zone].song_index + 1) % song_count);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    return true;
+}
+
+// Moves the open song to a resumed position, using the fast seek link map
+// when FatFS has it. Caller must hold SD_MUTEX.
+void SeekSong(uint32_t offset)
+{
+    uint64_t start_time = Uptime();
+    bool fast_seek = false;
+    // 0, or where a WAV's samples start. Chunks stay whole samples from there.
+    uint32_t start = main_zone.total_bytes_read;
+
+    offset = (offset > kResumeRewind) ? offset - kResumeRewind : 0;
+    offset = (offset > start) ? offset - (offset - start) % kChunkSize : start;
+    if(offset >= main_zone.file_size)
+    {
+        offset = start;
+    }
+#if FF_USE_FASTSEEK
+    song_link_map[0] = kLinkMapSize;
+    main_zone.file.cltbl = song_link_map;
+    fast_seek = (f_lseek(&main_zone.file, CREATE_LINKMAP) == FR_OK);
+    if(!fast_seek)
+    {
+        main_zone.file.cltbl = nullptr;     // Too fragmented, walk the FAT instead
+    }
+#endif
+    if(f_lseek(&main_zone.file, offset) != FR_OK)
+    {
+        offset = start;
+        f_lseek(&main_zone.file, start);
+    }
+    main_zone.total_bytes_read = offset;
+    resume_journal.SetResumed(offset, Uptime() - start_time, fast_seek);
+}
+
+// At boot the song to open is the one named in the resume journal, found by
+// cluster and size since the card may have changed, otherwise song_index.
+// The remote's song commands wrap around song_count, which only grows
+// while the card is scanned and stays 0 without a card
+bool SongsReady()
+{
+    return (xEventGroupGetBits(boot_events) & BootBit(kBootLibrary)) && song_count > 0;
+}
+
+bool IsBootTrack(uint8_t track)
+{
+    if(resume_pending)
+    {
+        return library.GetCluster(track) == resume_state.cluster &&
+               library.GetSize(track) == resume_state.size;
+    }
+    return track == song_index;
+}
+
+ResumeJournal::State CurrentResumeState()
+{
+    ResumeJournal::State state;
+
+    state.cluster = library.GetCluster(song_index);
+    state.size = library.GetSize(song_index);
+    state.offset = main_zone.total_bytes_read;
+    state.track = song_index;
+    state.volume = volume_level;
+    state.treble = treble_level;
+    state.bass = bass_level;
+    return state;
 }
 
 
+// Only the fast, dependency free stage runs here so the splash screen and IR
+// remote are up before the scheduler starts. The decoder is brought up by the
+// consumer task and the card by the scan task, at the same time.
 void MP3Init()
 {
-    FRESULT res;
-    char dir_path[512];
     song_count = 0;
     
     // INITIALIZE DEVICES
-    LOG_INFO("Starting Decoder...");
-    Decoder.init();
-    Decoder.setVolume(volume_level);
-
-    LOG_INFO("SINE TEST...");
-    // Decoder.sineTest(200);
+    TraceBuffer::Initialize();
 
     LOG_INFO("Starting OLED...");
     oled.Initialize();
-    oled.printf("                "\
+    display.printf("                "\
                 " Khalil's Kids' "\
                 "      MP3       "\
                 "                "\
                 "                "\
                 "  Press SOURCE  "\
                 "    to start!   ");
+    display.Flush();
 
     LOG_INFO("Starting Command Line Application");
     LOG_INFO("Adding common SJTwo commands to command line...");
@@ -392,6 +1036,45 @@ void MP3Init()
     LOG_INFO("Adding rtos command to command line...");
     ci.AddCommand(&rtos_command);
 
+    LOG_INFO("Adding stats command to command line...");
+    ci.AddCommand(&stats_command);
+
+    LOG_INFO("Adding bench command to command line...");
+    ci.AddCommand(&bench_command);
+
+    LOG_INFO("Adding trace command to command line...");
+    ci.AddCommand(&trace_command);
+
+    LOG_INFO("Adding log command to command line...");
+    ci.AddCommand(&log_command);
+
+    LOG_INFO("Adding profile command to command line...");
+    ci.AddCommand(&profile_command);
+
+    LOG_INFO("Adding dreq command to command line...");
+    ci.AddCommand(&dreq_command);
+
+    LOG_INFO("Adding press command to command line...");
+    ci.AddCommand(&press_command);
+
+    LOG_INFO("Adding resume command to command line...");
+    ci.AddCommand(&resume_command);
+
+    LOG_INFO("Adding zone command to command line...");
+    ci.AddCommand(&zone_command);
+
+    LOG_INFO("Adding dsp command to command line...");
+    ci.AddCommand(&dsp_command);
+
+    LOG_INFO("Adding record command to command line...");
+    ci.AddCommand(&record_command);
+
+    LOG_INFO("Adding stream command to command line...");
+    ci.AddCommand(&stream_command);
+
+    LOG_INFO("Adding upload command to command line...");
+    ci.AddCommand(&upload_command);
+
     LOG_INFO("Initializing CommandLine object...");
     ci.Initialize();
 
@@ -401,26 +1084,94 @@ void MP3Init()
     IR.SetAsInput();
     IR.AttachInterruptHandler(readIR_ISR, LabGPIO::Edge::kBoth);
 
-    LOG_INFO("Mounting SD Card...");
-    res = f_mount(&fs, "", 1);
-    if (res == FR_OK) {
-        LOG_INFO("File System Mounted Succesfully!");
-        LOG_INFO("Reading MP3 files from SD Card!");
-        strcpy(dir_path, "/");
-        ReadSDCard(dir_path, &song_count);
+    LOG_INFO("Initializing stream UART...");
+    stream_uart.Initialize(LabUart::kPort3, kStreamBaud, ReceiveSerialByte);
+
+    BootStageDone(kBootDisplay);
+}
+
+void vScanTask(void * pvParameter)
+{
+    FRESULT res = FR_NOT_READY;
+    char dir_path[16];
+    SettingsCommand command;
+
+    deferred_log.Log("Mounting SD Card...");
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        res = f_mount(&fs, "", 1);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    if(res != FR_OK)
+    {
+        deferred_log.Log("ERROR mounting SD card: %d", res);
+        card_error = true;
+        RequestRender();
+        vTaskDelete(nullptr);
+    }
+    BootStageDone(kBootMount);
+
+    xSemaphoreTake(SD_MUTEX, portMAX_DELAY);
+    resume_pending = resume_journal.Load(&resume_state);
+    xSemaphoreGive(SD_MUTEX);
+    if(resume_pending && resume_state.volume <= kVolumeMax &&
+       resume_state.treble <= kTrebleMax && resume_state.bass <= kBassMax)
+    {
+        deferred_log.Log("Resuming track %u at byte %lu", resume_state.track, resume_state.offset);
+        volume_level = resume_state.volume;
+        treble_level = resume_state.treble;
+        bass_level = resume_state.bass;
+
+        command.press = PressLatency::kNoPress;
+        command.type = kVolumeCommand;
+        command.value = volume_level * 10;
+        xQueueSend(settingsCommandQueueHandle, &command, 0);
+        command.type = kTrebleCommand;
+        command.value = treble_level;
+        xQueueSend(settingsCommandQueueHandle, &command, 0);
+        command.type = kBassCommand;
+        command.value = bass_level;
+        xQueueSend(settingsCommandQueueHandle, &command, 0);
+    }
+    else
+    {
+        resume_pending = false;
+    }
+
+    strcpy(dir_path, "/");
+    ReadSDCard(dir_path, &song_count);
+    if(!(xEventGroupGetBits(boot_events) & BootBit(kBootTrack)) && song_count > 0)
+    {
+        // The resumed song is gone, start from the top
+        deferred_log.Log("Resume track not found");
+        song_index = kFirstSong;
+        if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+        {
+            OpenSong(song_index);
+            xSemaphoreGive(SD_MUTEX);
+        }
+        BootStageDone(kBootTrack);
     }
-    else {
-        LOG_ERROR("ERROR");
-        oled.printf("ERROR");
+    resume_pending = false;
+    BootStageDone(kBootLibrary);
+
+    // Other zones start one track apart once the whole card is known
+    for(uint8_t zone = kMainZone + 1; zone < kZoneCount && song_count > 0; zone++)
+    {
+        if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+        {
+            OpenZoneSong(zone, (song_index + zone) % song_count);
+            xSemaphoreGive(SD_MUTEX);
+        }
     }
 
     for(int i = 0; i < song_count; i++)
     {
-        printf("%i. song: %s\n", i, fileName[i]);
+        printf("%i. song: %s\n", i, library.GetName(i));
     }
+    RequestRender();
 
-    // Open first song file for vFileTask
-    f_open(&song_file, fileName[song_index], FA_READ);
+    vTaskDelete(nullptr);
 }
 
 void printMetaData(ID3v1_t mp3)
@@ -430,69 +1181,114 @@ void printMetaData(ID3v1_t mp3)
         mp3.zero, mp3.track, mp3.genre);
 }
 
+// The one SD reader for every zone. ZoneScheduler picks the zone whose
+// audio runs out first among those with room, and the reader sleeps while
+// every zone is full or paused until a consumer takes a chunk.
 void vDecoderProducerTask(void *p)
 {
-    size_t bytes_read;
-    uint8_t buffer[512] = {0};
-    bool read_file = false;
-    FRESULT fo;
-    SettingsCommand command;
+    // Every free slot of a queue in one f_read, multi-block reads are what
+    // keep up with 176.4 KB/s PCM
+    alignas(int16_t) uint8_t buffer[kDecoderQueueDepth * kChunkSize] = {0};
+
+    WaitForBoot(BootBit(kBootDecoder) | BootBit(kBootTrack));
 
     while(1)
     {
-        while(total_bytes_read < file_size)
+        if(record_state != kRecordOff)
         {
-            if(!read_file)
-            {
-                if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
-                {
-                    f_read(&song_file, buffer, sizeof(buffer), &bytes_read);
-                    total_bytes_read += bytes_read;
-                    read_file = true;
-                    xSemaphoreGive(SD_MUTEX);
-                }
-            }
-            if(DREQ.ReadBool())
-            {
-                xQueueSend(decoderQueueHandle, &buffer, portMAX_DELAY);
-                vTaskDelay(45);
-                read_file = false;
-            }
+            WriteRecording();
+            continue;
         }
-
-        // AUTOPLAY
-        if(song_index != song_count - 1)
+        if(main_zone.streaming)
         {
-            song_index++;
+            pipeline.PumpStream(buffer, Uptime() / 1000);
         }
-        else
+        if(!pipeline.Read(buffer))
         {
-            song_index = kFirstSong;
+            ulTaskNotifyTake(pdTRUE, kReaderIdleMs);
         }
+        SaveResumeIfDue();
+    }
+}
 
-        // Send Command For kSongCommand
-        command.type = kSongCommand;
-        command.value = song_index;
-        xQueueSend(settingsCommandQueueHandle, &command, 0);
+// Periodic resume save, made between reads with a hold on the card of its
+// own so the sector write never stretches Read()'s
+void SaveResumeIfDue()
+{
+    if(!main_zone.playing || main_zone.streaming || !resume_journal.IsDue(Uptime()))
+    {
+        return;
+    }
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        resume_journal.Save(CurrentResumeState(), Uptime(), false);
+        xSemaphoreGive(SD_MUTEX);
     }
 }
 
+// One per zone, pvParameter is the Zone. DREQ latency, clock control, boot
+// timing and the trace follow the main zone only.
 void vDecoderConsumerTask(void *p)
 {
-    uint8_t buffer[512] = {0};
-    while(1)
+    Zone* zone = static_cast<Zone*>(p);
+    uint8_t index = zone - zones;
+    bool main = (index == kMainZone);
+
+    if(xSemaphoreTake(*zone->bus, portMAX_DELAY))
     {
-        if(xQueueReceive(decoderQueueHandle, &buffer, portMAX_DELAY))
-        {
-            if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
-            {
-                Decoder.SendData(buffer, sizeof(buffer));
-                xSemaphoreGive(SPI_MUTEX);
-            }
+        zone->decoder->init();
+        zone->decoder->setVolume(volume_level);
+        xSemaphoreGive(*zone->bus);
+    }
+    if(main)
+    {
+        BootStageDone(kBootDecoder);
+    }
+
+    while(1)
+    {
+        // A cut still pending when recording starts or ends is the
+        // consumer's to carry out, through Consume()
+        if(main && record_state != kRecordOff && !main_zone.cancel)
+        {
+            ServiceRecording();
+            continue;
+        }
+        if(pipeline.Consume(index, kRegisterFlushTimeoutMs) == ZonePipeline::Pass::kDecoderFull)
+        {
+            // Sleep rather than spin on DREQ, the reader gets the CPU
+            vTaskDelay(pdMS_TO_TICKS(kDecoderFullMs));
         }
     }
 }
 
+// Reader hook, SD_MUTEX still held. Opens the profiler's window to write
+// to the card.
+void CardRead(uint8_t zone)
+{
+    xTaskNotifyGive(profiler);
+}
+
+// Consumer hook, the main zone's first chunk is in the decoder
+void FirstAudio()
+{
+    BootStageDone(kBootFirstAudio);
+    if(resume_journal.IsResumed())
+    {
+        resume_journal.SetResumeToAudio(Uptime());
+    }
+}
+
+void WakeReader()
+{
+    xTaskNotifyGive(prod);
+}
+
+void SendStreamToken(uint8_t token)
+{
+    stream_uart.Send(token);
+}
+
 
 
 void vSettingsTask(void * pvParameter)
@@ -502,41 +1298,43 @@ void vSettingsTask(void * pvParameter)
     {
         if(xQueueReceive(settingsCommandQueueHandle, &command, portMAX_DELAY))
         {
+            press_latency.Stamp(command.press, PressLatency::kSettingsTask, Uptime());
             switch(command.type)
             {
+                // Settings only post to the decoder's register mailbox, the
+                // consumer writes them between SDI chunks
                 case kVolumeCommand:
-                    if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
-                    {
-                        printf("Changing volume to %d\n", command.value);
-                        Decoder.setVolume(command.value);
-                        xSemaphoreGive(SPI_MUTEX);
-                    }
+                    deferred_log.Log("Changing volume to %u", command.value);
+                    Decoder.setVolume(command.value);
+                    press_latency.Posted(command.press, Uptime());
                     break;
                 case kTrebleCommand:
-                    if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
-                    {
-                        printf("Changing treble to %d\n", command.value);
-                        Decoder.setTreble(command.value, 0x01);
-                        xSemaphoreGive(SPI_MUTEX);
-                    }
+                    deferred_log.Log("Changing treble to %u", command.value);
+                    Decoder.setTreble(command.value, 0x01);
+                    press_latency.Posted(command.press, Uptime());
                     break;
                 case kBassCommand:
-                    if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+                    deferred_log.Log("Changing bass to %u", command.value);
+                    Decoder.setBass(command.value, 0x01);
+                    press_latency.Posted(command.press, Uptime());
+                    break;
+                case kSongCommand:
+                    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
                     {
-                        printf("Changing bass to %d\n", command.value);
-                        Decoder.setBass(command.value, 0x01);
-                        xSemaphoreGive(SPI_MUTEX);
+                        trace_buffer.Record(trace::kSongChange, song_index);
+                        deferred_log.Log("Changing song to %u", command.value);
+                        clock_controller.NewTrack();
+                        OpenSong(song_index);
+                        deferred_log.Log("file size: %lu", main_zone.file_size);
+                        xSemaphoreGive(SD_MUTEX);
+                        press_latency.Stamp(command.press, PressLatency::kApplied, Uptime());
+                        press_latency.Complete(command.press);
                     }
                     break;
-                case kSongCommand:
+                case kSaveCommand:
                     if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
                     {
-                        printf("Changing song to %d\n", command.value);
-                        f_close(&song_file);
-                        f_open(&song_file, fileName[song_index], FA_READ);
-                        file_size = f_size(&song_file);
-                        printf("file size: %i\n", file_size);
-                        total_bytes_read = 0;
+                        resume_journal.Save(CurrentResumeState(), Uptime(), true);
                         xSemaphoreGive(SD_MUTEX);
                     }
                     break;
@@ -559,65 +1357,21 @@ void vTerminalTask(void *p)
 
 void vIrRemoteTask(void * pvParameter)
 {
-    uint16_t opcode = 0;
+    RemotePress remote_press;
     SettingsCommand command;
 
     while(1)
     {
-        if(xQueueReceive(irRemoteQueueHandle, &opcode, portMAX_DELAY))
+        if(xQueueReceive(irRemoteQueueHandle, &remote_press, portMAX_DELAY))
         {
-            switch(opcode)
+            press_latency.Stamp(remote_press.press, PressLatency::kIrTask, Uptime());
+            command.press = remote_press.press;
+
+            switch(remote_press.opcode)
             {
                 case IrOpcode::kSource:
                     menu_index = (menu_index + 1) % kMenuMaxSize;
-
-                    oled.Clear();
-                    switch(menu_index)
-                    {
-                        case kSongInfo:
-                            if(play_pause)
-                            {
-                                oled.printf("Now Playing...\n");
-                            }
-                            else
-                            {
-                                oled.printf("Paused...     \n");
-                            }
-                            
-                            oled.printf("Title: %s\n", mp3_files[song_index].title);
-                            oled.printf("Artist: %s\n", mp3_files[song_index].artist);
-                            oled.printf("Album: %s\n", mp3_files[song_index].album);
-                            break;
-
-                        case kSongList:
-                            {
-                                printSongList();
-                                break;
-                            }
-
-
-                        case kSettings:
-                            if(treble_bass)
-                            {
-                                oled.printf("****************");
-                                oled.printf("*    TREBLE    *");
-                                oled.printf("****************");
-                                oled.SetCursor(0, 4);
-                                oled.printf(STATUS[treble_level]);
-                                oled.printf("  -5    0    5  ");
-                            }
-                            else
-                            {
-                                oled.printf("****************");
-                                oled.printf("*     BASS     *");
-                                oled.printf("****************");
-                                oled.SetCursor(0, 4);
-                                oled.printf(STATUS[bass_level]);
-                                oled.printf("  -5    0    5  ");
-                            }    
-                            break;
-                    }
-
+                    RequestRender();
                     break;
 
                 case IrOpcode::kVolumeDown:
@@ -627,7 +1381,7 @@ void vIrRemoteTask(void * pvParameter)
                         // Send Command For kVolumeCommand
                         command.type = kVolumeCommand;
                         command.value = volume_level * 10;
-                        xQueueSend(settingsCommandQueueHandle, &command, 0);
+                        SendSettingsCommand(&command);
                     }
 
                     break;
@@ -639,7 +1393,7 @@ void vIrRemoteTask(void * pvParameter)
                         // Send Command For kVolumeCommand
                         command.type = kVolumeCommand;
                         command.value = volume_level * 10;
-                        xQueueSend(settingsCommandQueueHandle, &command, 0);
+                        SendSettingsCommand(&command);
                     }
 
                     break;
@@ -652,48 +1406,39 @@ void vIrRemoteTask(void * pvParameter)
                         // Send Command For kVolumeCommand
                         command.type = kVolumeCommand;
                         command.value = 100;
-                        xQueueSend(settingsCommandQueueHandle, &command, 0);
+                        SendSettingsCommand(&command);
                     }
                     else
                     {
                         // Send Command For kVolumeCommand
                         command.type = kVolumeCommand;
                         command.value = volume_level;
-                        xQueueSend(settingsCommandQueueHandle, &command, 0);
+                        SendSettingsCommand(&command);
                     }
 
                     break;
 
                 case IrOpcode::kSelectSong:
-                    if(menu_index == kSongList)
+                    if(menu_index == kSongList && SongsReady())
                     {
                         song_index = cursor_position;
                         menu_index = kSongInfo;
-                        play_pause = true;
-                        vTaskResume(prod);
+                        main_zone.playing = true;
 
                         // Send Command For kSongCommand
                         command.type = kSongCommand;
                         command.value = song_index;
-                        xQueueSend(settingsCommandQueueHandle, &command, 0);
+                        SendSettingsCommand(&command);
 
-                        oled.Clear();
-                        if(play_pause)
-                        {
-                            oled.printf("Now Playing...\n");
-                        }
-                        else
-                        {
-                            oled.printf("Paused...     \n");
-                        }
-                        
-                        oled.printf("Title: %s\n", mp3_files[song_index].title);
-                        oled.printf("Artist: %s\n", mp3_files[song_index].artist);
-                        oled.printf("Album: %s\n", mp3_files[song_index].album);
+                        RequestRender();
                     }
                     break;
 
                 case IrOpcode::kPrevious:
+                    if(!SongsReady())
+                    {
+                        break;
+                    }
                     if(song_index != kFirstSong)
                     {
                         song_index--;
@@ -703,59 +1448,48 @@ void vIrRemoteTask(void * pvParameter)
                         song_index = song_count - 1;
                     }
 
-                    play_pause = true;
-                    vTaskResume(prod);
+                    main_zone.playing = true;
 
                     // Send Command For kSongCommand
                     command.type = kSongCommand;
                     command.value = song_index;
-                    xQueueSend(settingsCommandQueueHandle, &command, 0);
+                    SendSettingsCommand(&command);
 
                     if(menu_index == kSongInfo)
                     {
-                        oled.Clear();
-                        if(play_pause)
-                        {
-                            oled.printf("Now Playing...\n");
-                        }
-                        else
-                        {
-                            oled.printf("Paused...     \n");
-                        }
-                        
-                        oled.printf("Title: %s\n", mp3_files[song_index].title);
-                        oled.printf("Artist: %s\n", mp3_files[song_index].artist);
-                        oled.printf("Album: %s\n", mp3_files[song_index].album);
+                        RequestRender();
                     }
                     break;
 
                 case IrOpcode::kPlayPause:
-                    play_pause = !play_pause;
-                    if(play_pause)
+                    main_zone.playing = !main_zone.playing;
+                    if(main_zone.playing)
                     {
-                        vTaskResume(prod);
+                        xTaskNotifyGive(prod);
                     }
                     else
                     {
-                        vTaskSuspend(prod);
+                        // The reader stops feeding the zone, what is queued still plays.
+                        // Pausing is the most likely moment before power off
+                        command.type = kSaveCommand;
+                        command.value = 0;
+                        command.press = PressLatency::kNoPress;
+                        xQueueSend(settingsCommandQueueHandle, &command, 0);
+                        command.press = remote_press.press;
                     }
 
                     if(menu_index == kSongInfo)
                     {
-                        oled.SetCursor(0, 0);
-                        if(play_pause)
-                        {
-                            oled.printf("Now Playing...\n");
-                        }
-                        else
-                        {
-                            oled.printf("Paused...     \n");
-                        }
+                        RequestRender();
                     }
 
                     break;
 
                 case IrOpcode::kNext:
+                    if(!SongsReady())
+                    {
+                        break;
+                    }
                     if(song_index != song_count - 1)
                     {
                         song_index++;
@@ -765,29 +1499,16 @@ void vIrRemoteTask(void * pvParameter)
                         song_index = kFirstSong;
                     }
 
-                    play_pause = true;
-                    vTaskResume(prod);
+                    main_zone.playing = true;
 
                     // Send Command For kSongCommand
                     command.type = kSongCommand;
                     command.value = song_index;
-                    xQueueSend(settingsCommandQueueHandle, &command, 0);
+                    SendSettingsCommand(&command);
 
                     if(menu_index == kSongInfo)
                     {
-                        oled.Clear();
-                        if(play_pause)
-                        {
-                            oled.printf("Now Playing...\n");
-                        }
-                        else
-                        {
-                            oled.printf("Paused...     \n");
-                        }
-                        
-                        oled.printf("Title: %s\n", mp3_files[song_index].title);
-                        oled.printf("Artist: %s\n", mp3_files[song_index].artist);
-                        oled.printf("Album: %s\n", mp3_files[song_index].album);
+                        RequestRender();
                     }
                     break;
 
@@ -797,21 +1518,14 @@ void vIrRemoteTask(void * pvParameter)
                         case kSongList:
                             if(cursor_position > kCursorPositionMin)
                             {
-                                oled.SetCursor(0, cursor_position);
-                                oled.printf(" ");
-
                                 cursor_position--;
-
-                                oled.SetCursor(0, cursor_position);
-                                oled.printf(">");
                             }
                             else if (current_page != 0)
                             {
                                 current_page--;
                                 cursor_position = 0;
-                                printSongList();
                             }
-
+                            RequestRender();
                             break;
 
                         case kSettings:
@@ -824,10 +1538,7 @@ void vIrRemoteTask(void * pvParameter)
                                     // Send Command For kTrebleCommand 
                                     command.type = kTrebleCommand;
                                     command.value = treble_level;
-                                    xQueueSend(settingsCommandQueueHandle, &command, 0);
-
-                                    oled.SetCursor(0, 4);
-                                    oled.printf(STATUS[treble_level]);
+                                    SendSettingsCommand(&command);
                                 }
                             }
                             else
@@ -839,12 +1550,10 @@ void vIrRemoteTask(void * pvParameter)
                                     // Send Command For kBassCommand
                                     command.type = kBassCommand;
                                     command.value = bass_level;
-                                    xQueueSend(settingsCommandQueueHandle, &command, 0);
-
-                                    oled.SetCursor(0, 4);
-                                    oled.printf(STATUS[bass_level]);
+                                    SendSettingsCommand(&command);
                                 }
                             }
+                            RequestRender();
                             break;
                     }
 
@@ -860,46 +1569,21 @@ void vIrRemoteTask(void * pvParameter)
                                 {
                                     if (cursor_position < ((songNumber % 8) - 1))
                                     {
-                                        oled.SetCursor(0, cursor_position);
-                                        oled.printf(" ");
-                                        if(cursor_position == 0)
-                                        {
-                                            char title[16] = {0};
-                                            memcpy(title, mp3_files[cursor_position  + (8 * current_page)].title, 15);
-                                            oled.printf(title);
-                                        }
                                         cursor_position++;
-
-                                        oled.SetCursor(0, cursor_position);
-                                        oled.printf(">");
                                     }
                                 }
                                 else
                                 {
-                                    oled.SetCursor(0, cursor_position);
-                                    oled.printf(" ");
-                                    if(cursor_position == 0)
-                                    {
-                                        char title[16] = {0};
-                                        memcpy(title, mp3_files[cursor_position + (8 * current_page)].title, 15);
-                                        oled.printf(title);
-                                    }
-
                                     cursor_position++;
-
-                                    oled.SetCursor(0, cursor_position);
-                                    oled.printf(">");
                                 }
-                                
                             }
                             else if (current_page < pages)
                             {
                                 current_page++;
-                                LOG_INFO("current page %d", current_page);
+                                deferred_log.Log("current page %u", current_page);
                                 cursor_position = 0;
-                                printSongList();
                             }
-
+                            RequestRender();
                             break;
 
                         case kSettings:
@@ -912,10 +1596,7 @@ void vIrRemoteTask(void * pvParameter)
                                     // Send Command For kTrebleCommand
                                     command.type = kTrebleCommand;
                                     command.value = treble_level;
-                                    xQueueSend(settingsCommandQueueHandle, &command, 0);
-
-                                    oled.SetCursor(0, 4);
-                                    oled.printf(STATUS[treble_level]);
+                                    SendSettingsCommand(&command);
                                 }
                             }
                             else
@@ -927,12 +1608,10 @@ void vIrRemoteTask(void * pvParameter)
                                     // Send Command For kBassCommand
                                     command.type = kBassCommand;
                                     command.value = bass_level;
-                                    xQueueSend(settingsCommandQueueHandle, &command, 0);
-
-                                    oled.SetCursor(0, 4);
-                                    oled.printf(STATUS[bass_level]);
+                                    SendSettingsCommand(&command);
                                 }
                             }
+                            RequestRender();
                             break;
                     }
                     break;
@@ -941,68 +1620,853 @@ void vIrRemoteTask(void * pvParameter)
                     if(menu_index == kSettings)
                     {
                         treble_bass = !treble_bass;
-                        if(treble_bass)
-                        {
-                            oled.SetCursor(0, 1);
-                            oled.printf("*    TREBLE    *");
-                            oled.SetCursor(0, 4);
-                            oled.printf(STATUS[treble_level]);
-                        }
-                        else
-                        {
-                            oled.SetCursor(0, 1);
-                            oled.printf("*     BASS     *");
-                            oled.SetCursor(0, 4);
-                            oled.printf(STATUS[bass_level]);
-                        }                        
+                        RequestRender();
                     }
                     break;
 
                 default:
                     break;
             }
+
+            // Presses that only change the UI are done here
+            if(!press_latency.IsForwarded(remote_press.press))
+            {
+                press_latency.Complete(remote_press.press);
+            }
         }
     }
 }
 
+void SendSettingsCommand(SettingsCommand * command)
+{
+    press_latency.Stamp(command->press, PressLatency::kSettingsQueued, Uptime());
+    xQueueSend(settingsCommandQueueHandle, command, 0);
+}
+
+void RecordPressStage(uint8_t press, uint8_t stage)
+{
+    trace_buffer.Record(trace::kPressStage, (press << 8) | stage);
+}
+
+void RequestRender()
+{
+    uint64_t now = Uptime();
 
+    // Only the oldest unserved request is timed, later ones coalesce into it
+    taskENTER_CRITICAL();
+    if(ui_stats.request_time == 0)
+    {
+        ui_stats.request_time = now;
+    }
+    else
+    {
+        ui_stats.coalesced_requests++;
+    }
+    taskEXIT_CRITICAL();
+    xTaskNotifyGive(render);
+}
+
+void RenderView()
+{
+    display.Clear();
+    if(card_error)
+    {
+        display.printf("ERROR\n");
+        display.printf("No SD card\n");
+        return;
+    }
+    switch(menu_index)
+    {
+        case kSongInfo:
+            if(main_zone.playing)
+            {
+                display.printf("Now Playing...\n");
+            }
+            else
+            {
+                display.printf("Paused...     \n");
+            }
+            
+            // Cut to exactly one row each, the full row wraps to the next page
+            display.printf("Title: %-9.9s", library.GetTitle(song_index));
+            display.printf("Artist: %-8.8s", now_playing.artist);
+            display.printf("Album: %-9.9s", now_playing.album);
+            if(telemetry.GetUpdates() > 0)
+            {
+                uint16_t elapsed = telemetry.GetElapsed();
+                display.printf("%s %lukbps\n", DecoderTelemetry::FormatToString(telemetry.GetFormat()),
+                               telemetry.GetBitrate() / 1000);
+                display.printf("%02u:%02u\n", elapsed / 60, elapsed % 60);
+            }
+            break;
+
+        case kSongList:
+            printSongList();
+            break;
+
+        case kSettings:
+            display.printf("****************");
+            if(treble_bass)
+            {
+                display.printf("*    TREBLE    *");
+            }
+            else
+            {
+                display.printf("*     BASS     *");
+            }
+            display.printf("****************");
+            display.SetCursor(0, 4);
+            display.printf(STATUS[treble_bass ? treble_level : bass_level]);
+            display.printf("  -5    0    5  ");
+            break;
+
+        case kSpectrum:
+            display.printf("    SPECTRUM    ");
+            // Levels are 0-63, one text row per 9 levels on the 7 rows below the title
+            for(uint8_t band = 0; band < spectrum_band_count; band++)
+            {
+                uint8_t height = spectrum_bands[band] / 9;
+                for(uint8_t row = 0; row < height; row++)
+                {
+                    display.SetCursor(band, OledFramebuffer::kPages - 1 - row);
+                    display.printf("|");
+                }
+            }
+            break;
+    }
+}
+
+bool LoadPlugin(const char * path)
+{
+    bool opened = false;
+
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        opened = plugin_loader.Open(path);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    if(!opened)
+    {
+        LOG_WARNING("Plugin %s not found", path);
+        return false;
+    }
+
+    while(!plugin_loader.Done())
+    {
+        if(plugin_loader.NeedsData() && xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+        {
+            plugin_loader.Refill();
+            xSemaphoreGive(SD_MUTEX);
+        }
+        if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+        {
+            plugin_loader.Write(kPluginWordsPerSlice);
+            xSemaphoreGive(SPI_MUTEX);
+        }
+        // Let the consumer send audio between slices
+        taskYIELD();
+    }
+
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        plugin_loader.Close();
+        xSemaphoreGive(SD_MUTEX);
+    }
+
+    LOG_INFO("Plugin %s: %lu words in %lu slices, load time %lu, max slice %lu",
+        path,
+        plugin_loader.GetWordsWritten(),
+        plugin_loader.GetSlices(),
+        static_cast<uint32_t>(plugin_loader.GetLoadTime()),
+        static_cast<uint32_t>(plugin_loader.GetMaxSliceTime()));
+
+    if(!plugin_loader.Succeeded())
+    {
+        LOG_WARNING("Plugin %s is corrupt", path);
+    }
+    return plugin_loader.Succeeded();
+}
+
+// Terminal task. Takes the main decoder off playback and starts the
+// encoder, or puts playback back if any step fails.
+bool StartRecording(const char * path, bool line_input)
+{
+    bool opened = false;
+
+    if(record_state != kRecordOff || main_zone.streaming || upload_receiver.IsOpen())
+    {
+        return false;
+    }
+    // The consumer leaves the decoder alone from here on, once it has
+    // dropped the queued chunks and cancelled the decoder's stream
+    record_state = kRecordStarting;
+    main_zone.playing = false;
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        pipeline.Cut(kMainZone);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    while(main_zone.cancel)
+    {
+        vTaskDelay(kRecordPollMs);
+    }
+
+    if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+    {
+        Decoder.prepareRecording();
+        xSemaphoreGive(SPI_MUTEX);
+    }
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        opened = record_writer.Open(path);
+        xSemaphoreGive(SD_MUTEX);
+    }
+
+    if(!opened || !LoadPlugin(kEncoderPlugin))
+    {
+        if(opened && xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+        {
+            record_writer.Close(false);
+            xSemaphoreGive(SD_MUTEX);
+        }
+        if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+        {
+            Decoder.endRecording();
+            xSemaphoreGive(SPI_MUTEX);
+        }
+        ResumePlayback();
+        return false;
+    }
+
+    if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+    {
+        Decoder.startRecording(line_input, 0);
+        xSemaphoreGive(SPI_MUTEX);
+    }
+    record_state = kRecordRunning;
+    deferred_log.Log("Recording started, %s input", line_input ? "line" : "mic");
+    return true;
+}
+
+// Terminal task. Waits for the consumer to read the last word and the
+// reader to close the file, then plays again.
+bool StopRecording()
+{
+    if(record_state != kRecordRunning)
+    {
+        return false;
+    }
+    if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+    {
+        Decoder.stopRecording();
+        xSemaphoreGive(SPI_MUTEX);
+    }
+    // The consumer gives up on the encoder after kRecordStopTimeoutMs, so
+    // this wait ends
+    record_stop_time = Uptime();
+    record_state = kRecordStopping;
+    while(record_state != kRecordOff)
+    {
+        vTaskDelay(kRecordPollMs);
+    }
+    deferred_log.Log("Recording stopped, %lu bytes, %lu words dropped",
+                     record_writer.GetBytesWritten(), record_writer.GetDroppedWords());
+
+    // The soft reset took the spectrum plugin with the encoder
+    LoadPlugin("spectrum.bin");
+    ResumePlayback();
+    return true;
+}
+
+// The decoder was reset under the track, so it starts again from the top
+void ResumePlayback()
+{
+    record_state = kRecordOff;
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        // Anything queued since the recording started goes through the
+        // consumer, as any other cut
+        pipeline.Cut(kMainZone);
+        OpenSong(song_index);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    main_zone.playing = true;
+    xTaskNotifyGive(prod);
+}
+
+// Consumer side of a recording, in place of playback: reads the encoder in
+// batches once enough is waiting and wakes the reader for each full buffer
+void ServiceRecording()
+{
+    uint16_t words[RecordWriter::kBatchWords];
+    uint16_t level;
+    uint16_t count;
+    uint16_t batch;
+    bool done = false;
+
+    if((record_state == kRecordRunning || record_state == kRecordStopping) &&
+       xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+    {
+        // Done before the level, so no word can arrive after the last look
+        if(record_state == kRecordStopping)
+        {
+            done = Decoder.recordingDone(&record_odd_byte);
+            if(!done && Uptime() - record_stop_time >= kRecordStopTimeoutMs * 1000)
+            {
+                deferred_log.Log("Recording: no last page after %lu ms, ending without it",
+                                 kRecordStopTimeoutMs);
+                record_odd_byte = false;
+                done = true;
+            }
+        }
+        level = Decoder.recordedWords();
+        count = record_writer.WordsToDrain(level, record_state == kRecordStopping);
+        done = done && (count == level);
+        while(count)
+        {
+            batch = (count < RecordWriter::kBatchWords) ? count : RecordWriter::kBatchWords;
+            Decoder.readRecorded(words, batch);
+            record_writer.Append(words, batch);
+            count -= batch;
+        }
+        if(done)
+        {
+            Decoder.endRecording();
+            record_state = kRecordClosing;
+        }
+        xSemaphoreGive(SPI_MUTEX);
+    }
+
+    if(record_writer.HasPending() || record_state == kRecordClosing)
+    {
+        xTaskNotifyGive(prod);
+    }
+    vTaskDelay(kRecordPollMs);
+}
+
+// Reader side of a recording: full buffers go to the card, and the file is
+// closed once the consumer has read the encoder's last word
+void WriteRecording()
+{
+    if(!record_writer.HasPending() && record_state != kRecordClosing)
+    {
+        ulTaskNotifyTake(pdTRUE, kReaderIdleMs);
+        return;
+    }
+
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        while(record_writer.WriteNext());
+        if(record_state == kRecordClosing)
+        {
+            if(!record_writer.Close(record_odd_byte))
+            {
+                deferred_log.Log("Recording: %lu write errors", record_writer.GetWriteErrors());
+            }
+            record_state = kRecordOff;
+        }
+        xSemaphoreGive(SD_MUTEX);
+    }
+}
+
+// Terminal task. The reader stops filling the main zone from the card and
+// the decoder drops what it has of the track, the stream starts clean.
+bool StartStream()
+{
+    if(main_zone.streaming || record_state != kRecordOff || upload_receiver.IsOpen())
+    {
+        return false;
+    }
+    main_zone.streaming = true;
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        pipeline.Cut(kMainZone);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    serial_stream.Start(Uptime() / 1000);
+    deferred_log.Log("Streaming from UART%u at %lu baud", LabUart::kPort3, stream_uart.GetBaud());
+    xTaskNotifyGive(prod);
+    return true;
+}
+
+// Terminal task. Back to the card, the track starts again from the top.
+bool StopStream()
+{
+    if(!main_zone.streaming)
+    {
+        return false;
+    }
+    serial_stream.Stop();
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        pipeline.Cut(kMainZone);
+        OpenSong(song_index);
+        main_zone.streaming = false;
+        xSemaphoreGive(SD_MUTEX);
+    }
+    deferred_log.Log("Stream stopped, %lu bytes, %lu overruns", serial_stream.GetReceived(),
+                     serial_stream.GetOverruns());
+    xTaskNotifyGive(prod);
+    return true;
+}
+
+// UART interrupt. During an upload every frame wakes the terminal task to
+// answer it, otherwise the reader is woken once a whole chunk of the
+// stream is waiting rather than left to the next consumer wakeup.
+void ReceiveSerialByte(uint8_t byte)
+{
+    BaseType_t woken = pdFALSE;
+
+    if(upload_receiver.IsOpen())
+    {
+        if(upload_receiver.Receive(byte))
+        {
+            vTaskNotifyGiveFromISR(task_handles[kTerminalTask], &woken);
+        }
+    }
+    else if(serial_stream.Receive(byte) == kChunkSize)
+    {
+        vTaskNotifyGiveFromISR(prod, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+// Terminal task, blocks until the file is in or the host has gone quiet.
+// Playback goes on, the buffers are written under SD_MUTEX between its reads.
+bool ReceiveUpload(const char * path, uint32_t size)
+{
+    uint8_t replies[4];
+    uint8_t count;
+    uint32_t frames = 0;
+    uint32_t now = Uptime() / 1000;
+    uint32_t last_frame = now;
+    bool opened = false;
+    bool complete = false;
+
+    // The stream and the upload share the UART
+    if(main_zone.streaming || record_state != kRecordOff)
+    {
+        return false;
+    }
+    // The scan task owns the library until it is done, and would list the
+    // file a second time if it got to it after the upload
+    if(!(xEventGroupGetBits(boot_events) & BootBit(kBootLibrary)))
+    {
+        return false;
+    }
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        // Renaming over the file a zone reads would pull it from under the
+        // zone, the old track would play on into the new one's clusters
+        opened = !IsZoneTrack(path) && upload_receiver.Open(size);
+        xSemaphoreGive(SD_MUTEX);
+    }
+    if(!opened)
+    {
+        return false;
+    }
+
+    while(!upload_receiver.IsComplete() && now - last_frame < kUploadTimeoutMs)
+    {
+        ulTaskNotifyTake(pdTRUE, kUploadPollMs);
+        now = Uptime() / 1000;
+        if(upload_receiver.HasPending() && xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+        {
+            while(upload_receiver.WriteNext());
+            xSemaphoreGive(SD_MUTEX);
+        }
+        // ACKs only move on once a buffer is written, so after the writes
+        count = upload_receiver.TakeReplies(replies, sizeof(replies), now);
+        for(uint8_t i = 0; i < count; i++)
+        {
+            stream_uart.Send(replies[i]);
+        }
+        if(upload_receiver.GetFrames() != frames)
+        {
+            frames = upload_receiver.GetFrames();
+            last_frame = now;
+        }
+    }
+
+    // The ACK of the last block, the host is done once it has it
+    count = upload_receiver.TakeReplies(replies, sizeof(replies), now);
+    for(uint8_t i = 0; i < count; i++)
+    {
+        stream_uart.Send(replies[i]);
+    }
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        // A zone may have opened the track since, it keeps the old file
+        complete = upload_receiver.Close(IsZoneTrack(path) ? nullptr : path);
+        if(complete)
+        {
+            AddUploadedTrack(path);
+        }
+        xSemaphoreGive(SD_MUTEX);
+    }
+    deferred_log.Log("Upload %s, %lu bytes, %lu CRC errors", complete ? "done" : "FAILED",
+                     upload_receiver.GetBytesWritten(), upload_receiver.GetCrcErrors());
+    return complete;
+}
+
+void vSpectrumTask(void * pvParameter)
+{
+    uint64_t start_time;
+
+    WaitForBoot(BootBit(kBootDecoder) | BootBit(kBootMount));
+
+    if(!LoadPlugin("spectrum.bin"))
+    {
+        vTaskDelete(nullptr);
+    }
+    spectrum_stats.load_time = plugin_loader.GetLoadTime();
+
+    while(1)
+    {
+        if(menu_index == kSpectrum && record_state == kRecordOff)
+        {
+            if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+            {
+                start_time = Uptime();
+                spectrum_band_count = Decoder.readSpectrum(spectrum_bands, sizeof(spectrum_bands));
+                spectrum_stats.last_spi_time = Uptime() - start_time;
+                xSemaphoreGive(SPI_MUTEX);
+            }
+
+            spectrum_stats.frames++;
+            if(spectrum_stats.last_spi_time > spectrum_stats.max_spi_time)
+            {
+                spectrum_stats.max_spi_time = spectrum_stats.last_spi_time;
+            }
+            RequestRender();
+        }
+
+        vTaskDelay(1000 / kSpectrumFramesPerSecond);
+    }
+}
+
+void vTelemetryTask(void * pvParameter)
+{
+    DecoderTelemetry::Registers registers;
+    uint64_t start_time;
+
+    WaitForBoot(BootBit(kBootDecoder));
+
+    while(1)
+    {
+        vTaskDelay(kTelemetryPeriodMs);
+
+        for(uint8_t zone = 0; zone < kZoneCount; zone++)
+        {
+            Zone& target = zones[zone];
+            if(target.bytes_sent == 0)
+            {
+                continue;   // Decoder not started yet
+            }
+            if(zone == kMainZone && record_state != kRecordOff)
+            {
+                continue;   // HDAT0/1 belong to the encoder
+            }
+            if(xSemaphoreTake(*target.bus, portMAX_DELAY))
+            {
+                start_time = Uptime();
+                target.decoder->readStatus(&registers.decode_time, &registers.hdat0,
+                                           &registers.hdat1, &registers.audata);
+                target.telemetry->RecordSpiTime(Uptime() - start_time);
+                xSemaphoreGive(*target.bus);
+            }
+            target.telemetry->Update(registers, target.bytes_sent, Uptime());
+            // Lets the reader weigh each zone by its real stream rate
+            zone_scheduler.SetByteRate(zone, target.telemetry->GetBitrate() / 8);
+        }
+        CheckStacks();
+
+        if(record_state == kRecordOff &&
+           clock_controller.Update(telemetry.GetFormat(), telemetry.GetBitrate(),
+                                   telemetry.GetSupplyRate()))
+        {
+            Decoder.setClock(clock_controller.GetClockf());
+        }
+
+        if(menu_index == kSongInfo)
+        {
+            RequestRender();
+        }
+    }
+}
+
+void AppendFile(const char * path, const char * data, uint16_t length)
+{
+    FIL file;
+    UINT written;
+
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        if(f_open(&file, path, FA_WRITE | FA_OPEN_APPEND) == FR_OK)
+        {
+            f_write(&file, data, length, &written);
+            f_close(&file);
+        }
+        xSemaphoreGive(SD_MUTEX);
+    }
+}
+
+// Overwrites, or extends the file if offset is its end
+void WriteFileAt(const char * path, uint32_t offset, const char * data, uint16_t length)
+{
+    FIL file;
+    UINT written;
+
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        if(f_open(&file, path, FA_WRITE | FA_OPEN_ALWAYS) == FR_OK)
+        {
+            if(f_lseek(&file, offset) == FR_OK)
+            {
+                f_write(&file, data, length, &written);
+            }
+            f_close(&file);
+        }
+        xSemaphoreGive(SD_MUTEX);
+    }
+}
+
+// Reads the file's last partial sector into data, offset set to where that
+// sector starts. A missing file reads as empty.
+//
+// @return bytes read, 0 if the file ends on a sector boundary
+uint16_t ReadFileTail(const char * path, uint32_t* offset, char * data)
+{
+    FIL file;
+    UINT bytes_read = 0;
+
+    *offset = 0;
+    if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+    {
+        if(f_open(&file, path, FA_READ) == FR_OK)
+        {
+            *offset = f_size(&file) - f_size(&file) % 512;
+            if(f_lseek(&file, *offset) == FR_OK)
+            {
+                f_read(&file, data, f_size(&file) % 512, &bytes_read);
+            }
+            f_close(&file);
+        }
+        xSemaphoreGive(SD_MUTEX);
+    }
+    return bytes_read;
+}
+
+// Writes to the card are whole sectors at sector offsets of LOG.TXT, so
+// FatFS never reads back a sector to merge a partial write. A partial
+// sector goes out padded with spaces and is written again in place as it
+// fills, the file always ends on a sector boundary.
+void vLogTask(void * pvParameter)
+{
+    char line[DeferredLog::kLineLength];
+    // One sector of LOG.TXT, the one at sd_offset
+    static char sd_buffer[kLogSectorSize];
+    uint32_t sd_offset = 0;
+    uint16_t sd_length = 0;
+    bool sd_located = false;
+    bool sd_dirty = false;
+    uint64_t sd_held_since = 0;
+
+    while(1)
+    {
+        while(deferred_log.Drain(line, sizeof(line)))
+        {
+            fputs(line, stdout);
+
+            if(!deferred_log.IsSdEnabled())
+            {
+                continue;
+            }
+            if(!sd_located)
+            {
+                // Carries on in the last sector of a log from an older
+                // build, which may not end on a boundary
+                sd_length = ReadFileTail("LOG.TXT", &sd_offset, sd_buffer);
+                sd_located = true;
+            }
+            uint16_t length = strlen(line);
+            uint16_t copied = 0;
+            while(copied < length)
+            {
+                uint16_t part = length - copied;
+                if(part > sizeof(sd_buffer) - sd_length)
+                {
+                    part = sizeof(sd_buffer) - sd_length;
+                }
+                if(!sd_dirty)
+                {
+                    sd_held_since = Uptime();
+                    sd_dirty = true;
+                }
+                memcpy(&sd_buffer[sd_length], &line[copied], part);
+                sd_length += part;
+                copied += part;
+                if(sd_length == sizeof(sd_buffer))
+                {
+                    WriteFileAt("LOG.TXT", sd_offset, sd_buffer, sizeof(sd_buffer));
+                    sd_offset += sizeof(sd_buffer);
+                    sd_length = 0;
+                    sd_dirty = false;
+                }
+            }
+        }
+
+        if(sd_dirty && Uptime() - sd_held_since > kLogSdFlushMs * 1000)
+        {
+            memset(&sd_buffer[sd_length], ' ', sizeof(sd_buffer) - sd_length);
+            sd_buffer[sizeof(sd_buffer) - 1] = '\n';
+            WriteFileAt("LOG.TXT", sd_offset, sd_buffer, sizeof(sd_buffer));
+            sd_dirty = false;
+        }
+
+        vTaskDelay(kLogPeriodMs);
+    }
+}
+
+void vProfilerTask(void * pvParameter)
+{
+    uint64_t start_time;
+    bool was_enabled = false;
+    FILINFO info;
+
+    while(1)
+    {
+        vTaskDelay(cpu_profiler.GetInterval());
+
+        if(cpu_profiler.IsEnabled() && !was_enabled)
+        {
+            // Line the staged sectors up with the end of the existing file
+            if(xSemaphoreTake(SD_MUTEX, portMAX_DELAY))
+            {
+                cpu_profiler.SetFileOffset((f_stat("CPU.TXT", &info) == FR_OK) ? info.fsize : 0);
+                xSemaphoreGive(SD_MUTEX);
+            }
+        }
+        was_enabled = cpu_profiler.IsEnabled();
+
+        if(was_enabled)
+        {
+            cpu_profiler.Sample(Uptime());
+        }
+
+        // When disabled, also write out the partial sector left over
+        while(cpu_profiler.ChunkReady() || (!was_enabled && cpu_profiler.GetPendingLength() > 0))
+        {
+            uint16_t length = cpu_profiler.ChunkReady() ? cpu_profiler.ChunkLength()
+                                                        : cpu_profiler.GetPendingLength();
+
+            // The producer notifies right after each read, its next read is
+            // at least 45 ms away so the card is free for one sector write
+            ulTaskNotifyTake(pdTRUE, 0);
+            ulTaskNotifyTake(pdTRUE, kProfilerWindowWaitMs);
+
+            start_time = Uptime();
+            AppendFile("CPU.TXT", cpu_profiler.GetChunk(), length);
+            cpu_profiler.ChunkWritten(length, Uptime() - start_time);
+        }
+    }
+}
+
+void vRenderTask(void * pvParameter)
+{
+    uint64_t frame_start;
+    uint64_t frame_end;
+    uint64_t request_time;
+
+    while(1)
+    {
+        // Any number of state changes since the last frame collapse into one
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Taken before drawing, a request made during this frame times the next
+        taskENTER_CRITICAL();
+        request_time = ui_stats.request_time;
+        ui_stats.request_time = 0;
+        taskEXIT_CRITICAL();
+
+        frame_start = Uptime();
+        RenderView();
+        // The panel is on SSP1 with the main decoder
+        if(xSemaphoreTake(SPI_MUTEX, portMAX_DELAY))
+        {
+            ui_stats.last_flush_bytes = display.Flush();
+            xSemaphoreGive(SPI_MUTEX);
+        }
+        frame_end = Uptime();
+
+        ui_stats.frames++;
+        ui_stats.last_frame_time = frame_end - frame_start;
+        if(ui_stats.last_frame_time > ui_stats.max_frame_time)
+        {
+            ui_stats.max_frame_time = ui_stats.last_frame_time;
+        }
+        if(request_time)
+        {
+            ui_stats.last_latency = frame_end - request_time;
+            if(ui_stats.last_latency > ui_stats.max_latency)
+            {
+                ui_stats.max_latency = ui_stats.last_latency;
+            }
+        }
+
+        // Rate limit: requests arriving during this delay wait for the next frame
+        vTaskDelay(1000 / kMaxFramesPerSecond);
+    }
+}
+
+
+
+#if MP3_DREQ_LATENCY && configUSE_TICK_HOOK
+// DREQ has no interrupt, catch it rising at tick resolution instead
+extern "C" void vApplicationTickHook()
+{
+    dreq_latency.Sample(DREQ.ReadBool(), main_zone.playing && record_state == kRecordOff, Uptime());
+}
+#endif
 
 void readIR_ISR() 
 {
     // printf("REMOTE ISR\n");
-    static uint8_t sample = 0;
-    static uint16_t opcode = 0;
-    static uint32_t start_time = 0;
-    static bool read_opcode = false;
-    static uint16_t prev_opcode = 0;
-    static uint64_t prev_sent_time = 0;
+    IrDecoder& ir = ir_decoder;
+    RemotePress remote_press;
     if(LPC_GPIOINT->IO0IntStatR & (1 << 18))
     {
-        start_time = Uptime();
+        ir.start_time = Uptime();
     }
     else
     {
-        opcode = (opcode << 1) | (((Uptime() - start_time) >> 7) == 5);
-        if(opcode == 0x9E00)
+        ir.opcode = (ir.opcode << 1) | (((Uptime() - ir.start_time) >> 7) == 5);
+        if(ir.opcode == 0x9E00)
         {
-            sample = 0;
+            ir.sample = 0;
         }
-        if(++sample == 16)
+        if(++ir.sample == 16)
         {
-            if(opcode == prev_opcode)
+            if(ir.opcode == ir.prev_opcode)
             {
-                if (Uptime() > prev_sent_time + DEBOUNCE_TIME_1MS)
+                if (Uptime() > ir.prev_sent_time + DEBOUNCE_TIME_1MS)
                 {
-                    prev_sent_time = Uptime();
-                    xQueueSendFromISR(irRemoteQueueHandle, &opcode, 0);
+                    ir.prev_sent_time = Uptime();
+                    trace_buffer.Record(trace::kIrOpcode, ir.opcode);
+                    remote_press.opcode = ir.opcode;
+                    remote_press.press = press_latency.Begin(Uptime());
+                    xQueueSendFromISR(irRemoteQueueHandle, &remote_press, 0);
 
                 }
             }
             else
             {
-                prev_sent_time = Uptime();
-                prev_opcode = opcode;
-                xQueueSendFromISR(irRemoteQueueHandle, &opcode, 0);
+                ir.prev_sent_time = Uptime();
+                ir.prev_opcode = ir.opcode;
+                trace_buffer.Record(trace::kIrOpcode, ir.opcode);
+                remote_press.opcode = ir.opcode;
+                remote_press.press = press_latency.Begin(Uptime());
+                xQueueSendFromISR(irRemoteQueueHandle, &remote_press, 0);
             }
         }
     }
@@ -1010,29 +2474,22 @@ void readIR_ISR()
 }
 void printSongList()
 {
-    oled.Clear();
-    char title[16] = {0};
-    //cursor_position = 0;
-
-    oled.printf(">");
-    
     for(uint8_t i = current_page * 8; i < (current_page * 8 + 8); i++)
     {
         if (current_page == pages) //last page only print remaining values
         {
-            if ((i % 8) < (songNumber % 8)) //if remainder less than slots then print
+            if ((i % 8) >= (songNumber % 8)) //past the last song on this page
             {
-                memcpy(title, mp3_files[i].title, 15);
-                oled.SetCursor(1, i % 8);
-                oled.printf(title); 
+                break;
             }
         }
-        else
+
+        if (i >= library.GetCount())
         {
-            memcpy(title, mp3_files[i].title, 15);
-            oled.SetCursor(1, i);
-            oled.printf(title); 
-        } 
-        
+            break;
+        }
+
+        display.SetCursor(0, i % 8);
+        display.printf("%c%.15s", (i % 8 == cursor_position) ? '>' : ' ', library.GetTitle(i));
     }   
 }
\ No newline at end of file